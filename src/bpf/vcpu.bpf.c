@@ -0,0 +1,64 @@
+/**
+ * Accounting of the vcpu threads on the sched_switch tracepoint
+ * The user space inserts the tids of the vcpus in the map vcpus, each switch adds the length of the slice that ends, and the cycles of the cpu during that slice
+ * Compiled with : clang -O2 -g -target bpf -c vcpu.bpf.c -o vcpu.bpf.o (cf. the option DIO_BPF of the CMakeLists.txt)
+ */
+
+#include <linux/bpf.h>
+#include <bpf/bpf_helpers.h>
+#include "vcpu.h"
+
+struct {
+    __uint (type, BPF_MAP_TYPE_HASH);
+    __uint (max_entries, VCPU_MAX_THREADS);
+    __type (key, __u32);
+    __type (value, struct vcpu_stat);
+} vcpus SEC (".maps");
+
+/// One cycle counter per cpu, opened by the user space (perf_event_open)
+struct {
+    __uint (type, BPF_MAP_TYPE_PERF_EVENT_ARRAY);
+    __uint (key_size, sizeof (__u32));
+    __uint (value_size, sizeof (__u32));
+} cycles SEC (".maps");
+
+/// The format of the tracepoint (/sys/kernel/tracing/events/sched/sched_switch/format)
+struct sched_switch_args {
+    __u64 pad;
+    char prev_comm [16];
+    int prev_pid;
+    int prev_prio;
+    long prev_state;
+    char next_comm [16];
+    int next_pid;
+    int next_prio;
+};
+
+SEC ("tracepoint/sched/sched_switch")
+int on_sched_switch (struct sched_switch_args * ctx) {
+    __u64 now = bpf_ktime_get_ns ();
+    struct bpf_perf_event_value counter = {};
+    int hasCycles = bpf_perf_event_read_value (&cycles, BPF_F_CURRENT_CPU, &counter, sizeof (counter)) == 0;
+
+    __u32 prev = ctx-> prev_pid;
+    struct vcpu_stat * s = bpf_map_lookup_elem (&vcpus, &prev);
+    if (s != 0 && s-> start != 0) {
+	__sync_fetch_and_add (&s-> runtime, now - s-> start);
+	if (hasCycles && s-> startCycles != 0 && counter.counter > s-> startCycles) {
+	    __sync_fetch_and_add (&s-> cycles, counter.counter - s-> startCycles);
+	}
+
+	s-> start = 0;
+    }
+
+    __u32 next = ctx-> next_pid;
+    s = bpf_map_lookup_elem (&vcpus, &next);
+    if (s != 0) {
+	s-> start = now;
+	s-> startCycles = hasCycles ? counter.counter : 0;
+    }
+
+    return 0;
+}
+
+char LICENSE [] SEC ("license") = "GPL";
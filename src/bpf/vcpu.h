@@ -0,0 +1,23 @@
+#pragma once
+
+#include <linux/types.h>
+
+/**
+ * The accounting of a vcpu thread, kept by the sched_switch program (vcpu.bpf.c), and read by the BpfBackend
+ */
+struct vcpu_stat {
+    /// The time the thread ran on a cpu in nanoseconds (finished slices only)
+    __u64 runtime;
+
+    /// The cycles of the cpus during the finished slices of the thread (0 if the cycle counters are not available)
+    __u64 cycles;
+
+    /// The instant the current slice started (bpf_ktime_get_ns), 0 if the thread is not running
+    __u64 start;
+
+    /// The cycle counter of the cpu when the current slice started
+    __u64 startCycles;
+};
+
+/// The maximal number of vcpu threads that are accounted
+#define VCPU_MAX_THREADS 16384
@@ -3,7 +3,9 @@
 #include <filesystem>
 #include <nlohmann/json.hpp>
 #include <monitor/utils/log.hh>
+#include <monitor/utils/exception.hh>
 #include <monitor/net/_.hh>
+#include <monitor/concurrency/thread.hh>
 #include <monitor/libvirt/_.hh>
 
 using namespace monitor;
@@ -13,117 +15,289 @@ using namespace monitor::libvirt;
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
-void killVM (const std::string & name, const std::filesystem::path & path = "/var/lib/dio/") {
-    std::ifstream f (path / "daemon.json");
-    std::stringstream ss;
-    ss << f.rdbuf ();
-    
-    auto port = json::parse (ss.str ());
-    TcpStream client (net::SockAddrV4 (net::Ipv4Address (127, 0, 0, 1), port["port"]));
-    client.connect ();
-    
-    client.sendInt (VMProtocol::KILL);
-    client.sendInt (name.length ());
-    client.send (name);
+/**
+ * The operations the client can send to the daemons
+ */
+enum ClientOperation {
+    KILL_OP,
+    PROVISION_OP,
+    IP_OP,
+    NAT_OP,
+    RESET_OP,
+    STATS_OP
+};
 
+/**
+ * A request sent to one daemon, and its result
+ * Each request is executed in its own thread, so a dead host only costs its timeout
+ */
+struct HostRequest {
 
-    auto resp = client.receiveInt ();
-    switch (resp) {
-    case VMProtocol::OK :
-	logging::success ("VM", name, "killed");
-	break;
-    default:
-	auto err = client.receiveInt ();
-	logging::error ("VM", name, "does not exists");
-	break;
-    }
-}
+    /// The name of the host (as given by the user)
+    std::string host;
+
+    /// The port of the daemon on the host
+    unsigned short port;
+
+    /// The maximal time of connection and of each send/receive in seconds
+    float timeout;
+
+    /// The maximal time to wait for the answer of a provision in seconds (negative means until the VM is booted)
+    float provisionTimeout = -1.0f;
+
+    /// The operation to execute
+    ClientOperation op;
 
-void provisionVM (const std::filesystem::path & cfgPath, const std::filesystem::path & path = "/var/lib/dio/") {
+    /// The name of the vm (kill, ip, nat)
+    std::string vm;
+
+    /// The content of the vm configuration (provision)
+    std::string cfg;
+
+    /// The nat ports (nat)
+    int natHost = 0, natGuest = 0;
+
+    /// True iif the daemon was reached, and answered
+    bool reached = false;
+
+    /// True iif the daemon answered positively
+    bool success = false;
+
+    /// The message describing the result
+    std::string message;
+
+    /// The data returned by the daemon (ip, stats)
+    json data;
+
+    /// The thread executing the request
+    concurrency::thread th;
+};
+
+
+/**
+ * @returns: the port of the local daemon, 0 if there is no local daemon
+ */
+unsigned short readLocalPort (const std::filesystem::path & path = "/var/lib/dio/") {
     std::ifstream f (path / "daemon.json");
+    if (!f.good ()) return 0;
+
     std::stringstream ss;
     ss << f.rdbuf ();
+    try {
+	auto j = json::parse (ss.str ());
+	return j["port"].get<unsigned short> ();
+    } catch (...) {
+	return 0;
+    }
+}
 
-    std::ifstream content (cfgPath);
-    if (!content.good ()) {
-	logging::error ("VM config file not found");
+/**
+ * Read the error code sent by the daemon after an ERR response
+ */
+void readError (TcpStream & client, HostRequest & req) {
+    auto err = client.receiveInt ();
+    switch (err) {
+    case VMProtocolError::NOT_FOUND : req.message = "not found"; break;
+    case VMProtocolError::ALREADY_EXISTS : req.message = "already exists"; break;
+    default : req.message = "protocol error"; break;
     }
+}
 
-    std::stringstream vmCfg;
-    vmCfg << content.rdbuf ();    
-    
-    auto port = json::parse (ss.str ());
-    TcpStream client (net::SockAddrV4 (net::Ipv4Address (127, 0, 0, 1), port["port"]));
-    client.connect ();
-    
+void killVM (TcpStream & client, HostRequest & req) {
+    client.sendInt (VMProtocol::KILL);
+    client.sendInt (req.vm.length ());
+    client.send (req.vm);
+
+    auto resp = client.receiveInt ();
+    if (resp == VMProtocol::OK) {
+	req.success = true;
+	req.message = "VM " + req.vm + " killed";
+    } else readError (client, req);
+}
+
+void provisionVM (TcpStream & client, HostRequest & req) {
     client.sendInt (VMProtocol::PROVISION);
-    client.sendInt (vmCfg.str ().length ());
-    client.send (vmCfg.str ());
-    
+    client.sendInt (req.cfg.length ());
+    client.send (req.cfg);
+
     auto resp = client.receiveInt ();
-    switch (resp) {
-    case VMProtocol::IP : {
+    if (resp == VMProtocol::IP) {
 	auto ipLen = client.receiveInt ();
 	auto ip = client.receive (ipLen);
-	logging::success ("VM started at :", ip);
-	break;
-    }
-    default:
-	auto err = client.receiveInt ();
-	logging::error ("VM error :", err);
-	break;
-    }
+	req.success = true;
+	req.message = "VM started at : " + ip;
+	req.data = ip;
+    } else readError (client, req);
 }
 
-void natVM (const std::string & name, int host, int guest, const std::filesystem::path & path = "/var/lib/dio") {
-    std::ifstream f (path / "daemon.json");
-    std::stringstream ss;
-    ss << f.rdbuf ();
-    
-    auto port = json::parse (ss.str ());
-    TcpStream client (net::SockAddrV4 (net::Ipv4Address (127, 0, 0, 1), port["port"]));
-    client.connect ();
-    
+void ipVM (TcpStream & client, HostRequest & req) {
+    client.sendInt (VMProtocol::IP);
+    client.sendInt (req.vm.length ());
+    client.send (req.vm);
+
+    auto resp = client.receiveInt ();
+    if (resp == VMProtocol::IP) {
+	auto ipLen = client.receiveInt ();
+	auto ip = client.receive (ipLen);
+	req.success = true;
+	req.message = "VM " + req.vm + " at : " + ip;
+	req.data = ip;
+    } else readError (client, req);
+}
+
+void natVM (TcpStream & client, HostRequest & req) {
     client.sendInt (VMProtocol::NAT);
-    client.sendInt (name.length ());
-    client.send (name);
-    client.sendInt (host);
-    client.sendInt (guest);
-    
+    client.sendInt (req.vm.length ());
+    client.send (req.vm);
+    client.sendInt (req.natHost);
+    client.sendInt (req.natGuest);
+
     auto resp = client.receiveInt ();
-    switch (resp) {
-    case VMProtocol::OK :
-	logging::success ("VM", name, "nat enable from", host, "->", guest);
-	break;
-    default:
-	auto err = client.receiveInt ();
-	logging::error ("VM", name, "does not exists");
-	break;
+    if (resp == VMProtocol::OK) {
+	req.success = true;
+	req.message = "VM " + req.vm + " nat enable from " + std::to_string (req.natHost) + " -> " + std::to_string (req.natGuest);
+    } else readError (client, req);
+}
+
+void resetCounters (TcpStream & client, HostRequest & req) {
+    client.sendInt (VMProtocol::RESET_COUNTERS);
+    auto resp = client.receiveInt ();
+    if (resp == VMProtocol::OK) {
+	req.success = true;
+	req.message = "Counter are reset";
+    } else readError (client, req);
+}
+
+void stats (TcpStream & client, HostRequest & req) {
+    client.sendInt (VMProtocol::STATS);
+    auto resp = client.receiveInt ();
+    if (resp == VMProtocol::STATS) {
+	auto len = client.receiveInt ();
+	auto content = client.receive (len);
+	if (content.length () == len) {
+	    req.data = json::parse (content);
+	    req.success = true;
+	    req.message = "stats received";
+	}
+    } else readError (client, req);
+}
+
+/**
+ * Execute a request on a daemon
+ * @info: never throws, the errors are written in the request
+ */
+void runRequest (concurrency::thread, HostRequest * req) {
+    try {
+	TcpStream client (SockAddrV4 (Ipv4Address::resolve (req-> host), req-> port));
+	client.connect (req-> timeout);
+
+	// The daemon only answers a provision after the installation and the boot of the VM
+	if (req-> op == PROVISION_OP) client.setTimeout (req-> provisionTimeout);
+
+	switch (req-> op) {
+	case KILL_OP : killVM (client, *req); break;
+	case PROVISION_OP : provisionVM (client, *req); break;
+	case IP_OP : ipVM (client, *req); break;
+	case NAT_OP : natVM (client, *req); break;
+	case RESET_OP : resetCounters (client, *req); break;
+	case STATS_OP : stats (client, *req); break;
+	}
+
+	// The stream is closed when the daemon timed out, or hung up before the end of the response
+	req-> reached = req-> success || client.isOpen ();
+	if (!req-> reached) req-> message = "connection lost, or timed out";
+	client.close ();
+    } catch (utils::exception & e) {
+	req-> message = e.msg;
+    } catch (std::exception & e) {
+	req-> message = e.what ();
     }
 }
 
+/**
+ * Parse the list of hosts (name[:port])
+ * @params:
+ *   - hosts: the hosts given by the user (local daemon if empty)
+ *   - defaultPort: the port used if not specified
+ */
+std::vector <HostRequest> createRequests (const std::vector <std::string> & hosts, unsigned short defaultPort, float timeout) {
+    std::vector <HostRequest> reqs;
+    if (hosts.size () == 0) {
+	if (defaultPort == 0) {
+	    throw utils::command_line_error ("No local monitor found (use --hosts, or --port)");
+	}
+	
+	HostRequest req;
+	req.host = "127.0.0.1";
+	req.port = defaultPort;
+	req.timeout = timeout;
+	reqs.push_back (req);
+    }
 
-void resetCounters (const std::filesystem::path & path = "/var/lib/dio") {
-    std::ifstream f (path / "daemon.json");
-    std::stringstream ss;
-    ss << f.rdbuf ();
-    
-    auto port = json::parse (ss.str ());
-    TcpStream client (net::SockAddrV4 (net::Ipv4Address (127, 0, 0, 1), port["port"]));
-    client.connect ();
+    for (auto & h : hosts) {
+	HostRequest req;
+	auto sep = h.find (':');
+	req.host = h.substr (0, sep);
+	req.port = sep == std::string::npos ? defaultPort : SockAddrV4::parsePort (h.substr (sep + 1));
+	req.timeout = timeout;
+	if (req.port == 0) {
+	    throw utils::command_line_error ("No port for host " + h + " (use host:port, or --port)");
+	}
+	reqs.push_back (req);
+    }
 
-    client.sendInt (VMProtocol::RESET_COUNTERS);    
-    auto resp = client.receiveInt ();
-    switch (resp) {
-    case VMProtocol::OK :
-	logging::success ("Counter are reset");
-	break;
-    default:
-	auto err = client.receiveInt ();
-	logging::error ("Failed to reset counters !");
-	break;
+    return reqs;
+}
+
+/**
+ * Execute the requests concurrently on all the hosts
+ */
+void fanOut (std::vector <HostRequest> & reqs) {
+    for (auto & r : reqs) {
+	r.th = concurrency::spawn (&runRequest, &r);
     }
 
+    for (auto & r : reqs) {
+	concurrency::join (r.th);
+    }
+}
+
+/**
+ * Print the results of the requests
+ * @returns: the exit code of the client
+ */
+int report (const std::vector <HostRequest> & reqs, ClientOperation op, bool asJson) {
+    int nbSuccess = 0, nbUnreached = 0;
+    json all = json::array ();
+    for (auto & r : reqs) {
+	if (r.success) nbSuccess += 1;
+	if (!r.reached && !r.success) nbUnreached += 1;
+
+	if (asJson) {
+	    json j;
+	    j["host"] = r.host;
+	    j["port"] = r.port;
+	    j["reached"] = r.reached || r.success;
+	    j["success"] = r.success;
+	    j["message"] = r.message;
+	    if (!r.data.is_null ()) j["data"] = r.data;
+	    all.push_back (j);
+	} else if (r.success) {
+	    logging::success (r.host, ":", r.message);
+	    if (op == STATS_OP) std::cout << r.data.dump (4) << std::endl;
+	} else {
+	    logging::error (r.host, ":", r.message);
+	}
+    }
+
+    if (asJson) std::cout << all.dump () << std::endl;
+    else if (reqs.size () > 1) logging::info ("Done :", nbSuccess, "success,", nbUnreached, "unreachable, on", reqs.size (), "hosts");
+
+    // A vm lives on only one host, so a kill, or ip is successful if one host found it
+    if (nbUnreached != 0) return 1;
+    if ((op == KILL_OP || op == IP_OP || op == NAT_OP) && nbSuccess == 0) return 1;
+    if ((op == RESET_OP || op == STATS_OP || op == PROVISION_OP) && nbSuccess != (int) reqs.size ()) return 1;
+    return 0;
 }
 
 
@@ -133,7 +307,10 @@ int main (int argc, char ** argv) {
     std::string kill = "", provision = "", ip = "";
     std::string nat = "";
     int nat_host = 2020, nat_guest = 22;
-    bool flg;
+    bool flg = false, statsFlg = false, asJson = false;
+    std::vector <std::string> hosts;
+    int port = 0;
+    float timeout = 5.0f, provisionTimeout = -1.0f;
     app.add_option ("--kill", kill, "kill the VM (vm name)");
     app.add_option ("--provision", provision, "provision a VM (toml file)");
     app.add_option ("--ip", ip, "get the ip address of the VM (vm name)");
@@ -141,25 +318,73 @@ int main (int argc, char ** argv) {
     app.add_option ("--host", nat_host, "nat in port (host port)");
     app.add_option ("--guest", nat_guest, "nat out port (guest port)");
     app.add_flag ("--reset-counters", flg, "reset market counters of the monitor");
-	
+    app.add_flag ("--stats", statsFlg, "get the last market information of the monitor");
+    app.add_option ("--hosts", hosts, "list of monitors to contact concurrently (host[:port]), default is the local monitor")-> delimiter (',');
+    app.add_option ("--port", port, "port of the monitors when not specified in --hosts (default is the port of the local monitor)");
+    app.add_option ("--timeout", timeout, "timeout in seconds of the connection and of each exchange with a monitor");
+    app.add_option ("--provision-timeout", provisionTimeout, "timeout in seconds of the answer to --provision (default is to wait until the VM is booted)");
+    app.add_flag ("--json", asJson, "print the aggregated results in json");
+
     try {
 	app.parse(argc, argv);
 
+	HostRequest base;
+	ClientOperation op;
 	if (kill != "") {
-	    killVM (kill);
+	    op = KILL_OP;
+	    base.vm = kill;
 	} else if (provision != "") {
-	    provisionVM (provision);
+	    op = PROVISION_OP;
+	    std::ifstream content (provision);
+	    if (!content.good ()) {
+		logging::error ("VM config file not found");
+		return 1;
+	    }
+
+	    std::stringstream vmCfg;
+	    vmCfg << content.rdbuf ();
+	    base.cfg = vmCfg.str ();
 	} else if (ip != "") {
-	    //ipVM (ip);
+	    op = IP_OP;
+	    base.vm = ip;
 	} else if (nat != "") {
-	    natVM (nat, nat_host, nat_guest);
+	    op = NAT_OP;
+	    base.vm = nat;
+	    base.natHost = nat_host;
+	    base.natGuest = nat_guest;
 	} else if (flg) {
-	    resetCounters ();
+	    op = RESET_OP;
+	} else if (statsFlg) {
+	    op = STATS_OP;
 	} else {
 	    std::cout << "exit." << std::endl;
+	    return 0;
+	}
+
+	if (op == PROVISION_OP && hosts.size () > 1) {
+	    throw utils::command_line_error ("A VM can only be provisioned on one host");
+	}
+
+	if (port < 0 || port > 65535) throw utils::command_line_error ("Port out of range : " + std::to_string (port));
+	auto defaultPort = port != 0 ? (unsigned short) port : readLocalPort ();
+	auto reqs = createRequests (hosts, defaultPort, timeout);
+	for (auto & r : reqs) {
+	    r.op = op;
+	    r.provisionTimeout = provisionTimeout;
+	    r.vm = base.vm;
+	    r.cfg = base.cfg;
+	    if (op == NAT_OP) {
+		r.natHost = base.natHost;
+		r.natGuest = base.natGuest;
+	    }
 	}
+
+	fanOut (reqs);
+	return report (reqs, op, asJson);
     } catch (const CLI::ParseError &e) {
 	return app.exit(e);
+    } catch (const utils::exception & e) {
+	logging::error (e.msg);
+	return 1;
     }
 }
-
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <monitor/foreign/CLI11.hpp>
+#include <nlohmann/json.hpp>
+#include <monitor/utils/log.hh>
+#include <monitor/utils/exception.hh>
+#include <monitor/concurrency/timer.hh>
+#include <server/cluster/coordinator.hh>
+
+using namespace monitor;
+using namespace monitor::utils;
+using json = nlohmann::json;
+
+/**
+ * Read the configuration of the coordinator
+ * @info: a missing file keeps the default configuration
+ * @throws:
+ *   - utils::exception: if the file is invalid
+ */
+server::cluster::ClusterConfig readConfig (const std::string & path) {
+    std::ifstream f (path);
+    if (!f.good ()) return server::cluster::ClusterConfig ();
+
+    std::stringstream ss;
+    ss << f.rdbuf ();
+    try {
+	return server::cluster::ClusterConfig::parse (json::parse (ss.str ()));
+    } catch (const json::exception & e) {
+	throw utils::exception (std::string ("Invalid cluster configuration : ") + e.what ());
+    }
+}
+
+int main (int argc, char ** argv) {
+    CLI::App app {"Coordinator of the cpu markets of the dio-monitors of a cluster"};
+
+    std::vector <std::string> hosts;
+    std::string config = "/usr/lib/dio/cluster.json";
+    std::string output = "/var/log/dio/cluster-log.json";
+    int port = 0;
+    unsigned long rounds = 0;
+    app.add_option ("--hosts", hosts, "list of monitors of the cluster (host[:port])")-> delimiter (',')-> required ();
+    app.add_option ("--port", port, "port of the monitors when not specified in --hosts");
+    app.add_option ("--config", config, "the configuration of the coordinator (cluster.json)");
+    app.add_option ("--rounds", rounds, "the number of clearings before exiting (0 to run forever)");
+    app.add_option ("--output", output, "the file to which the plan of each clearing is appended");
+
+    try {
+	app.parse (argc, argv);
+
+	if (port < 0 || port > 65535) throw utils::command_line_error ("Port out of range : " + std::to_string (port));
+	server::cluster::Coordinator coordinator (hosts, (unsigned short) port);
+	coordinator.setConfig (readConfig (config));
+
+	auto dir = std::filesystem::path (output).parent_path ();
+	if (!dir.empty ()) std::filesystem::create_directories (dir);
+
+	concurrency::timer t;
+	for (unsigned long r = 0 ; rounds == 0 || r < rounds ; r++) {
+	    t.reset ();
+	    auto plan = coordinator.run ();
+	    for (auto & h : plan.unreached) logging::warn ("Monitor", h, "unreachable");
+	    for (auto & m : plan.migrations) logging::info ("Migrate", m.vm, "from", m.from, "to", m.to);
+
+	    // One plan per line, as the control log of the monitors
+	    json j = plan.dump ();
+	    j ["time"] = logging::get_time ();
+	    std::ofstream f (output, std::ios_base::app);
+	    f << j.dump () << std::endl;
+	    f.close ();
+
+	    if (rounds != 0 && r + 1 == rounds) break;
+	    auto left = coordinator.getConfig ().period - t.time_since_start ();
+	    if (left > 0.f) t.sleep (left);
+	}
+    } catch (const CLI::ParseError &e) {
+	return app.exit (e);
+    } catch (const utils::exception & e) {
+	logging::error (e.msg);
+	return 1;
+    }
+
+    return 0;
+}
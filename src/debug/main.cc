@@ -3,8 +3,16 @@
 #include <ifaddrs.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <monitor/foreign/CLI11.hpp>
+#include <monitor/utils/toml.hh>
 
-int main()
+using namespace monitor::utils;
+
+int printInterfaces ()
 {
 struct ifaddrs *addresses;
 if (getifaddrs(&addresses) == -1)
@@ -31,3 +39,93 @@ address = address->ifa_next;
 freeifaddrs(addresses);
 return 0;
 }
+
+/**
+ * Generate a vm spec file containing nb vms
+ */
+std::string generateVMSpecs (int nb) {
+    std::stringstream ss;
+    for (int i = 0 ; i < nb ; i++) {
+	ss << "# vm number " << i << std::endl;
+	ss << "[vm" << i << "]" << std::endl;
+	ss << "name = \"v" << i << "\"" << std::endl;
+	ss << "image = \"/home/phil/.qcow2/ubuntu-20.04.qcow2\"" << std::endl;
+	ss << "ssh_key = \"ssh-rsa AAAAB3NzaC1yc2EAAAADAQABAAABAQDJe3QVm7nA05wZAVGhcZT4Rv8Uvkox3PlGfisP2KMHQNhdpLseTWGk6iuB user@host\"" << std::endl;
+	ss << "vcpus = " << (1 + i % 8) << std::endl;
+	ss << "memory = " << 1024 * (1 + i % 4) << std::endl;
+	ss << "frequency = " << 800 + 100 * (i % 20) << std::endl;
+	ss << "memorySLA = 0." << (1 + i % 9) << std::endl;
+	ss << "disk = 10000" << std::endl;
+	ss << "tags = [\"bench\", 'tier-" << i % 3 << "', " << i << "]" << std::endl;
+	ss << "test = { type = \"phoronix\", name = \"compress-7zip\", start = " << i % 100 << ", nb-run = 15 }" << std::endl;
+	ss << std::endl;
+    }
+
+    return ss.str ();
+}
+
+/**
+ * Benchmark the toml parser
+ * @params:
+ *   - content: the content to parse
+ *   - iterations: the number of parses
+ */
+int benchToml (const std::string & content, int iterations) {
+    std::size_t nodes = 0;
+    auto s = std::chrono::steady_clock::now ();
+    for (int i = 0 ; i < iterations ; i++) {
+	auto dic = toml::parse (content);
+	nodes += dic.keys ().size ();
+    }
+    auto m = std::chrono::steady_clock::now ();
+
+    // Lookups and copies of the sub dicts, as done when the daemon creates the vms
+    auto dic = toml::parse (content);
+    auto keys = dic.keys ();
+    for (int i = 0 ; i < iterations ; i++) {
+	for (auto & k : keys) {
+	    auto vm = dic.get<config::dict> (k);
+	    nodes += vm.getOr<int> ("vcpus", 1) + vm.get<std::string_view> ("name").length ();
+	}
+    }
+    auto e = std::chrono::steady_clock::now ();
+
+    auto parse = std::chrono::duration<double> (m - s).count () / iterations;
+    auto lookup = std::chrono::duration<double> (e - m).count () / iterations;
+    auto mb = (double) content.length () / (1024.0 * 1024.0);
+
+    std::cout << "content : " << content.length () << " bytes, " << keys.size () << " sections, document memory : " << dic.memory () << " bytes" << std::endl;
+    std::cout << "parse  : " << parse * 1000.0 << " ms/parse, " << mb / parse << " MB/s" << std::endl;
+    std::cout << "lookup : " << lookup * 1000.0 << " ms/" << keys.size () << " vms" << std::endl;
+
+    return nodes == 0 ? 1 : 0;
+}
+
+int main (int argc, char ** argv) {
+    CLI::App app {"debug"};
+
+    std::string tomlFile = "";
+    int generate = 0, iterations = 10;
+    app.add_option ("--toml-bench", tomlFile, "benchmark the toml parser on a vm spec file");
+    app.add_option ("--toml-generate", generate, "benchmark the toml parser on a generated spec file containing n vms");
+    app.add_option ("--iterations", iterations, "number of iterations of the benchmarks");
+
+    try {
+	app.parse (argc, argv);
+	if (tomlFile != "") {
+	    std::ifstream f (tomlFile);
+	    std::stringstream ss;
+	    ss << f.rdbuf ();
+	    return benchToml (ss.str (), iterations);
+	} else if (generate != 0) {
+	    return benchToml (generateVMSpecs (generate), iterations);
+	}
+
+	return printInterfaces ();
+    } catch (const CLI::ParseError &e) {
+	return app.exit (e);
+    } catch (const config::config_error & e) {
+	e.print ();
+	return 1;
+    }
+}
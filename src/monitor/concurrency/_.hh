@@ -1,7 +1,9 @@
 #pragma once
 
+#include <monitor/concurrency/barrier.hh>
 #include <monitor/concurrency/iopipe.hh>
 #include <monitor/concurrency/mutex.hh>
 #include <monitor/concurrency/proc.hh>
 #include <monitor/concurrency/thread.hh>
 #include <monitor/concurrency/timer.hh>
+#include <monitor/concurrency/watcher.hh>
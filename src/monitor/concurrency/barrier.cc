@@ -0,0 +1,21 @@
+#include <monitor/concurrency/barrier.hh>
+
+namespace monitor {
+
+    namespace concurrency {
+
+	barrier::barrier (unsigned int count) {
+	    pthread_barrier_init (&this-> _b, nullptr, count);
+	}
+
+	void barrier::wait () {
+	    pthread_barrier_wait (&this-> _b);
+	}
+
+	barrier::~barrier () {
+	    pthread_barrier_destroy (&this-> _b);
+	}
+
+    }
+
+}
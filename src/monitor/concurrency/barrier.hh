@@ -0,0 +1,38 @@
+#pragma once
+
+#include <pthread.h>
+
+namespace monitor {
+
+    namespace concurrency {
+
+	/**
+	 * A barrier on which a fixed number of threads wait for each other
+	 */
+	class barrier {
+
+	    pthread_barrier_t _b;
+
+	public:
+
+	    /**
+	     * @params:
+	     *   - count: the number of threads that must reach the barrier before they are released
+	     */
+	    barrier (unsigned int count);
+
+	    barrier (const barrier &) = delete;
+
+	    const barrier & operator= (const barrier &) = delete;
+
+	    /**
+	     * Wait until count threads reached the barrier
+	     */
+	    void wait ();
+
+	    ~barrier ();
+	};
+
+    }
+
+}
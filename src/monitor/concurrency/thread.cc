@@ -7,8 +7,9 @@ namespace monitor {
 
 	thread spawn (void (*func)(thread)) {
 	    auto th = new internal::fn_thread_launcher (func);
-	    pthread_create (&th-> content, nullptr, &internal::thread_fn_main, th);
-	    return th-> content;
+	    thread content;
+	    pthread_create (&content, nullptr, &internal::thread_fn_main, th); // th is deleted by the thread, maybe before pthread_create returns
+	    return content;
 	}
 
 	void join (thread th) {
@@ -41,7 +42,7 @@ namespace monitor {
 	    {}
 
 	    void dg_thread_launcher::run () {
-		(this-> closure->* (this-> func)) (this-> content);
+		(this-> closure->* (this-> func)) (pthread_self ());
 	    }
 
 	    fn_thread_launcher::fn_thread_launcher (void (*func) (thread)) :
@@ -50,7 +51,7 @@ namespace monitor {
 	    {}
 
 	    void fn_thread_launcher::run () {
-		this-> func (this-> content);
+		this-> func (pthread_self ());
 	    }
 	       
 	}
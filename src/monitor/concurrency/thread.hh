@@ -50,7 +50,7 @@ namespace monitor {
 
 		void run () override  {
 		    std::apply ([this](auto &&... args) {
-				    (this-> closure->* (this-> func)) (this-> content, args...);
+				    (this-> closure->* (this-> func)) (pthread_self (), args...);
 				}, this-> datas);
 		}
 	    };
@@ -68,7 +68,7 @@ namespace monitor {
 		    {}
 
 		void run () override {
-		    std::apply (this-> func, std::tuple_cat (std::make_tuple (this-> content), this-> datas));
+		    std::apply (this-> func, std::tuple_cat (std::make_tuple (pthread_self ()), this-> datas));
 		}
 		
 	    };
@@ -84,8 +84,9 @@ namespace monitor {
 	template <typename ... T>
 	thread spawn (void (*func) (thread, T...), T... args) {
 	    auto th = new internal::fn_thread_launcher_template<T...> (func, args...);
-	    pthread_create (&th-> content, nullptr, &internal::thread_fn_main, th);
-	    return th-> content;
+	    thread content;
+	    pthread_create (&content, nullptr, &internal::thread_fn_main, th); // th is deleted by the thread, maybe before pthread_create returns
+	    return content;
 	}
 	
 	/**
@@ -96,16 +97,18 @@ namespace monitor {
 	template <class X>
 	thread spawn (X * x, void (X::*func)(thread)) {
 	    auto th = new internal::dg_thread_launcher ((internal::fake*) x, (void (internal::fake::*)(thread)) func);
-	    pthread_create (&th-> content, nullptr, &internal::thread_dg_main, th);
-	    return th-> content;
+	    thread content;
+	    pthread_create (&content, nullptr, &internal::thread_dg_main, th); // th is deleted by the thread, maybe before pthread_create returns
+	    return content;
 	}
 
 
 	template <class X, typename ... T>
 	thread spawn (X * x, void (X::*func)(thread, T...), T... args) {
 	    auto th = new internal::dg_thread_launcher_template ((internal::fake*)x, (void (internal::fake::*)(thread, T...)) func, args...);
-	    pthread_create (&th-> content, nullptr, &internal::thread_dg_main, th);
-	    return th-> content;
+	    thread content;
+	    pthread_create (&content, nullptr, &internal::thread_dg_main, th); // th is deleted by the thread, maybe before pthread_create returns
+	    return content;
 	}
 
 	/**
@@ -0,0 +1,82 @@
+#include <monitor/concurrency/watcher.hh>
+#include <monitor/utils/exception.hh>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <chrono>
+
+namespace monitor {
+
+    namespace concurrency {
+
+	FileWatcher::FileWatcher (const std::filesystem::path & file) :
+	    _fd (-1),
+	    _wd (-1),
+	    _name (file.filename ().string ())
+	{
+	    auto dir = file.has_parent_path () ? file.parent_path () : std::filesystem::path (".");
+	    this-> _fd = inotify_init1 (IN_CLOEXEC);
+	    if (this-> _fd < 0) {
+		throw utils::file_error ("inotify : " + std::string (strerror (errno)));
+	    }
+
+	    this-> _wd = inotify_add_watch (this-> _fd, dir.c_str (), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+	    if (this-> _wd < 0) {
+		auto err = std::string (strerror (errno));
+		this-> close ();
+		throw utils::file_error ("Cannot watch directory " + dir.string () + " : " + err);
+	    }
+	}
+
+	bool FileWatcher::wait (float timeout) {
+	    // Enough for several events, as the name is at most NAME_MAX
+	    alignas (struct inotify_event) char buffer [4 * (sizeof (struct inotify_event) + NAME_MAX + 1)];
+
+	    // The events of the other files of the directory must not postpone the timeout
+	    auto deadline = std::chrono::steady_clock::now () + std::chrono::microseconds ((long) (timeout * 1000000.0f));
+	    for (;;) {
+		if (this-> _fd < 0) return false;
+
+		int remain = -1;
+		if (timeout >= 0) {
+		    auto left = std::chrono::duration_cast <std::chrono::milliseconds> (deadline - std::chrono::steady_clock::now ()).count ();
+		    remain = left > 0 ? (int) left : 0;
+		}
+
+		struct pollfd pfd = {this-> _fd, POLLIN, 0};
+		auto ret = ::poll (&pfd, 1, remain);
+		if (ret < 0 && errno == EINTR) continue;
+		if (ret <= 0) return false;
+
+		auto len = ::read (this-> _fd, buffer, sizeof (buffer));
+		if (len <= 0) return false;
+
+		bool found = false;
+		for (char * ptr = buffer ; ptr < buffer + len ; ) {
+		    auto event = (const struct inotify_event*) ptr;
+		    if (event-> len != 0 && this-> _name == event-> name) found = true;
+		    ptr += sizeof (struct inotify_event) + event-> len;
+		}
+
+		if (found) return true;
+	    }
+	}
+
+	void FileWatcher::close () {
+	    if (this-> _fd >= 0) {
+		::close (this-> _fd);
+		this-> _fd = -1;
+		this-> _wd = -1;
+	    }
+	}
+
+	FileWatcher::~FileWatcher () {
+	    this-> close ();
+	}
+
+    }
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <filesystem>
+
+namespace monitor {
+
+    namespace concurrency {
+
+	/**
+	 * Watch the modifications of a file using inotify
+	 * The directory of the file is watched (not the file itself), so the file can be created, or replaced by a rename (as most editors do)
+	 */
+	class FileWatcher {
+
+	    /// The inotify instance
+	    int _fd;
+
+	    /// The watch descriptor of the directory
+	    int _wd;
+
+	    /// The name of the watched file in its directory
+	    std::string _name;
+
+	public:
+
+	    /**
+	     * @params:
+	     *   - file: the file to watch
+	     * @throws:
+	     *   - utils::file_error: if the directory of the file cannot be watched
+	     */
+	    FileWatcher (const std::filesystem::path & file);
+
+	    /**
+	     * Wait for a modification of the file
+	     * @params:
+	     *   - timeout: the maximal time to wait in seconds (-1 for no timeout)
+	     * @returns: true if the file was written, created, replaced or removed, false on timeout
+	     */
+	    bool wait (float timeout = -1.0f);
+
+	    /**
+	     * Stop watching the file
+	     */
+	    void close ();
+
+	    ~FileWatcher ();
+
+	};
+
+    }
+
+}
@@ -1,8 +1,11 @@
 #include <monitor/libvirt/client.hh>
+#include <monitor/libvirt/controller/sysfs_backend.hh>
+#include <monitor/libvirt/controller/bpf_backend.hh>
 #include <monitor/concurrency/proc.hh>
 #include <monitor/utils/log.hh>
 #include <sys/stat.h>
 #include <fstream>
+#include <algorithm>
 #include <monitor/concurrency/timer.hh>
 #include <unistd.h>
 #include <sys/types.h>
@@ -32,10 +35,24 @@ namespace monitor {
 		logging::error ("you are not root. This program will only work if run as root.");
 		exit(1);
 	    }
-	    
+
+#ifdef DIO_BPF
+	    this-> _backend = std::make_unique <control::BpfBackend> ();
+#else
+	    this-> _backend = std::make_unique <control::SysfsBackend> ();
+#endif
+
 	    this-> enableNatRouting ();
 	}
 
+	LibvirtClient::LibvirtClient (const char * uri, bool offline) :
+	    _conn (nullptr), _uri (uri), _offline (offline)
+	{}
+
+	LibvirtClient LibvirtClient::offline () {
+	    return LibvirtClient ("", true);
+	}
+
 	/**
 	 * ================================================================================
 	 * ================================================================================
@@ -54,7 +71,22 @@ namespace monitor {
 	    f.close ();
 	}
        
+	void LibvirtClient::setBackend (std::unique_ptr <control::HostBackend> backend) {
+	    this-> _backend = std::move (backend);
+	}
+
+	control::HostBackend * LibvirtClient::getBackend () {
+	    return this-> _backend.get ();
+	}
+
+	int LibvirtClient::getNbCpus () {
+	    if (this-> _backend == nullptr) return get_nprocs ();
+	    return this-> _backend-> nbCpus ();
+	}
+       
 	void LibvirtClient::connect () {
+	    if (this-> _offline) throw LibvirtError ("Offline client cannot be connected\n");
+
 	    // First disconnect, maybe it was connected to something
 	    this-> disconnect ();
 	    
@@ -66,7 +98,6 @@ namespace monitor {
 	    }
 
 	    logging::success ("Libvirt client connected to :", this-> _uri);
-	    this-> killAllRunningDomains ();
 	}
 
 	void LibvirtClient::disconnect () {
@@ -89,6 +120,7 @@ namespace monitor {
 
 	void LibvirtClient::updateVCPUControllers () {
 	    auto speed = this-> readCPUFrequency ();
+	    if (this-> _backend != nullptr) this-> _backend-> sample ();
 	    
 	    for (auto & vm : this-> _running) {
 		for (auto & vt : vm-> getVCPUControllers ()) {
@@ -102,6 +134,19 @@ namespace monitor {
 		for (auto & vt : vm-> getVCPUControllers ()) {
 		    vt.updateBeforeMarket ();
 		}
+		vm-> getCPUController ().updateBeforeMarket ();
+	    }
+	}
+
+	void LibvirtClient::updateMemoryControllers () {
+	    for (auto & vm : this-> _running) {
+		vm-> getMemoryController ().update ();
+	    }
+	}
+
+	void LibvirtClient::updateIOControllers () {
+	    for (auto & vm : this-> _running) {
+		vm-> getIOController ().update ();
 	    }
 	}
 	
@@ -130,6 +175,49 @@ namespace monitor {
 	    free (domains);
 	    this-> _running.clear ();
 	}
+
+	void LibvirtClient::killUnknownDomains () {
+	    virDomainPtr * domains = nullptr;
+	    auto num_domains = virConnectListAllDomains (this-> _conn, &domains, VIR_CONNECT_LIST_DOMAINS_ACTIVE);
+	    for (int i = 0 ; i < num_domains ; i++) {
+		virDomainPtr dom = domains [i];
+		auto name = std::string (virDomainGetName (dom));
+		if (name [0] == 'v' && !this-> hasVM (name.substr (1))) {
+		    logging::info ("Killing unknown VM:", name.substr (1));
+		    virDomainDestroy (dom);
+		    virDomainUndefine (dom);
+		}
+		virDomainFree (dom);
+	    }
+
+	    free (domains);
+	}
+
+	LibvirtVM * LibvirtClient::adoptVM (const utils::config::dict & cfg, const std::string & ip, const std::string & mac) {
+	    auto vm = new LibvirtVM (cfg);
+	    vm-> _dom = this-> retreiveDomain (vm-> id ());
+	    if (vm-> _dom == nullptr || virDomainIsActive (vm-> _dom) != 1) {
+		if (vm-> _dom != nullptr) virDomainFree (vm-> _dom);
+		delete vm;
+		return nullptr;
+	    }
+
+	    vm-> _ip = ip;
+	    vm-> _mac = mac;
+	    vm-> _backend = this-> _backend.get ();
+	    for (auto & it : vm-> getVCPUControllers ()) {
+		it.enable ();
+	    }
+	    vm-> getCPUController ().enable ();
+	    vm-> getMemoryController ().enable ();
+	    vm-> getIOController ().enable ();
+
+	    this-> _mutex.lock ();
+	    this-> _running.push_back (vm);
+	    this-> _mutex.unlock ();
+
+	    return vm;
+	}
 	
 	void LibvirtClient::printDomains () const {
 	    virDomainPtr * domains = nullptr;	    
@@ -167,7 +255,7 @@ namespace monitor {
 	    this-> _mutex.lock ();
 	    bool found = false;
 	    for (auto & vm : this-> _running) {
-		if (vm-> id () == name) {
+		if (vm-> id () == name && std::find (this-> _removed.begin (), this-> _removed.end (), vm) == this-> _removed.end ()) {
 		    found = true;
 		    break;
 		}
@@ -181,7 +269,7 @@ namespace monitor {
 	    this-> _mutex.lock ();
 	    LibvirtVM * ret = nullptr;
 	    for (auto & vm : this-> _running) {
-		if (vm-> id () == name) {
+		if (vm-> id () == name && std::find (this-> _removed.begin (), this-> _removed.end (), vm) == this-> _removed.end ()) {
 		    ret = vm;
 		    break;
 		}
@@ -198,11 +286,10 @@ namespace monitor {
 	    for (auto & vm : this-> _running) {
 		if (vm-> id () != name) {
 		    res.push_back (vm);
-		    break;
 		}
 	    }
+	    this-> _running = std::move (res);
 	    this-> _mutex.unlock ();
-	    this-> _running = std::move (res);	    
 	}
 	
 
@@ -210,6 +297,18 @@ namespace monitor {
 	    return this-> _running;
 	}
 
+	void LibvirtClient::attach (LibvirtVM * vm) {
+	    vm-> _backend = this-> _backend.get ();
+
+	    this-> _mutex.lock ();
+	    this-> _running.push_back (vm);
+	    this-> _mutex.unlock ();
+	}
+
+	void LibvirtClient::detach (const std::string & name) {
+	    this-> removeVM (name);
+	}
+
        	
 	const LibvirtVM * LibvirtClient::provision (const utils::config::dict & cfg, const std::filesystem::path & path) {
 	    auto vm = new LibvirtVM (cfg);
@@ -236,10 +335,14 @@ namespace monitor {
 		logging::success ("VM", vm-> id (), "is ready at ip : ", vm-> ip ());
 	    
 		vm-> _dom = this-> retreiveDomain (vm-> id ());
+		vm-> _backend = this-> _backend.get ();
 	    
 		for (auto &it : vm-> getVCPUControllers ()) {
 		    it.enable ();
 		}
+		vm-> getCPUController ().enable ();
+		vm-> getMemoryController ().enable ();
+		vm-> getIOController ().enable ();
 			    
 		this-> _running.push_back (vm);
 
@@ -264,8 +367,65 @@ namespace monitor {
 
 		logging::success ("VM", v-> id (), "is killed");
 
-		this-> removeVM (vm);
-		delete v;		
+		// The loops of the controller may be using the VM, it is freed by releaseRemoved
+		this-> _mutex.lock ();
+		this-> _removed.push_back (v);
+		this-> _mutex.unlock ();
+	    }
+	}
+
+	void LibvirtClient::migrate (const std::string & vm, const std::string & uri, unsigned long bandwidth, bool sharedStorage, const std::filesystem::path & path) {
+	    auto v = this-> getVM (vm);
+	    if (v == nullptr || v-> _dom == nullptr) throw LibvirtError ("Unknown VM " + vm);
+
+	    virTypedParameterPtr params = nullptr;
+	    int nparams = 0, maxparams = 0;
+	    if (bandwidth != 0) {
+		virTypedParamsAddULLong (&params, &nparams, &maxparams, VIR_MIGRATE_PARAM_BANDWIDTH, bandwidth);
+	    }
+
+	    unsigned int flags = VIR_MIGRATE_LIVE | VIR_MIGRATE_PEER2PEER | VIR_MIGRATE_PERSIST_DEST | VIR_MIGRATE_UNDEFINE_SOURCE;
+	    if (!sharedStorage) flags |= VIR_MIGRATE_NON_SHARED_DISK;
+
+	    auto res = virDomainMigrateToURI3 (v-> _dom, uri.c_str (), params, nparams, flags);
+	    virTypedParamsFree (params, nparams);
+	    if (res != 0) throw LibvirtError ("Migration of " + vm + " to " + uri + " failed");
+
+	    // The drives were copied to the destination
+	    if (!sharedStorage) this-> deleteDirAndVMFile (*v, path / ("v" + v-> id ()));
+
+	    logging::success ("VM", v-> id (), "is migrated to", uri);
+
+	    this-> _mutex.lock ();
+	    this-> _removed.push_back (v);
+	    this-> _mutex.unlock ();
+	}
+
+	bool LibvirtClient::hasRemoved () {
+	    this-> _mutex.lock ();
+	    auto ret = !this-> _removed.empty ();
+	    this-> _mutex.unlock ();
+
+	    return ret;
+	}
+
+	void LibvirtClient::releaseRemoved () {
+	    this-> _mutex.lock ();
+	    auto removed = std::move (this-> _removed);
+	    this-> _removed.clear ();
+
+	    std::vector <LibvirtVM*> res;
+	    for (auto & vm : this-> _running) {
+		if (std::find (removed.begin (), removed.end (), vm) == removed.end ()) {
+		    res.push_back (vm);
+		}
+	    }
+	    this-> _running = std::move (res);
+	    this-> _mutex.unlock ();
+
+	    for (auto & v : removed) {
+		if (v-> _dom != nullptr) virDomainFree (v-> _dom);
+		delete v;
 	    }
 	}
 	
@@ -589,23 +749,8 @@ namespace monitor {
 
 
 	const std::vector <unsigned int> & LibvirtClient::readCPUFrequency () {
-	    if (this-> _cpuPath.size () != get_nprocs ()) {
-		for (auto i = 0 ; i < get_nprocs (); i++) {
-		    std::stringstream path;
-		    path << "/sys/devices/system/cpu/cpu" << i << "/cpufreq/scaling_cur_freq";
-		    this-> _cpuPath.push_back (path.str ());
-		    this-> _cpuFreq.push_back (0);
-		}
-	    }
-	    
-	    for (auto i = 0 ; i < this-> _cpuFreq.size (); i++) {
-		std::ifstream f (this-> _cpuPath[i]);
-		std::stringstream buffer;
-		std::string res;
-		buffer << f.rdbuf();
-		unsigned int p;
-		buffer >> this-> _cpuFreq[i];
-		f.close ();
+	    if (this-> _backend != nullptr) {
+		this-> _cpuFreq = this-> _backend-> readFrequencies ();
 	    }
 
 	    return this-> _cpuFreq;
@@ -5,6 +5,8 @@
 #include <monitor/concurrency/mutex.hh>
 #include <filesystem>
 #include <map>
+#include <memory>
+#include <monitor/libvirt/controller/backend.hh>
 #include <monitor/foreign/tinyxml2.h>
 
 namespace monitor {
@@ -24,21 +26,29 @@ namespace monitor {
 	    /// The uri of the qemu system
 	    const char * _uri;
 
+	    /// True iif the client is never connected (cf. offline ())
+	    bool _offline = false;
+
 	    /// The mutex used to synchronized the VM provisionning/killing that cannot be done in parallel
 	    concurrency::mutex _mutex;
 
 	    /// The list of running VMs
 	    std::vector <LibvirtVM*> _running;
 
+	    /// The VMs killed or migrated away, still in the running VMs until they are released (cf. releaseRemoved), but no longer found by their name
+	    std::vector <LibvirtVM*> _removed;
+
 	    /// The key used to connect to VM 
 	    std::string _pubKey;
 
 	    /// The directory containing monitor keys
 	    std::filesystem::path _keyPath;
 
-	    std::vector <unsigned int> _cpuFreq;
+	    /// The backend reading, and writing the cgroups of the VMs and the frequency of the cpus (nullptr for an offline client)
+	    std::unique_ptr <control::HostBackend> _backend;
 
-	    std::vector <std::string> _cpuPath;
+	    /// The frequency of the cpus read in the last update
+	    std::vector <unsigned int> _cpuFreq;
 
 	    
 	public:
@@ -49,6 +59,12 @@ namespace monitor {
 	     */
 	    LibvirtClient (const char * uri = "qemu:///system");
 
+	    /**
+	     * @returns: a client that is never connected to an hypervisor, its VMs have no domain and are attached by hand
+	     * @info: used by the simulator, the client does not need to be root, and does not touch the network of the host
+	     */
+	    static LibvirtClient offline ();
+
 	    /**
 	     * ================================================================================
 	     * ================================================================================
@@ -61,7 +77,7 @@ namespace monitor {
 	     * Connect the client
 	     * @info: this is a pretty heavy function, it should be done once at the beginning of the program
 	     * @throws: 
-	     *   - LibvirtError: if the connection failed
+	     *   - LibvirtError: if the connection failed, or if the client is offline
 	     */
 	    void connect ();
 
@@ -75,6 +91,24 @@ namespace monitor {
 	     * Set the path to the key directory
 	     */
 	    void setKeyPath (const std::filesystem::path & path);
+
+	    /**
+	     * Replace the backend of the host used by the controllers of the VMs
+	     * @info: must be called before any VM is provisionned or attached, the VMs keep the backend they were attached with
+	     * @params:
+	     *   - backend: the new backend (e.g. a SysfsBackend on a copied tree, or a FakeBackend)
+	     */
+	    void setBackend (std::unique_ptr <control::HostBackend> backend);
+
+	    /**
+	     * @returns: the backend of the host (nullptr for an offline client without backend)
+	     */
+	    control::HostBackend * getBackend ();
+
+	    /**
+	     * @returns: the number of cpus of the host
+	     */
+	    int getNbCpus ();
 	    
 	    /**
 	     * ================================================================================
@@ -93,6 +127,16 @@ namespace monitor {
 	     * Compute the means of the last ticks for before the market execution (and log dumping)
 	     */
 	    void updateVCPUBeforeMarket ();
+
+	    /**
+	     * Sample the memory usage of the vms
+	     */
+	    void updateMemoryControllers ();
+
+	    /**
+	     * Sample the io rates of the vms
+	     */
+	    void updateIOControllers ();
 	    
 	    /**
 	     * ================================================================================
@@ -113,6 +157,22 @@ namespace monitor {
 	     * Kill all the domains that are running on this machine
 	     */
 	    void killAllRunningDomains ();
+
+	    /**
+	     * Kill the domains managed by the monitor (named v*) that are running on this machine, but not adopted (or provisionned)
+	     */
+	    void killUnknownDomains ();
+
+	    /**
+	     * Adopt a VM that was provisionned by a previous run of the monitor, and is still running
+	     * @info: the cgroups of the vcpus are attached again, the market informations (money, history) are not restored
+	     * @params:
+	     *   - cfg: the configuration used to provision the VM
+	     *   - ip: the ip address of the VM
+	     *   - mac: the mac address of the VM
+	     * @returns: the adopted VM, nullptr if the domain of the VM is not running
+	     */
+	    LibvirtVM * adoptVM (const utils::config::dict & cfg, const std::string & ip, const std::string & mac);
 	    
 	    /**
 	     * Retrieve the XML of the VM vm
@@ -138,6 +198,21 @@ namespace monitor {
 	     */
 	    std::vector <LibvirtVM*> & getRunningVMs ();
 
+	    /**
+	     * Add a VM to the running VMs without provisionning it
+	     * @info: used by the offline clients, the VM stays owned by the caller, its controllers use the backend of the client (but are not enabled)
+	     * @params:
+	     *   - vm: the VM to add (without domain)
+	     */
+	    void attach (LibvirtVM * vm);
+
+	    /**
+	     * Remove a VM from the running VMs without killing it
+	     * @params:
+	     *   - name: the id of the VM
+	     */
+	    void detach (const std::string & name);
+
 	    /**
 	     * Provision a new VM
 	     * @params: 
@@ -152,12 +227,39 @@ namespace monitor {
 	    /**
 	     * Kill the VM that is running
 	     * @info: delete the associated drives
+	     * @info: the VM stays in the running VMs until releaseRemoved is called, as other threads may be using it
 	     * @params: 
 	     *   - vm: the name of the vm to kill
 	     *   - path: the location of the installed VM
 	     */
 	    void kill (const std::string & vm, const std::filesystem::path & path = "/tmp/");
 
+	    /**
+	     * Live migrate a running VM to another hypervisor
+	     * @info: the domain is persisted on the destination and undefined here, the drives are copied with the memory if the storage is not shared
+	     * @info: the VM stays in the running VMs until releaseRemoved is called, as other threads may be using it
+	     * @params:
+	     *   - vm: the name of the vm to migrate
+	     *   - uri: the uri of the destination hypervisor (e.g. qemu+ssh://host/system)
+	     *   - bandwidth: the maximal bandwidth of the migration in MiB/s (0 for no limit)
+	     *   - sharedStorage: true iif the drives of the VM are reachable from the destination at the same path
+	     *   - path: the location of the installed VM
+	     * @throws:
+	     *   - LibvirtError: if the VM is unknown or the migration failed (the VM still runs here)
+	     */
+	    void migrate (const std::string & vm, const std::string & uri, unsigned long bandwidth, bool sharedStorage, const std::filesystem::path & path = "/tmp/");
+
+	    /**
+	     * Remove the VMs that were killed or migrated away from the running VMs, and free them
+	     * @warning: no other thread may be using the running VMs during the call
+	     */
+	    void releaseRemoved ();
+
+	    /**
+	     * @returns: true iif some VMs were killed or migrated away, and are not released yet
+	     */
+	    bool hasRemoved ();
+
 	    
 	    /**
 	     * ================================================================================
@@ -203,6 +305,13 @@ namespace monitor {
 
 	private :
 
+	    /**
+	     * @params:
+	     *   - uri: the uri of the qemu system
+	     *   - offline: if true, the client is not allowed to connect (cf. offline ())
+	     */
+	    LibvirtClient (const char * uri, bool offline);
+
 	    /**
 	     * ================================================================================
 	     * ================================================================================
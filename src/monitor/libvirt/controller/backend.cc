@@ -0,0 +1,92 @@
+#include <monitor/libvirt/controller/backend.hh>
+#include <algorithm>
+#include <sstream>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    long HostBackend::VCPU::readFrequency () {
+		return -1;
+	    }
+
+	    bool HostBackend::VCPU::readCounters (counters &) {
+		return false;
+	    }
+
+	    bool HostBackend::VCPU::setAffinity (const std::vector <unsigned int> &) {
+		return false;
+	    }
+
+	    HostBackend::VCPU::~VCPU () {}
+
+	    bool HostBackend::VM::setMemoryNodes (const std::vector <unsigned int> &) {
+		return false;
+	    }
+
+	    HostBackend::VM::~VM () {}
+
+	    HostBackend::topology HostBackend::readTopology () {
+		topology t;
+		for (int i = 0 ; i < this-> nbCpus () ; i++) {
+		    cpu_place p;
+		    p.core = i;
+		    p.domain = i;
+		    t.cpus.push_back (p);
+		}
+
+		t.memory.push_back (0);
+		return t;
+	    }
+
+	    bool HostBackend::setMaxFrequency (unsigned int, unsigned int) {
+		return false;
+	    }
+
+	    void HostBackend::sample () {}
+
+	    HostBackend::~HostBackend () {}
+
+	    std::string HostBackend::formatList (const std::vector <unsigned int> & ids) {
+		auto sorted = ids;
+		std::sort (sorted.begin (), sorted.end ());
+
+		std::stringstream ss;
+		for (std::size_t i = 0 ; i < sorted.size () ; ) {
+		    auto j = i;
+		    while (j + 1 < sorted.size () && sorted [j + 1] <= sorted [j] + 1) j += 1;
+
+		    if (i != 0) ss << ",";
+		    ss << sorted [i];
+		    if (sorted [j] != sorted [i]) ss << "-" << sorted [j];
+		    i = j + 1;
+		}
+
+		return ss.str ();
+	    }
+
+	    std::vector <unsigned int> HostBackend::parseList (const std::string & list) {
+		std::vector <unsigned int> ids;
+		std::stringstream ss (list);
+		std::string range;
+		while (std::getline (ss, range, ',')) {
+		    if (range.empty () || range [0] < '0' || range [0] > '9') continue;
+
+		    auto dash = range.find ('-');
+		    unsigned int start = std::stoul (range.substr (0, dash));
+		    unsigned int end = dash == std::string::npos ? start : std::stoul (range.substr (dash + 1));
+		    for (auto i = start ; i <= end ; i++) ids.push_back (i);
+		}
+
+		std::sort (ids.begin (), ids.end ());
+		ids.erase (std::unique (ids.begin (), ids.end ()), ids.end ());
+		return ids;
+	    }
+
+	}
+
+    }
+
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    /**
+	     * The access to the host used by the cpu controllers : consumption and placement of the vcpu threads, frequency of the cpus, and quotas
+	     * The controllers never read the sysfs directly, so the control loop can run against a fake host (cf. FakeBackend), or a backend reading the host differently
+	     */
+	    class HostBackend {
+	    public:
+
+		/**
+		 * The hardware counters of a vcpu thread, since it was found
+		 */
+		struct counters {
+		    /// The cycles executed by the thread
+		    unsigned long cycles = 0;
+
+		    /// The instructions retired by the thread
+		    unsigned long instructions = 0;
+
+		    /// The misses in the last level cache (0 if the counter is not available)
+		    unsigned long llcMisses = 0;
+		};
+
+		/**
+		 * The place of a cpu in the topology of the host
+		 */
+		struct cpu_place {
+		    /// The numa node of the cpu
+		    unsigned int node = 0;
+
+		    /// The socket of the cpu
+		    unsigned int package = 0;
+
+		    /// The physical core of the cpu (shared by its hyperthreads)
+		    unsigned int core = 0;
+
+		    /// The last level cache of the cpu (the lowest cpu sharing the cache)
+		    unsigned int llc = 0;
+
+		    /// The frequency domain of the cpu (the lowest cpu whose frequency is set with it)
+		    unsigned int domain = 0;
+
+		    /// The minimal frequency of the cpu in KHz (0 if unknown)
+		    unsigned int minFreq = 0;
+
+		    /// The maximal frequency of the cpu in KHz (0 if unknown)
+		    unsigned int maxFreq = 0;
+		};
+
+		/**
+		 * The numa nodes and caches of the host
+		 */
+		struct topology {
+		    /// The place of each cpu
+		    std::vector <cpu_place> cpus;
+
+		    /// The memory of each numa node in MB (0 if unknown)
+		    std::vector <unsigned long> memory;
+		};
+
+		/**
+		 * The thread of a vcpu, found in the host
+		 */
+		class VCPU {
+		public:
+
+		    /**
+		     * @returns: the cpu time consumed by the vcpu since it started in microseconds
+		     */
+		    virtual unsigned long readUsage () = 0;
+
+		    /**
+		     * @returns: the id of the cpu that ran the vcpu last
+		     */
+		    virtual unsigned int readCpu () = 0;
+
+		    /**
+		     * @returns: the mean frequency of the vcpu since the last call in KHz, -1 if the backend does not measure it (the frequency of the cpu given by readCpu is used instead)
+		     */
+		    virtual long readFrequency ();
+
+		    /**
+		     * Read the hardware counters of the vcpu
+		     * @params:
+		     *    - c: the counters to fill
+		     * @returns: false if the backend does not count them (c is unchanged)
+		     */
+		    virtual bool readCounters (counters & c);
+
+		    /**
+		     * Set the quota of the vcpu
+		     * @params:
+		     *    - nbMicros: the number of microseconds the vcpu can use during one period (-1 for no limit)
+		     *    - period: the period in microseconds
+		     */
+		    virtual void setLimit (long nbMicros, unsigned long period) = 0;
+
+		    /**
+		     * Restrict the cpus that can run the vcpu
+		     * @params:
+		     *    - cpus: the ids of the cpus (all the cpus if empty)
+		     * @returns: false if the backend cannot pin the vcpus
+		     */
+		    virtual bool setAffinity (const std::vector <unsigned int> & cpus);
+
+		    virtual ~VCPU ();
+		};
+
+		/**
+		 * The group of all the threads of a VM, found in the host
+		 */
+		class VM {
+		public:
+
+		    /**
+		     * Set the quota shared by all the vcpus of the VM
+		     * @params:
+		     *    - nbMicros: the number of microseconds the VM can use during one period (-1 for no limit)
+		     *    - period: the period in microseconds
+		     */
+		    virtual void setLimit (long nbMicros, unsigned long period) = 0;
+
+		    /**
+		     * Restrict the numa nodes the memory of the VM is allocated on (the pages already allocated elsewhere are migrated)
+		     * @params:
+		     *    - nodes: the ids of the nodes (all the nodes if empty)
+		     * @returns: false if the backend cannot bind the memory
+		     */
+		    virtual bool setMemoryNodes (const std::vector <unsigned int> & nodes);
+
+		    virtual ~VM ();
+		};
+
+	    public:
+
+		/**
+		 * Search the thread of a vcpu
+		 * @params:
+		 *    - vmName: the name of the VM
+		 *    - vcpuId: the number of the vcpu in the VM
+		 * @returns: the vcpu, nullptr if it is not running (yet)
+		 */
+		virtual std::unique_ptr <VCPU> findVCPU (const std::string & vmName, unsigned int vcpuId) = 0;
+
+		/**
+		 * Search the group of threads of a VM
+		 * @params:
+		 *    - vmName: the name of the VM
+		 * @returns: the VM, nullptr if it is not running
+		 */
+		virtual std::unique_ptr <VM> findVM (const std::string & vmName) = 0;
+
+		/**
+		 * @returns: the number of cpus of the host
+		 */
+		virtual int nbCpus () = 0;
+
+		/**
+		 * Read the current frequency of the cpus
+		 * @returns: the frequency of each cpu in KHz
+		 */
+		virtual const std::vector <unsigned int> & readFrequencies () = 0;
+
+		/**
+		 * Read the numa nodes and caches of the host
+		 * @returns: the topology, by default a single node whose cpus share one cache
+		 */
+		virtual topology readTopology ();
+
+		/**
+		 * Limit the frequency of a cpu (the governor of the cpu still chooses its frequency below the limit)
+		 * @params:
+		 *    - cpu: the id of the cpu
+		 *    - frequency: the maximal frequency in KHz
+		 * @returns: false if the backend cannot limit the frequency
+		 * @info: the limit applies to the whole frequency domain of the cpu
+		 */
+		virtual bool setMaxFrequency (unsigned int cpu, unsigned int frequency);
+
+		/**
+		 * Read the state of all the vcpus at once, before they are updated
+		 * @info: called once per tick by the client, the vcpus then read their values from this sample
+		 */
+		virtual void sample ();
+
+		virtual ~HostBackend ();
+
+		/**
+		 * @returns: the list of ids in the format of the kernel (e.g. "0-3,8,10-11")
+		 */
+		static std::string formatList (const std::vector <unsigned int> & ids);
+
+		/**
+		 * @returns: the ids of a list in the format of the kernel (e.g. "0-3,8,10-11"), sorted
+		 */
+		static std::vector <unsigned int> parseList (const std::string & list);
+
+	    };
+
+	}
+
+    }
+
+}
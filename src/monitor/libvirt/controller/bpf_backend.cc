@@ -0,0 +1,212 @@
+#ifdef DIO_BPF
+
+#include <monitor/libvirt/controller/bpf_backend.hh>
+#include <monitor/utils/log.hh>
+#include <bpf/libbpf.h>
+#include <bpf/bpf.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#include <cerrno>
+
+namespace fs = std::filesystem;
+using namespace monitor::utils;
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    BpfBackend::BpfBackend (const fs::path & object, const fs::path & root) :
+		SysfsBackend (root)
+	    {
+		if (!this-> load (object)) {
+		    this-> _program = nullptr;
+		    logging::warn ("eBPF vcpu sampler unavailable, the vcpus are read in procfs");
+		}
+	    }
+
+	    bool BpfBackend::isLoaded () const {
+		return this-> _program != nullptr;
+	    }
+
+	    bool BpfBackend::load (const fs::path & object) {
+		auto prog = std::make_shared <program> ();
+		prog-> obj = bpf_object__open_file (object.c_str (), nullptr);
+		if (prog-> obj == nullptr) return false;
+		if (bpf_object__load (prog-> obj) != 0) return false;
+
+		auto p = bpf_object__find_program_by_name (prog-> obj, "on_sched_switch");
+		prog-> vcpus = bpf_object__find_map_fd_by_name (prog-> obj, "vcpus");
+		int cycles = bpf_object__find_map_fd_by_name (prog-> obj, "cycles");
+		if (p == nullptr || prog-> vcpus < 0 || cycles < 0) return false;
+
+		// Without the cycle counters (e.g. in a VM), the runtime is still exact, but the frequency is the one of the cpus
+		for (__u32 cpu = 0 ; cpu < (__u32) this-> nbCpus () ; cpu++) {
+		    perf_event_attr attr = {};
+		    attr.type = PERF_TYPE_HARDWARE;
+		    attr.size = sizeof (attr);
+		    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+
+		    int fd = syscall (__NR_perf_event_open, &attr, -1, cpu, -1, 0);
+		    if (fd < 0) continue;
+
+		    if (bpf_map_update_elem (cycles, &cpu, &fd, BPF_ANY) != 0) {
+			close (fd);
+			continue;
+		    }
+
+		    prog-> counters.push_back (fd);
+		}
+
+		if (prog-> counters.size () != (std::size_t) this-> nbCpus ()) {
+		    logging::warn ("Cycle counters available on", prog-> counters.size (), "cpus of", this-> nbCpus ());
+		}
+
+		prog-> link = bpf_program__attach (p);
+		if (prog-> link == nullptr) return false;
+
+		this-> _keys.resize (VCPU_MAX_THREADS);
+		this-> _values.resize (VCPU_MAX_THREADS);
+		this-> _program = prog;
+
+		logging::success ("eBPF vcpu sampler attached on sched_switch");
+		return true;
+	    }
+
+	    std::unique_ptr <HostBackend::VCPU> BpfBackend::findVCPU (const std::string & vmName, unsigned int vcpuId) {
+		if (this-> _program == nullptr) return SysfsBackend::findVCPU (vmName, vcpuId);
+
+		unsigned int tid = 0;
+		auto sysfs = this-> findSysfsVCPU (vmName, vcpuId, tid);
+		if (sysfs == nullptr) return nullptr;
+
+		// The map is full, this vcpu is read in procfs
+		vcpu_stat zero = {};
+		__u32 key = tid;
+		if (bpf_map_update_elem (this-> _program-> vcpus, &key, &zero, BPF_ANY) != 0) {
+		    logging::warn ("eBPF vcpu sampler cannot account the vcpu", vcpuId, "of VM", vmName);
+		    return sysfs;
+		}
+
+		return std::make_unique <BpfVCPU> (std::move (sysfs), this-> _program, key);
+	    }
+
+	    void BpfBackend::sample () {
+		if (this-> _program == nullptr) return;
+
+		auto & prog = *this-> _program;
+		timespec ts;
+		clock_gettime (CLOCK_MONOTONIC, &ts);
+		prog.now = ((__u64) ts.tv_sec) * 1000000000 + ts.tv_nsec;
+		prog.stats.clear ();
+
+		__u32 out = 0;
+		void * in = nullptr;
+		for (;;) {
+		    __u32 count = this-> _keys.size ();
+		    int err = bpf_map_lookup_batch (prog.vcpus, in, &out, this-> _keys.data (), this-> _values.data (), &count, nullptr);
+		    for (__u32 i = 0 ; i < count ; i++) {
+			prog.stats [this-> _keys [i]] = this-> _values [i];
+		    }
+
+		    if (err == 0) {
+			in = &out;
+			continue;
+		    }
+
+		    if (errno == ENOENT) return; // the whole map was read
+		    break;
+		}
+
+		// The kernel does not support the batch operations (< 5.6), the threads are read one by one
+		__u32 key = 0, next = 0;
+		void * prev = nullptr;
+		while (bpf_map_get_next_key (prog.vcpus, prev, &next) == 0) {
+		    vcpu_stat s;
+		    if (bpf_map_lookup_elem (prog.vcpus, &next, &s) == 0) prog.stats [next] = s;
+
+		    key = next;
+		    prev = &key;
+		}
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================             VCPU             =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    BpfBackend::BpfVCPU::BpfVCPU (std::unique_ptr <SysfsVCPU> sysfs, std::shared_ptr <program> prog, __u32 tid) :
+		_sysfs (std::move (sysfs)),
+		_program (prog),
+		_tid (tid)
+	    {}
+
+	    unsigned long BpfBackend::BpfVCPU::readUsage () {
+		auto it = this-> _program-> stats.find (this-> _tid);
+		if (it == this-> _program-> stats.end ()) return this-> _usage;
+
+		// The slice that is running is not yet in the runtime
+		auto & s = it-> second;
+		auto runtime = s.runtime;
+		if (s.start != 0 && this-> _program-> now > s.start) runtime += this-> _program-> now - s.start;
+
+		this-> _usage = std::max (this-> _usage, (unsigned long) (runtime / 1000));
+		return this-> _usage;
+	    }
+
+	    unsigned int BpfBackend::BpfVCPU::readCpu () {
+		return this-> _sysfs-> readCpu ();
+	    }
+
+	    long BpfBackend::BpfVCPU::readFrequency () {
+		auto it = this-> _program-> stats.find (this-> _tid);
+		if (it == this-> _program-> stats.end ()) return -1;
+
+		auto & s = it-> second;
+		auto runtime = s.runtime - this-> _lastRuntime;
+		auto cycles = s.cycles - this-> _lastCycles;
+		this-> _lastRuntime = s.runtime;
+		this-> _lastCycles = s.cycles;
+
+		// No finished slice, or no cycle counter
+		if (runtime == 0 || cycles == 0) return -1;
+
+		// cycles per nanosecond are GHz
+		return (long) (((double) cycles) / ((double) runtime) * 1000000.0);
+	    }
+
+	    bool BpfBackend::BpfVCPU::readCounters (HostBackend::counters & c) {
+		return this-> _sysfs-> readCounters (c);
+	    }
+
+	    void BpfBackend::BpfVCPU::setLimit (long nbMicros, unsigned long period) {
+		this-> _sysfs-> setLimit (nbMicros, period);
+	    }
+
+	    bool BpfBackend::BpfVCPU::setAffinity (const std::vector <unsigned int> & cpus) {
+		return this-> _sysfs-> setAffinity (cpus);
+	    }
+
+	    BpfBackend::BpfVCPU::~BpfVCPU () {
+		bpf_map_delete_elem (this-> _program-> vcpus, &this-> _tid);
+	    }
+
+	    BpfBackend::program::~program () {
+		if (this-> link != nullptr) bpf_link__destroy (this-> link);
+		for (auto & fd : this-> counters) close (fd);
+		if (this-> obj != nullptr) bpf_object__close (this-> obj);
+	    }
+
+	}
+
+    }
+
+}
+
+#endif
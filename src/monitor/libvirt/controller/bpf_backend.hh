@@ -0,0 +1,137 @@
+#pragma once
+
+#ifdef DIO_BPF
+
+#include <unordered_map>
+#include <monitor/libvirt/controller/sysfs_backend.hh>
+#include <bpf/vcpu.h>
+
+struct bpf_object;
+struct bpf_link;
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    /**
+	     * The sysfs backend, whose vcpus are accounted by an eBPF program on the sched_switch tracepoint (src/bpf/vcpu.bpf.c)
+	     * The program sums the exact on-cpu time of each vcpu thread, and the cycles of the cpus during its slices, the frequency of a vcpu is then cycles / runtime even if the thread migrates
+	     * The map of the program is read with one batch syscall per tick (cf. sample)
+	     * @info: if the program cannot be loaded (no libbpf object, not root, kernel without BPF), the backend is the SysfsBackend (procfs and cgroups)
+	     */
+	    class BpfBackend : public SysfsBackend {
+
+		/**
+		 * The program loaded in the kernel, shared with the vcpus that remove their thread from the map when they are destroyed
+		 */
+		struct program {
+		    /// The loaded object
+		    bpf_object * obj = nullptr;
+
+		    /// The attachment on the tracepoint
+		    bpf_link * link = nullptr;
+
+		    /// The map of the accounted threads
+		    int vcpus = -1;
+
+		    /// The cycle counters of the cpus
+		    std::vector <int> counters;
+
+		    /// The content of the map at the last sample
+		    std::unordered_map <__u32, vcpu_stat> stats;
+
+		    /// The instant of the last sample (CLOCK_MONOTONIC, as bpf_ktime_get_ns) in nanoseconds
+		    __u64 now = 0;
+
+		    ~program ();
+		};
+
+		/**
+		 * A vcpu whose usage and frequency are read from the last sample of the map
+		 */
+		class BpfVCPU : public HostBackend::VCPU {
+
+		    /// The sysfs vcpu, used for the limits
+		    std::unique_ptr <SysfsVCPU> _sysfs;
+
+		    /// The program accounting the thread
+		    std::shared_ptr <program> _program;
+
+		    /// The id of the thread of the vcpu
+		    __u32 _tid;
+
+		    /// The runtime read at the last call of readFrequency in nanoseconds
+		    __u64 _lastRuntime = 0;
+
+		    /// The cycles read at the last call of readFrequency
+		    __u64 _lastCycles = 0;
+
+		    /// The last usage returned in microseconds
+		    unsigned long _usage = 0;
+
+		public:
+
+		    BpfVCPU (std::unique_ptr <SysfsVCPU> sysfs, std::shared_ptr <program> prog, __u32 tid);
+
+		    unsigned long readUsage () override;
+
+		    unsigned int readCpu () override;
+
+		    long readFrequency () override;
+
+		    bool readCounters (HostBackend::counters & c) override;
+
+		    void setLimit (long nbMicros, unsigned long period) override;
+
+		    bool setAffinity (const std::vector <unsigned int> & cpus) override;
+
+		    ~BpfVCPU ();
+
+		};
+
+	    private:
+
+		/// The loaded program (nullptr if the backend falls back to procfs)
+		std::shared_ptr <program> _program;
+
+		/// The buffers of the batch reads
+		std::vector <__u32> _keys;
+		std::vector <vcpu_stat> _values;
+
+	    public:
+
+		/**
+		 * @params:
+		 *    - object: the compiled program (vcpu.bpf.o)
+		 *    - root: the directory containing sys and proc
+		 */
+		BpfBackend (const std::filesystem::path & object = "/usr/lib/dio/vcpu.bpf.o", const std::filesystem::path & root = "/");
+
+		/**
+		 * @returns: true iif the program is loaded (false if the backend reads the procfs)
+		 */
+		bool isLoaded () const;
+
+		std::unique_ptr <HostBackend::VCPU> findVCPU (const std::string & vmName, unsigned int vcpuId) override;
+
+		void sample () override;
+
+	    private:
+
+		/**
+		 * Load the program and attach it to the tracepoint, open the cycle counters
+		 * @returns: false if the program could not be loaded
+		 */
+		bool load (const std::filesystem::path & object);
+
+	    };
+
+	}
+
+    }
+
+}
+
+#endif
@@ -16,125 +16,49 @@ namespace monitor {
 
 	    cgroup::cgroup (const std::string & vmName) :
 		_vmName (vmName)
-	    {
-		std::ifstream f ("/sys/fs/cgroup/cgroup.controllers");
-		this-> _v2 = f.good ();
-		f.close ();		
-	    }
+	    {}
 
-	    void cgroup::enable (unsigned int vcpuId) {
+	    void cgroup::enable (unsigned int vcpuId, HostBackend & backend) {
 		concurrency::timer t;
-		std::stringstream ss; ss << "vcpu" << vcpuId;
-		std::stringstream vname; vname << "v" << this-> _vmName;
-		std::filesystem::path cgroupPath;
-		if (this-> _v2) {
-		    auto path = fs::path ("/sys/fs/cgroup/machine.slice");
-		    for (;;) {
-			cgroupPath = this-> recursiveSearch (path, vname.str ());
-			if (cgroupPath.u8string ().length () != 0) {
-			    cgroupPath = cgroupPath  / ss.str ();
-			    break;
-			}
-			t.sleep (0.1);
-		    } 
-		} else {
-		    auto path = fs::path ("/sys/fs/cgroup/cpu/machine.slice");
-		    for (;;) {			
-			cgroupPath = this-> recursiveSearch (path, vname.str ());
-			if (cgroupPath.u8string ().length () != 0) {
-			    cgroupPath = cgroupPath  / ss.str ();
-			    break;
-			}
-			t.sleep (0.1);
-		    }
-		
+		for (;;) {
+		    this-> _vcpu = backend.findVCPU (this-> _vmName, vcpuId);
+		    if (this-> _vcpu != nullptr) break;
+		    t.sleep (0.1);
 		}
-		
-		this-> _procId = this-> readProcId (cgroupPath);
-		
-		std::stringstream ss2;
-		ss2 << "/proc/" << this-> _procId << "/stat";
-		auto procPath = std::filesystem::path (ss2.str ());
-
-		if (this-> _v2) {
-		    this-> _usage = std::ifstream (cgroupPath / "cpu.stat");
-		    this-> _limit = cgroupPath / "cpu.max";
-		} else {
-		    this-> _usage = std::ifstream (cgroupPath / "cpuacct.usage");
-		    this-> _limit =  cgroupPath / "cpu.cfs_quota_us";
-		}
-		
-		this-> _procPath = procPath;
 	    }
 
-	    unsigned int cgroup::readUsage () {
-		this-> _usage.sync ();
-		this-> _usage.seekg (0, this-> _usage.beg);
-		unsigned long res = 0;
-		if (this-> _v2) {
-		    std::string ignore;
-		    this-> _usage >> ignore;
-		    this-> _usage >> res;
-
-		    return res;
-		} else {
-		    this-> _usage >> res;
-		    return res / 1000;
-		}		
+	    bool cgroup::isEnabled () const {
+		return this-> _vcpu != nullptr;
 	    }
 
-	    void cgroup::setLimit (long nbMicros, unsigned long period) {
-		std::ofstream limit (this-> _limit);
-		if (this-> _v2) {
-		    if (nbMicros == -1) {
-			limit << "max " << period;
-		    } else {
-			limit << nbMicros << " " << period;
-		    }
-		} else {
-		    limit << nbMicros;		    
-		}
-		
-		limit.close ();
+	    unsigned long cgroup::readUsage () {
+		if (this-> _vcpu == nullptr) return 0;
+		return this-> _vcpu-> readUsage ();
 	    }
 
-	    unsigned int cgroup::readCpu () {		
-		FILE *fp = fopen(this-> _procPath.c_str (), "r");
-		if(fp != NULL)
-		{
-		    char content[1024];
-		    size_t len = fread (content, sizeof (char), 1024, fp);
-		    content[len] = '\0';
-		    
-		    int i = 0, j = 0;
-		    for (;;)
-		    {
-			if (content[j] == ' ') { i += 1; if (i == 39) break;}
-			j += 1;
-		    }
+	    void cgroup::setLimit (long nbMicros, unsigned long period) {
+		if (this-> _vcpu == nullptr) return;
+		this-> _vcpu-> setLimit (nbMicros, period);
+	    }
 
-		    char * endPtr;
-		    int p = strtol (content + j, &endPtr, 10);
-		    
-		    fclose(fp);
-		    return p;
-		}
-		
-		return 0;
+	    unsigned int cgroup::readCpu () {
+		if (this-> _vcpu == nullptr) return 0;
+		return this-> _vcpu-> readCpu ();
 	    }
 
+	    long cgroup::readFrequency () {
+		if (this-> _vcpu == nullptr) return -1;
+		return this-> _vcpu-> readFrequency ();
+	    }
 
-	    unsigned int cgroup::readProcId (const std::filesystem::path & cgroupPath) const {
-		auto path = cgroupPath / "cgroup.threads";
-		std::ifstream t (path);
-		std::stringstream buffer;
-		buffer << t.rdbuf();
-		t.close ();
-		
-		int j = 0;
-		buffer >> j;
+	    bool cgroup::readCounters (HostBackend::counters & c) {
+		if (this-> _vcpu == nullptr) return false;
+		return this-> _vcpu-> readCounters (c);
+	    }
 
-		return j;       
+	    bool cgroup::setAffinity (const std::vector <unsigned int> & cpus) {
+		if (this-> _vcpu == nullptr) return false;
+		return this-> _vcpu-> setAffinity (cpus);
 	    }
 	    
 	    std::filesystem::path cgroup::recursiveSearch (const fs::path & path, const std::string & name) {
@@ -144,7 +68,7 @@ namespace monitor {
 		    } else {
 			for (const auto & entry : fs::directory_iterator(path)) {
 			    if (fs::is_directory (entry.path ())) {
-				auto ret = this-> recursiveSearch (fs::path (entry.path ()), name);
+				auto ret = recursiveSearch (fs::path (entry.path ()), name);
 				if (ret != "") return ret;
 			    }
 			}	    
@@ -3,6 +3,8 @@
 #include <vector>
 #include <filesystem>
 #include <fstream>
+#include <memory>
+#include <monitor/libvirt/controller/backend.hh>
 #include <monitor/concurrency/timer.hh>
 #include <nlohmann/json.hpp>
 
@@ -12,24 +14,15 @@ namespace monitor {
 	
 	namespace control {
 	    
+	    /**
+	     * The cgroup of a vcpu, read and written through the backend of the host
+	     */
 	    class cgroup {
 		
 		const std::string _vmName;
-		
-		/// True if cgroup is v2
-		bool _v2;
-
-		/// The id of the proc of the vcpu
-		unsigned int _procId;
-
-		/// The file in which usage of the vcpu is written
-		std::ifstream _usage;
-
-		/// The file in which the limit of the vcpu is written
-		std::filesystem::path _limit;
 
-		/// The file in which the stat of the vcpu process is written
-		std::filesystem::path _procPath;		
+		/// The thread of the vcpu in the host (nullptr until the cgroup is enabled)
+		std::unique_ptr <HostBackend::VCPU> _vcpu;
 		
 	    public:
 
@@ -40,14 +33,23 @@ namespace monitor {
 		cgroup (const std::string & vmName);
 
 		/**
-		 * Enable the cgroup 
+		 * Enable the cgroup
+		 * @info: wait until the vcpu is found in the host
+		 * @params:
+		 *    - vcpuId: the number of the vcpu in the VM
+		 *    - backend: the backend of the host
 		 */
-		void enable (unsigned int vcpuId);
+		void enable (unsigned int vcpuId, HostBackend & backend);
+
+		/**
+		 * @returns: true iif the cgroup was enabled
+		 */
+		bool isEnabled () const;
 				
 		/**
-		 * Read the current usage of the cgroup
+		 * Read the current usage of the cgroup in microseconds
 		 */
-		unsigned int readUsage ();
+		unsigned long readUsage ();
 
 		/**
 		 * Set the limit of the cgroup
@@ -58,18 +60,30 @@ namespace monitor {
 		 * Read the id of the cpu that is running the vcpu
 		 */
 		unsigned int readCpu ();
-		
-	    private:
 
 		/**
-		 * @returns: the proc id of the associated vcpu
+		 * Read the mean frequency of the vcpu since the last read
+		 * @returns: the frequency in KHz, -1 if the backend does not measure it
 		 */
-		unsigned int readProcId (const std::filesystem::path & cgroupPath) const;
-		
+		long readFrequency ();
+
+		/**
+		 * Read the hardware counters of the vcpu since it was found
+		 * @returns: false if the backend does not count
+		 */
+		bool readCounters (HostBackend::counters & c);
+
+		/**
+		 * Restrict the cpus that can run the vcpu
+		 * @returns: false if the backend cannot pin the vcpu
+		 */
+		bool setAffinity (const std::vector <unsigned int> & cpus);
+
 		/**
 		 * Recursively search for the cgroup of the VM
+		 * @returns: the first directory whose path contains vmName, empty path if there is none
 		 */
-		std::filesystem::path recursiveSearch (const std::filesystem::path & p, const std::string & vmName);
+		static std::filesystem::path recursiveSearch (const std::filesystem::path & p, const std::string & vmName);
 		
 	    };	    
 
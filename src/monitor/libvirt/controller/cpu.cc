@@ -0,0 +1,182 @@
+#include <monitor/libvirt/controller/cpu.hh>
+#include <monitor/libvirt/vm.hh>
+#include <monitor/utils/log.hh>
+
+using namespace monitor::utils;
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    LibvirtCPUController::LibvirtCPUController (LibvirtVM & context, int maxHistory) :
+		_context (context),
+		_enabled (false),
+		_history (maxHistory)
+	    {}
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================          ACQUIRING           =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    void LibvirtCPUController::enable () {
+		// A VM that is not on a host is simulated, its quota is only recorded
+		if (this-> _context._backend != nullptr && !this-> _cgroup.enable (this-> _context.id (), *this-> _context._backend)) {
+		    logging::warn ("CPU cgroup of VM", this-> _context.id (), "not found");
+		}
+
+		this-> _enabled = true;
+	    }
+
+	    void LibvirtCPUController::updateBeforeMarket () {
+		this-> _consumption = 0;
+		for (auto & vt : this-> _context.getVCPUControllers ()) {
+		    this-> _consumption += vt.getAbsoluteConsumption ();
+		}
+
+		this-> _allocated = 0;
+		this-> _buying = 0;
+		this-> _history.push (((float) this-> _consumption) / ((float) this-> getMaxConsumption ()) * 100.0f);
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================           GETTERS            =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    unsigned long LibvirtCPUController::getConsumption () const {
+		return this-> _consumption;
+	    }
+
+	    unsigned long LibvirtCPUController::getMaxConsumption () const {
+		return ((unsigned long) this-> _context.vcpus ()) * 1000000;
+	    }
+
+	    unsigned long LibvirtCPUController::getAbsoluteCapping () const {
+		if (this-> _quota < 0) return this-> getMaxConsumption ();
+		return this-> _quota;
+	    }
+
+	    float LibvirtCPUController::getRelativePercentConsumption () const {
+		return ((float) this-> _consumption) / ((float) this-> getAbsoluteCapping ()) * 100.0f;
+	    }
+
+	    float LibvirtCPUController::getSlope () const {
+		return this-> _history.slope ();
+	    }
+
+	    float LibvirtCPUController::getIPC () const {
+		unsigned long cycles = 0, instructions = 0;
+		for (auto & vt : this-> _context.getVCPUControllers ()) {
+		    cycles += vt.getCycles ();
+		    instructions += vt.getInstructions ();
+		}
+
+		if (cycles == 0) return 0.0f;
+		return ((float) instructions) / ((float) cycles);
+	    }
+
+	    unsigned long LibvirtCPUController::getNominal (int cpuFreq) const {
+		unsigned long nominal = 0;
+		for (auto & vt : this-> _context.getVCPUControllers ()) {
+		    nominal += ((float) vt.getNominalFreq ()) / ((float) cpuFreq) * 1000000;
+		}
+
+		return nominal;
+	    }
+
+	    LibvirtVM & LibvirtCPUController::vm () {
+		return this-> _context;
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================         CONTROLLING          =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    void LibvirtCPUController::setQuota (unsigned long nbMicros, unsigned long period) {
+		if (!this-> _enabled) return;
+
+		// As for the vcpus, an allocation close to the maximum is not worth throttling
+		if (nbMicros >= (unsigned long) (this-> getMaxConsumption () * 0.85)) {
+		    if (this-> _quota != -1) this-> _cgroup.setLimit (-1, period);
+		    this-> _quota = -1;
+		    return;
+		}
+
+		this-> _quota = nbMicros;
+		auto cap = (((float) (nbMicros + this-> _overhead)) / 1000000.0f) * (float) period;
+		this-> _cgroup.setLimit ((long) cap, period);
+	    }
+
+	    void LibvirtCPUController::unlimit () {
+		if (!this-> _enabled) return;
+
+		this-> _cgroup.setLimit (-1, 100000);
+		this-> _quota = -1;
+	    }
+
+	    bool LibvirtCPUController::setMemoryNodes (const std::vector <unsigned int> & nodes) {
+		this-> _memoryNodes = nodes;
+		if (!this-> _enabled) return false;
+
+		return this-> _cgroup.setMemoryNodes (nodes);
+	    }
+
+	    const std::vector <unsigned int> & LibvirtCPUController::getMemoryNodes () const {
+		return this-> _memoryNodes;
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================            MARKET            =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    unsigned long & LibvirtCPUController::allocated () {
+		return this-> _allocated;
+	    }
+
+	    unsigned long & LibvirtCPUController::buying () {
+		return this-> _buying;
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================             LOG              =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    nlohmann::json LibvirtCPUController::dumpLogs () const {
+		nlohmann::json j;
+		j["consumption"] = this-> _consumption;
+		j["capping"] = this-> getAbsoluteCapping ();
+		j["allocated"] = this-> _allocated;
+		j["slope"] = this-> getSlope ();
+
+		auto ipc = this-> getIPC ();
+		if (ipc > 0.0f) j["ipc"] = ipc;
+
+		return j;
+	    }
+
+	}
+
+    }
+
+}
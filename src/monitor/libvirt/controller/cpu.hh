@@ -0,0 +1,234 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <monitor/libvirt/controller/cpu_cgroup.hh>
+#include <monitor/libvirt/controller/history.hh>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	class LibvirtVM;
+
+	namespace control {
+
+	    /**
+	     * The cpu controller of a whole VM
+	     * The consumption is the sum of the consumptions of the vcpus, and the allocation is applied with one limit on the cgroup of the VM
+	     * @info: the quantities are in microseconds of cpu time per second
+	     */
+	    class LibvirtCPUController {
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================           CONTEXT            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// The vm associated to the controller
+		LibvirtVM & _context;
+
+		/// True iif the controller was enabled (the VM is booted)
+		bool _enabled;
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================            CGROUP            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// The cpu cgroup of the VM
+		cpu_cgroup _cgroup;
+
+		/// The cpu time added to the allocation in the limit of the cgroup (emulator, and io threads of qemu)
+		unsigned long _overhead = 50000; // 5% of a cpu
+
+		/// The cpu time the VM can use in one second (-1 if there is no limit)
+		long _quota = -1;
+
+		/// The numa nodes the memory of the VM is bound to (empty if all)
+		std::vector <unsigned int> _memoryNodes;
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================           HISTORY            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// The history in used percentage of the maximum consumption
+		history _history;
+
+		/// The consumption of the vcpus during the last macro tick
+		unsigned long _consumption = 0;
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================            MARKET            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// The number of cycles allocated to the VM
+		unsigned long _allocated = 0;
+
+		/// The number of cycles to buy
+		unsigned long _buying = 0;
+
+	    public:
+
+		/**
+		 * @params:
+		 *    - context: the vm of the controller
+		 *    - maxHistory: the maximum length of the history
+		 */
+		LibvirtCPUController (LibvirtVM & context, int maxHistory = 5);
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================          ACQUIRING           =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * Search the cpu cgroup of the VM
+		 * @info: this function should be called once after the VM is booted (a VM that is not on a host has no cgroup, its limits are only recorded)
+		 */
+		void enable ();
+
+		/**
+		 * Sum the consumptions of the vcpus of the last macro tick
+		 * @info: must be called after the updateBeforeMarket of the vcpu controllers
+		 */
+		void updateBeforeMarket ();
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================           GETTERS            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * @returns: the consumption of the vcpus scaled to the second
+		 */
+		unsigned long getConsumption () const;
+
+		/**
+		 * @returns: the maximum consumption of the VM (one second per vcpu)
+		 */
+		unsigned long getMaxConsumption () const;
+
+		/**
+		 * @returns: the maximum number of cycles the VM can consume in one second based on the current capping
+		 */
+		unsigned long getAbsoluteCapping () const;
+
+		/**
+		 * @returns: the percentage consumption of the VM in relation to the capping
+		 */
+		float getRelativePercentConsumption () const;
+
+		/**
+		 * @returns: the slope of the consumption in the latests ticks
+		 */
+		float getSlope () const;
+
+		/**
+		 * @returns: the instructions per cycle of the vcpus in the last macro tick (0 if the backend does not count)
+		 */
+		float getIPC () const;
+
+		/**
+		 * @returns: the number of cycles to guarantee to the VM at a given frequency
+		 * @params:
+		 *    - cpuFreq: the frequency of the cpus of the host
+		 */
+		unsigned long getNominal (int cpuFreq) const;
+
+		/**
+		 * @returns: the context of the controller
+		 */
+		LibvirtVM & vm ();
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================         CONTROLLING          =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * Update the limit of the cgroup of the VM
+		 * @params:
+		 *   - nbMicros: the number of microseconds of cpu usage allowed for the VM in one second
+		 *   - period: the period of the limit in microseconds
+		 */
+		void setQuota (unsigned long nbMicros, unsigned long period = 100000);
+
+		/**
+		 * Remove the limit of the cgroup of the VM
+		 */
+		void unlimit ();
+
+		/**
+		 * Bind the memory of the VM to a set of numa nodes
+		 * @params:
+		 *   - nodes: the nodes of the memory (all the nodes if empty)
+		 * @returns: false if the memory could not be bound (the nodes are still recorded)
+		 */
+		bool setMemoryNodes (const std::vector <unsigned int> & nodes);
+
+		/**
+		 * @returns: the numa nodes the memory of the VM is bound to (empty if all)
+		 */
+		const std::vector <unsigned int> & getMemoryNodes () const;
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================            MARKET            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * @returns: the number of cycles allocated to the VM
+		 */
+		unsigned long & allocated ();
+
+		/**
+		 * @returns: the number of cycles the VM wants to buy
+		 */
+		unsigned long & buying ();
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================             LOG              =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * @returns: the log about the cpu controller for the current tick
+		 */
+		nlohmann::json dumpLogs () const;
+
+	    };
+
+	}
+
+    }
+
+}
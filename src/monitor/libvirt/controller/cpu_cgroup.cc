@@ -0,0 +1,34 @@
+#include <monitor/libvirt/controller/cpu_cgroup.hh>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    cpu_cgroup::cpu_cgroup () {}
+
+	    bool cpu_cgroup::enable (const std::string & vmName, HostBackend & backend) {
+		this-> _vm = backend.findVM (vmName);
+		return this-> _vm != nullptr;
+	    }
+
+	    bool cpu_cgroup::isEnabled () const {
+		return this-> _vm != nullptr;
+	    }
+
+	    void cpu_cgroup::setLimit (long nbMicros, unsigned long period) {
+		if (this-> _vm == nullptr) return;
+		this-> _vm-> setLimit (nbMicros, period);
+	    }
+
+	    bool cpu_cgroup::setMemoryNodes (const std::vector <unsigned int> & nodes) {
+		if (this-> _vm == nullptr) return false;
+		return this-> _vm-> setMemoryNodes (nodes);
+	    }
+
+	}
+
+    }
+
+}
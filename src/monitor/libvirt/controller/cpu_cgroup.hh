@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <monitor/libvirt/controller/backend.hh>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    /**
+	     * The cpu cgroup of a whole VM (the scope of the qemu process, parent of the cgroups of the vcpus)
+	     * A limit set on this cgroup is shared by all the vcpus, the guest scheduler balances the cycles between them
+	     */
+	    class cpu_cgroup {
+
+		/// The threads of the VM in the host (nullptr if the cgroup was not found)
+		std::unique_ptr <HostBackend::VM> _vm;
+
+	    public:
+
+		cpu_cgroup ();
+
+		/**
+		 * Search the cgroup of the VM
+		 * @info: the VM must be running
+		 * @params:
+		 *    - vmName: the name of the vm
+		 *    - backend: the backend of the host
+		 * @returns: true iif the cgroup was found
+		 */
+		bool enable (const std::string & vmName, HostBackend & backend);
+
+		/**
+		 * @returns: true iif the cgroup was found
+		 */
+		bool isEnabled () const;
+
+		/**
+		 * Set the limit of the cgroup
+		 * @params:
+		 *    - nbMicros: the number of microseconds the VM can use during one period (-1 for no limit)
+		 *    - period: the period in microseconds
+		 */
+		void setLimit (long nbMicros, unsigned long period);
+
+		/**
+		 * Restrict the numa nodes of the memory of the VM
+		 * @returns: false if the backend cannot bind the memory
+		 */
+		bool setMemoryNodes (const std::vector <unsigned int> & nodes);
+
+	    };
+
+	}
+
+    }
+
+}
@@ -0,0 +1,432 @@
+#include <monitor/libvirt/controller/fake_backend.hh>
+#include <algorithm>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    FakeBackend::FakeBackend (int nbCpus, unsigned int frequency) :
+		_cpuFreq (nbCpus, frequency),
+		_speed (nbCpus, frequency),
+		_maxFreq (nbCpus, frequency),
+		_writes (std::make_shared <std::atomic <unsigned long> > (0))
+	    {
+		this-> _topology = HostBackend::readTopology ();
+		for (auto & p : this-> _topology.cpus) {
+		    p.minFreq = frequency / 2;
+		    p.maxFreq = frequency;
+		}
+	    }
+
+	    std::unique_ptr <HostBackend::VCPU> FakeBackend::findVCPU (const std::string & vmName, unsigned int vcpuId) {
+		this-> _m.lock ();
+		auto state = this-> find (vmName, vcpuId);
+		this-> _m.unlock ();
+
+		if (state == nullptr) return nullptr;
+		return std::make_unique <FakeVCPU> (state, this-> _writes);
+	    }
+
+	    std::unique_ptr <HostBackend::VM> FakeBackend::findVM (const std::string & vmName) {
+		this-> _m.lock ();
+		auto it = this-> _vms.find (vmName);
+		auto state = it == this-> _vms.end () ? nullptr : it-> second;
+		this-> _m.unlock ();
+
+		if (state == nullptr) return nullptr;
+		return std::make_unique <FakeVM> (state, this-> _writes);
+	    }
+
+	    int FakeBackend::nbCpus () {
+		return this-> _cpuFreq.size ();
+	    }
+
+	    const std::vector <unsigned int> & FakeBackend::readFrequencies () {
+		return this-> _cpuFreq;
+	    }
+
+	    HostBackend::topology FakeBackend::readTopology () {
+		this-> _m.lock ();
+		auto t = this-> _topology;
+		this-> _m.unlock ();
+
+		return t;
+	    }
+
+	    bool FakeBackend::setMaxFrequency (unsigned int cpu, unsigned int frequency) {
+		if (cpu >= this-> _cpuFreq.size ()) return false;
+
+		this-> _m.lock ();
+		this-> _maxFreq [cpu] = frequency;
+		this-> updateFrequency (cpu);
+		this-> _m.unlock ();
+
+		return true;
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================            DRIVER            =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    void FakeBackend::addVM (const std::string & vmName, int vcpus) {
+		auto vm = std::make_shared <vm_state> ();
+		auto now = std::chrono::steady_clock::now ();
+
+		this-> _m.lock ();
+		unsigned int next = 0;
+		for (auto & it : this-> _vms) next += it.second-> vcpus.size ();
+
+		for (int i = 0 ; i < vcpus ; i++) {
+		    auto vcpu = std::make_shared <vcpu_state> ();
+		    vcpu-> last = now;
+		    vcpu-> cpu = (next + i) % this-> _cpuFreq.size ();
+		    vcpu-> mhz = this-> _cpuFreq [vcpu-> cpu] / 1000.0;
+		    vcpu-> maxMhz = this-> _topology.cpus [vcpu-> cpu].maxFreq / 1000.0;
+		    vm-> vcpus.push_back (vcpu);
+		}
+
+		this-> _vms [vmName] = vm;
+		this-> _m.unlock ();
+	    }
+
+	    void FakeBackend::removeVM (const std::string & vmName) {
+		this-> _m.lock ();
+		auto it = this-> _vms.find (vmName);
+		if (it != this-> _vms.end ()) {
+		    for (auto & vcpu : it-> second-> vcpus) {
+			vcpu-> m.lock ();
+			vcpu-> advance ();
+			vcpu-> demand = 0;
+			vcpu-> m.unlock ();
+		    }
+
+		    this-> _vms.erase (it);
+		}
+		this-> _m.unlock ();
+	    }
+
+	    void FakeBackend::setDemand (const std::string & vmName, unsigned int vcpuId, double demand) {
+		this-> _m.lock ();
+		auto state = this-> find (vmName, vcpuId);
+		this-> _m.unlock ();
+
+		if (state != nullptr) {
+		    state-> m.lock ();
+		    state-> advance ();
+		    state-> demand = std::max (0.0, std::min (1.0, demand));
+		    state-> m.unlock ();
+		}
+	    }
+
+	    void FakeBackend::setTopology (unsigned int nbNodes, unsigned int llcsPerNode, unsigned long memory) {
+		nbNodes = std::max (1u, nbNodes);
+		llcsPerNode = std::max (1u, llcsPerNode);
+		auto nbCpus = this-> _cpuFreq.size ();
+		auto nbLlcs = nbNodes * llcsPerNode;
+
+		this-> _m.lock ();
+		this-> _topology.memory.assign (nbNodes, memory);
+		for (std::size_t i = 0 ; i < nbCpus ; i++) {
+		    unsigned int llc = i * nbLlcs / nbCpus;
+		    auto & p = this-> _topology.cpus [i];
+		    p.node = llc / llcsPerNode;
+		    p.package = p.node;
+		    p.core = i;
+
+		    // The first cpu of the cache
+		    p.llc = (llc * nbCpus + nbLlcs - 1) / nbLlcs;
+		}
+		this-> _m.unlock ();
+	    }
+
+	    void FakeBackend::setCpu (const std::string & vmName, unsigned int vcpuId, unsigned int cpu) {
+		this-> _m.lock ();
+		auto state = this-> find (vmName, vcpuId);
+		this-> _m.unlock ();
+
+		if (state != nullptr) {
+		    state-> m.lock ();
+		    state-> advance ();
+		    cpu = cpu % this-> _cpuFreq.size ();
+		    auto & allowed = state-> affinity;
+		    if (!allowed.empty () && std::find (allowed.begin (), allowed.end (), cpu) == allowed.end ()) {
+			cpu = allowed [cpu % allowed.size ()];
+		    }
+
+		    state-> cpu = cpu;
+		    state-> mhz = this-> _cpuFreq [state-> cpu] / 1000.0;
+		    state-> m.unlock ();
+		}
+	    }
+
+	    void FakeBackend::setFrequency (unsigned int cpu, unsigned int frequency) {
+		if (cpu >= this-> _cpuFreq.size ()) return;
+
+		this-> _m.lock ();
+		this-> _speed [cpu] = frequency;
+		this-> updateFrequency (cpu);
+		this-> _m.unlock ();
+	    }
+
+	    unsigned int FakeBackend::getMaxFrequency (unsigned int cpu) {
+		if (cpu >= this-> _cpuFreq.size ()) return 0;
+
+		this-> _m.lock ();
+		auto frequency = this-> _maxFreq [cpu];
+		this-> _m.unlock ();
+
+		return frequency;
+	    }
+
+	    void FakeBackend::setIPC (const std::string & vmName, unsigned int vcpuId, double ipc) {
+		this-> _m.lock ();
+		auto state = this-> find (vmName, vcpuId);
+		this-> _m.unlock ();
+
+		if (state != nullptr) {
+		    state-> m.lock ();
+		    state-> advance ();
+		    state-> ipc = std::max (0.0, ipc);
+		    state-> m.unlock ();
+		}
+	    }
+
+	    long FakeBackend::getLimit (const std::string & vmName, unsigned int vcpuId) {
+		this-> _m.lock ();
+		auto state = this-> find (vmName, vcpuId);
+		this-> _m.unlock ();
+
+		if (state == nullptr) return -1;
+
+		state-> m.lock ();
+		auto limit = state-> limit;
+		state-> m.unlock ();
+
+		return limit;
+	    }
+
+	    long FakeBackend::getVMLimit (const std::string & vmName) {
+		this-> _m.lock ();
+		auto it = this-> _vms.find (vmName);
+		auto limit = it == this-> _vms.end () ? -1 : it-> second-> limit.load ();
+		this-> _m.unlock ();
+
+		return limit;
+	    }
+
+	    std::vector <unsigned int> FakeBackend::getAffinity (const std::string & vmName, unsigned int vcpuId) {
+		this-> _m.lock ();
+		auto state = this-> find (vmName, vcpuId);
+		this-> _m.unlock ();
+
+		if (state == nullptr) return {};
+
+		state-> m.lock ();
+		auto affinity = state-> affinity;
+		state-> m.unlock ();
+
+		return affinity;
+	    }
+
+	    std::vector <unsigned int> FakeBackend::getMemoryNodes (const std::string & vmName) {
+		this-> _m.lock ();
+		auto it = this-> _vms.find (vmName);
+		auto state = it == this-> _vms.end () ? nullptr : it-> second;
+		this-> _m.unlock ();
+
+		if (state == nullptr) return {};
+
+		state-> m.lock ();
+		auto nodes = state-> memoryNodes;
+		state-> m.unlock ();
+
+		return nodes;
+	    }
+
+	    void FakeBackend::readCycles (double & wanted, double & executed, double & energy) {
+		wanted = 0;
+		executed = 0;
+		energy = 0;
+
+		this-> _m.lock ();
+		for (auto & vm : this-> _vms) {
+		    for (auto & vcpu : vm.second-> vcpus) {
+			vcpu-> m.lock ();
+			vcpu-> advance ();
+			wanted += vcpu-> wanted;
+			executed += vcpu-> cycles;
+			energy += vcpu-> energy;
+			vcpu-> m.unlock ();
+		    }
+		}
+		this-> _m.unlock ();
+	    }
+
+	    double FakeBackend::readEnergy (const std::string & vmName) {
+		double energy = 0;
+
+		this-> _m.lock ();
+		auto it = this-> _vms.find (vmName);
+		if (it != this-> _vms.end ()) {
+		    for (auto & vcpu : it-> second-> vcpus) {
+			vcpu-> m.lock ();
+			vcpu-> advance ();
+			energy += vcpu-> energy;
+			vcpu-> m.unlock ();
+		    }
+		}
+		this-> _m.unlock ();
+
+		return energy;
+	    }
+
+	    unsigned long FakeBackend::nbWrites () const {
+		return this-> _writes-> load ();
+	    }
+
+	    std::shared_ptr <FakeBackend::vcpu_state> FakeBackend::find (const std::string & vmName, unsigned int vcpuId) const {
+		auto it = this-> _vms.find (vmName);
+		if (it == this-> _vms.end () || vcpuId >= it-> second-> vcpus.size ()) return nullptr;
+
+		return it-> second-> vcpus [vcpuId];
+	    }
+
+	    void FakeBackend::updateFrequency (unsigned int cpu) {
+		auto frequency = std::min (this-> _speed [cpu], this-> _maxFreq [cpu]);
+		if (frequency == this-> _cpuFreq [cpu]) return;
+
+		this-> _cpuFreq [cpu] = frequency;
+		for (auto & vm : this-> _vms) {
+		    for (auto & vcpu : vm.second-> vcpus) {
+			vcpu-> m.lock ();
+			if (vcpu-> cpu == cpu) {
+			    vcpu-> advance ();
+			    vcpu-> mhz = frequency / 1000.0;
+			}
+			vcpu-> m.unlock ();
+		    }
+		}
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================            STATES            =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    void FakeBackend::vcpu_state::advance () {
+		auto now = std::chrono::steady_clock::now ();
+		auto delta = std::chrono::duration <double, std::micro> (now - this-> last).count ();
+		this-> last = now;
+
+		// The demand is at the maximal frequency, a slower cpu needs more time
+		auto time = this-> demand;
+		if (this-> mhz > 0 && this-> maxMhz > 0) time = std::min (1.0, this-> demand * this-> maxMhz / this-> mhz);
+
+		auto consumed = delta * std::min (time, std::min (this-> cap, this-> vmCap));
+		this-> usage += consumed;
+
+		// microseconds * MHz are cycles
+		this-> cycles += consumed * this-> mhz;
+		this-> instructions += consumed * this-> mhz * this-> ipc;
+		this-> wanted += delta * this-> demand * (this-> maxMhz > 0 ? this-> maxMhz : this-> mhz);
+		if (this-> maxMhz > 0) {
+		    auto relative = this-> mhz / this-> maxMhz;
+		    this-> energy += consumed * this-> mhz * relative * relative;
+		}
+	    }
+
+	    FakeBackend::FakeVCPU::FakeVCPU (std::shared_ptr <vcpu_state> state, std::shared_ptr <std::atomic <unsigned long> > writes) :
+		_state (state),
+		_writes (writes)
+	    {}
+
+	    unsigned long FakeBackend::FakeVCPU::readUsage () {
+		this-> _state-> m.lock ();
+		this-> _state-> advance ();
+		auto usage = (unsigned long) this-> _state-> usage;
+		this-> _state-> m.unlock ();
+
+		return usage;
+	    }
+
+	    unsigned int FakeBackend::FakeVCPU::readCpu () {
+		this-> _state-> m.lock ();
+		auto cpu = this-> _state-> cpu;
+		this-> _state-> m.unlock ();
+
+		return cpu;
+	    }
+
+	    bool FakeBackend::FakeVCPU::readCounters (HostBackend::counters & c) {
+		this-> _state-> m.lock ();
+		this-> _state-> advance ();
+		c.cycles = (unsigned long) this-> _state-> cycles;
+		c.instructions = (unsigned long) this-> _state-> instructions;
+		c.llcMisses = 0;
+		this-> _state-> m.unlock ();
+
+		return true;
+	    }
+
+	    void FakeBackend::FakeVCPU::setLimit (long nbMicros, unsigned long period) {
+		this-> _state-> m.lock ();
+		this-> _state-> advance ();
+		this-> _state-> limit = nbMicros;
+		this-> _state-> cap = nbMicros < 0 ? 1.0 : ((double) nbMicros) / ((double) period);
+		this-> _state-> m.unlock ();
+
+		this-> _writes-> fetch_add (1);
+	    }
+
+	    bool FakeBackend::FakeVCPU::setAffinity (const std::vector <unsigned int> & cpus) {
+		// The vcpu is moved by the driver of the host (cf. setCpu)
+		this-> _state-> m.lock ();
+		this-> _state-> affinity = cpus;
+		std::sort (this-> _state-> affinity.begin (), this-> _state-> affinity.end ());
+		this-> _state-> m.unlock ();
+
+		return true;
+	    }
+
+	    FakeBackend::FakeVM::FakeVM (std::shared_ptr <vm_state> state, std::shared_ptr <std::atomic <unsigned long> > writes) :
+		_state (state),
+		_writes (writes)
+	    {}
+
+	    void FakeBackend::FakeVM::setLimit (long nbMicros, unsigned long period) {
+		// The quota of the VM is spread evenly over its vcpus
+		double cap = nbMicros < 0 ? 1.0 : ((double) nbMicros) / ((double) period) / this-> _state-> vcpus.size ();
+		for (auto & vcpu : this-> _state-> vcpus) {
+		    vcpu-> m.lock ();
+		    vcpu-> advance ();
+		    vcpu-> vmCap = cap;
+		    vcpu-> m.unlock ();
+		}
+
+		this-> _state-> limit = nbMicros;
+		this-> _writes-> fetch_add (1);
+	    }
+
+	    bool FakeBackend::FakeVM::setMemoryNodes (const std::vector <unsigned int> & nodes) {
+		this-> _state-> m.lock ();
+		this-> _state-> memoryNodes = nodes;
+		std::sort (this-> _state-> memoryNodes.begin (), this-> _state-> memoryNodes.end ());
+		this-> _state-> m.unlock ();
+
+		return true;
+	    }
+
+	}
+
+    }
+
+}
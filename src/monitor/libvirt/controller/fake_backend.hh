@@ -0,0 +1,301 @@
+#pragma once
+
+#include <map>
+#include <chrono>
+#include <atomic>
+#include <monitor/concurrency/mutex.hh>
+#include <monitor/libvirt/controller/backend.hh>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    /**
+	     * A host that only exists in memory, used to run the control loop without VMs (load tests, benchmarks)
+	     * The vcpus consume their demand, bounded by their quota and the quota of their VM, in real time, so the controllers see the consumption they would see on a real host
+	     * The demand of a vcpu is a share of a cpu at the maximal frequency, on a slower cpu the vcpu needs more time to execute the same cycles
+	     * The energy of a cycle is modeled as proportional to the square of the frequency (the voltage following the frequency), one cycle at the maximal frequency costing 1
+	     * @info: the contention between the vcpus on the cpus of the host is not modeled (cf. the dio-sim for that)
+	     */
+	    class FakeBackend : public HostBackend {
+
+		/**
+		 * The state of a vcpu of the fake host
+		 */
+		struct vcpu_state {
+		    /// The mutex protecting the state (the controllers and the driver of the host run in different threads)
+		    concurrency::mutex m;
+
+		    /// The share of a cpu at the maximal frequency the vcpu wants to use (0 to 1)
+		    double demand = 0;
+
+		    /// The maximal frequency of the cpus in MHz
+		    double maxMhz = 0;
+
+		    /// The share of a cpu the vcpu can use (its quota)
+		    double cap = 1;
+
+		    /// The share of a cpu the vcpu can use by the quota of the VM
+		    double vmCap = 1;
+
+		    /// The limit written by the controller (-1 if unlimited)
+		    long limit = -1;
+
+		    /// The cpu time consumed since the vcpu started in microseconds
+		    double usage = 0;
+
+		    /// The instant of the last update of the usage
+		    std::chrono::steady_clock::time_point last;
+
+		    /// The cpu running the vcpu
+		    unsigned int cpu = 0;
+
+		    /// The frequency of the cpu running the vcpu in MHz
+		    double mhz = 0;
+
+		    /// The instructions per cycle of the load of the vcpu
+		    double ipc = 1;
+
+		    /// The cpus allowed to run the vcpu (all if empty)
+		    std::vector <unsigned int> affinity;
+
+		    /// The cycles and the instructions executed since the vcpu started
+		    double cycles = 0;
+		    double instructions = 0;
+
+		    /// The cycles the vcpu wanted to execute since it started
+		    double wanted = 0;
+
+		    /// The energy of the cycles executed since the vcpu started (cf. the model of FakeBackend)
+		    double energy = 0;
+
+		    /**
+		     * Add the consumption since the last update to the usage and the counters
+		     * @warning: m must be locked
+		     */
+		    void advance ();
+		};
+
+		/**
+		 * The state of a VM of the fake host
+		 */
+		struct vm_state {
+		    /// The vcpus of the VM
+		    std::vector <std::shared_ptr <vcpu_state> > vcpus;
+
+		    /// The limit of the VM written by the controller (-1 if unlimited)
+		    std::atomic <long> limit {-1};
+
+		    /// The mutex protecting the memory nodes
+		    concurrency::mutex m;
+
+		    /// The numa nodes the memory of the VM is bound to (all if empty)
+		    std::vector <unsigned int> memoryNodes;
+		};
+
+		class FakeVCPU : public HostBackend::VCPU {
+
+		    std::shared_ptr <vcpu_state> _state;
+
+		    std::shared_ptr <std::atomic <unsigned long> > _writes;
+
+		public:
+
+		    FakeVCPU (std::shared_ptr <vcpu_state> state, std::shared_ptr <std::atomic <unsigned long> > writes);
+
+		    unsigned long readUsage () override;
+
+		    unsigned int readCpu () override;
+
+		    bool readCounters (HostBackend::counters & c) override;
+
+		    void setLimit (long nbMicros, unsigned long period) override;
+
+		    bool setAffinity (const std::vector <unsigned int> & cpus) override;
+
+		};
+
+		class FakeVM : public HostBackend::VM {
+
+		    std::shared_ptr <vm_state> _state;
+
+		    std::shared_ptr <std::atomic <unsigned long> > _writes;
+
+		public:
+
+		    FakeVM (std::shared_ptr <vm_state> state, std::shared_ptr <std::atomic <unsigned long> > writes);
+
+		    void setLimit (long nbMicros, unsigned long period) override;
+
+		    bool setMemoryNodes (const std::vector <unsigned int> & nodes) override;
+
+		};
+
+	    private:
+
+		/// The mutex protecting the VMs of the host
+		concurrency::mutex _m;
+
+		/// The VMs running on the host
+		std::map <std::string, std::shared_ptr <vm_state> > _vms;
+
+		/// The frequency of the cpus in KHz
+		std::vector <unsigned int> _cpuFreq;
+
+		/// The frequency the cpus would run at without limit in KHz (cf. setFrequency)
+		std::vector <unsigned int> _speed;
+
+		/// The maximal frequency of the cpus in KHz (cf. setMaxFrequency)
+		std::vector <unsigned int> _maxFreq;
+
+		/// The numa nodes and caches of the host
+		topology _topology;
+
+		/// The number of limits written by the controllers
+		std::shared_ptr <std::atomic <unsigned long> > _writes;
+
+	    public:
+
+		/**
+		 * @params:
+		 *    - nbCpus: the number of cpus of the host
+		 *    - frequency: the frequency of the cpus in KHz (their maximal frequency, the minimal one is half of it)
+		 */
+		FakeBackend (int nbCpus, unsigned int frequency = 2000000);
+
+		std::unique_ptr <HostBackend::VCPU> findVCPU (const std::string & vmName, unsigned int vcpuId) override;
+
+		std::unique_ptr <HostBackend::VM> findVM (const std::string & vmName) override;
+
+		int nbCpus () override;
+
+		const std::vector <unsigned int> & readFrequencies () override;
+
+		topology readTopology () override;
+
+		bool setMaxFrequency (unsigned int cpu, unsigned int frequency) override;
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================            DRIVER            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * Start a VM on the host, its vcpus are placed on the cpus round robin
+		 * @params:
+		 *    - vmName: the name of the VM
+		 *    - vcpus: the number of vcpus of the VM
+		 */
+		void addVM (const std::string & vmName, int vcpus);
+
+		/**
+		 * Stop a VM
+		 * @info: the vcpus found by the controllers stay readable, but do not consume anymore
+		 */
+		void removeVM (const std::string & vmName);
+
+		/**
+		 * Change the demand of a vcpu
+		 * @params:
+		 *    - demand: the share of a cpu at the maximal frequency the vcpu wants to use (0 to 1)
+		 */
+		void setDemand (const std::string & vmName, unsigned int vcpuId, double demand);
+
+		/**
+		 * Split the cpus of the host in numa nodes and caches, the cpus of a cache are contiguous
+		 * @params:
+		 *    - nbNodes: the number of numa nodes
+		 *    - llcsPerNode: the number of last level caches in each node
+		 *    - memory: the memory of each node in MB
+		 */
+		void setTopology (unsigned int nbNodes, unsigned int llcsPerNode, unsigned long memory = 0);
+
+		/**
+		 * Move a vcpu to another cpu
+		 * @info: a vcpu whose affinity does not contain the cpu is moved to one of its allowed cpus instead
+		 */
+		void setCpu (const std::string & vmName, unsigned int vcpuId, unsigned int cpu);
+
+		/**
+		 * Change the frequency of a cpu
+		 * @params:
+		 *    - frequency: the frequency in KHz
+		 * @info: the cpu runs at the maximal frequency written by the controllers if it is lower
+		 */
+		void setFrequency (unsigned int cpu, unsigned int frequency);
+
+		/**
+		 * @returns: the maximal frequency of a cpu written by the controllers in KHz
+		 */
+		unsigned int getMaxFrequency (unsigned int cpu);
+
+		/**
+		 * Change the instructions per cycle of the load of a vcpu (its counters are cycles = usage * frequency, instructions = cycles * ipc)
+		 */
+		void setIPC (const std::string & vmName, unsigned int vcpuId, double ipc);
+
+		/**
+		 * @returns: the limit of a vcpu written by its controller (microseconds per period, -1 if unlimited)
+		 */
+		long getLimit (const std::string & vmName, unsigned int vcpuId);
+
+		/**
+		 * @returns: the limit of a VM written by its controller (microseconds per period, -1 if unlimited)
+		 */
+		long getVMLimit (const std::string & vmName);
+
+		/**
+		 * @returns: the cpus allowed to run a vcpu (empty if all)
+		 */
+		std::vector <unsigned int> getAffinity (const std::string & vmName, unsigned int vcpuId);
+
+		/**
+		 * @returns: the numa nodes the memory of a VM is bound to (empty if all)
+		 */
+		std::vector <unsigned int> getMemoryNodes (const std::string & vmName);
+
+		/**
+		 * @returns: the number of limits written by the controllers since the host was created
+		 */
+		unsigned long nbWrites () const;
+
+		/**
+		 * Read the cycles of all the vcpus of the host since they started
+		 * @params:
+		 *    - wanted: set to the cycles the vcpus wanted to execute
+		 *    - executed: set to the cycles the vcpus executed
+		 *    - energy: set to the energy of the executed cycles (cf. the model of FakeBackend)
+		 */
+		void readCycles (double & wanted, double & executed, double & energy);
+
+		/**
+		 * @returns: the energy of the cycles executed by the vcpus of a VM since they started (0 if the VM is unknown)
+		 */
+		double readEnergy (const std::string & vmName);
+
+	    private:
+
+		/**
+		 * @returns: the state of a vcpu, nullptr if it does not exist
+		 * @warning: _m must be locked
+		 */
+		std::shared_ptr <vcpu_state> find (const std::string & vmName, unsigned int vcpuId) const;
+
+		/**
+		 * Set the frequency of a cpu to its speed bounded by its maximal frequency, and of the vcpus running on it
+		 * @warning: _m must be locked
+		 */
+		void updateFrequency (unsigned int cpu);
+
+	    };
+
+	}
+
+    }
+
+}
@@ -0,0 +1,63 @@
+#include <monitor/libvirt/controller/history.hh>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    history::history (int maxLength) :
+		_maxLength (maxLength)
+	    {}
+
+	    void history::push (float value) {
+		this-> _values.push_back (value);
+		if (this-> _values.size () > (std::size_t) this-> _maxLength) {
+		    this-> _values.erase (this-> _values.begin ());
+		}
+
+		if (this-> _values.size () == (std::size_t) this-> _maxLength) this-> computeSlope ();
+	    }
+
+	    void history::restore (const std::vector <float> & values) {
+		auto beg = values.size () > (std::size_t) this-> _maxLength ? values.end () - this-> _maxLength : values.begin ();
+		this-> _values = std::vector <float> (beg, values.end ());
+		this-> _slope = 0;
+
+		if (this-> _values.size () == (std::size_t) this-> _maxLength) this-> computeSlope ();
+	    }
+
+	    const std::vector <float> & history::values () const {
+		return this-> _values;
+	    }
+
+	    double history::slope () const {
+		return this-> _slope;
+	    }
+
+	    void history::computeSlope () {
+		double sum_x = 0;
+		double sum_y = 0;
+
+		for (std::size_t x = 0; x < this-> _values.size () ; x++) {
+		    sum_y += this-> _values [x];
+		    sum_x += x;
+		}
+
+		auto m_x = sum_x / (double) (this-> _values.size ());
+		auto m_y = sum_y / (double) (this-> _values.size ());
+
+		double ss_x = 0.0, sp = 0.0;
+		for (std::size_t x = 0 ; x < this-> _values.size (); x++) {
+		    ss_x += (x - m_x) * (x - m_x);
+		    sp += (x - m_x) * (this-> _values [x] - m_y);
+		}
+
+		this-> _slope = ss_x == 0.0 ? 0.0 : sp / ss_x;
+	    }
+
+	}
+
+    }
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    /**
+	     * A sliding history of percentages of consumption, and the slope of its linear regression
+	     * Used by the controllers to detect if a consumption is stable, increasing or decreasing
+	     */
+	    class history {
+
+		/// The values of the history (oldest first)
+		std::vector <float> _values;
+
+		/// The maximum length of the history
+		int _maxLength;
+
+		/// The slope of the history (0 until the history is full)
+		double _slope = 0;
+
+	    public:
+
+		/**
+		 * @params:
+		 *   - maxLength: the maximum length of the history
+		 */
+		history (int maxLength = 5);
+
+		/**
+		 * Add a value at the end of the history (removing the oldest value if the history is full)
+		 */
+		void push (float value);
+
+		/**
+		 * Replace the values of the history
+		 * @info: only the last maxLength values are kept
+		 */
+		void restore (const std::vector <float> & values);
+
+		/**
+		 * @returns: the values of the history (oldest first)
+		 */
+		const std::vector <float> & values () const;
+
+		/**
+		 * @returns: the slope of the history
+		 */
+		double slope () const;
+
+	    private:
+
+		/**
+		 * Compute the slope of the history
+		 */
+		void computeSlope ();
+
+	    };
+
+	}
+
+    }
+
+}
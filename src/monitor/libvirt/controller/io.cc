@@ -0,0 +1,196 @@
+#include <monitor/libvirt/controller/io.hh>
+#include <monitor/libvirt/vm.hh>
+#include <monitor/utils/xml.hh>
+#include <monitor/utils/log.hh>
+#include <libvirt/libvirt.h>
+#include <stdlib.h>
+#include <algorithm>
+
+using namespace monitor::utils;
+using namespace tinyxml2;
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    LibvirtIOController::LibvirtIOController (LibvirtVM & context) :
+		_context (context),
+		_enabled (false)
+	    {}
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================          ACQUIRING           =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    void LibvirtIOController::enable () {
+		if (this-> _context._dom == nullptr) return;
+
+		std::string disk;
+		char * xml = virDomainGetXMLDesc (this-> _context._dom, 0);
+		if (xml != nullptr) {
+		    XMLDocument doc;
+		    doc.Parse (xml);
+		    free (xml);
+
+		    // The first disk is the image of the VM, the swap disk is on the same device
+		    auto source = utils::findInXML (doc.RootElement (), {"devices", "disk", "source"});
+		    if (source != nullptr && source-> Attribute ("file") != nullptr) disk = source-> Attribute ("file");
+
+		    auto target = utils::findInXML (doc.RootElement (), {"devices", "interface", "target"});
+		    if (target != nullptr && target-> Attribute ("dev") != nullptr) this-> _interface = target-> Attribute ("dev");
+		}
+
+		if (disk == "" || !this-> _cgroup.enable (this-> _context.id (), disk)) {
+		    logging::warn ("IO cgroup of VM", this-> _context.id (), "not found");
+		}
+
+		if (this-> _interface == "") {
+		    logging::warn ("Network interface of VM", this-> _context.id (), "not found");
+		}
+
+		this-> _disk.nominal = this-> _context.diskBandwidth ();
+		this-> _iops.nominal = this-> _context.diskIops ();
+		this-> _net.nominal = this-> _context.netBandwidth ();
+		this-> _t.reset ();
+		this-> _enabled = true;
+	    }
+
+	    void LibvirtIOController::update () {
+		if (!this-> _enabled) return;
+
+		float delta = this-> _t.time_since_start ();
+		this-> _t.reset ();
+		if (delta <= 0.0f) return;
+
+		// The first read only gives the reference of the counters
+		auto stat = this-> _cgroup.readStat ();
+		if (this-> _lastDiskBytes >= 0 && (long long) stat.bytes >= this-> _lastDiskBytes && (long long) stat.ios >= this-> _lastDiskIos) {
+		    this-> _disk.usage = (unsigned long) ((stat.bytes - this-> _lastDiskBytes) / 1024 / delta);
+		    this-> _iops.usage = (unsigned long) ((stat.ios - this-> _lastDiskIos) / delta);
+		}
+		this-> _lastDiskBytes = stat.bytes;
+		this-> _lastDiskIos = stat.ios;
+
+		virDomainInterfaceStatsStruct net;
+		if (this-> _interface != "" && virDomainInterfaceStats (this-> _context._dom, this-> _interface.c_str (), &net, sizeof (net)) == 0) {
+		    auto bytes = std::max (net.rx_bytes, (long long) 0) + std::max (net.tx_bytes, (long long) 0);
+		    if (this-> _lastNetBytes >= 0 && bytes >= this-> _lastNetBytes) {
+			this-> _net.usage = (unsigned long) ((bytes - this-> _lastNetBytes) / 1024 / delta);
+		    }
+		    this-> _lastNetBytes = bytes;
+		}
+
+		this-> _disk.buying = 0;
+		this-> _iops.buying = 0;
+		this-> _net.buying = 0;
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================           GETTERS            =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    io_resource & LibvirtIOController::disk () {
+		return this-> _disk;
+	    }
+
+	    io_resource & LibvirtIOController::iops () {
+		return this-> _iops;
+	    }
+
+	    io_resource & LibvirtIOController::net () {
+		return this-> _net;
+	    }
+
+	    LibvirtVM & LibvirtIOController::vm () {
+		return this-> _context;
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================         CONTROLLING          =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    void LibvirtIOController::applyAllocation () {
+		if (!this-> _enabled) return;
+
+		auto disk = limitOf (this-> _disk), iops = limitOf (this-> _iops);
+		if (disk != this-> _disk.limit || iops != this-> _iops.limit) {
+		    this-> _cgroup.setMax (disk, iops);
+		    this-> _disk.limit = disk;
+		    this-> _iops.limit = iops;
+		}
+
+		auto net = limitOf (this-> _net);
+		if (net != this-> _net.limit) {
+		    this-> setInterfaceBandwidth (net);
+		    this-> _net.limit = net;
+		}
+	    }
+
+	    void LibvirtIOController::unlimit () {
+		if (!this-> _enabled) return;
+
+		this-> _cgroup.setMax (-1, -1);
+		this-> setInterfaceBandwidth (-1);
+		this-> _disk.limit = -1;
+		this-> _iops.limit = -1;
+		this-> _net.limit = -1;
+	    }
+
+	    long LibvirtIOController::limitOf (const io_resource & res) {
+		// As for the cpu, an allocation close to the capacity is not worth throttling
+		if (res.max == 0 || res.allocated >= (unsigned long) (res.max * 0.85)) return -1;
+		return std::max (res.allocated, (unsigned long) 1);
+	    }
+
+	    void LibvirtIOController::setInterfaceBandwidth (long kbs) {
+		if (this-> _interface == "") return;
+
+		// An average of 0 removes the limit
+		unsigned int avg = kbs < 0 ? 0 : (unsigned int) kbs;
+		virTypedParameterPtr params = nullptr;
+		int nparams = 0, maxparams = 0;
+		virTypedParamsAddUInt (&params, &nparams, &maxparams, VIR_DOMAIN_BANDWIDTH_IN_AVERAGE, avg);
+		virTypedParamsAddUInt (&params, &nparams, &maxparams, VIR_DOMAIN_BANDWIDTH_OUT_AVERAGE, avg);
+		if (virDomainSetInterfaceParameters (this-> _context._dom, this-> _interface.c_str (), params, nparams, VIR_DOMAIN_AFFECT_LIVE) != 0) {
+		    logging::warn ("Cannot set the bandwidth of the interface of VM", this-> _context.id ());
+		}
+
+		virTypedParamsFree (params, nparams);
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================             LOG              =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    nlohmann::json LibvirtIOController::dumpLogs () const {
+		nlohmann::json j;
+		j["disk"] = {{"usage", this-> _disk.usage}, {"allocated", this-> _disk.allocated}, {"limit", this-> _disk.limit}};
+		j["iops"] = {{"usage", this-> _iops.usage}, {"allocated", this-> _iops.allocated}, {"limit", this-> _iops.limit}};
+		j["net"] = {{"usage", this-> _net.usage}, {"allocated", this-> _net.allocated}, {"limit", this-> _net.limit}};
+
+		return j;
+	    }
+
+	}
+
+    }
+
+}
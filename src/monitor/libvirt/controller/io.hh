@@ -0,0 +1,206 @@
+#pragma once
+
+#include <string>
+#include <nlohmann/json.hpp>
+#include <monitor/concurrency/timer.hh>
+#include <monitor/libvirt/controller/io_cgroup.hh>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	class LibvirtVM;
+
+	namespace control {
+
+	    /**
+	     * An io resource of a VM sold by the io market (disk bandwidth, disk operations, or network bandwidth)
+	     */
+	    struct io_resource {
+
+		/// The usage of the resource in the last update (per second)
+		unsigned long usage = 0;
+
+		/// The quantity of the resource guaranteed to the VM
+		unsigned long nominal = 0;
+
+		/// The maximal quantity of the resource the VM can use (the capacity of the host)
+		unsigned long max = 0;
+
+		/// The quantity of the resource allocated to the VM by the market
+		unsigned long allocated = 0;
+
+		/// The quantity of the resource the VM wants to buy
+		unsigned long buying = 0;
+
+		/// The limit currently applied (-1 if there is no limit)
+		long limit = -1;
+
+	    };
+
+	    /**
+	     * The io controller of a VM
+	     * The disk accesses are sampled in the io cgroup of the VM (io.stat), and limited with io.max
+	     * The network accesses are sampled on the virtio interface of the VM (virDomainInterfaceStats), and limited with virDomainSetInterfaceParameters
+	     * @info: the bandwidths are in KB/s
+	     */
+	    class LibvirtIOController {
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================           CONTEXT            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// The vm associated to the controller
+		LibvirtVM & _context;
+
+		/// True iif the controller was enabled (the VM is booted)
+		bool _enabled;
+
+		/// The io cgroup of the VM
+		io_cgroup _cgroup;
+
+		/// The name of the network interface of the VM on the host (empty if not found)
+		std::string _interface;
+
+		/// The timer used to compute the rates between two updates
+		concurrency::timer _t;
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================           SAMPLING           =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// The bytes accessed on the disk device at the last update (-1 before the first update)
+		long long _lastDiskBytes = -1;
+
+		/// The operations on the disk device at the last update
+		long long _lastDiskIos = -1;
+
+		/// The bytes received, and transmitted by the interface at the last update
+		long long _lastNetBytes = -1;
+
+		/// The disk bandwidth
+		io_resource _disk;
+
+		/// The disk operations per second
+		io_resource _iops;
+
+		/// The network bandwidth
+		io_resource _net;
+
+	    public:
+
+		/**
+		 * @params:
+		 *    - context: the vm of the controller
+		 */
+		LibvirtIOController (LibvirtVM & context);
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================          ACQUIRING           =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * Search the disk, and the network interface of the VM in its domain description, and its io cgroup
+		 * @info: this function should be called once after the VM is booted
+		 */
+		void enable ();
+
+		/**
+		 * Sample the io rates of the VM since the last update
+		 * @info: this function should be called periodically (before each market tick)
+		 */
+		void update ();
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================           GETTERS            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * @returns: the disk bandwidth of the VM
+		 */
+		io_resource & disk ();
+
+		/**
+		 * @returns: the disk operations per second of the VM
+		 */
+		io_resource & iops ();
+
+		/**
+		 * @returns: the network bandwidth of the VM
+		 */
+		io_resource & net ();
+
+		/**
+		 * @returns: the context of the controller
+		 */
+		LibvirtVM & vm ();
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================         CONTROLLING          =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * Apply the allocations computed by the market (io.max, and interface bandwidth)
+		 * @info: an allocation close to the capacity of the host is applied as no limit
+		 */
+		void applyAllocation ();
+
+		/**
+		 * Remove all the io limits of the VM
+		 */
+		void unlimit ();
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================             LOG              =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * @returns: the log about the io controller for the current tick
+		 */
+		nlohmann::json dumpLogs () const;
+
+	    private:
+
+		/**
+		 * @returns: the limit to apply for an allocation (-1 if the allocation is close to the capacity)
+		 */
+		static long limitOf (const io_resource & res);
+
+		/**
+		 * Set the bandwidth of the network interface
+		 * @params:
+		 *    - kbs: the bandwidth in KB/s for each direction (-1 for no limit)
+		 */
+		void setInterfaceBandwidth (long kbs);
+
+	    };
+
+	}
+
+    }
+
+}
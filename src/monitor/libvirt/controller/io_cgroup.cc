@@ -0,0 +1,98 @@
+#include <monitor/libvirt/controller/io_cgroup.hh>
+#include <monitor/libvirt/controller/cgroup.hh>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    io_cgroup::io_cgroup () :
+		_enabled (false)
+	    {}
+
+	    bool io_cgroup::enable (const std::string & vmName, const fs::path & disk) {
+		this-> _enabled = false;
+		std::ifstream f ("/sys/fs/cgroup/cgroup.controllers");
+		if (!f.good ()) return false;
+		f.close ();
+
+		struct stat st;
+		if (::stat (disk.c_str (), &st) != 0) return false;
+		this-> _device = wholeDevice (major (st.st_dev), minor (st.st_dev));
+
+		this-> _path = cgroup::recursiveSearch ("/sys/fs/cgroup/machine.slice", "v" + vmName);
+		this-> _enabled = this-> _path.u8string ().length () != 0;
+
+		return this-> _enabled;
+	    }
+
+	    bool io_cgroup::isEnabled () const {
+		return this-> _enabled;
+	    }
+
+	    io_stat io_cgroup::readStat () const {
+		io_stat stat;
+		if (!this-> _enabled) return stat;
+
+		// 8:0 rbytes=1459200 wbytes=314773504 rios=192 wios=353 dbytes=0 dios=0
+		std::ifstream f (this-> _path / "io.stat");
+		std::string line;
+		while (std::getline (f, line)) {
+		    std::stringstream ss (line);
+		    std::string dev, field;
+		    ss >> dev;
+		    if (dev != this-> _device) continue;
+
+		    while (ss >> field) {
+			auto eq = field.find ('=');
+			if (eq == std::string::npos) continue;
+
+			auto key = field.substr (0, eq);
+			auto value = std::strtoul (field.c_str () + eq + 1, nullptr, 10);
+			if (key == "rbytes" || key == "wbytes") stat.bytes += value;
+			else if (key == "rios" || key == "wios") stat.ios += value;
+		    }
+		}
+
+		return stat;
+	    }
+
+	    void io_cgroup::setMax (long kbs, long iops) {
+		if (!this-> _enabled) return;
+
+		std::stringstream bps, ops;
+		if (kbs < 0) bps << "max"; else bps << kbs * 1024;
+		if (iops < 0) ops << "max"; else ops << iops;
+
+		std::ofstream limit (this-> _path / "io.max");
+		limit << this-> _device << " rbps=" << bps.str () << " wbps=" << bps.str () << " riops=" << ops.str () << " wiops=" << ops.str ();
+		limit.close ();
+	    }
+
+	    std::string io_cgroup::wholeDevice (unsigned int maj, unsigned int min) {
+		std::stringstream dev;
+		dev << maj << ":" << min;
+
+		// The sysfs directory of a partition is inside the directory of its disk
+		auto sys = fs::path ("/sys/dev/block") / dev.str ();
+		if (fs::exists (sys / "partition")) {
+		    std::ifstream f (fs::canonical (sys).parent_path () / "dev");
+		    std::string whole;
+		    if (f >> whole) return whole;
+		}
+
+		return dev.str ();
+	    }
+
+	}
+
+    }
+
+}
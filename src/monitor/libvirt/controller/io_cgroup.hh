@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <filesystem>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    /**
+	     * The content of io.stat of an io cgroup for one block device
+	     */
+	    struct io_stat {
+
+		/// The bytes read, and written since the creation of the cgroup
+		unsigned long bytes = 0;
+
+		/// The read, and write operations since the creation of the cgroup
+		unsigned long ios = 0;
+
+	    };
+
+	    /**
+	     * The io cgroup of a VM (the scope of the qemu process), limiting the accesses to the block device holding the disks of the VM
+	     * @info: only cgroup v2 is supported (io.stat, io.max), the limits are ignored on v1
+	     */
+	    class io_cgroup {
+
+		/// True iif the cgroup of the VM was found (and is v2)
+		bool _enabled;
+
+		/// The directory of the cgroup of the VM
+		std::filesystem::path _path;
+
+		/// The device holding the disks of the VM (major:minor)
+		std::string _device;
+
+	    public:
+
+		io_cgroup ();
+
+		/**
+		 * Search the cgroup of the VM, and the block device of its disk
+		 * @info: the VM must be running
+		 * @params:
+		 *    - vmName: the name of the vm
+		 *    - disk: the path of the disk image of the VM on the host
+		 * @returns: true iif the cgroup, and the device were found
+		 */
+		bool enable (const std::string & vmName, const std::filesystem::path & disk);
+
+		/**
+		 * @returns: true iif the cgroup was found
+		 */
+		bool isEnabled () const;
+
+		/**
+		 * @returns: the accesses of the VM processes to the device of the disk (zeros if the cgroup is not enabled)
+		 */
+		io_stat readStat () const;
+
+		/**
+		 * Set the limits of the cgroup on the device of the disk
+		 * @info: the read, and write limits are the same
+		 * @params:
+		 *    - kbs: the bandwidth in KB/s (-1 for no limit)
+		 *    - iops: the operations per second (-1 for no limit)
+		 */
+		void setMax (long kbs, long iops);
+
+	    private:
+
+		/**
+		 * @returns: the whole disk device (major:minor) of a device, io.max does not accept partitions
+		 */
+		static std::string wholeDevice (unsigned int major, unsigned int minor);
+
+	    };
+
+	}
+
+    }
+
+}
@@ -0,0 +1,278 @@
+#include <monitor/libvirt/controller/memory.hh>
+#include <monitor/libvirt/vm.hh>
+#include <libvirt/libvirt.h>
+#include <monitor/utils/log.hh>
+#include <algorithm>
+
+using namespace monitor::utils;
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    LibvirtMemoryController::LibvirtMemoryController (LibvirtVM & context, int maxHistory) :
+		_context (context),
+		_enabled (false),
+		_history (maxHistory)
+	    {}
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================          ACQUIRING           =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    void LibvirtMemoryController::enable () {
+		if (this-> _context._dom == nullptr) return;
+
+		// The balloon driver of the guest refreshes its statistics every second
+		virDomainSetMemoryStatsPeriod (this-> _context._dom, 1, VIR_DOMAIN_AFFECT_LIVE);
+		if (!this-> _cgroup.enable (this-> _context.id ())) {
+		    logging::warn ("Memory cgroup of VM", this-> _context.id (), "not found");
+		}
+
+		// Only the soft limit throttles the VM, a hard limit would let the OOM killer kill qemu
+		this-> _cgroup.setMax (-1);
+		this-> _cgroup.setHigh (-1);
+		this-> _high = -1;
+		this-> _stat = this-> _cgroup.readStat ();
+
+		this-> _balloon = this-> getMaxMemory ();
+		this-> _allocated = this-> _balloon;
+		this-> _enabled = true;
+	    }
+
+	    void LibvirtMemoryController::update () {
+		if (!this-> _enabled) return;
+
+		virDomainMemoryStatStruct stats [VIR_DOMAIN_MEMORY_STAT_NR];
+		auto nb = virDomainMemoryStats (this-> _context._dom, stats, VIR_DOMAIN_MEMORY_STAT_NR, 0);
+
+		unsigned long available = 0, unused = 0, usable = 0;
+		bool hasUsable = false;
+		for (int i = 0 ; i < nb ; i++) {
+		    switch (stats [i].tag) {
+		    case VIR_DOMAIN_MEMORY_STAT_AVAILABLE : available = stats [i].val; break;
+		    case VIR_DOMAIN_MEMORY_STAT_UNUSED : unused = stats [i].val; break;
+		    case VIR_DOMAIN_MEMORY_STAT_USABLE : usable = stats [i].val; hasUsable = true; break;
+		    case VIR_DOMAIN_MEMORY_STAT_ACTUAL_BALLOON : this-> _balloon = stats [i].val; break;
+		    default : break;
+		    }
+		}
+
+		// The usable memory includes the caches that the guest can drop, so it is preferred to the unused memory
+		auto reclaimable = hasUsable ? usable : unused;
+		this-> _sampled = available != 0 && reclaimable <= available;
+		if (this-> _sampled) {
+		    this-> _guestUsed = available - reclaimable;
+		    this-> _history.push (this-> getRelativePercentUsed ());
+		}
+
+		this-> _hostUsed = this-> _cgroup.readCurrent ();
+		this-> _hostSwap = this-> _cgroup.readSwapCurrent ();
+
+		auto stat = this-> _cgroup.readStat ();
+		this-> _majorFaults = stat.pgmajfault >= this-> _stat.pgmajfault ? stat.pgmajfault - this-> _stat.pgmajfault : 0;
+		this-> _stat = stat;
+		this-> _hasPressure = this-> _cgroup.readPressure (this-> _pressure);
+
+		this-> updateSwap ();
+		this-> _buying = 0;
+	    }
+
+	    void LibvirtMemoryController::updateSwap () {
+		virDomainBlockStatsStruct stats;
+		if (virDomainBlockStats (this-> _context._dom, this-> _swapDisk.c_str (), &stats, sizeof (stats)) == 0) {
+		    // The first read only gives the reference of the counters
+		    if (this-> _swapRead >= 0 && stats.rd_bytes >= this-> _swapRead && stats.wr_bytes >= this-> _swapWritten) {
+			this-> _swapIn = (stats.rd_bytes - this-> _swapRead) / 1024;
+			this-> _swapOut = (stats.wr_bytes - this-> _swapWritten) / 1024;
+		    } else {
+			this-> _swapIn = 0;
+			this-> _swapOut = 0;
+		    }
+
+		    this-> _swapRead = stats.rd_bytes;
+		    this-> _swapWritten = stats.wr_bytes;
+		}
+
+		// The swap disk is a sparse raw file, its allocation grows with the pages swapped out by the guest
+		virDomainBlockInfo info;
+		if (virDomainGetBlockInfo (this-> _context._dom, this-> _swapDisk.c_str (), &info, 0) == 0) {
+		    this-> _swapAllocated = info.allocation / 1024;
+		}
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================           GETTERS            =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    unsigned long LibvirtMemoryController::getGuestUsed () const {
+		return this-> _guestUsed;
+	    }
+
+	    unsigned long LibvirtMemoryController::getHostUsed () const {
+		return this-> _hostUsed;
+	    }
+
+	    unsigned long LibvirtMemoryController::getBalloon () const {
+		return this-> _balloon;
+	    }
+
+	    unsigned long LibvirtMemoryController::getMaxMemory () const {
+		return ((unsigned long) this-> _context.memory ()) * 1024;
+	    }
+
+	    unsigned long LibvirtMemoryController::getNominal () const {
+		return (unsigned long) (this-> getMaxMemory () * this-> _context.memorySLA ());
+	    }
+
+	    float LibvirtMemoryController::getRelativePercentUsed () const {
+		if (this-> _balloon == 0) return 0.0f;
+		return ((float) this-> _guestUsed) / ((float) this-> _balloon) * 100.0f;
+	    }
+
+	    float LibvirtMemoryController::getSlope () const {
+		return this-> _history.slope ();
+	    }
+
+	    bool LibvirtMemoryController::isSampled () const {
+		return this-> _sampled;
+	    }
+
+	    unsigned long LibvirtMemoryController::getSwapping () const {
+		return this-> _swapIn;
+	    }
+
+	    float LibvirtMemoryController::getPressure () const {
+		return this-> _hasPressure ? this-> _pressure.some10 : 0.0f;
+	    }
+
+	    LibvirtVM & LibvirtMemoryController::vm () {
+		return this-> _context;
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================         CONTROLLING          =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    void LibvirtMemoryController::applyAllocation () {
+		if (!this-> _enabled) return;
+
+		auto alloc = std::min (this-> _allocated, this-> getMaxMemory ());
+		auto diff = alloc > this-> _balloon ? alloc - this-> _balloon : this-> _balloon - alloc;
+
+		// Ballooning is costly for the guest, small variations are ignored
+		if (diff > std::max (this-> getMaxMemory () / 100, (unsigned long) 16384)) {
+		    if (virDomainSetMemory (this-> _context._dom, alloc) == 0) {
+			this-> _balloon = alloc;
+		    }
+		}
+
+		this-> paceHigh (alloc + this-> _overhead);
+	    }
+
+	    void LibvirtMemoryController::paceHigh (unsigned long target) {
+		unsigned long limit = this-> getMaxMemory () + this-> _overhead;
+		target = std::min (target, limit);
+		if (!this-> _hasPressure) {
+		    this-> _high = target;
+		    this-> _cgroup.setHigh (this-> _high);
+		    return;
+		}
+
+		unsigned long current = this-> _high < 0 ? limit : (unsigned long) this-> _high;
+		unsigned long next = current;
+		if (target >= current) { // raising the limit never causes reclaim
+		    next = target;
+		} else if (this-> _pressure.some10 >= this-> _pressureHigh) { // the VM is thrashing, the reclaim is released
+		    next = std::min (limit, current + this-> _reclaimStep);
+		} else if (this-> _pressure.some10 <= this-> _pressureLow) {
+		    // The limit is never set far below the usage, the kernel reclaims at most a step at each tick
+		    auto from = std::min (current, this-> _hostUsed);
+		    next = std::max (target, from > this-> _reclaimStep ? from - this-> _reclaimStep : 0);
+		} // else, moderate pressure, the reclaim continues at the current limit
+
+		if (next >= limit) {
+		    if (this-> _high != -1) this-> _cgroup.setHigh (-1);
+		    this-> _high = -1;
+		} else if ((long) next != this-> _high) {
+		    this-> _high = next;
+		    this-> _cgroup.setHigh (this-> _high);
+		}
+	    }
+
+	    void LibvirtMemoryController::unlimit () {
+		if (!this-> _enabled) return;
+
+		this-> _allocated = this-> getMaxMemory ();
+		if (virDomainSetMemory (this-> _context._dom, this-> _allocated) == 0) {
+		    this-> _balloon = this-> _allocated;
+		}
+
+		this-> _cgroup.setHigh (-1);
+		this-> _high = -1;
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================            MARKET            =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    unsigned long & LibvirtMemoryController::allocated () {
+		return this-> _allocated;
+	    }
+
+	    unsigned long & LibvirtMemoryController::buying () {
+		return this-> _buying;
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================             LOG              =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    nlohmann::json LibvirtMemoryController::dumpLogs () const {
+		nlohmann::json j;
+		j["guest-used"] = this-> _guestUsed;
+		j["host-used"] = this-> _hostUsed;
+		j["balloon"] = this-> _balloon;
+		j["allocated"] = this-> _allocated;
+		j["high"] = this-> _high;
+		j["anon"] = this-> _stat.anon;
+		j["file"] = this-> _stat.file;
+		j["major-faults"] = this-> _majorFaults;
+		j["host-swap"] = this-> _hostSwap;
+		j["swap-in"] = this-> _swapIn;
+		j["swap-out"] = this-> _swapOut;
+		j["swap-disk"] = this-> _swapAllocated;
+		if (this-> _hasPressure) {
+		    j["pressure"] = {{"some", this-> _pressure.some10}, {"full", this-> _pressure.full10}};
+		}
+
+		return j;
+	    }
+
+	}
+
+    }
+
+}
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <nlohmann/json.hpp>
+#include <monitor/libvirt/controller/memory_cgroup.hh>
+#include <monitor/libvirt/controller/history.hh>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	class LibvirtVM;
+
+	namespace control {
+
+	    /**
+	     * The memory controller of a VM
+	     * The usage of the guest is sampled with the balloon driver (virDomainMemoryStats)
+	     * The allocation is applied by ballooning (virDomainSetMemory), and by the soft limit of the memory cgroup of the VM
+	     * @info: all the quantities are in KB
+	     */
+	    class LibvirtMemoryController {
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================           CONTEXT            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// The vm associated to the controller
+		LibvirtVM & _context;
+
+		/// True iif the controller was enabled (the VM is booted)
+		bool _enabled;
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================            CGROUP            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// The memory cgroup of the VM
+		memory_cgroup _cgroup;
+
+		/// The memory added to the allocation in the soft limit of the cgroup (qemu overhead)
+		unsigned long _overhead = 262144; // 256MB
+
+		/// The soft limit currently written in the cgroup (-1 if there is no limit)
+		long _high = -1;
+
+		/// The maximal decrease of the soft limit at each tick
+		unsigned long _reclaimStep = 131072; // 128MB
+
+		/// Above this pressure (some avg10 in %), the soft limit is raised to relieve the VM
+		float _pressureHigh = 10.0f;
+
+		/// Under this pressure (some avg10 in %), the soft limit can be lowered
+		float _pressureLow = 1.0f;
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================           SAMPLING           =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// The memory used by the guest (available - unused) during the last update
+		unsigned long _guestUsed = 0;
+
+		/// The current size of the balloon (the memory usable by the guest)
+		unsigned long _balloon = 0;
+
+		/// The memory used by the VM processes on the host
+		unsigned long _hostUsed = 0;
+
+		/// The memory of the VM processes swapped out by the host
+		unsigned long _hostSwap = 0;
+
+		/// The statistics of the memory cgroup in the last update
+		memory_stat _stat;
+
+		/// The number of major page faults of the VM processes since the last update
+		unsigned long _majorFaults = 0;
+
+		/// The memory pressure of the cgroup in the last update
+		memory_pressure _pressure;
+
+		/// True iif the pressure was read in the last update (cgroup v2 with PSI)
+		bool _hasPressure = false;
+
+		/// True iif the guest reported its usage in the last update (balloon driver loaded)
+		bool _sampled = false;
+
+		/// The history in used percentage of the balloon
+		history _history;
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================             SWAP             =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// The target of the swap disk in the guest (cf. LibvirtClient::attachSwapDisk)
+		std::string _swapDisk = "vdb";
+
+		/// The bytes read from the swap disk since the boot of the VM
+		long long _swapRead = -1;
+
+		/// The bytes written in the swap disk since the boot of the VM
+		long long _swapWritten = -1;
+
+		/// The memory swapped in by the guest since the last update
+		unsigned long _swapIn = 0;
+
+		/// The memory swapped out by the guest since the last update
+		unsigned long _swapOut = 0;
+
+		/// The size of the swap disk allocated on the host (the maximal swap usage of the guest)
+		unsigned long _swapAllocated = 0;
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================            MARKET            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// The memory allocated to the VM by the market
+		unsigned long _allocated = 0;
+
+		/// The memory the VM wants to buy
+		unsigned long _buying = 0;
+
+	    public:
+
+		/**
+		 * @params:
+		 *    - context: the vm of the controller
+		 *    - maxHistory: the maximum length of the history
+		 */
+		LibvirtMemoryController (LibvirtVM & context, int maxHistory = 5);
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================          ACQUIRING           =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * Enable the balloon statistics of the guest, and search the memory cgroup of the VM
+		 * @info: this function should be called once after the VM is booted
+		 */
+		void enable ();
+
+		/**
+		 * Sample the memory usage of the guest, and of the VM on the host
+		 * @info: this function should be called periodically (before each market tick)
+		 */
+		void update ();
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================           GETTERS            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * @returns: the memory used by the guest
+		 */
+		unsigned long getGuestUsed () const;
+
+		/**
+		 * @returns: the memory used by the VM processes on the host
+		 */
+		unsigned long getHostUsed () const;
+
+		/**
+		 * @returns: the current size of the balloon
+		 */
+		unsigned long getBalloon () const;
+
+		/**
+		 * @returns: the memory size of the VM (maximal balloon)
+		 */
+		unsigned long getMaxMemory () const;
+
+		/**
+		 * @returns: the memory guaranteed to the VM (memory size * memorySLA)
+		 */
+		unsigned long getNominal () const;
+
+		/**
+		 * @returns: the percentage of the balloon used by the guest
+		 */
+		float getRelativePercentUsed () const;
+
+		/**
+		 * @returns: the slope of the usage in the latests ticks
+		 */
+		float getSlope () const;
+
+		/**
+		 * @returns: true iif the guest reported its usage in the last update
+		 */
+		bool isSampled () const;
+
+		/**
+		 * @returns: the memory swapped in by the guest since the last update
+		 */
+		unsigned long getSwapping () const;
+
+		/**
+		 * @returns: the share of time (in %) the VM processes were stalled on memory in the last 10 seconds (0 if unknown)
+		 */
+		float getPressure () const;
+
+		/**
+		 * @returns: the context of the controller
+		 */
+		LibvirtVM & vm ();
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================         CONTROLLING          =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * Apply the allocation computed by the market (balloon, and cgroup soft limit)
+		 */
+		void applyAllocation ();
+
+		/**
+		 * Give the whole memory size to the VM, and remove the cgroup soft limit
+		 */
+		void unlimit ();
+
+	    private:
+
+		/**
+		 * Move the soft limit of the cgroup toward a target
+		 * The limit is raised immediately, but lowered by steps when the VM is not under pressure, so the kernel reclaims the memory progressively
+		 * When the VM is under pressure, the limit is raised again, the VM is never OOM killed by the controller
+		 * @info: without pressure information (cgroup v1), the target is applied directly
+		 * @params:
+		 *    - target: the soft limit to reach
+		 */
+		void paceHigh (unsigned long target);
+
+		/**
+		 * Read the activity of the swap disk of the guest
+		 */
+		void updateSwap ();
+
+	    public:
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================            MARKET            =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * @returns: the memory allocated to the VM
+		 */
+		unsigned long & allocated ();
+
+		/**
+		 * @returns: the memory the VM wants to buy
+		 */
+		unsigned long & buying ();
+
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================             LOG              =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/**
+		 * @returns: the log about the memory controller for the current tick
+		 */
+		nlohmann::json dumpLogs () const;
+
+	    };
+
+	}
+
+    }
+
+}
@@ -0,0 +1,116 @@
+#include <monitor/libvirt/controller/memory_cgroup.hh>
+#include <monitor/libvirt/controller/cgroup.hh>
+#include <fstream>
+#include <stdio.h>
+
+namespace fs = std::filesystem;
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    memory_cgroup::memory_cgroup () :
+		_enabled (false)
+	    {
+		std::ifstream f ("/sys/fs/cgroup/cgroup.controllers");
+		this-> _v2 = f.good ();
+		f.close ();
+	    }
+
+	    bool memory_cgroup::enable (const std::string & vmName) {
+		auto root = this-> _v2 ? fs::path ("/sys/fs/cgroup/machine.slice") : fs::path ("/sys/fs/cgroup/memory/machine.slice");
+		this-> _path = cgroup::recursiveSearch (root, "v" + vmName);
+		this-> _enabled = this-> _path.u8string ().length () != 0;
+
+		return this-> _enabled;
+	    }
+
+	    bool memory_cgroup::isEnabled () const {
+		return this-> _enabled;
+	    }
+
+	    unsigned long memory_cgroup::readCurrent () const {
+		if (!this-> _enabled) return 0;
+
+		std::ifstream f (this-> _path / (this-> _v2 ? "memory.current" : "memory.usage_in_bytes"));
+		unsigned long bytes = 0;
+		f >> bytes;
+
+		return bytes / 1024;
+	    }
+
+	    unsigned long memory_cgroup::readSwapCurrent () const {
+		if (!this-> _enabled || !this-> _v2) return 0;
+
+		std::ifstream f (this-> _path / "memory.swap.current");
+		unsigned long bytes = 0;
+		f >> bytes;
+
+		return bytes / 1024;
+	    }
+
+	    memory_stat memory_cgroup::readStat () const {
+		memory_stat stat;
+		if (!this-> _enabled) return stat;
+
+		// The v1 hierarchy reports the counters of the whole subtree with the total_ prefix
+		std::string anon = this-> _v2 ? "anon" : "total_rss";
+		std::string file = this-> _v2 ? "file" : "total_cache";
+		std::string fault = this-> _v2 ? "pgmajfault" : "total_pgmajfault";
+
+		std::ifstream f (this-> _path / "memory.stat");
+		std::string key;
+		unsigned long value;
+		while (f >> key >> value) {
+		    if (key == anon) stat.anon = value / 1024;
+		    else if (key == file) stat.file = value / 1024;
+		    else if (key == fault) stat.pgmajfault = value;
+		}
+
+		return stat;
+	    }
+
+	    bool memory_cgroup::readPressure (memory_pressure & psi) const {
+		if (!this-> _enabled || !this-> _v2) return false;
+
+		auto f = fopen ((this-> _path / "memory.pressure").c_str (), "r");
+		if (f == nullptr) return false;
+
+		// some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+		// full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+		int nb = fscanf (f, "some avg10=%f avg60=%*f avg300=%*f total=%lu\n", &psi.some10, &psi.someTotal);
+		nb += fscanf (f, "full avg10=%f avg60=%*f avg300=%*f total=%lu", &psi.full10, &psi.fullTotal);
+		fclose (f);
+
+		return nb == 4;
+	    }
+
+	    void memory_cgroup::setHigh (long kbs) {
+		this-> writeLimit (this-> _v2 ? "memory.high" : "memory.soft_limit_in_bytes", kbs);
+	    }
+
+	    void memory_cgroup::setMax (long kbs) {
+		this-> writeLimit (this-> _v2 ? "memory.max" : "memory.limit_in_bytes", kbs);
+	    }
+
+	    void memory_cgroup::writeLimit (const std::string & file, long kbs) {
+		if (!this-> _enabled) return;
+
+		std::ofstream limit (this-> _path / file);
+		if (kbs < 0) {
+		    if (this-> _v2) limit << "max";
+		    else limit << -1;
+		} else {
+		    limit << kbs * 1024;
+		}
+
+		limit.close ();
+	    }
+
+	}
+
+    }
+
+}
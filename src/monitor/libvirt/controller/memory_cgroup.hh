@@ -0,0 +1,136 @@
+#pragma once
+
+#include <string>
+#include <filesystem>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    /**
+	     * The content of memory.stat of a memory cgroup that is used by the controller
+	     * @info: the quantities are in KB
+	     */
+	    struct memory_stat {
+
+		/// The anonymous memory of the VM processes (mostly the guest memory)
+		unsigned long anon = 0;
+
+		/// The page cache of the VM processes
+		unsigned long file = 0;
+
+		/// The number of major page faults since the creation of the cgroup
+		unsigned long pgmajfault = 0;
+
+	    };
+
+	    /**
+	     * The pressure stall information of a memory cgroup (memory.pressure)
+	     * @info: the averages are in percentage of time, the totals in microseconds
+	     */
+	    struct memory_pressure {
+
+		/// The share of time at least one task was stalled on memory in the last 10 seconds
+		float some10 = 0.0f;
+
+		/// The share of time all the tasks were stalled on memory in the last 10 seconds
+		float full10 = 0.0f;
+
+		/// The total stall time of at least one task
+		unsigned long someTotal = 0;
+
+		/// The total stall time of all the tasks
+		unsigned long fullTotal = 0;
+
+	    };
+
+	    /**
+	     * The memory cgroup of a VM (the scope of the qemu process, containing the emulator and the vcpu threads)
+	     */
+	    class memory_cgroup {
+
+		/// True if cgroup is v2
+		bool _v2;
+
+		/// True iif the cgroup of the VM was found
+		bool _enabled;
+
+		/// The directory of the cgroup of the VM
+		std::filesystem::path _path;
+
+	    public:
+
+		memory_cgroup ();
+
+		/**
+		 * Search the cgroup of the VM
+		 * @info: the VM must be running
+		 * @params:
+		 *    - vmName: the name of the vm
+		 * @returns: true iif the cgroup was found
+		 */
+		bool enable (const std::string & vmName);
+
+		/**
+		 * @returns: true iif the cgroup was found
+		 */
+		bool isEnabled () const;
+
+		/**
+		 * @returns: the memory used by the VM processes on the host in KB (0 if the cgroup is not enabled)
+		 */
+		unsigned long readCurrent () const;
+
+		/**
+		 * @returns: the memory of the VM processes swapped out by the host in KB (0 on cgroup v1)
+		 */
+		unsigned long readSwapCurrent () const;
+
+		/**
+		 * @returns: the statistics of the cgroup (zeros if the cgroup is not enabled)
+		 */
+		memory_stat readStat () const;
+
+		/**
+		 * Read the pressure stall information of the cgroup
+		 * @params:
+		 *    - psi: the pressure read
+		 * @returns: false if the pressure is not available (cgroup v1, kernel without PSI)
+		 */
+		bool readPressure (memory_pressure & psi) const;
+
+		/**
+		 * Set the soft limit of the cgroup, above which the kernel reclaims the memory of the VM processes
+		 * @info: on cgroup v1, the soft limit is used, as there is no memory.high
+		 * @params:
+		 *    - kbs: the limit in KB (-1 for no limit)
+		 */
+		void setHigh (long kbs);
+
+		/**
+		 * Set the hard limit of the cgroup, above which the VM processes are killed by the OOM killer
+		 * @info: on cgroup v1, memory.limit_in_bytes is used
+		 * @params:
+		 *    - kbs: the limit in KB (-1 for no limit)
+		 */
+		void setMax (long kbs);
+
+	    private:
+
+		/**
+		 * Write a limit in a file of the cgroup
+		 * @params:
+		 *    - file: the name of the file
+		 *    - kbs: the limit in KB (-1 for no limit)
+		 */
+		void writeLimit (const std::string & file, long kbs);
+
+	    };
+
+	}
+
+    }
+
+}
@@ -0,0 +1,91 @@
+#include <monitor/libvirt/controller/perf.hh>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    perf_group::perf_group () {}
+
+	    bool perf_group::open (unsigned int tid) {
+		this-> close ();
+
+		int leader = this-> openEvent (tid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+		if (leader < 0) return false;
+		this-> _fds.push_back (leader);
+
+		int instructions = this-> openEvent (tid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, leader);
+		if (instructions < 0) {
+		    this-> close ();
+		    return false;
+		}
+		this-> _fds.push_back (instructions);
+
+		// The cache misses are optional, some cpus (and most VMs) do not have the event
+		int misses = this-> openEvent (tid, PERF_TYPE_HW_CACHE,
+					       PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+					       leader);
+		this-> _hasMisses = misses >= 0;
+		if (this-> _hasMisses) this-> _fds.push_back (misses);
+
+		return true;
+	    }
+
+	    bool perf_group::isOpen () const {
+		return !this-> _fds.empty ();
+	    }
+
+	    bool perf_group::read (HostBackend::counters & c) {
+		if (this-> _fds.empty ()) return false;
+
+		// nr, time enabled, time running, and one value per event
+		unsigned long buf [3 + 3];
+		auto size = sizeof (unsigned long) * (3 + this-> _fds.size ());
+		if (::read (this-> _fds [0], buf, size) != (ssize_t) size) return false;
+		if (buf [0] != this-> _fds.size ()) return false;
+
+		double scale = 1.0;
+		if (buf [2] != 0 && buf [2] < buf [1]) scale = ((double) buf [1]) / ((double) buf [2]);
+
+		c.cycles = (unsigned long) (buf [3] * scale);
+		c.instructions = (unsigned long) (buf [4] * scale);
+		c.llcMisses = this-> _hasMisses ? (unsigned long) (buf [5] * scale) : 0;
+
+		return true;
+	    }
+
+	    void perf_group::close () {
+		for (auto it = this-> _fds.rbegin () ; it != this-> _fds.rend () ; it++) {
+		    ::close (*it);
+		}
+
+		this-> _fds.clear ();
+		this-> _hasMisses = false;
+	    }
+
+	    int perf_group::openEvent (unsigned int tid, unsigned int type, unsigned long config, int leader) {
+		perf_event_attr attr;
+		memset (&attr, 0, sizeof (attr));
+		attr.size = sizeof (attr);
+		attr.type = type;
+		attr.config = config;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		return syscall (__NR_perf_event_open, &attr, tid, -1, leader, 0);
+	    }
+
+	    perf_group::~perf_group () {
+		this-> close ();
+	    }
+
+	}
+
+    }
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <monitor/libvirt/controller/backend.hh>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    /**
+	     * A group of hardware counters on a thread (perf_event_open), read in one read () with PERF_FORMAT_GROUP
+	     * The group counts the cycles (leader), the instructions, and the last level cache misses if the cpu has the event
+	     * @info: when the counters are multiplexed with other groups, the values are scaled by the time the group was running
+	     */
+	    class perf_group {
+
+		/// The file descriptors of the events, the first one is the leader (empty if the group is not opened)
+		std::vector <int> _fds;
+
+		/// True iif the cache misses are in the group
+		bool _hasMisses = false;
+
+	    public:
+
+		perf_group ();
+
+		perf_group (const perf_group &) = delete;
+		void operator= (const perf_group &) = delete;
+
+		/**
+		 * Open the counters on a thread
+		 * @params:
+		 *    - tid: the id of the thread
+		 * @returns: false if the counters cannot be opened (no hardware counter, perf_event_paranoid)
+		 */
+		bool open (unsigned int tid);
+
+		/**
+		 * @returns: true iif the group is opened
+		 */
+		bool isOpen () const;
+
+		/**
+		 * Read the counters since the group was opened
+		 * @returns: false if the group is not opened, or the read failed
+		 */
+		bool read (HostBackend::counters & c);
+
+		/**
+		 * Close the counters
+		 */
+		void close ();
+
+		~perf_group ();
+
+	    private:
+
+		/**
+		 * Open one event of the group
+		 * @returns: the file descriptor, -1 on failure
+		 */
+		int openEvent (unsigned int tid, unsigned int type, unsigned long config, int leader);
+
+	    };
+
+	}
+
+    }
+
+}
@@ -0,0 +1,364 @@
+#include <monitor/libvirt/controller/sysfs_backend.hh>
+#include <monitor/libvirt/controller/cgroup.hh>
+#include <sys/sysinfo.h>
+#include <sched.h>
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    SysfsBackend::SysfsBackend (const fs::path & root) :
+		_root (root)
+	    {
+		std::ifstream f (this-> _root / "sys/fs/cgroup/cgroup.controllers");
+		this-> _v2 = f.good ();
+		f.close ();
+
+		for (auto i = 0 ; i < this-> nbCpus () ; i++) {
+		    std::stringstream path;
+		    path << "sys/devices/system/cpu/cpu" << i << "/cpufreq/scaling_cur_freq";
+		    this-> _cpuPath.push_back (this-> _root / path.str ());
+		    this-> _cpuFreq.push_back (0);
+		}
+	    }
+
+	    std::unique_ptr <HostBackend::VCPU> SysfsBackend::findVCPU (const std::string & vmName, unsigned int vcpuId) {
+		unsigned int tid = 0;
+		return this-> findSysfsVCPU (vmName, vcpuId, tid);
+	    }
+
+	    std::unique_ptr <SysfsBackend::SysfsVCPU> SysfsBackend::findSysfsVCPU (const std::string & vmName, unsigned int vcpuId, unsigned int & tid) {
+		auto vmPath = cgroup::recursiveSearch (this-> machineSlice (), "v" + vmName);
+		if (vmPath.empty ()) return nullptr;
+
+		std::stringstream ss; ss << "vcpu" << vcpuId;
+		auto cgroupPath = vmPath / ss.str ();
+
+		std::ifstream threads (cgroupPath / "cgroup.threads");
+		if (!threads.good ()) return nullptr;
+
+		tid = 0;
+		threads >> tid;
+
+		std::stringstream procPath;
+		procPath << "proc/" << tid << "/stat";
+
+		// The threads of a copied tree are not the threads of this host, they are not counted
+		return std::make_unique <SysfsVCPU> (this-> _v2, cgroupPath, this-> cpusetPath (cgroupPath), this-> _root / procPath.str (), this-> _root == "/" ? tid : 0);
+	    }
+
+	    std::unique_ptr <HostBackend::VM> SysfsBackend::findVM (const std::string & vmName) {
+		auto path = cgroup::recursiveSearch (this-> machineSlice (), "v" + vmName);
+		if (path.empty ()) return nullptr;
+
+		return std::make_unique <SysfsVM> (this-> _v2, path, this-> cpusetPath (path));
+	    }
+
+	    int SysfsBackend::nbCpus () {
+		if (this-> _root == "/") return get_nprocs ();
+
+		// The cpus of a copied tree are the cpuN directories
+		int nb = 0;
+		while (fs::is_directory (this-> _root / ("sys/devices/system/cpu/cpu" + std::to_string (nb)))) nb += 1;
+		return nb;
+	    }
+
+	    const std::vector <unsigned int> & SysfsBackend::readFrequencies () {
+		for (std::size_t i = 0 ; i < this-> _cpuFreq.size () ; i++) {
+		    std::ifstream f (this-> _cpuPath [i]);
+		    f >> this-> _cpuFreq [i];
+		    f.close ();
+		}
+
+		return this-> _cpuFreq;
+	    }
+
+	    HostBackend::topology SysfsBackend::readTopology () {
+		topology t;
+		std::map <unsigned int, unsigned int> firstOfPackage;
+		for (int i = 0 ; i < this-> nbCpus () ; i++) {
+		    auto base = this-> _root / ("sys/devices/system/cpu/cpu" + std::to_string (i));
+		    cpu_place p;
+		    p.core = i;
+		    p.llc = i;
+		    p.domain = i;
+
+		    std::ifstream package (base / "topology/physical_package_id");
+		    package >> p.package;
+		    std::ifstream core (base / "topology/core_id");
+		    core >> p.core;
+
+		    // The last level cache is the cache of highest level, identified by the first cpu sharing it
+		    bool hasCache = false;
+		    unsigned int maxLevel = 0;
+		    std::error_code err;
+		    for (const auto & entry : fs::directory_iterator (base / "cache", err)) {
+			auto cache = entry.path ();
+			if (cache.filename ().string ().rfind ("index", 0) != 0) continue;
+
+			unsigned int level = 0;
+			std::ifstream l (cache / "level");
+			l >> level;
+
+			std::ifstream shared (cache / "shared_cpu_list");
+			std::string list;
+			shared >> list;
+			auto cpus = parseList (list);
+			if (level >= maxLevel && !cpus.empty ()) {
+			    maxLevel = level;
+			    p.llc = cpus [0];
+			    hasCache = true;
+			}
+		    }
+
+		    // Without cache information, the cpus of a socket are assumed to share their cache
+		    if (!hasCache) {
+			firstOfPackage.emplace (p.package, i);
+			p.llc = firstOfPackage [p.package];
+		    }
+
+		    // The cpus of a cpufreq policy share their frequency (related_cpus is a sorted list separated by spaces)
+		    std::ifstream related (base / "cpufreq/related_cpus");
+		    related >> p.domain;
+
+		    std::ifstream minFreq (base / "cpufreq/cpuinfo_min_freq");
+		    minFreq >> p.minFreq;
+		    std::ifstream maxFreq (base / "cpufreq/cpuinfo_max_freq");
+		    maxFreq >> p.maxFreq;
+
+		    t.cpus.push_back (p);
+		}
+
+		auto nodes = this-> _root / "sys/devices/system/node";
+		if (fs::is_directory (nodes)) {
+		    for (const auto & entry : fs::directory_iterator (nodes)) {
+			auto name = entry.path ().filename ().string ();
+			if (name.rfind ("node", 0) != 0 || name.size () == 4 || name.find_first_not_of ("0123456789", 4) != std::string::npos) continue;
+
+			unsigned int node = std::stoul (name.substr (4));
+			std::ifstream cpulist (entry.path () / "cpulist");
+			std::string list;
+			cpulist >> list;
+			for (auto & cpu : parseList (list)) {
+			    if (cpu < t.cpus.size ()) t.cpus [cpu].node = node;
+			}
+
+			// Node 0 MemTotal:       32780604 kB
+			if (t.memory.size () <= node) t.memory.resize (node + 1, 0);
+			std::ifstream meminfo (entry.path () / "meminfo");
+			std::string line;
+			while (std::getline (meminfo, line)) {
+			    auto pos = line.find ("MemTotal:");
+			    if (pos == std::string::npos) continue;
+
+			    t.memory [node] = std::strtoul (line.c_str () + pos + 9, nullptr, 10) / 1024;
+			    break;
+			}
+		    }
+		}
+
+		if (t.memory.empty ()) t.memory.push_back (0);
+		return t;
+	    }
+
+	    bool SysfsBackend::setMaxFrequency (unsigned int cpu, unsigned int frequency) {
+		std::ofstream f (this-> _root / ("sys/devices/system/cpu/cpu" + std::to_string (cpu)) / "cpufreq/scaling_max_freq");
+		if (!f.good ()) return false;
+
+		f << frequency;
+		f.close ();
+		return !f.fail ();
+	    }
+
+	    fs::path SysfsBackend::machineSlice () const {
+		return this-> _v2 ? this-> _root / "sys/fs/cgroup/machine.slice" : this-> _root / "sys/fs/cgroup/cpu/machine.slice";
+	    }
+
+	    fs::path SysfsBackend::cpusetPath (const fs::path & cpuPath) const {
+		if (this-> _v2) return cpuPath;
+		return this-> _root / "sys/fs/cgroup/cpuset" / cpuPath.lexically_relative (this-> _root / "sys/fs/cgroup/cpu");
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================             VCPU             =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    SysfsBackend::SysfsVCPU::SysfsVCPU (bool v2, const fs::path & cgroupPath, const fs::path & cpusetPath, const fs::path & procPath, unsigned int tid) :
+		_v2 (v2),
+		_procPath (procPath),
+		_cpuset (cpusetPath),
+		_tid (tid)
+	    {
+		if (tid != 0) this-> _counters.open (tid);
+
+		if (this-> _v2) {
+		    this-> _usage = std::ifstream (cgroupPath / "cpu.stat");
+		    this-> _limit = cgroupPath / "cpu.max";
+		} else {
+		    this-> _usage = std::ifstream (cgroupPath / "cpuacct.usage");
+		    this-> _limit = cgroupPath / "cpu.cfs_quota_us";
+		}
+	    }
+
+	    unsigned long SysfsBackend::SysfsVCPU::readUsage () {
+		this-> _usage.clear ();
+		this-> _usage.sync ();
+		this-> _usage.seekg (0, this-> _usage.beg);
+		unsigned long res = 0;
+		if (this-> _v2) {
+		    std::string ignore;
+		    this-> _usage >> ignore;
+		    this-> _usage >> res;
+
+		    return res;
+		} else {
+		    this-> _usage >> res;
+		    return res / 1000;
+		}
+	    }
+
+	    unsigned int SysfsBackend::SysfsVCPU::readCpu () {
+		FILE *fp = fopen (this-> _procPath.c_str (), "r");
+		if (fp == NULL) return 0;
+
+		char content[1024];
+		size_t len = fread (content, sizeof (char), 1023, fp);
+		content[len] = '\0';
+		fclose (fp);
+
+		// The processor is the 39th field of the stat, the name of the thread (2nd field) can contain spaces ("CPU 0/KVM")
+		char * it = strrchr (content, ')');
+		if (it == nullptr) return 0;
+
+		for (int i = 0 ; i < 37 ; i++) {
+		    it = strchr (it + 1, ' ');
+		    if (it == nullptr) return 0;
+		}
+
+		return strtol (it + 1, nullptr, 10);
+	    }
+
+	    bool SysfsBackend::SysfsVCPU::readCounters (HostBackend::counters & c) {
+		return this-> _counters.read (c);
+	    }
+
+	    void SysfsBackend::SysfsVCPU::setLimit (long nbMicros, unsigned long period) {
+		std::ofstream limit (this-> _limit);
+		if (this-> _v2) {
+		    if (nbMicros == -1) {
+			limit << "max " << period;
+		    } else {
+			limit << nbMicros << " " << period;
+		    }
+		} else {
+		    limit << nbMicros;
+		}
+
+		limit.close ();
+	    }
+
+	    bool SysfsBackend::SysfsVCPU::setAffinity (const std::vector <unsigned int> & cpus) {
+		// The cpus of the parent on cgroup v1, where an empty cpuset is invalid, the inherited cpus on cgroup v2
+		auto list = formatList (cpus);
+		if (cpus.empty () && !this-> _v2) {
+		    std::ifstream parent (this-> _cpuset.parent_path () / "cpuset.cpus");
+		    parent >> list;
+		}
+
+		if (fs::exists (this-> _cpuset / "cpuset.cpus")) {
+		    std::ofstream f (this-> _cpuset / "cpuset.cpus");
+		    f << list;
+		    f.close ();
+		    if (!f.fail ()) return true;
+		}
+
+		// The cgroup of the vcpu has no cpuset controller, the thread itself is pinned
+		if (this-> _tid == 0) return false;
+
+		cpu_set_t set;
+		CPU_ZERO (&set);
+		if (cpus.empty ()) {
+		    for (int i = 0 ; i < get_nprocs () ; i++) CPU_SET (i, &set);
+		} else {
+		    for (auto & cpu : cpus) CPU_SET (cpu, &set);
+		}
+
+		return sched_setaffinity (this-> _tid, sizeof (set), &set) == 0;
+	    }
+
+	    /**
+	     * ================================================================================
+	     * ================================================================================
+	     * =========================              VM              =========================
+	     * ================================================================================
+	     * ================================================================================
+	     */
+
+	    SysfsBackend::SysfsVM::SysfsVM (bool v2, const fs::path & path, const fs::path & cpusetPath) :
+		_v2 (v2),
+		_path (path),
+		_cpuset (cpusetPath)
+	    {}
+
+	    void SysfsBackend::SysfsVM::setLimit (long nbMicros, unsigned long period) {
+		if (this-> _v2) {
+		    std::ofstream limit (this-> _path / "cpu.max");
+		    if (nbMicros == -1) {
+			limit << "max " << period;
+		    } else {
+			limit << nbMicros << " " << period;
+		    }
+		    limit.close ();
+		} else {
+		    std::ofstream per (this-> _path / "cpu.cfs_period_us");
+		    per << period;
+		    per.close ();
+
+		    std::ofstream limit (this-> _path / "cpu.cfs_quota_us");
+		    limit << nbMicros;
+		    limit.close ();
+		}
+	    }
+
+	    bool SysfsBackend::SysfsVM::setMemoryNodes (const std::vector <unsigned int> & nodes) {
+		if (!fs::exists (this-> _cpuset / "cpuset.mems")) return false;
+
+		auto list = formatList (nodes);
+		if (!this-> _v2) {
+		    if (nodes.empty ()) {
+			std::ifstream parent (this-> _cpuset.parent_path () / "cpuset.mems");
+			parent >> list;
+		    }
+
+		    // The pages already allocated are only migrated with memory_migrate on cgroup v1 (always on cgroup v2)
+		    std::ofstream migrate (this-> _cpuset / "cpuset.memory_migrate");
+		    migrate << "1";
+		    migrate.close ();
+		}
+
+		std::ofstream f (this-> _cpuset / "cpuset.mems");
+		f << list;
+		f.close ();
+
+		return !f.fail ();
+	    }
+
+	}
+
+    }
+
+}
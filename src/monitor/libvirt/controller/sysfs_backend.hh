@@ -0,0 +1,156 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <monitor/libvirt/controller/backend.hh>
+#include <monitor/libvirt/controller/perf.hh>
+
+namespace monitor {
+
+    namespace libvirt {
+
+	namespace control {
+
+	    /**
+	     * The backend reading the cgroups (v1 or v2) of the VMs created by libvirt, the stat of the vcpu threads in procfs, and the cpufreq of the cpus in sysfs
+	     * @info: the root of the tree can be changed to run against a copy of /sys and /proc (for example in a tmpfs)
+	     */
+	    class SysfsBackend : public HostBackend {
+	    protected:
+
+		/**
+		 * A vcpu thread, whose cgroup is a child of the cgroup of the VM (machine.slice/.../vcpuN)
+		 */
+		class SysfsVCPU : public HostBackend::VCPU {
+
+		    /// True if cgroup is v2
+		    bool _v2;
+
+		    /// The file in which usage of the vcpu is written
+		    std::ifstream _usage;
+
+		    /// The file in which the limit of the vcpu is written
+		    std::filesystem::path _limit;
+
+		    /// The file in which the stat of the vcpu process is written
+		    std::filesystem::path _procPath;
+
+		    /// The cgroup of the vcpu in the cpuset hierarchy
+		    std::filesystem::path _cpuset;
+
+		    /// The id of the vcpu thread (0 if it is not a thread of this host)
+		    unsigned int _tid;
+
+		    /// The hardware counters of the vcpu thread (not opened if perf_event_open is not permitted)
+		    perf_group _counters;
+
+		public:
+
+		    /**
+		     * @params:
+		     *    - cpusetPath: the cgroup of the vcpu in the cpuset hierarchy (cgroupPath on cgroup v2)
+		     *    - tid: the id of the vcpu thread whose counters are opened, and that is pinned if the cgroup has no cpuset (0 if it is not a thread of this host)
+		     */
+		    SysfsVCPU (bool v2, const std::filesystem::path & cgroupPath, const std::filesystem::path & cpusetPath, const std::filesystem::path & procPath, unsigned int tid = 0);
+
+		    unsigned long readUsage () override;
+
+		    unsigned int readCpu () override;
+
+		    bool readCounters (HostBackend::counters & c) override;
+
+		    void setLimit (long nbMicros, unsigned long period) override;
+
+		    bool setAffinity (const std::vector <unsigned int> & cpus) override;
+
+		};
+
+		/**
+		 * The cgroup of a whole VM (the scope of the qemu process)
+		 */
+		class SysfsVM : public HostBackend::VM {
+
+		    /// True if cgroup is v2
+		    bool _v2;
+
+		    /// The directory of the cgroup of the VM
+		    std::filesystem::path _path;
+
+		    /// The directory of the cgroup of the VM in the cpuset hierarchy
+		    std::filesystem::path _cpuset;
+
+		public:
+
+		    SysfsVM (bool v2, const std::filesystem::path & path, const std::filesystem::path & cpusetPath);
+
+		    void setLimit (long nbMicros, unsigned long period) override;
+
+		    bool setMemoryNodes (const std::vector <unsigned int> & nodes) override;
+
+		};
+
+	    private:
+
+		/// The root of the tree containing sys and proc
+		std::filesystem::path _root;
+
+		/// True if cgroup is v2
+		bool _v2;
+
+		/// The files in which the frequency of the cpus are written
+		std::vector <std::filesystem::path> _cpuPath;
+
+		/// The last frequency read for each cpu
+		std::vector <unsigned int> _cpuFreq;
+
+	    public:
+
+		/**
+		 * @params:
+		 *    - root: the directory containing sys and proc
+		 */
+		SysfsBackend (const std::filesystem::path & root = "/");
+
+		std::unique_ptr <HostBackend::VCPU> findVCPU (const std::string & vmName, unsigned int vcpuId) override;
+
+		std::unique_ptr <HostBackend::VM> findVM (const std::string & vmName) override;
+
+		int nbCpus () override;
+
+		const std::vector <unsigned int> & readFrequencies () override;
+
+		topology readTopology () override;
+
+		bool setMaxFrequency (unsigned int cpu, unsigned int frequency) override;
+
+	    protected:
+
+		/**
+		 * Search the cgroup, and the thread of a vcpu
+		 * @params:
+		 *    - vmName: the name of the VM
+		 *    - vcpuId: the number of the vcpu in the VM
+		 *    - tid: set to the id of the thread of the vcpu
+		 * @returns: the vcpu, nullptr if it is not running (yet)
+		 */
+		std::unique_ptr <SysfsVCPU> findSysfsVCPU (const std::string & vmName, unsigned int vcpuId, unsigned int & tid);
+
+	    private:
+
+		/**
+		 * @returns: the directory of the cgroups of the VMs
+		 */
+		std::filesystem::path machineSlice () const;
+
+		/**
+		 * @returns: the directory of a cgroup of the cpu hierarchy in the cpuset hierarchy (the same directory on cgroup v2)
+		 */
+		std::filesystem::path cpusetPath (const std::filesystem::path & cpuPath) const;
+
+	    };
+
+	}
+
+    }
+
+}
@@ -16,7 +16,7 @@ namespace monitor {
 	    LibvirtVCPUController::LibvirtVCPUController (int id, LibvirtVM & context, int maxHistory) :
 		_id (id),
 		_context (context),
-		_maxHistory (maxHistory),
+		_history (maxHistory),
 		_cgroup (context.id ()),
 		_sumFrequency (0),
 		_consumption (0),
@@ -36,29 +36,70 @@ namespace monitor {
 	     */
 
 	    void LibvirtVCPUController::enable () {
-		this-> _cgroup.enable (this-> _id);
+		// A VM that is not on a host is simulated, it has no cgroup
+		if (this-> _context._backend != nullptr) {
+		    this-> _cgroup.enable (this-> _id, *this-> _context._backend);
+		}
 	    }
 
 	    void LibvirtVCPUController::update (const std::vector<unsigned int> & freq) {			
 		this-> _lastMicroConsumption = this-> _microConsumption;
-		unsigned int p = this-> _cgroup.readCpu ();
 		this-> _microConsumption = this-> _cgroup.readUsage ();
+		auto used = this-> _microConsumption - this-> _lastMicroConsumption;
+
+		HostBackend::counters c;
+		unsigned long cycles = 0;
+		if (this-> _cgroup.readCounters (c)) {
+		    if (this-> _counting) {
+			cycles = c.cycles - this-> _lastCounters.cycles;
+			this-> _sumCounters.cycles += cycles;
+			this-> _sumCounters.instructions += c.instructions - this-> _lastCounters.instructions;
+			this-> _sumCounters.llcMisses += c.llcMisses - this-> _lastCounters.llcMisses;
+		    }
+
+		    this-> _lastCounters = c;
+		    this-> _counting = true;
+		}
+
+		// Without a measure of the backend, the frequency is the cycles per microsecond of the vcpu, or the one of the cpu running the vcpu
+		long frequency = this-> _cgroup.readFrequency ();
+		if (frequency < 0 && cycles != 0 && used != 0) {
+		    frequency = (long) (cycles * 1000 / used);
+		}
+
+		if (frequency < 0) {
+		    unsigned int p = this-> _cgroup.readCpu ();
+		    frequency = p < freq.size () ? freq [p] : 0;
+		}
 		
 		this-> _microDelta = this-> _t.time_since_start ();
-		auto deltaUsed = (float (this-> _microConsumption - this-> _lastMicroConsumption) / 1000000.0f);		
+		auto deltaUsed = (float (used) / 1000000.0f);		
 		this-> _t.reset ();
 
-		this-> _sumFrequency += (unsigned long) (float (freq[p]) * (deltaUsed / this-> _microDelta));
-		this-> _sumConsumption += (this-> _microConsumption - this-> _lastMicroConsumption);
+		this-> _sumFrequency += (unsigned long) (float (frequency) * (deltaUsed / this-> _microDelta));
+		this-> _sumConsumption += used;
 		this-> _sumDelta += this-> _microDelta;
 		this-> _nbMicros += 1;
 	    }
 
+	    void LibvirtVCPUController::feed (unsigned long consumption, float delta, unsigned int frequency) {
+		this-> _lastMicroConsumption = this-> _microConsumption;
+		this-> _microConsumption += consumption;
+		this-> _microDelta = delta;
+
+		this-> _sumFrequency += (unsigned long) (float (frequency) * (float (consumption) / 1000000.0f / delta));
+		this-> _sumConsumption += consumption;
+		this-> _sumDelta += delta;
+		this-> _nbMicros += 1;
+	    }
+
 	    void LibvirtVCPUController::updateBeforeMarket () {
 		this-> _lastFrequency = this-> _sumFrequency / this-> _nbMicros;
 		this-> _consumption = this-> _sumConsumption;
 		this-> _delta = this-> _sumDelta;
+		this-> _counters = this-> _sumCounters;
 		
+		this-> _sumCounters = HostBackend::counters ();
 		this-> _sumConsumption = 0;
 		this-> _sumFrequency = 0;
 		this-> _nbMicros = 0;
@@ -81,6 +122,10 @@ namespace monitor {
 		return this-> _lastFrequency;
 	    }
 	    
+	    int LibvirtVCPUController::getId () const {
+		return this-> _id;
+	    }
+
 	    unsigned long LibvirtVCPUController::getConsumption () const {
 		return this-> _consumption;
 	    }
@@ -90,7 +135,7 @@ namespace monitor {
 	    }
 
 	    float LibvirtVCPUController::getSlope () const {
-		return this-> _slope;
+		return this-> _history.slope ();
 	    }
 
 	    int LibvirtVCPUController::getQuota () const {
@@ -118,9 +163,46 @@ namespace monitor {
 		return this-> _nominalFreq;
 	    }
 
+	    bool LibvirtVCPUController::hasCounters () const {
+		return this-> _counting;
+	    }
+
+	    unsigned long LibvirtVCPUController::getCycles () const {
+		return this-> _counters.cycles;
+	    }
+
+	    unsigned long LibvirtVCPUController::getInstructions () const {
+		return this-> _counters.instructions;
+	    }
+
+	    float LibvirtVCPUController::getIPC () const {
+		if (this-> _counters.cycles == 0) return 0.0f;
+		return ((float) this-> _counters.instructions) / ((float) this-> _counters.cycles);
+	    }
+
+	    unsigned long LibvirtVCPUController::getDeliveredFrequency () const {
+		if (this-> _counters.cycles == 0 || this-> _consumption == 0) return 0;
+		return this-> _counters.cycles * 1000 / this-> _consumption;
+	    }
+
+	    unsigned long LibvirtVCPUController::getDeliveredCycles () const {
+		if (this-> _counting) return this-> _counters.cycles;
+
+		// The frequency of the tick is weighted by the usage of the vcpu, KHz * seconds are thousands of cycles
+		return (unsigned long) (((double) this-> _lastFrequency) * this-> _delta * 1000.0);
+	    }
+
 	    LibvirtVM & LibvirtVCPUController::vm () {
 		return this-> _context;
 	    }
+
+	    const std::vector <float> & LibvirtVCPUController::getHistory () const {
+		return this-> _history.values ();
+	    }
+
+	    void LibvirtVCPUController::restoreHistory (const std::vector <float> & history) {
+		this-> _history.restore (history);
+	    }
 	    
 	    /**
 	     * ================================================================================
@@ -148,6 +230,19 @@ namespace monitor {
 		this-> setQuota (-1);
 	    }
 
+	    bool LibvirtVCPUController::setAffinity (const std::vector <unsigned int> & cpus) {
+		this-> _affinity = cpus;
+		return this-> _cgroup.setAffinity (cpus);
+	    }
+
+	    const std::vector <unsigned int> & LibvirtVCPUController::getAffinity () const {
+		return this-> _affinity;
+	    }
+
+	    unsigned int LibvirtVCPUController::readCpu () {
+		return this-> _cgroup.readCpu ();
+	    }
+
 	    /**
 	     * ================================================================================
 	     * ================================================================================
@@ -178,6 +273,11 @@ namespace monitor {
 		j["cycles"] = this-> getAbsoluteConsumption ();
 		j["capping"] = this-> getQuota ();
 		j["frequency"] = this-> _lastFrequency;
+		if (this-> _counting) {
+		    j["instructions"] = this-> _counters.instructions;
+		    j["ipc"] = this-> getIPC ();
+		    j["llc-misses"] = this-> _counters.llcMisses;
+		}
 
 		return j;
 	    }	    
@@ -190,34 +290,8 @@ namespace monitor {
 	     * ================================================================================
 	     */
 	    
-	    void LibvirtVCPUController::addToHistory () {		
-		this-> _history.push_back (this-> getPercentageConsumption ());
-		if (this-> _history.size () > this-> _maxHistory) {
-		    this-> _history.erase (this-> _history.begin ());
-		}
-	    
-		if (this-> _history.size () == this-> _maxHistory) this-> computeSlope ();
-	    }
-
-	    void LibvirtVCPUController::computeSlope () {
-		double sum_x = 0;
-		double sum_y = 0;
-
-		for (int x = 0; x < this-> _history.size () ; x++) {
-		    sum_y += this-> _history [x];
-		    sum_x += x;
-		}
-		
-		auto m_x = sum_x / (double) (this-> _history.size ());
-		auto m_y = sum_y / (double) (this-> _history.size ());
-
-		double ss_x = 0.0, sp = 0.0;
-		for (int x = 0 ; x < this-> _history.size (); x++) {
-		    ss_x += (x - m_x) * (x - m_x);
-		    sp += (x - m_x) * (this-> _history [x] - m_y);
-		}
-
-		this-> _slope = sp / ss_x;
+	    void LibvirtVCPUController::addToHistory () {
+		this-> _history.push (this-> getPercentageConsumption ());
 	    }
 
 	}
@@ -5,6 +5,7 @@
 #include <monitor/concurrency/timer.hh>
 #include <nlohmann/json.hpp>
 #include <monitor/libvirt/controller/cgroup.hh>
+#include <monitor/libvirt/controller/history.hh>
 
 namespace monitor {
     
@@ -51,6 +52,9 @@ namespace monitor {
 		/// The actual quota of the vm cpu domain in microseconds (allowed micro seconds / seconds = period * quota)
 		unsigned long _quota = -1;
 
+		/// The cpus allowed to run the vcpu (empty if all)
+		std::vector <unsigned int> _affinity;
+
 		/**
 		 * ================================================================================
 		 * ================================================================================
@@ -60,13 +64,7 @@ namespace monitor {
 		 */
 		
 		/// The history in used percentage of the maximum consumption
-		std::vector <float> _history;		
-
-		/// The maximum length of the history 
-		int _maxHistory;
-
-		/// The slope of the history
-		double _slope = 0;
+		history _history;
 
 		/// The sum of the frequency during the last micro ticks
 		unsigned long _sumFrequency;
@@ -89,6 +87,26 @@ namespace monitor {
 		/// The consumption of the vcpu during the last macro tick
 		unsigned long _consumption = 0;		
 
+		/**
+		 * ================================================================================
+		 * ================================================================================
+		 * =========================           COUNTERS           =========================
+		 * ================================================================================
+		 * ================================================================================
+		 */
+
+		/// True iif the backend counts the cycles and instructions of the vcpu
+		bool _counting = false;
+
+		/// The counters read at the last micro tick
+		HostBackend::counters _lastCounters;
+
+		/// The counters during the last micro ticks
+		HostBackend::counters _sumCounters;
+
+		/// The counters during the last macro tick
+		HostBackend::counters _counters;
+
 		/**
 		 * ================================================================================
 		 * ================================================================================
@@ -158,6 +176,16 @@ namespace monitor {
 		 */
 		void update (const std::vector <unsigned int> & cpuFrequency) ;
 
+		/**
+		 * Update the information of the cpu with a sample that was not read from the cgroup
+		 * @info: used instead of update by the simulator, whose vcpus have no cgroup
+		 * @params:
+		 *    - consumption: the cpu time consumed by the vcpu since the last update in microseconds
+		 *    - delta: the duration since the last update in seconds
+		 *    - frequency: the frequency of the cpu running the vcpu
+		 */
+		void feed (unsigned long consumption, float delta, unsigned int frequency);
+
 		/**
 		 * Update the mean informations of the vcpu		 
 		 */
@@ -171,6 +199,11 @@ namespace monitor {
 		 * ================================================================================
 		 */
 		
+		/**
+		 * @returns: the id of the vcpu in its VM
+		 */
+		int getId () const;
+
 		/**
 		 * @returns: the cpu consumption conmputed in the last update tick
 		 */	       
@@ -221,10 +254,53 @@ namespace monitor {
 		 */
 		unsigned long getNominalFreq () const;
 
+		/**
+		 * @returns: true iif the backend counts the cycles and instructions of the vcpu
+		 */
+		bool hasCounters () const;
+
+		/**
+		 * @returns: the cycles executed by the vcpu in the last macro tick (0 if the backend does not count)
+		 */
+		unsigned long getCycles () const;
+
+		/**
+		 * @returns: the instructions retired by the vcpu in the last macro tick (0 if the backend does not count)
+		 */
+		unsigned long getInstructions () const;
+
+		/**
+		 * @returns: the instructions per cycle of the vcpu in the last macro tick (0 if unknown)
+		 */
+		float getIPC () const;
+
+		/**
+		 * @returns: the mean frequency of the cpus while they were running the vcpu in the last macro tick in KHz (cycles / cpu time, 0 if unknown)
+		 * @info: unlike getFrequency, this frequency is not weighted by the usage of the vcpu
+		 */
+		unsigned long getDeliveredFrequency () const;
+
+		/**
+		 * @returns: the cycles executed by the vcpu in the last macro tick, counted by the backend, or estimated with the frequency of the cpus that ran it
+		 */
+		unsigned long getDeliveredCycles () const;
+
 		/**
 		 * @returns: the context of the vcpu
 		 */
 		LibvirtVM & vm ();
+
+		/**
+		 * @returns: the history of consumption of the vcpu (in percentage of the maximum consumption)
+		 */
+		const std::vector <float> & getHistory () const;
+
+		/**
+		 * Restore the history of a previous run of the monitor (and the slope associated to it)
+		 * @params:
+		 *   - history: the history of consumption (only the last maxHistory values are kept)
+		 */
+		void restoreHistory (const std::vector <float> & history);
 		
 		/**
 		 * ================================================================================
@@ -248,6 +324,24 @@ namespace monitor {
 		 */
 		void unlimit ();
 
+		/**
+		 * Pin the vcpu on a set of cpus
+		 * @params:
+		 *   - cpus: the cpus allowed to run the vcpu (all the cpus if empty)
+		 * @returns: false if the vcpu could not be pinned (the affinity is still recorded)
+		 */
+		bool setAffinity (const std::vector <unsigned int> & cpus);
+
+		/**
+		 * @returns: the cpus allowed to run the vcpu (empty if all)
+		 */
+		const std::vector <unsigned int> & getAffinity () const;
+
+		/**
+		 * @returns: the cpu that ran the vcpu last (read in the host, 0 if the vcpu has no cgroup)
+		 */
+		unsigned int readCpu ();
+
 
 		/**
 		 * ================================================================================
@@ -287,11 +381,6 @@ namespace monitor {
 		 * Add a value to the end of the history
 		 */
 		void addToHistory ();
-
-		/**
-		 * Compute the slope of the history
-		 */
-		void computeSlope ();
 				
 	    };	    
 	    
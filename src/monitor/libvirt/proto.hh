@@ -15,6 +15,9 @@ namespace monitor {
 	    IP, // Ask or Send the ip of a VM, (different action for server or client)
 	    NAT, // Ask an new port opening
 	    RESET_COUNTERS, // Reset the markets counters
+	    STATS, // Ask or Send the last market and monitoring information of the host
+	    SUMMARY, // Ask or Send the supply and demand of the cpu market of the host (cluster coordinator)
+	    ADOPT, // Hand over a VM migrated from another host (migration orchestrator)
 	};
 
 	enum VMProtocolError {
@@ -10,7 +10,11 @@ namespace monitor {
 
     namespace libvirt {
 
-	LibvirtVM::LibvirtVM (const utils::config::dict & cfg)
+	LibvirtVM::LibvirtVM (const utils::config::dict & cfg) :
+	    _spec (cfg),
+	    _cpuController (*this),
+	    _memoryController (*this),
+	    _ioController (*this)
 	{
 	    auto inner = cfg.get <utils::config::dict> ("vm");
 	    this-> _id = inner.get<std::string> ("name");
@@ -21,12 +25,14 @@ namespace monitor {
 	    this-> _mem = inner.getOr <int> ("memory", 2048);
 	    this-> _freq = inner.getOr<int> ("frequency", 1000);
 	    this-> _memorySLA = inner.getOr <float> ("memorySLA", 0.5);
+	    this-> _diskBandwidth = inner.getOr <int> ("disk-bandwidth", 50) * 1024;
+	    this-> _diskIops = inner.getOr <int> ("disk-iops", 500);
+	    this-> _netBandwidth = inner.getOr <int> ("net-bandwidth", 50) * 1024;
 	    
 	    std::filesystem::path home = getenv ("HOME");	    
 	    this-> _pubKey = inner.getOr <std::string> ("ssh_key", "");
 
 	    this-> _dom = nullptr;
-	    this-> _money = 0;
 
 	    for (int i = 0 ; i < this-> _vcpus ; i++) {
 		this-> _vcpuControllers.push_back (control::LibvirtVCPUController (i, *this));
@@ -40,13 +46,18 @@ namespace monitor {
 	    _disk (10000),
 	    _vcpus (1),
 	    _mem (2048),
-	    _memorySLA (0.5)
+	    _memorySLA (0.5),
+	    _diskBandwidth (51200),
+	    _diskIops (500),
+	    _netBandwidth (51200),
+	    _cpuController (*this),
+	    _memoryController (*this),
+	    _ioController (*this)
 	{
 	    std::filesystem::path home = getenv ("HOME");	    
 	    this-> pubKey (home / ".ssh/id_rsa.pub");
 
 	    this-> _dom = nullptr;
-	    this-> _money = 0;
 	    
 	    for (int i = 0 ; i < this-> _vcpus ; i++) {
 		this-> _vcpuControllers.push_back (control::LibvirtVCPUController (i, *this));
@@ -57,6 +68,10 @@ namespace monitor {
 	    return this-> _id;
 	}
 
+	const utils::config::dict & LibvirtVM::spec () const {
+	    return this-> _spec;
+	}
+
 	LibvirtVM & LibvirtVM::qcow (const std::filesystem::path & path) {
 	    this-> _qcow = path;
 	    return *this;
@@ -153,6 +168,18 @@ namespace monitor {
 	    return *this;
 	}
 
+	unsigned long LibvirtVM::diskBandwidth () const {
+	    return this-> _diskBandwidth;
+	}
+
+	unsigned long LibvirtVM::diskIops () const {
+	    return this-> _diskIops;
+	}
+
+	unsigned long LibvirtVM::netBandwidth () const {
+	    return this-> _netBandwidth;
+	}
+
 	/**
 	 * ================================================================================
 	 * ================================================================================
@@ -169,6 +196,30 @@ namespace monitor {
 	    return this-> _vcpuControllers;
 	}
 
+	const control::LibvirtCPUController & LibvirtVM::getCPUController () const {
+	    return this-> _cpuController;
+	}
+
+	control::LibvirtCPUController & LibvirtVM::getCPUController () {
+	    return this-> _cpuController;
+	}
+
+	const control::LibvirtMemoryController & LibvirtVM::getMemoryController () const {
+	    return this-> _memoryController;
+	}
+
+	control::LibvirtMemoryController & LibvirtVM::getMemoryController () {
+	    return this-> _memoryController;
+	}
+
+	const control::LibvirtIOController & LibvirtVM::getIOController () const {
+	    return this-> _ioController;
+	}
+
+	control::LibvirtIOController & LibvirtVM::getIOController () {
+	    return this-> _ioController;
+	}
+
 	/**
 	 * ================================================================================
 	 * ================================================================================
@@ -177,12 +228,7 @@ namespace monitor {
 	 * ================================================================================
 	 */
 
-	unsigned long & LibvirtVM::money () {
-	    return this-> _money;
-	}
-
 	void LibvirtVM::applyMarketAllocation (unsigned long period) {
-	    // logging::info ("VM Money :", this-> _id, this-> _money);
 	    for (auto & c : this-> _vcpuControllers) {
 		c.setQuota (c.allocated (), period);
 	    }
@@ -5,6 +5,9 @@
 #include <libvirt/libvirt.h>
 #include <monitor/utils/config.hh>
 #include <monitor/libvirt/controller/vcpu.hh>
+#include <monitor/libvirt/controller/cpu.hh>
+#include <monitor/libvirt/controller/memory.hh>
+#include <monitor/libvirt/controller/io.hh>
 
 namespace monitor {
 
@@ -20,6 +23,12 @@ namespace monitor {
 
 	    /// The domain of the VM in libvirt
 	    virDomainPtr _dom;
+
+	    /// The backend of the host used by the cpu controllers (set by the client, nullptr if the VM is not on a host)
+	    control::HostBackend * _backend = nullptr;
+
+	    /// The configuration used to create the VM (empty if the VM was not created from a configuration)
+	    utils::config::dict _spec;
 	    
 	    /// The id of the vm
 	    std::string _id;
@@ -48,6 +57,15 @@ namespace monitor {
 	    /// The sla of the memory (% of guarantee of the VM before swap)
 	    /// For example, 2GB VM, with SLA of 0.5, 1GB is guaranteed, and the other may swap
 	    float _memorySLA;
+
+	    /// The disk bandwidth guaranteed to the VM in KB/s
+	    unsigned long _diskBandwidth;
+
+	    /// The disk operations per second guaranteed to the VM
+	    unsigned long _diskIops;
+
+	    /// The network bandwidth guaranteed to the VM in KB/s
+	    unsigned long _netBandwidth;
 	    
 	    /// The ip address of the VM
 	    std::string _ip;
@@ -58,21 +76,22 @@ namespace monitor {
 	    /// The list of vcpu of the VM
 	    std::vector <control::LibvirtVCPUController> _vcpuControllers;
 
-	    /**
-	     * ================================================================================
-	     * ================================================================================
-	     * =========================            MARKET            =========================
-	     * ================================================================================
-	     * ================================================================================
-	     */
-	    
-	    /// The money of the VM
-	    unsigned long _money;
-	    
+	    /// The cpu controller of the whole VM (used by the VM level cpu market)
+	    control::LibvirtCPUController _cpuController;
+
+	    /// The memory controller of the VM
+	    control::LibvirtMemoryController _memoryController;
+
+	    /// The io controller of the VM
+	    control::LibvirtIOController _ioController;
+
 	public:
 
 	    friend LibvirtClient;
 	    friend control::LibvirtVCPUController;
+	    friend control::LibvirtCPUController;
+	    friend control::LibvirtMemoryController;
+	    friend control::LibvirtIOController;
 
 	    /**
 	     * @params: 
@@ -101,6 +120,11 @@ namespace monitor {
 	     */
 	    const std::string & id () const;
 
+	    /**
+	     * @returns: the configuration used to create the VM
+	     */
+	    const utils::config::dict & spec () const;
+
 	    /**
 	     * Set the path of the qcow image to use
 	     * @params: 
@@ -223,6 +247,21 @@ namespace monitor {
 	     *   - frq: the new frequence
 	     */
 	    LibvirtVM & freq (int frq);
+
+	    /**
+	     * @returns: the disk bandwidth guaranteed to the VM (in KB/s)
+	     */
+	    unsigned long diskBandwidth () const;
+
+	    /**
+	     * @returns: the disk operations per second guaranteed to the VM
+	     */
+	    unsigned long diskIops () const;
+
+	    /**
+	     * @returns: the network bandwidth guaranteed to the VM (in KB/s)
+	     */
+	    unsigned long netBandwidth () const;
 	    
 	    /**
 	     * ================================================================================
@@ -236,6 +275,18 @@ namespace monitor {
 
 	    std::vector <control::LibvirtVCPUController> & getVCPUControllers ();
 
+	    const control::LibvirtCPUController & getCPUController () const;
+
+	    control::LibvirtCPUController & getCPUController ();
+
+	    const control::LibvirtMemoryController & getMemoryController () const;
+
+	    control::LibvirtMemoryController & getMemoryController ();
+
+	    const control::LibvirtIOController & getIOController () const;
+
+	    control::LibvirtIOController & getIOController ();
+
 
 	    /**
 	     * ================================================================================
@@ -245,11 +296,6 @@ namespace monitor {
 	     * ================================================================================
 	     */
 
-	    /**
-	     * @returns: the money of the VM	      
-	     */
-	    unsigned long & money ();
-
 	    /**
 	     * Apply the vcpu allocation computed by a market
 	     */
@@ -1,6 +1,9 @@
 #include <monitor/net/addr.hh>
 #include <monitor/utils/tokenizer.hh>
 #include <monitor/utils/exception.hh>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <string.h>
 
 union Packer {
     unsigned char pack [4];
@@ -25,6 +28,23 @@ namespace monitor {
 	{	    
 	}
 
+	Ipv4Address Ipv4Address::resolve (const std::string & host) {
+	    addrinfo hints;
+	    memset (&hints, 0, sizeof (addrinfo));
+	    hints.ai_family = AF_INET;
+	    hints.ai_socktype = SOCK_STREAM;
+
+	    addrinfo * res = nullptr;
+	    if (getaddrinfo (host.c_str (), nullptr, &hints, &res) != 0 || res == nullptr) {
+		throw utils::addr_error ("Cannot resolve host : " + host);
+	    }
+
+	    auto ret = Ipv4Address ((int) ((sockaddr_in*) res-> ai_addr)-> sin_addr.s_addr);
+	    freeaddrinfo (res);
+	    
+	    return ret;
+	}
+
 	unsigned int Ipv4Address::toN () const {
 	    Packer p;
 	    p.pack [0] = this-> _a;
@@ -74,6 +94,17 @@ namespace monitor {
 	    this-> _port = port;	    
 	}
 
+	unsigned short SockAddrV4::parsePort (const std::string & port) {
+	    if (port.empty () || port.length () > 5 || port.find_first_not_of ("0123456789") != std::string::npos) {
+		throw utils::addr_error ("Malformed port : " + port);
+	    }
+
+	    auto n = std::atoi (port.c_str ());
+	    if (n < 1 || n > 65535) throw utils::addr_error ("Port out of range : " + port);
+
+	    return (unsigned short) n;
+	}
+
 	Ipv4Address SockAddrV4::ip () const {
 	    return this-> _addr;
 	}
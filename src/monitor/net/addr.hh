@@ -23,6 +23,13 @@ namespace monitor {
 
 	    Ipv4Address (unsigned char a, unsigned char b, unsigned char c, unsigned char d);
 
+	    /**
+	     * Resolve a host name (or a dotted ip) into an ipv4 address
+	     * @throws: 
+	     *   - utils::addr_error: if the host cannot be resolved
+	     */
+	    static Ipv4Address resolve (const std::string & host);
+
 
 	    /**
 	     * Store the four part of the ip A.B.C.D in a single u64 (A << 24 | B << 16 | C << 8 | D)
@@ -48,6 +55,13 @@ namespace monitor {
 	    SockAddrV4 (Ipv4Address addr, unsigned short port);
 
 	    SockAddrV4 (const std::string & addr);
+
+	    /**
+	     * Parse a port number
+	     * @throws:
+	     *   - utils::addr_error: if the port is not a number in [1, 65535]
+	     */
+	    static unsigned short parsePort (const std::string & port);
 	    
 	    Ipv4Address ip () const;
 
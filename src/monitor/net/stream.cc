@@ -6,7 +6,12 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
 #include <monitor/utils/log.hh>
+#include <monitor/utils/exception.hh>
 
 namespace monitor {
 
@@ -24,12 +29,12 @@ namespace monitor {
 	{
 	}
 
-	void TcpStream::connect () {
+	void TcpStream::connect (float timeout) {
 	    this-> close ();
 	    this-> _sockfd = socket (AF_INET, SOCK_STREAM, 0);
 	    if (this-> _sockfd == -1) {
-		std::cout << "Error creating socket" << std::endl;
-		exit (-1);
+		this-> _sockfd = 0;
+		throw utils::socket_error ("Error creating socket");
 	    }
 
 	    sockaddr_in sin = { 0 };
@@ -37,12 +42,60 @@ namespace monitor {
 	    sin.sin_port = htons(this-> _addr.port ());
 	    sin.sin_family = AF_INET;
 
+	    if (timeout < 0.0f) {
+		if (::connect (this-> _sockfd, (sockaddr*) &sin, sizeof (sockaddr_in)) != 0) {
+		    this-> close ();
+		    throw utils::socket_error (std::string ("Error connecting socket : ") + strerror (errno));
+		}
+		return;
+	    }
+
+	    // Non blocking connection, so we can give up after timeout instead of waiting for the kernel (can be minutes)
+	    auto flags = fcntl (this-> _sockfd, F_GETFL, 0);
+	    fcntl (this-> _sockfd, F_SETFL, flags | O_NONBLOCK);
 	    if (::connect (this-> _sockfd, (sockaddr*) &sin, sizeof (sockaddr_in)) != 0) {
-		std::cout << "Error connecting socket" << std::endl;
-		exit (-1);
-	    }	    
+		if (errno != EINPROGRESS) {
+		    auto err = errno;
+		    this-> close ();
+		    throw utils::socket_error (std::string ("Error connecting socket : ") + strerror (err));
+		}
+
+		pollfd pfd = { this-> _sockfd, POLLOUT, 0 };
+		auto r = poll (&pfd, 1, (int) (timeout * 1000.0f));
+		if (r == 0) {
+		    this-> close ();
+		    throw utils::socket_error ("Connection timed out");
+		}
+
+		int err = 0;
+		socklen_t len = sizeof (int);
+		if (r < 0 || getsockopt (this-> _sockfd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+		    this-> close ();
+		    throw utils::socket_error (std::string ("Error connecting socket : ") + strerror (err != 0 ? err : errno));
+		}
+	    }
+	    fcntl (this-> _sockfd, F_SETFL, flags);
+
+	    // The send/receive operations fail instead of blocking forever on a dead peer
+	    this-> setTimeout (timeout);
+	}
+
+	void TcpStream::setTimeout (float timeout) {
+	    if (this-> _sockfd == 0) return;
+
+	    timeval tv = { 0, 0 }; // zero means blocking
+	    if (timeout >= 0.0f) {
+		tv.tv_sec = (long) timeout;
+		tv.tv_usec = (long) ((timeout - (float) tv.tv_sec) * 1000000.0f);
+	    }
+
+	    setsockopt (this-> _sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (timeval));
+	    setsockopt (this-> _sockfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (timeval));
+	}
+
+	bool TcpStream::isOpen () const {
+	    return this-> _sockfd != 0;
 	}
-	
 	
 	bool TcpStream::sendInt (unsigned long i) {
 	    if (this-> _sockfd != 0) {
@@ -69,16 +122,18 @@ namespace monitor {
 
 	std::string TcpStream::receive (unsigned long len) {
 	    if (this-> _sockfd != 0) {
-		auto buf = new char [len + 1];
-
-		auto r = read (this-> _sockfd, buf, len * sizeof (char));
-		if (r == -1) {
-		    this-> _sockfd = 0;
-		} else buf [r] = '\0';
-		
-		auto ret = std::string (buf);
-		delete buf;
+		std::string ret (len, '\0');
+		unsigned long done = 0;
+		while (done < len) {
+		    auto r = read (this-> _sockfd, ret.data () + done, (len - done) * sizeof (char));
+		    if (r <= 0) { // error, timeout or closed by the peer
+			this-> close ();
+			break;
+		    }
+		    done += r;
+		}
 
+		ret.resize (done);
 		return ret;
 	    }
 
@@ -89,8 +144,9 @@ namespace monitor {
 	    unsigned long res = 0;
 	    if (this-> _sockfd != 0) {
 		auto r = read (this-> _sockfd, &res, sizeof (unsigned long));
-		if (r == -1) {
-		    this-> _sockfd = 0;
+		if (r != sizeof (unsigned long)) {
+		    this-> close ();
+		    res = 0;
 		}
 	    }
 
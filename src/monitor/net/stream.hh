@@ -59,8 +59,24 @@ namespace monitor {
 	     * Connect the stream as a client
 	     * @info: use the addr given in the constructor
 	     * @warning: close the current stream if connected to something
+	     * @params: 
+	     *   - timeout: the maximal time in seconds to wait for the connection, and for each send/receive afterward (negative means blocking)
+	     * @throws: 
+	     *   - utils::socket_error: if the connection failed or timed out
+	     */
+	    void connect (float timeout = -1.0f);
+
+	    /**
+	     * Change the maximal time of each send/receive of a connected stream
+	     * @params:
+	     *   - timeout: the time in seconds (negative means blocking)
+	     */
+	    void setTimeout (float timeout);
+
+	    /**
+	     * @returns: true iif the stream is connected, and no error occured on it
 	     */
-	    void connect ();	    
+	    bool isOpen () const;
 	    
 	    /**
 	     * Close the stream if connected
@@ -91,6 +107,7 @@ namespace monitor {
 	    
 	    /**
 	     * Receive a message from the stream
+	     * @info: wait until the whole message is received, or the stream fails
 	     * @params: 
 	     *   - size: the size of the string to receive
 	     */
@@ -0,0 +1,67 @@
+#include <monitor/utils/arena.hh>
+#include <cstring>
+#include <cstdint>
+
+namespace monitor {
+
+    namespace utils {
+
+	arena::arena (std::size_t blockSize) :
+	    _blockSize (blockSize),
+	    _used (0),
+	    _capacity (0),
+	    _size (0)
+	{}
+
+	void * arena::allocate (std::size_t size, std::size_t align) {
+	    auto current = this-> _blocks.size () == 0 ? 0 : reinterpret_cast <std::uintptr_t> (this-> _blocks.back ()) + this-> _used;
+	    auto padding = current % align == 0 ? 0 : align - (current % align);
+
+	    if (this-> _blocks.size () == 0 || this-> _used + padding + size > this-> _capacity) {
+		// new block, big allocations get their own block, so the current one is not wasted
+		auto capacity = std::max (this-> _blockSize, size + align);
+		if (capacity > this-> _blockSize && this-> _blocks.size () != 0) {
+		    auto block = new char [capacity];
+		    this-> _blocks.insert (this-> _blocks.end () - 1, block);
+		    this-> _size += size;
+
+		    auto addr = reinterpret_cast <std::uintptr_t> (block);
+		    return block + (addr % align == 0 ? 0 : align - (addr % align));
+		}
+
+		this-> _blocks.push_back (new char [capacity]);
+		this-> _capacity = capacity;
+		this-> _used = 0;
+
+		current = reinterpret_cast <std::uintptr_t> (this-> _blocks.back ());
+		padding = current % align == 0 ? 0 : align - (current % align);
+	    }
+
+	    auto ret = this-> _blocks.back () + this-> _used + padding;
+	    this-> _used += padding + size;
+	    this-> _size += size;
+
+	    return ret;
+	}
+
+	std::string_view arena::store (std::string_view str) {
+	    auto mem = reinterpret_cast <char*> (this-> allocate (str.length () + 1, 1));
+	    memcpy (mem, str.data (), str.length ());
+	    mem [str.length ()] = '\0';
+
+	    return std::string_view (mem, str.length ());
+	}
+
+	std::size_t arena::size () const {
+	    return this-> _size;
+	}
+
+	arena::~arena () {
+	    for (auto & b : this-> _blocks) {
+		delete [] b;
+	    }
+	}
+
+    }
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+
+namespace monitor {
+
+    namespace utils {
+
+	/**
+	 * A bump allocator, the memory is released all at once when the arena is destroyed
+	 * It is used to build trees of small values (e.g. configurations) without an allocation per node
+	 * @warning: only trivially destructible values can be allocated in an arena (their dtor is never called)
+	 */
+	class arena {
+
+	    /// The allocated blocks
+	    std::vector <char*> _blocks;
+
+	    /// The size of a block (bigger allocations get their own block)
+	    std::size_t _blockSize;
+
+	    /// The number of bytes used in the last block
+	    std::size_t _used;
+
+	    /// The capacity of the last block
+	    std::size_t _capacity;
+
+	    /// The number of bytes allocated by the user
+	    std::size_t _size;
+
+	public :
+
+	    /**
+	     * @params:
+	     *    - blockSize: the size of the blocks allocated when the current one is full
+	     */
+	    arena (std::size_t blockSize = 4096);
+
+	    arena (const arena &) = delete;
+
+	    const arena & operator= (const arena &) = delete;
+
+	    /**
+	     * Allocate raw memory inside the arena
+	     * @params:
+	     *   - size: the number of bytes
+	     *   - align: the alignment of the memory
+	     */
+	    void * allocate (std::size_t size, std::size_t align = alignof (std::max_align_t));
+
+	    /**
+	     * Construct a value inside the arena
+	     */
+	    template <typename T, typename ... A>
+	    T * make (A&&... args) {
+		static_assert (std::is_trivially_destructible <T>::value, "arena values are never destroyed");
+		return new (this-> allocate (sizeof (T), alignof (T))) T (std::forward<A> (args)...);
+	    }
+
+	    /**
+	     * Allocate an array of default constructed values inside the arena
+	     */
+	    template <typename T>
+	    T * makeArray (std::size_t nb) {
+		static_assert (std::is_trivially_destructible <T>::value, "arena values are never destroyed");
+		auto mem = reinterpret_cast <T*> (this-> allocate (sizeof (T) * (nb == 0 ? 1 : nb), alignof (T)));
+		for (std::size_t i = 0 ; i < nb ; i++) new (mem + i) T ();
+		return mem;
+	    }
+
+	    /**
+	     * Copy a string inside the arena
+	     * @info: the copy is null terminated
+	     * @returns: a view on the copy, valid as long as the arena is alive
+	     */
+	    std::string_view store (std::string_view str);
+
+	    /**
+	     * @returns: the number of bytes allocated by the user
+	     */
+	    std::size_t size () const;
+
+	    /**
+	     * Free all the blocks
+	     */
+	    ~arena ();
+
+	};
+
+    }
+
+}
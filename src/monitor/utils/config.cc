@@ -1,5 +1,4 @@
 #include <monitor/utils/config.hh>
-#include <gc/gc.h>
 #include <sstream>
 #include <istream>
 #include <fstream>
@@ -9,139 +8,126 @@ namespace monitor {
     namespace utils {
 
 	using namespace std;
-	
+
 
 	namespace config {
 
-	    
+	    std::string name (kind type) {
+		switch (type) {
+		case kind::BOOL : return "bool";
+		case kind::INT : return "long";
+		case kind::FLOAT : return "float";
+		case kind::STRING : return "string";
+		case kind::ARRAY : return "array";
+		case kind::DICT : return "dict";
+		}
+
+		return "unmanaged";
+	    }
+
 	    /***
 	     * ========================================================================
 	     * ========================================================================
-	     * =========================          array           =====================
+	     * =========================          value           =====================
 	     * ========================================================================
 	     * ========================================================================
 	     */
 
-	    array::array () {}
+	    value::value (kind type, int line) :
+		type (type),
+		line (line),
+		dic {nullptr, 0}
+	    {}
 
-	    
-	    array::array (const array & other) {
-		other.clone_content (this-> _types, this-> _content);
+	    std::string_view value::str () const {
+		return std::string_view (this-> s.data, this-> s.len);
 	    }
 
-	    const array & array::operator= (const array& other) {
-		this-> clear ();
-		other.clone_content (this-> _types, this-> _content);
-		return other;
-	    }
+	    const value * value::find (std::string_view key) const {
+		if (this-> type != kind::DICT) return nullptr;
 
-	    int array::size () const {
-		return this-> _content.size ();
-	    }
-
-	    const std::vector <std::string> & array::types () const {
-		return this-> _types;
-	    }
-	    
-	    int array::get_int (unsigned int i) const {	
-		if (i >= this-> _content.size ()) {
-		    std::stringstream ss;
-		    ss << "Out of array : " << i << " > " << this-> _content.size ();
-		    throw config_error (0, ss.str ());
-		} else if (this-> _types [i] == typeid (float).name ()) {
-		    return static_cast <long> (* (reinterpret_cast <float*> (this-> _content [i])));
-		} else if (this-> _types [i] != typeid (long).name ()) {			
-		    throw config_error (0, "Incompatible types : " + this-> _types [i] + "  and " + typeid (long).name ());
+		std::size_t beg = 0, end = this-> dic.size;
+		while (beg < end) {
+		    auto mid = (beg + end) / 2;
+		    auto cmp = this-> dic.items [mid].key.compare (key);
+		    if (cmp == 0) return this-> dic.items [mid].val;
+		    else if (cmp < 0) beg = mid + 1;
+		    else end = mid;
 		}
-		return * (reinterpret_cast <long*> (this-> _content [i]));
-	    }
 
-	    float array::get_float (unsigned int i) const {
-		if (i >= this-> _content.size ()) {
-		    std::stringstream ss;
-		    ss << "Out of array : " << i << " > " << this-> _content.size ();
-		    throw config_error (0, ss.str ());
-		} else if (this-> _types [i] == typeid (long).name ()) {
-		    return static_cast <float> (* (reinterpret_cast <long*> (this-> _content [i])));
-		} else if (this-> _types [i] != typeid (float).name ()) {			
-		    throw config_error (0, "Incompatible types : " + this-> _types [i] + "  and " + typeid (float).name ());
-		}
-		return * (reinterpret_cast <float*> (this-> _content [i]));
+		return nullptr;
 	    }
 
-	
-	    void array::print (std::ostream & stream) const {
-		stream << "[";
-		for (auto i : utils::range (0, this-> _content.size ())) {
-		    if (i != 0)
-			stream << ", ";
-		    if (this-> _types [i] == typeid (float).name ()) {
-			stream << "float(" << *(reinterpret_cast<float*> (this-> _content [i])) << ")";
-		    } else if (this-> _types [i] == typeid (long).name ()) {
-			stream << "long(" << *(reinterpret_cast<long*> (this-> _content [i])) << ")";
-		    } else if (this-> _types [i] == typeid (std::string).name ()) {
-			stream << "str(" << *(reinterpret_cast<std::string*> (this-> _content [i])) << ")";
-		    } else if (this-> _types [i] == typeid (bool).name ()) {
-			stream << "bool(" << *(reinterpret_cast<bool*> (this-> _content [i])) << ")";
-		    } else if (this-> _types [i] == typeid (array).name ()) {
-			(reinterpret_cast<array*> (this-> _content [i]))-> print (stream);
-		    } else if (this-> _types [i] == typeid (dict).name ()) {
-			(reinterpret_cast<dict*> (this-> _content [i]))-> print (stream);
-		    } else {
-			stream << "unmanaged";
+	    /**
+	     * The empty array and dict, used by the default constructors
+	     */
+	    static const value EMPTY_ARRAY (kind::ARRAY, 0);
+	    static const value EMPTY_DICT (kind::DICT, 0);
+
+	    void print (std::ostream & stream, const value & v) {
+		switch (v.type) {
+		case kind::FLOAT : stream << "float(" << v.f << ")"; break;
+		case kind::INT : stream << "long(" << v.i << ")"; break;
+		case kind::STRING : stream << "str(" << v.str () << ")"; break;
+		case kind::BOOL : stream << "bool(" << v.b << ")"; break;
+		case kind::ARRAY : {
+		    stream << "[";
+		    for (std::size_t i = 0 ; i < v.arr.size ; i++) {
+			if (i != 0) stream << ", ";
+			print (stream, *v.arr.items [i]);
 		    }
+		    stream << "]";
+		} break;
+		case kind::DICT : {
+		    stream << "{";
+		    for (std::size_t i = 0 ; i < v.dic.size ; i++) {
+			if (i != 0) stream << ", ";
+			stream << v.dic.items [i].key << "=> ";
+			print (stream, *v.dic.items [i].val);
+		    }
+		    stream << "}";
+		} break;
 		}
-		stream << "]";
 	    }
 
-	    void array::push (void * value, const std::string & type) {
-		this-> _types.push_back (type);
-		this-> _content.push_back (value);
+	    /***
+	     * ========================================================================
+	     * ========================================================================
+	     * =========================          array           =====================
+	     * ========================================================================
+	     * ========================================================================
+	     */
+
+	    array::array () :
+		_node (&EMPTY_ARRAY)
+	    {}
+
+	    array::array (std::shared_ptr <const utils::arena> doc, const value * node) :
+		_doc (std::move (doc)),
+		_node (node)
+	    {}
+
+	    int array::size () const {
+		return this-> _node-> arr.size;
 	    }
-	    
-	    void array::clone_content (std::vector <std::string> & types, std::vector <void*> & content) const {
-		content.reserve (this-> _content.size ());
-		types.reserve (this-> _content.size ());
-		for (auto i : utils::range (0, this-> _content.size ())) {
-		    types.push_back (this-> _types [i]);
-		    if (this-> _types [i] == typeid (float).name ()) {
-			content.push_back (new  float (*(reinterpret_cast<float*> (this-> _content [i]))));
-		    } else if (this-> _types [i] == typeid (long).name ()) {
-			content.push_back (new  long (*(reinterpret_cast<long*> (this-> _content [i]))));
-		    } else if (this-> _types [i] == typeid (std::string).name ()) {
-			content.push_back (new  std::string (*(reinterpret_cast<std::string*> (this-> _content [i]))));
-		    } else if (this-> _types [i]== typeid (bool).name ()) {
-			content.push_back (new  bool (*(reinterpret_cast<bool*> (this-> _content [i]))));
-		    } else if (this-> _types [i] == typeid (array).name ()) {
-			content.push_back (new  array (*(reinterpret_cast<array*> (this-> _content [i]))));
-		    } else if (this-> _types [i] == typeid (dict).name ()) {
-			content.push_back (new  dict (*(reinterpret_cast<dict*> (this-> _content [i]))));
-		    }
-		}		
+
+	    kind array::type (unsigned int i) const {
+		return this-> at (i).type;
 	    }
 
-	    void array::clear () {
-		for (auto i : utils::range (0, this-> _content.size ())) {
-		    if (this-> _types [i] == typeid (std::string).name ()) {
-			(reinterpret_cast<std::string*> (this-> _content [i]))->~string ();
-		    } else if (this-> _types [i] == typeid (array).name ()) {
-			(reinterpret_cast<array*> (this-> _content [i]))-> clear ();
-		    } else if (this-> _types [i] == typeid (dict).name ()) {
-			(reinterpret_cast<dict*> (this-> _content [i]))-> clear ();
-		    } 
-		    
-		    delete (char*) this-> _content [i];		    
+	    const value & array::at (unsigned int i) const {
+		if (i >= this-> _node-> arr.size) {
+		    std::stringstream ss;
+		    ss << "Out of array : " << i << " > " << this-> _node-> arr.size;
+		    throw config_error (this-> _node-> line, ss.str ());
 		}
-		
-		this-> _types.clear ();
-		this-> _content.clear ();
-	    }
-	    
-	    
-	    array::~array () {
-		this-> clear ();
+
+		return *this-> _node-> arr.items [i];
 	    }
 
+	    void array::print (std::ostream & stream) const {
+		config::print (stream, *this-> _node);
+	    }
 
 	    /***
 	     * ========================================================================
@@ -151,186 +137,55 @@ namespace monitor {
 	     * ========================================================================
 	     */
 
-	    dict::dict () {
-	    }
+	    dict::dict () :
+		_node (&EMPTY_DICT)
+	    {}
 
-	    dict::dict (const dict & other) {
-		other.clone_content (this-> _types, this-> _content);
-	    }
-
-	    const dict & dict::operator= (const dict & other) {
-		this-> clear ();
-		other.clone_content (this-> _types, this-> _content);
-		
-		return other;
-	    }
+	    dict::dict (std::shared_ptr <const utils::arena> doc, const value * node) :
+		_doc (std::move (doc)),
+		_node (node)
+	    {}
 
 	    std::vector <std::string> dict::keys () const {
 		std::vector <std::string> keys;
-		for (auto & it : this-> _types) {
-		    keys.push_back (it.first);
+		keys.reserve (this-> _node-> dic.size);
+		for (std::size_t i = 0 ; i < this-> _node-> dic.size ; i++) {
+		    keys.push_back (std::string (this-> _node-> dic.items [i].key));
 		}
-		return keys;
-	    }
 
-	    const std::map <std::string, std::string> & dict::types () const {
-		return this-> _types;
+		return keys;
 	    }
 
-	    const std::map <std::string, void*> & dict::content () const {
-		return this-> _content;
+	    kind dict::type (const std::string & name) const {
+		return this-> at (name).type;
 	    }
 
-	    
-	    void dict::insert (const std::string & name, void* value, const std::string & type) {
-		this-> _types [name] = type;
-		this-> _content [name] = value;
+	    std::size_t dict::memory () const {
+		return this-> _doc == nullptr ? 0 : this-> _doc-> size ();
 	    }
 
-	    int dict::get_int (const std::string & name) const {
-		auto value = this-> _content.find (name);
-		if (value == this-> _content.end ()) {
-		    std::stringstream ss;
-		    ss << "Name : [" << name << "] not found in dictionnary ";
-		    this-> print (ss);
-		    throw config_error (0, ss.str ());
-		} else if (this-> _types.find (name)-> second == typeid (float).name ()) {
-		    return static_cast<long> (*(reinterpret_cast<float*> (value-> second)));
-		} else if (this-> _types.find (name)-> second != typeid (long).name ()) {
-		    throw config_error (0, "Incompatible types : " + this-> _types.find (name)-> second + " and " + std::string (typeid (long).name ()) + " for index [" + name + "]");
-		} else {
-		    return *(reinterpret_cast<long*> (value-> second));
-		}
-	    }
-		
-	    float dict::get_float (const std::string & name) const {
-		auto value = this-> _content.find (name);
-		if (value == this-> _content.end ()) {
+	    const value & dict::at (const std::string & name) const {
+		auto v = this-> _node-> find (name);
+		if (v == nullptr) {
 		    std::stringstream ss;
 		    ss << "Name : [" << name << "] not found in dictionnary ";
 		    this-> print (ss);
-		    throw config_error (0, ss.str ());
-		} else if (this-> _types.find (name)-> second == typeid (long).name ()) {
-		    return static_cast<float> (*(reinterpret_cast<long*> (value-> second)));
-		} else if (this-> _types.find (name)-> second != typeid (float).name ()) {
-		    throw config_error (0, "Incompatible types : " + this-> _types.find (name)-> second + " and " + std::string (typeid (long).name ()) + " for index [" + name + "]");
-		} else {
-		    return *(reinterpret_cast<float*> (value-> second));
+		    throw config_error (this-> _node-> line, ss.str ());
 		}
-	    }		
 
-	    bool dict::has_int (const std::string & name) const {
-		auto value = this-> _content.find (name);
-		if (value == this-> _content.end ()) return false;
-		return (this-> _types.find (name)-> second == typeid (long).name () || this-> _types.find (name)-> second == typeid (float).name ());
+		return *v;
 	    }
 
-	    bool dict::has_float (const std::string & name) const {
-		auto value = this-> _content.find (name);
-		if (value == this-> _content.end ()) return false;
-		return (this-> _types.find (name)-> second == typeid (long).name () || this-> _types.find (name)-> second == typeid (float).name ());
-	    }
-	    
-	    int dict::getOr_int (const std::string & name, int orVal) const {
-		auto value = this-> _content.find (name);
-		if (value == this-> _content.end ()) return orVal;
-		else if (this-> _types.find (name)-> second == typeid (float).name ()) {
-		    return static_cast<long> (*(reinterpret_cast<float*> (value-> second)));
-		} else if (this-> _types.find (name)-> second != typeid (long).name ()) {
-		    throw config_error (0, "Incompatible types : " + this-> _types.find (name)-> second + " and " + std::string (typeid (long).name ()) + " for index [" + name + "]");
-		} else {
-		    return *(reinterpret_cast<long*> (value-> second));
-		}
-	    }
-
-	    float dict::getOr_float (const std::string & name, float orVal) const {
-		auto value = this-> _content.find (name);
-		if (value == this-> _content.end ()) return orVal;
-		else if (this-> _types.find (name)-> second == typeid (long).name ()) {
-		    return static_cast<float> (*(reinterpret_cast<long*> (value-> second)));
-		} else if (this-> _types.find (name)-> second != typeid (float).name ()) {
-		    throw config_error (0, "Incompatible types : " + this-> _types.find (name)-> second + " and " + std::string (typeid (float).name ()) + " for index [" + name + "]");
-		} else {
-		    return *(reinterpret_cast<float*> (value-> second));
-		}
-	    }
-
-	    
-	    
 	    void dict::print (std::ostream & stream) const {
-		stream << "{";
-		int j = 0;
-		for (auto i : this-> _content) {
-		    if (j != 0)
-			stream << ", ";
-		    j += 1;
-		    if (this-> _types.find (i.first)-> second == typeid (float).name ()) {
-			stream << i.first << "=> float(" << *(reinterpret_cast<float*> (i.second)) << ")";
-		    } else if (this-> _types.find (i.first)-> second == typeid (long).name ()) {
-			stream << i.first << "=> long(" << *(reinterpret_cast<long*> (i.second)) << ")";
-		    } else if (this-> _types.find (i.first)-> second == typeid (std::string).name ()) {
-			stream << i.first << "=> str(" << *(reinterpret_cast<std::string*> (i.second)) << ")";
-		    } else if (this-> _types.find (i.first)-> second == typeid (bool).name ()) {
-			stream << i.first << "=> bool(" << *(reinterpret_cast<bool*> (i.second)) << ")";
-		    } else if (this-> _types.find (i.first)-> second == typeid (array).name ()) {
-			stream <<  i.first << "=> ";
-			(reinterpret_cast<array*> (i.second))-> print (stream);
-		    } else if (this-> _types.find (i.first)-> second == typeid (dict).name ()) {
-			stream <<  i.first << "=> ";
-			(reinterpret_cast<dict*> (i.second))-> print (stream);
-		    } else {
-			stream << "unmanaged";
-		    }
-		}
-		stream << "}";
+		config::print (stream, *this-> _node);
 	    }
 
-	    void dict::clone_content (std::map <std::string, std::string> & types, std::map <std::string, void*> & content) const {
-		for (auto it : this-> _content) {
-		    types [it.first] = this-> _types.find (it.first)-> second;
-		    if (this-> _types.find (it.first)-> second == typeid (float).name ()) {
-			content [it.first] = new  float (*(reinterpret_cast<float*> (it.second)));
-		    } else if (this-> _types.find (it.first)-> second == typeid (long).name ()) {
-			content [it.first] = new  long (*(reinterpret_cast<long*> (it.second)));
-		    } else if (this-> _types.find (it.first)-> second == typeid (std::string).name ()) {
-			content [it.first] = new  std::string (*(reinterpret_cast<std::string*> (it.second)));
-		    } else if (this-> _types.find (it.first)-> second == typeid (bool).name ()) {
-			content [it.first] = new  bool (*(reinterpret_cast<bool*> (it.second)));
-		    } else if (this-> _types.find (it.first)-> second == typeid (array).name ()) {
-			content [it.first] = new  array (*(reinterpret_cast<array*> (it.second)));
-		    } else if (this-> _types.find (it.first)-> second == typeid (dict).name ()) {
-			content [it.first] = new  dict (*(reinterpret_cast<dict*> (it.second)));
-		    }
-		}
-	    }	    
-
-	    void dict::clear () {
-		for (auto & it : this-> _content) {		    
-		    if (this-> _types.find (it.first)-> second == typeid (std::string).name ()) {
-			(reinterpret_cast<std::string*> (it.second))->~string ();
-		    } else if (this-> _types.find (it.first)-> second == typeid (array).name ()) {			
-			(reinterpret_cast<array*> (it.second))-> clear ();
-		    } else if (this-> _types.find (it.first)-> second == typeid (dict).name ()) {
-			(reinterpret_cast<dict*> (it.second))-> clear ();
-		    }
-			
-		    delete (char*) it.second;		
-		}
-		
-		this-> _types.clear ();
-		this-> _content.clear ();		
-	    }
-	    
-	    dict::~dict () {
-		this-> clear ();
-	    }
-	    
 	}
 
-	   
-	
+
+
     }
-           
+
 }
 
 
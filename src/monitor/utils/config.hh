@@ -2,8 +2,10 @@
 
 #include <map>
 #include <vector>
+#include <memory>
+#include <string_view>
 #include <typeinfo>
-#include <gc/gc.h>
+#include <type_traits>
 #include <cassert>
 #include <iostream>
 #include <sstream>
@@ -11,6 +13,7 @@
 #include <monitor/utils/tokenizer.hh>
 #include <monitor/utils/range.hh>
 #include <monitor/utils/exception.hh>
+#include <monitor/utils/arena.hh>
 
 namespace monitor {
 
@@ -21,202 +24,247 @@ namespace monitor {
 	    struct config_error : utils::exception {
 
 		int line;
-		
+
 		config_error (int line, const std::string & msg) :
 		    exception (msg),
 		    line (line)
 		    {}
-		
+
 	    };
 
-	    class array {
+	    /**
+	     * The type of a configuration value
+	     */
+	    enum class kind : char {
+		BOOL,
+		INT,
+		FLOAT,
+		STRING,
+		ARRAY,
+		DICT
+	    };
 
-	    private :
+	    /**
+	     * @returns: the name of the type (for error messages)
+	     */
+	    std::string name (kind type);
 
-		std::vector <std::string> _types;
-		std::vector <void*> _content;
+	    struct value;
 
-	    public :
+	    /**
+	     * An entry of a dict value, the entries of a dict are sorted by key
+	     */
+	    struct entry {
+		std::string_view key;
+		value * val;
+	    };
+
+	    /**
+	     * A configuration value (tagged union)
+	     * The values are allocated in the arena of their document, and never freed individually
+	     * The strings are views on memory owned by the same arena
+	     */
+	    struct value {
+
+		/// The type of the value
+		kind type;
+
+		/// The line of the value in the document
+		int line;
+
+		union {
+		    bool b;
+		    long i;
+		    float f;
+		    struct { const char * data; std::size_t len; } s;
+		    struct { value ** items; std::size_t size; } arr;
+		    struct { entry * items; std::size_t size; } dic;
+		};
+
+		value (kind type, int line);
+
+		/**
+		 * @returns: the content of a STRING value
+		 */
+		std::string_view str () const;
 
-		array ();
-		
 		/**
-		 * Deep copy
+		 * @returns: the value associated to key in a DICT value, nullptr if there is none
+		 * @complexity: O(log (n))
 		 */
-		array (const array& other);
+		const value * find (std::string_view key) const;
+
+	    };
+
+	    class dict;
+	    class array;
+
+	    namespace internal {
 
 		/**
-		 * Deep copy
+		 * @returns: true if a value of type 'type' can be read as a T
 		 */
-		const array& operator= (const array & other);
-		
 		template <typename T>
-		void push (const T * value) {
-		    this-> _types.push_back (typeid (T).name ());
-		    this-> _content.push_back (value);
+		bool compatible (kind type) {
+		    if constexpr (std::is_same <T, bool>::value) return type == kind::BOOL;
+		    else if constexpr (std::is_arithmetic <T>::value) return type == kind::INT || type == kind::FLOAT;
+		    else if constexpr (std::is_same <T, std::string>::value || std::is_same <T, std::string_view>::value) return type == kind::STRING;
+		    else if constexpr (std::is_same <T, dict>::value) return type == kind::DICT;
+		    else if constexpr (std::is_same <T, array>::value) return type == kind::ARRAY;
+		    else return false;
 		}
 
-		void push (void * value, const std::string & type);
-		
-		template <typename T> 
-		T get (unsigned int i) const {
-		    if constexpr (std::is_floating_point <T> ()) return get_float (i);
-		    if constexpr (std::is_signed<T> ()) return get_int (i);
-		    if (i >= this-> _content.size ()) {
-			std::stringstream ss;
-			ss << "Out of array : " << i << " > " << this-> _content.size ();
-			throw config_error (0, ss.str ());
-		    } else if (this-> _types [i] != typeid (T).name ()) {			
-			throw config_error (0, "Incompatible types : " + this-> _types [i] + "  and " + typeid (T).name ());
+		/**
+		 * Read a value as a T
+		 * @params:
+		 *   - doc: the arena owning the value (shared by dict, and array results)
+		 *   - v: the value to read
+		 *   - where: the location of the value (for error messages)
+		 * @throws:
+		 *   - config_error: if the value is not a T
+		 */
+		template <typename T>
+		T convert (const std::shared_ptr <const utils::arena> & doc, const value & v, const std::string & where) {
+		    if (!compatible <T> (v.type)) {
+			throw config_error (v.line, "Incompatible types : " + name (v.type) + " and " + std::string (typeid (T).name ()) + " for index [" + where + "]");
 		    }
-		    return * (reinterpret_cast <T*> (this-> _content [i]));
+
+		    if constexpr (std::is_same <T, bool>::value) return v.b;
+		    else if constexpr (std::is_arithmetic <T>::value) {
+			if (v.type == kind::INT) return static_cast <T> (v.i);
+			else return static_cast <T> (v.f);
+		    }
+		    else if constexpr (std::is_same <T, std::string>::value) return std::string (v.str ());
+		    else if constexpr (std::is_same <T, std::string_view>::value) return v.str ();
+		    else return T (doc, &v);
 		}
 
-		int get_int (unsigned int i) const;
-		float get_float (unsigned int i) const;
-		
-				
-		int size () const;
-		
-		void print (std::ostream & stream) const;
+	    }
+
+	    /**
+	     * An array of configuration values
+	     * @info: the copies share the values (O(1))
+	     */
+	    class array {
+
+		/// The arena owning the values
+		std::shared_ptr <const utils::arena> _doc;
+
+		/// The array value
+		const value * _node;
+
+	    public :
 
-		const std::vector <std::string> & types () const;
-		
 		/**
-		 * clear the array
+		 * An empty array
 		 */
-		void clear ();
-		
-		~array ();
-		
-	    private :		
+		array ();
+
 		/**
-		 * Deep copy of the content inside types, and content
+		 * @params:
+		 *   - doc: the arena owning the value
+		 *   - node: an ARRAY value
 		 */
-		void clone_content (std::vector <std::string> & types, std::vector <void*> & content) const;		
-		
+		array (std::shared_ptr <const utils::arena> doc, const value * node);
+
+		template <typename T>
+		T get (unsigned int i) const {
+		    return internal::convert <T> (this-> _doc, this-> at (i), std::to_string (i));
+		}
+
+		/**
+		 * @returns: the type of the ith value
+		 */
+		kind type (unsigned int i) const;
+
+		int size () const;
+
+		void print (std::ostream & stream) const;
+
+	    private :
+
+		/**
+		 * @throws: config_error if i is out of the array
+		 */
+		const value & at (unsigned int i) const;
+
 	    };
 
-	    struct dict {
+	    /**
+	     * A dictionnary of configuration values
+	     * @info: the copies share the values (O(1))
+	     */
+	    class dict {
+
+		/// The arena owning the values
+		std::shared_ptr <const utils::arena> _doc;
 
-		std::map <std::string, std::string> _types;
-		std::map <std::string, void*> _content;
+		/// The dict value
+		const value * _node;
 
 	    public :
 
+		/**
+		 * An empty dict
+		 */
 		dict ();
 
 		/**
-		 * Deep copy
+		 * @params:
+		 *   - doc: the arena owning the value
+		 *   - node: a DICT value
 		 */
-		dict (const dict & other);
+		dict (std::shared_ptr <const utils::arena> doc, const value * node);
 
 		/**
-		 * Deep copy
+		 * @returns: the keys of the dict (sorted)
 		 */
-		const dict & operator= (const dict & other);
-		
-		
-		template <typename T>
-		void insert (const std::string & name, T* value) {
-		    this-> _types.emplace (name, typeid (T).name ());
-		    this-> _content.emplace (name, value);
-		}
-
-		void insert (const std::string & name, void* value, const std::string & type);
-
 		std::vector <std::string> keys () const;
-		
-		template <typename T>
-		const T& getRef (const std::string & name) const {		    
-		    auto value = this-> _content.find (name);
-		    if (value == this-> _content.end ()) {
-			std::stringstream ss;
-			ss << "Name : [" << name << "] not found in dictionnary ";
-			this-> print (ss);
-			throw config_error (0, ss.str ());
-		    } else if (this-> _types.find (name)-> second != std::string (typeid (T).name ())) {
-			throw config_error (0, "Incompatible types : " + this-> _types.find (name)-> second + " and " + std::string (typeid (T).name ()) + " for index [" + name + "]");
-		    }
-		    return * (reinterpret_cast <T*> (value-> second));
-		}
 
 		template <typename T>
 		T get (const std::string & name) const {
-		    if constexpr (std::is_floating_point<T> ()) return get_float (name);
-		    if constexpr (std::is_signed<T> ()) return get_int (name);
-		    
-		    auto value = this-> _content.find (name);
-		    if (value == this-> _content.end ()) {
-			std::stringstream ss;
-			ss << "Name : [" << name << "] not found in dictionnary ";
-			this-> print (ss);
-			throw config_error (0, ss.str ());
-		    } else if (this-> _types.find (name)-> second != std::string (typeid (T).name ())) {
-			throw config_error (0, "Incompatible types : " + this-> _types.find (name)-> second + " and " + std::string (typeid (T).name ()) + " for index [" + name + "]");
-		    }
-		    return * (reinterpret_cast <T*> (value-> second));
+		    return internal::convert <T> (this-> _doc, this-> at (name), name);
 		}
 
-		
-		int get_int (const std::string & name) const;
-		float get_float (const std::string & name) const;
-		
 		template <typename T>
 		bool has (const std::string & name) const {
-		    if constexpr (std::is_floating_point <T> ()) return has_float (name);
-		    if constexpr (std::is_signed <T> ()) return has_int (name);
-		    auto value = this-> _content.find (name);
-		    if (value == this-> _content.end ()) return false;
-		    auto ty = this-> _types.find (name);
-		    return (ty-> second == typeid (T).name ());
+		    auto v = this-> _node-> find (name);
+		    return v != nullptr && internal::compatible <T> (v-> type);
 		}
 
-		bool has_int (const std::string & name) const;
-		
-		bool has_float (const std::string & name) const;
-		
 		template <typename T>
 		T getOr (const std::string & name, T orVal) const {
-		    if constexpr (std::is_floating_point <T> ()) return getOr_float (name, orVal);
-		    if constexpr (std::is_signed <T> ()) return getOr_int (name, orVal);
-		    auto value = this-> _content.find (name);
-		    if (value == this-> _content.end ()) return orVal;
-		    else if (this-> _types.find (name)-> second == typeid (T).name ()) {
-			return * (reinterpret_cast<T*> (value-> second));
-		    } else {
-			throw config_error (0, "Incompatible types : " + this-> _types.find (name)-> second + " and " + std::string (typeid (T).name ()) + " for index [" + name + "]");
-		    }
+		    auto v = this-> _node-> find (name);
+		    if (v == nullptr) return orVal;
+		    return internal::convert <T> (this-> _doc, *v, name);
 		}
 
-		float getOr_float (const std::string & name, float orVal) const;
-		int getOr_int (const std::string & name, int orVal) const;
-		
-		void print (std::ostream & stream) const;
-
-		void clear ();
-
+		/**
+		 * @returns: the type of the value associated to name
+		 * @throws: config_error if there is no such value
+		 */
+		kind type (const std::string & name) const;
 
-		const std::map <std::string, std::string> & types () const;
+		/**
+		 * @returns: the number of bytes of the document containing the dict
+		 */
+		std::size_t memory () const;
 
-		const std::map <std::string, void*> & content () const;
-		
-		~dict ();
+		void print (std::ostream & stream) const;
 
 	    private :
 
-
 		/**
-		 * Deep copy of the content inside types, and content
+		 * @throws: config_error if there is no value named name
 		 */
-		void clone_content (std::map <std::string, std::string> & types, std::map <std::string, void*> & content) const;
-		
+		const value & at (const std::string & name) const;
+
 	    };
-	           
-	    	    
+
+
 	}
-		
-    }    
+
+    }
 
 }
 
@@ -30,6 +30,10 @@ namespace monitor {
 	struct addr_error : public exception {
 	    addr_error (const std::string & msg) : exception (msg) {}	    
 	};
+
+	struct socket_error : public exception {
+	    socket_error (const std::string & msg) : exception (msg) {}
+	};
 	
 
     }    
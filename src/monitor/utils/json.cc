@@ -7,18 +7,22 @@ namespace monitor {
     namespace utils {
 
 	namespace json {
-	   
+
+	    using config::kind;
+	    
 	    std::string dump (const config::array & cfg) {
 		std::stringstream ss;
 		ss << "[";
-		auto & type = cfg.types ();
 		for (auto it : range (0, cfg.size ())) {
 		    if (it != 0) ss << ", ";
-		    if (type [it] == typeid (float).name ()) ss << cfg.get<float> (it);
-		    if (type [it] == typeid (long).name ()) ss << cfg.get<long> (it);
-		    if (type [it] == typeid (std::string).name ()) ss << "\"" << cfg.get<std::string> (it) << "\"";
-		    if (type [it] == typeid (config::array).name ()) ss << dump (cfg.get<config::array> (it));
-		    if (type [it] == typeid (config::dict).name ()) ss << dump (cfg.get<config::dict> (it));		   
+		    switch (cfg.type (it)) {
+		    case kind::FLOAT : ss << cfg.get<float> (it); break;
+		    case kind::INT : ss << cfg.get<long> (it); break;
+		    case kind::BOOL : ss << (cfg.get<bool> (it) ? "true" : "false"); break;
+		    case kind::STRING : ss << "\"" << cfg.get<std::string_view> (it) << "\""; break;
+		    case kind::ARRAY : ss << dump (cfg.get<config::array> (it)); break;
+		    case kind::DICT : ss << dump (cfg.get<config::dict> (it)); break;
+		    }
 		}
 		ss << "]";
 		return ss.str ();
@@ -28,15 +32,18 @@ namespace monitor {
 	    std::string dump (const config::dict & cfg) {
 		std::stringstream ss;
 		ss << "{";
-		auto type = cfg.types ();
 		int i = 0;
 		for (auto & it : cfg.keys ()) {
 		    if (i != 0) ss << ", ";
-		    if (type [it] == typeid (float).name ()) ss << "\"" << it << "\" : " << cfg.get<float> (it);
-		    if (type [it] == typeid (long).name ()) ss << "\"" << it << "\" : " << cfg.get<long> (it);
-		    if (type [it] == typeid (std::string).name ()) ss << "\"" << it << "\" : \"" << cfg.get<std::string> (it) << "\"";
-		    if (type [it] == typeid (config::array).name ()) ss << "\"" << it << "\" : " << dump (cfg.get<config::array> (it));
-		    if (type [it] == typeid (config::dict).name ()) ss << "\"" << it << "\" : " << dump (cfg.get<config::dict> (it));
+		    ss << "\"" << it << "\" : ";
+		    switch (cfg.type (it)) {
+		    case kind::FLOAT : ss << cfg.get<float> (it); break;
+		    case kind::INT : ss << cfg.get<long> (it); break;
+		    case kind::BOOL : ss << (cfg.get<bool> (it) ? "true" : "false"); break;
+		    case kind::STRING : ss << "\"" << cfg.get<std::string_view> (it) << "\""; break;
+		    case kind::ARRAY : ss << dump (cfg.get<config::array> (it)); break;
+		    case kind::DICT : ss << dump (cfg.get<config::dict> (it)); break;
+		    }
 		    
 		    i += 1;
 		}
@@ -1,5 +1,7 @@
 #include <monitor/utils/toml.hh>
 #include <fstream>
+#include <charconv>
+#include <algorithm>
 
 namespace monitor {
 
@@ -7,6 +9,10 @@ namespace monitor {
 
 	namespace toml {
 
+	    using config::value;
+	    using config::entry;
+	    using config::kind;
+
 	    /***
 	     * ========================================================================
 	     * ========================================================================
@@ -15,150 +21,304 @@ namespace monitor {
 	     * ========================================================================
 	     */
 
-	
-	    void* parse_value (tokenizer & tok, std::string & type);
-	
-	    config::dict* parse_dict (tokenizer & tok, bool glob = false);
+	    /**
+	     * Single pass parser, reading the content char by char
+	     * The line number is updated when a new line is consumed, and never recomputed
+	     * The values are built in the arena of the document, the entries and items of the tables and arrays being parsed are stacked in scratch vectors
+	     */
+	    class parser {
+
+		/// The content to parse (owned by the arena)
+		std::string_view _content;
+
+		/// The position of the cursor in the content
+		std::size_t _cursor;
+
+		/// The current line
+		int _line;
+
+		/// The arena in which values are allocated
+		utils::arena & _arena;
 
-	    config::array* parse_array (tokenizer & tok);
+		/// The entries of the tables being parsed
+		std::vector <entry> _entries;
 
-	    long* parse_int (tokenizer & tok);
+		/// The items of the arrays being parsed
+		std::vector <value*> _items;
 
-	    float* parse_float (tokenizer & tok);
+	    public :
 
-	    std::string* parse_string (tokenizer & tok, char beginChar = '"');
+		parser (std::string_view content, utils::arena & arena) :
+		    _content (content),
+		    _cursor (0),
+		    _line (1),
+		    _arena (arena)
+		{}
 
-	    bool* parse_bool (tokenizer & tok);	
+		value * parseDocument () {
+		    std::vector <entry> sections;
+		    std::string_view current = "";
+		    int currentLine = 1;
 
+		    for (;;) {
+			this-> skipBlanks (true);
+			if (this-> eof () || this-> peek () == '[') {
+			    if (current.length () != 0) { // close the previous section
+				sections.push_back ({current, this-> makeDict (0, currentLine)});
+			    } else { // global values (before the first section)
+				for (auto & e : this-> _entries) sections.push_back (e);
+				this-> _entries.clear ();
+			    }
 
-	    void assert_msg (bool test, const std::string & msg, tokenizer & tok) {
-		if (!test) {
-		    tok.rewind ();
-		    throw config::config_error (tok.getLineNumber (), msg + " at line : " + std::to_string (tok.getLineNumber ()));
-		}	    
-	    }	
-	
-	    config::dict * parse_dict (tokenizer & tok, bool glob) {
-		config::dict* dic = new  config::dict ();
-		while (true) {
-		    auto name = tok.next ();
-		    if (name == "" || name == "[") {
-			tok.rewind ();
-			break;
+			    if (this-> eof ()) break;
+
+			    this-> _cursor += 1;
+			    this-> skipBlanks (false);
+			    currentLine = this-> _line;
+			    current = this-> parseKey ("expected section name");
+			    this-> skipBlanks (false);
+			    this-> expect (']');
+			} else {
+			    this-> _entries.push_back (this-> parseKeyValue ());
+			    this-> skipBlanks (false);
+			    if (!this-> eof () && this-> peek () != '\n') {
+				this-> error ("expected new line (not " + this-> describe () + ")");
+			    }
+			}
 		    }
 
-		    assert_msg (tok.next () == "=", "expected = ", tok);
-		
-		    std::string type;
-		    auto value = parse_value (tok, type);
-		    dic-> insert (name, value, type);
-		
-		    if (!glob) {
-			auto next = tok.next ();
-			assert_msg (next == "}" || next == ",", "expected } or , (not " + next + ")", tok);
-			if (next == "}") break;
-		    } 
-		}
-		return dic;
-	    }	
-
-	    config::array * parse_array (tokenizer & tok) {
-		config::array * arr = new  config::array ();
-		while (true) {
-		    if (tok.next () != "]") {
-			std::string type;
-			tok.rewind ();
-			auto value = parse_value (tok, type);
-			arr-> push (value, type);
-			auto t = tok.next ();
-			assert_msg (t == "," || t == "]", "expected ,", tok);
-			if (t == "]") break;
-		    } else break;
-		}
-	    
-		return arr;
-	    }
-	
-	    long * parse_int (tokenizer & tok) {
-		auto x = tok.next ();
-		auto * i = new  long (std::stoi (x));
-		return i;
-	    }
+		    this-> _entries = std::move (sections);
+		    return this-> makeDict (0, 1);
+		}
 
-	    float* parse_float (tokenizer & tok) {
-		auto x = tok.next ();
-		auto * i = new  float (std::stof (x));
-		return i;
-	    }
+	    private :
 
-	    std::string * parse_string (tokenizer & tok, char end) {
-		tok.skip (false);
-		std::stringstream ss;
-		while (true) {
-		    auto next = tok.next ();
-		    if (next == "") {
-			throw config::config_error (tok.getLineNumber (), "Unterminated string literal");
-		    } else if (next.length () == 1 && next [0] == end) {
-			break;
+		bool eof () const {
+		    return this-> _cursor >= this-> _content.length ();
+		}
+
+		char peek () const {
+		    return this-> eof () ? '\0' : this-> _content [this-> _cursor];
+		}
+
+		[[noreturn]] void error (const std::string & msg, int line = -1) const {
+		    if (line == -1) line = this-> _line;
+		    throw config::config_error (line, msg + " at line : " + std::to_string (line));
+		}
+
+		/**
+		 * @returns: the description of the char at the cursor position, for error messages
+		 */
+		std::string describe () const {
+		    if (this-> eof ()) return "end of file";
+		    if (this-> peek () == '\n') return "end of line";
+		    return std::string (1, this-> peek ());
+		}
+
+		void expect (char c) {
+		    if (this-> peek () != c) {
+			this-> error (std::string ("expected ") + c + " (not " + this-> describe () + ")");
 		    }
-		    ss << next;
+		    this-> _cursor += 1;
 		}
-		tok.skip (true);
-	    
-		return new  std::string (ss.str ());
-	    }
-	
-	    void * parse_value (tokenizer & tok, std::string & type) {
-		auto begin = tok.next ();
-		if (begin == "{") {
-		    type = typeid (config::dict).name ();
-		    return parse_dict (tok, false);
-		} else if (begin == "[") {
-		    type = typeid (config::array).name ();
-		    return parse_array (tok);
-		} else if (begin == "'" || begin == "\"") {
-		    type = typeid (std::string).name ();
-		    return parse_string (tok, begin[0]);
-		} else if (begin == "false") {		
-		    type = typeid (bool).name ();
-		    return new  bool (false);
-		} else if (begin == "true") {		
-		    type = typeid (bool).name ();
-		    return new  bool (true);
-		} else {
-		    tok.rewind ();
-		    if (begin.find (".") != std::string::npos) {
-			type = typeid (float).name ();
-			return parse_float (tok);
+
+		/**
+		 * Create a dict value from the entries stacked since 'from'
+		 * @info: the entries are sorted by key, and unstacked
+		 */
+		value * makeDict (std::size_t from, int line) {
+		    auto dic = this-> _arena.make <value> (kind::DICT, line);
+		    auto nb = this-> _entries.size () - from;
+		    dic-> dic.items = this-> _arena.makeArray <entry> (nb);
+		    dic-> dic.size = nb;
+
+		    std::copy (this-> _entries.begin () + from, this-> _entries.end (), dic-> dic.items);
+		    std::stable_sort (dic-> dic.items, dic-> dic.items + nb, [] (const entry & a, const entry & b) {
+			return a.key < b.key;
+		    });
+
+		    for (std::size_t i = 1 ; i < nb ; i++) {
+			if (dic-> dic.items [i - 1].key == dic-> dic.items [i].key) {
+			    this-> error ("duplicate key " + std::string (dic-> dic.items [i].key), dic-> dic.items [i].val-> line);
+			}
+		    }
+
+		    this-> _entries.resize (from);
+		    return dic;
+		}
+
+		/**
+		 * Create an array value from the items stacked since 'from'
+		 */
+		value * makeArray (std::size_t from, int line) {
+		    auto arr = this-> _arena.make <value> (kind::ARRAY, line);
+		    auto nb = this-> _items.size () - from;
+		    arr-> arr.items = this-> _arena.makeArray <value*> (nb);
+		    arr-> arr.size = nb;
+
+		    std::copy (this-> _items.begin () + from, this-> _items.end (), arr-> arr.items);
+		    this-> _items.resize (from);
+		    return arr;
+		}
+
+		/**
+		 * Skip the spaces and the comments
+		 * @params:
+		 *   - newLines: if true skip new lines as well
+		 */
+		void skipBlanks (bool newLines) {
+		    while (!this-> eof ()) {
+			auto c = this-> _content [this-> _cursor];
+			if (c == ' ' || c == '\t' || c == '\r') {
+			    this-> _cursor += 1;
+			} else if (c == '\n' && newLines) {
+			    this-> _line += 1;
+			    this-> _cursor += 1;
+			} else if (c == '#') {
+			    while (!this-> eof () && this-> _content [this-> _cursor] != '\n') this-> _cursor += 1;
+			} else break;
+		    }
+		}
+
+		static bool isBareChar (char c) {
+		    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '.';
+		}
+
+		std::string_view parseKey (const std::string & msg) {
+		    auto c = this-> peek ();
+		    if (c == '"' || c == '\'') {
+			return this-> parseString (c)-> str ();
+		    }
+
+		    auto beg = this-> _cursor;
+		    while (isBareChar (this-> peek ())) this-> _cursor += 1;
+		    if (beg == this-> _cursor) this-> error (msg);
+
+		    return this-> _content.substr (beg, this-> _cursor - beg);
+		}
+
+		entry parseKeyValue () {
+		    auto name = this-> parseKey ("expected key");
+		    this-> skipBlanks (false);
+		    this-> expect ('=');
+		    this-> skipBlanks (false);
+
+		    return {name, this-> parseValue ()};
+		}
+
+		value * parseValue () {
+		    auto c = this-> peek ();
+		    switch (c) {
+		    case '{' : return this-> parseInlineTable ();
+		    case '[' : return this-> parseArray ();
+		    case '"' :
+		    case '\'' : return this-> parseString (c);
+		    default : break;
+		    }
+
+		    auto beg = this-> _cursor;
+		    while (isBareChar (this-> peek ()) || this-> peek () == '+') this-> _cursor += 1;
+		    auto word = this-> _content.substr (beg, this-> _cursor - beg);
+		    if (word.length () == 0) {
+			this-> error ("expected value (not " + this-> describe () + ")");
+		    }
+
+		    if (word == "true" || word == "false") {
+			auto val = this-> _arena.make <value> (kind::BOOL, this-> _line);
+			val-> b = (word == "true");
+			return val;
+		    }
+
+		    return this-> parseNumber (word);
+		}
+
+		value * parseNumber (std::string_view word) {
+		    auto isFloat = word.find ('.') != std::string_view::npos || word.find ('e') != std::string_view::npos || word.find ('E') != std::string_view::npos;
+		    auto beg = word.data (), end = word.data () + word.length ();
+		    if (*beg == '+') beg += 1;
+
+		    if (isFloat) {
+			auto val = this-> _arena.make <value> (kind::FLOAT, this-> _line);
+			auto res = std::from_chars (beg, end, val-> f);
+			if (res.ec != std::errc () || res.ptr != end) this-> error ("malformed float " + std::string (word));
+			return val;
 		    } else {
-			type = typeid (long).name ();
-			return parse_int (tok);
+			auto val = this-> _arena.make <value> (kind::INT, this-> _line);
+			auto res = std::from_chars (beg, end, val-> i);
+			if (res.ec != std::errc () || res.ptr != end) this-> error ("malformed integer " + std::string (word));
+			return val;
+		    }
+		}
+
+		value * parseString (char quote) {
+		    auto val = this-> _arena.make <value> (kind::STRING, this-> _line);
+		    this-> _cursor += 1;
+
+		    auto beg = this-> _cursor;
+		    while (!this-> eof () && this-> _content [this-> _cursor] != quote) {
+			if (this-> _content [this-> _cursor] == '\n') this-> _line += 1;
+			this-> _cursor += 1;
+		    }
+
+		    if (this-> eof ()) this-> error ("Unterminated string literal");
+
+		    val-> s.data = this-> _content.data () + beg;
+		    val-> s.len = this-> _cursor - beg;
+		    this-> _cursor += 1;
+
+		    return val;
+		}
+
+		value * parseArray () {
+		    auto line = this-> _line;
+		    auto from = this-> _items.size ();
+		    this-> _cursor += 1;
+		    for (;;) {
+			this-> skipBlanks (true);
+			if (this-> peek () == ']') break;
+
+			auto v = this-> parseValue ();
+			this-> _items.push_back (v);
+			this-> skipBlanks (true);
+			if (this-> peek () != ']') this-> expect (',');
 		    }
+
+		    this-> _cursor += 1;
+		    return this-> makeArray (from, line);
 		}
-	    }	
-
-	
-	    config::dict parse (const std::string & content) {
-		tokenizer tok (content, {"[", "]", "{", "}", "=", ",", "'", "\"", " ", "\n", "\t", "\r", "#"}, {" ", "\t", "\n", "\r"}, {"#"});
-	    
-		config::dict dic;
-		while (true) {
-		    auto next = tok.next ();
-
-		    assert_msg (next == "[" || next == "" || next == "#", "expected [ (not " + next + ")", tok);
-		    if (next == "[") {
-			auto name = tok.next ();
-			assert_msg (tok.next () == "]", "expected ]", tok);
-			auto content = parse_dict (tok, true);
-			dic.insert (name, content, typeid (config::dict).name ());
-		    } else break;
-		}
-	    
-		return dic;
+
+		value * parseInlineTable () {
+		    auto line = this-> _line;
+		    auto from = this-> _entries.size ();
+		    this-> _cursor += 1;
+		    for (;;) {
+			this-> skipBlanks (true);
+			if (this-> peek () == '}') break;
+
+			auto e = this-> parseKeyValue ();
+			this-> _entries.push_back (e);
+			this-> skipBlanks (true);
+			if (this-> peek () != '}') this-> expect (',');
+		    }
+
+		    this-> _cursor += 1;
+		    return this-> makeDict (from, line);
+		}
+
+	    };
+
+	    config::dict parse (std::string_view content) {
+		auto doc = std::make_shared <utils::arena> ();
+		auto copy = doc-> store (content);
+
+		parser p (copy, *doc);
+		auto root = p.parseDocument ();
+
+		return config::dict (std::move (doc), root);
 	    }
 
 
-	    config::dict parse_file (const std::string & filePath) {	       
+	    config::dict parse_file (const std::string & filePath) {
 		std::ifstream t(filePath);
 		if (!t.good ()) {
 		    throw utils::file_error ("File not found : " + filePath);
@@ -170,62 +330,75 @@ namespace monitor {
 		return parse (str);
 	    }
 
+	    /***
+	     * ========================================================================
+	     * ========================================================================
+	     * =========================          dump            =====================
+	     * ========================================================================
+	     * ========================================================================
+	     */
+
 	    std::string dump (const config::array & cfg) {
 		std::stringstream ss;
 		ss << "[";
-		auto & type = cfg.types ();
 		for (auto it : range (0, cfg.size ())) {
 		    if (it != 0) ss << ", ";
-		    if (type [it] == typeid (float).name ()) ss << cfg.get<float> (it);
-		    if (type [it] == typeid (long).name ()) ss << cfg.get<long> (it);
-		    if (type [it] == typeid (std::string).name ()) ss << "\"" << cfg.get<std::string> (it) << "\"";
-		    if (type [it] == typeid (config::array).name ()) ss << dump (cfg.get<config::array> (it));
-		    if (type [it] == typeid (config::dict).name ()) ss << dump (cfg.get<config::dict> (it), false);		   
+		    switch (cfg.type (it)) {
+		    case kind::FLOAT : ss << cfg.get<float> (it); break;
+		    case kind::INT : ss << cfg.get<long> (it); break;
+		    case kind::BOOL : ss << (cfg.get<bool> (it) ? "true" : "false"); break;
+		    case kind::STRING : ss << "\"" << cfg.get<std::string_view> (it) << "\""; break;
+		    case kind::ARRAY : ss << dump (cfg.get<config::array> (it)); break;
+		    case kind::DICT : ss << dump (cfg.get<config::dict> (it), false, false); break;
+		    }
 		}
 		ss << "]";
 		return ss.str ();
 	    }
 
-	    
-	    std::string dump (const config::dict & cfg, bool isSuper, bool isGlobal) {		
+	    /**
+	     * Dump the value 'it' of the dict cfg (key = value)
+	     */
+	    void dump_value (std::stringstream & ss, const config::dict & cfg, const std::string & it) {
+		switch (cfg.type (it)) {
+		case kind::FLOAT : ss << it << " = " << cfg.get<float> (it); break;
+		case kind::INT : ss << it << " = " << cfg.get<long> (it); break;
+		case kind::BOOL : ss << it << " = " << (cfg.get<bool> (it) ? "true" : "false"); break;
+		case kind::STRING : ss << it << " = \"" << cfg.get<std::string_view> (it) << "\""; break;
+		case kind::ARRAY : ss << it << " = " << dump (cfg.get<config::array> (it)); break;
+		case kind::DICT : ss << it << " = " << dump (cfg.get<config::dict> (it), false, false); break;
+		}
+	    }
+
+	    std::string dump (const config::dict & cfg, bool isSuper, bool isGlobal) {
 		std::stringstream ss;
-		auto type = cfg.types ();
 		int i = 0;
 		if (!isGlobal) {
 		    ss << "{";
 		    for (auto & it : cfg.keys ()) {
 			if (i != 0) ss << ", ";
-			if (type [it] == typeid (float).name ()) ss << it << " = " << cfg.get<float> (it);
-			if (type [it] == typeid (long).name ()) ss << it << " = " << cfg.get<long> (it);
-			if (type [it] == typeid (std::string).name ()) ss << it << " = \"" << cfg.get<std::string> (it) << "\"";
-			if (type [it] == typeid (config::array).name ()) ss << it << " = " << dump (cfg.get<config::array> (it));
-			if (type [it] == typeid (config::dict).name ()) ss << it << " = " << dump (cfg.get<config::dict> (it), false);
-			
+			dump_value (ss, cfg, it);
 			i += 1;
 		    }
 		    ss << "}";
 		} else {
 		    for (auto & it : cfg.keys ()) {
-			if (type [it] == typeid (config::dict).name () && isSuper) {
+			if (cfg.type (it) == kind::DICT && isSuper) {
 			    ss << "\n[" << it << "]\n";
 			    ss << dump (cfg.get<config::dict> (it), false, true);
 			} else {
-			    if (type [it] == typeid (float).name ()) ss << it << " = " << cfg.get<float> (it);
-			    if (type [it] == typeid (long).name ()) ss << it << " = " << cfg.get<long> (it);
-			    if (type [it] == typeid (std::string).name ()) ss << it << " = \"" << cfg.get<std::string> (it) << "\"";
-			    if (type [it] == typeid (config::array).name ()) ss << it << " = " << dump (cfg.get<config::array> (it));
-			    if (type [it] == typeid (config::dict).name ()) ss << it << " = " << dump (cfg.get<config::dict> (it), false, false);
+			    dump_value (ss, cfg, it);
 			    ss << "\n";
 			}
 			i += 1;
-				    }
+		    }
 		}
 		return ss.str ();
 
 	    }
-	    
+
 	}
-	
+
     }
-    
+
 }
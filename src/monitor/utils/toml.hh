@@ -13,8 +13,11 @@ namespace monitor {
 	    
 	    /*
 	     * Parse a string, and return a configuration
+	     * @info: the content is copied once in the arena of the configuration, the strings of the configuration are views on this copy
+	     * @throws: 
+	     *   - config::config_error: if the content is malformed
 	     */       
-	    config::dict parse (const std::string & content);
+	    config::dict parse (std::string_view content);
 
 	    config::dict parse_file (const std::string & path);
 
@@ -0,0 +1,193 @@
+#include "coordinator.hh"
+#include <algorithm>
+#include <map>
+#include <monitor/net/_.hh>
+#include <monitor/libvirt/proto.hh>
+#include <monitor/utils/exception.hh>
+
+using namespace monitor;
+using namespace monitor::net;
+using namespace monitor::libvirt;
+using json = nlohmann::json;
+
+namespace server {
+
+    namespace cluster {
+
+	ClusterConfig ClusterConfig::parse (const json & j) {
+	    ClusterConfig read;
+	    read.period = j.contains ("period") ? j.at ("period").get<float> () : 10.0f;
+	    read.timeout = j.contains ("timeout") ? j.at ("timeout").get<float> () : 5.0f;
+	    read.minPressure = j.contains ("min-pressure") ? j.at ("min-pressure").get<float> () / 100.0f : 0.05f;
+	    read.maxMigrations = j.contains ("max-migrations") ? j.at ("max-migrations").get<unsigned int> () : 1;
+
+	    if (read.period <= 0.0f) throw utils::exception ("period must be positive");
+	    if (read.timeout <= 0.0f) throw utils::exception ("timeout must be positive");
+	    if (read.minPressure < 0.0f || read.minPressure > 1.0f) throw utils::exception ("min-pressure must be in [0, 100]");
+
+	    return read;
+	}
+
+	json ClusterPlan::dump () const {
+	    json migrations = json::array (), transfers = json::array ();
+	    for (auto & m : this-> migrations) {
+		migrations.push_back ({{"vm", m.vm}, {"from", m.from}, {"to", m.to}, {"demand", m.demand}});
+	    }
+
+	    for (auto & t : this-> transfers) {
+		transfers.push_back ({{"from", t.from}, {"to", t.to}, {"amount", t.amount}});
+	    }
+
+	    return {
+		{"migrations", migrations},
+		{"transfers", transfers},
+		{"placement", this-> placement},
+		{"unreached", this-> unreached}
+	    };
+	}
+
+	Coordinator::Coordinator (const std::vector <std::string> & hosts, unsigned short defaultPort) {
+	    for (auto & h : hosts) {
+		auto sep = h.find (':');
+		unsigned short port = sep == std::string::npos ? defaultPort : SockAddrV4::parsePort (h.substr (sep + 1));
+		if (port == 0) throw utils::exception ("No port for host " + h);
+
+		this-> _hosts.emplace_back (h.substr (0, sep), port);
+	    }
+	}
+
+	void Coordinator::setConfig (const ClusterConfig & cfg) {
+	    this-> _config = cfg;
+	}
+
+	const ClusterConfig & Coordinator::getConfig () const {
+	    return this-> _config;
+	}
+
+	ClusterPlan Coordinator::run () {
+	    std::vector <std::string> unreached;
+	    auto summaries = this-> collect (unreached);
+
+	    auto plan = this-> clear (summaries);
+	    plan.unreached = std::move (unreached);
+	    return plan;
+	}
+
+	std::vector <HostSummary> Coordinator::collect (std::vector <std::string> & unreached) {
+	    std::vector <request> reqs (this-> _hosts.size ());
+	    for (std::size_t i = 0 ; i < this-> _hosts.size () ; i++) {
+		reqs [i].host = this-> _hosts [i].first;
+		reqs [i].port = this-> _hosts [i].second;
+		reqs [i].timeout = this-> _config.timeout;
+		reqs [i].th = concurrency::spawn (&Coordinator::fetch, &reqs [i]);
+	    }
+
+	    std::vector <HostSummary> summaries;
+	    for (auto & r : reqs) {
+		concurrency::join (r.th);
+		if (r.reached) summaries.push_back (std::move (r.summary));
+		else unreached.push_back (r.host + ":" + std::to_string (r.port));
+	    }
+
+	    return summaries;
+	}
+
+	void Coordinator::fetch (concurrency::thread, request * req) {
+	    try {
+		TcpStream client (SockAddrV4 (Ipv4Address::resolve (req-> host), req-> port));
+		client.connect (req-> timeout);
+		client.sendInt (VMProtocol::SUMMARY);
+
+		auto resp = client.receiveInt ();
+		if (resp == VMProtocol::SUMMARY) {
+		    auto len = client.receiveInt ();
+		    auto content = client.receive (len);
+		    if (content.length () == len) {
+			req-> summary = HostSummary::parse (json::parse (content));
+			req-> summary.host = req-> host + ":" + std::to_string (req-> port);
+			req-> reached = true;
+		    }
+		}
+
+		client.close ();
+	    } catch (utils::exception & e) {
+		req-> message = e.msg;
+	    } catch (std::exception & e) {
+		req-> message = e.what ();
+	    }
+	}
+
+	ClusterPlan Coordinator::clear (const std::vector <HostSummary> & hosts) const {
+	    ClusterPlan plan;
+	    std::vector <unsigned long> slack;
+	    for (auto & h : hosts) slack.push_back (h.slack ());
+
+	    // The most starved hosts first (the order of the names for the same pressure, so the plan does not depend on the order of the answers)
+	    // A host whose guarantees exceed its cpus does not clear its market, its VMs buy nothing and only its excess shows its starvation
+	    std::vector <std::size_t> sources;
+	    for (std::size_t i = 0 ; i < hosts.size () ; i++) {
+		if (hosts [i].pressure () > 0 && hosts [i].pressure () >= hosts [i].capacity * this-> _config.minPressure) sources.push_back (i);
+	    }
+
+	    std::sort (sources.begin (), sources.end (), [&hosts] (std::size_t a, std::size_t b) {
+		if (hosts [a].pressure () != hosts [b].pressure ()) return hosts [a].pressure () > hosts [b].pressure ();
+		return hosts [a].host < hosts [b].host;
+	    });
+
+	    std::map <std::pair <std::string, std::string>, unsigned long> transfers;
+	    for (auto s : sources) {
+		std::vector <const VMSummary*> starved;
+		for (auto & v : hosts [s].vms) {
+		    if (v.unmet > 0 || hosts [s].excess > 0) starved.push_back (&v);
+		}
+
+		std::sort (starved.begin (), starved.end (), [] (const VMSummary * a, const VMSummary * b) {
+		    if (a-> money != b-> money) return a-> money > b-> money;
+		    return a-> id < b-> id;
+		});
+
+		// Moving a VM frees its cpu time on the source, and its own demand leaves with it
+		long remaining = hosts [s].pressure ();
+		for (auto & v : starved) {
+		    if (remaining <= 0 || plan.migrations.size () >= this-> _config.maxMigrations) break;
+
+		    auto demand = v-> usage + v-> unmet;
+		    std::size_t best = hosts.size ();
+		    for (std::size_t d = 0 ; d < hosts.size () ; d++) {
+			if (d == s) continue;
+			if (best == hosts.size () || slack [d] > slack [best] || (slack [d] == slack [best] && hosts [d].host < hosts [best].host)) best = d;
+		    }
+
+		    if (best == hosts.size ()) break;
+
+		    // A VM too large for every host still moves if the cpu time it misses on its new host is much lower than what it gives back to the source
+		    auto relieved = std::min (demand, (unsigned long) remaining);
+		    auto overflow = slack [best] < demand ? demand - slack [best] : 0;
+		    if (overflow >= relieved || relieved - overflow < hosts [s].capacity * this-> _config.minPressure) continue; // a smaller one may fit
+
+		    slack [best] -= demand - overflow;
+		    remaining -= relieved;
+		    plan.migrations.push_back ({v-> id, hosts [s].host, hosts [best].host, demand});
+		    transfers [{hosts [s].host, hosts [best].host}] += v-> money;
+		}
+	    }
+
+	    for (auto & it : transfers) {
+		plan.transfers.push_back ({it.first.first, it.first.second, it.second});
+	    }
+
+	    // The placement takes the migrations into account
+	    std::vector <std::size_t> order;
+	    for (std::size_t i = 0 ; i < hosts.size () ; i++) order.push_back (i);
+	    std::sort (order.begin (), order.end (), [&hosts, &slack] (std::size_t a, std::size_t b) {
+		if (slack [a] != slack [b]) return slack [a] > slack [b];
+		return hosts [a].host < hosts [b].host;
+	    });
+
+	    for (auto i : order) plan.placement.push_back (hosts [i].host);
+	    return plan;
+	}
+
+    }
+
+}
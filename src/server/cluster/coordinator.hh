@@ -0,0 +1,183 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <monitor/concurrency/thread.hh>
+#include <server/cluster/summary.hh>
+#include <nlohmann/json.hpp>
+
+namespace server {
+
+    namespace cluster {
+
+	struct ClusterConfig {
+	    /// The time between two clearings in seconds
+	    float period = 10.0f;
+
+	    /// The maximal time of connection and of each exchange with a daemon in seconds
+	    float timeout = 5.0f;
+
+	    /// The share of the cpus of a host its VMs must fail to buy before some of them are moved
+	    float minPressure = 0.05f;
+
+	    /// The maximal number of migrations hinted at each clearing
+	    unsigned int maxMigrations = 1;
+
+	    /**
+	     * Read a configuration from the content of a cluster.json file
+	     * @throws:
+	     *   - utils::exception: if a value is invalid
+	     *   - nlohmann::json::exception: if a key has the wrong type
+	     */
+	    static ClusterConfig parse (const nlohmann::json & j);
+	};
+
+	/**
+	 * A VM that should move to a host whose market has cycles left
+	 */
+	struct MigrationHint {
+	    /// The name of the VM
+	    std::string vm;
+
+	    /// The host running the VM
+	    std::string from;
+
+	    /// The host that should run it
+	    std::string to;
+
+	    /// The cpu time the VM wants (consumed and not bought)
+	    unsigned long demand;
+	};
+
+	/**
+	 * Money moving from the accounting of a host to the accounting of another one
+	 */
+	struct MoneyTransfer {
+	    std::string from;
+
+	    std::string to;
+
+	    unsigned long amount;
+	};
+
+	/**
+	 * The outcome of a cluster clearing
+	 */
+	struct ClusterPlan {
+	    /// The VMs to move
+	    std::vector <MigrationHint> migrations;
+
+	    /// The cpu money following the moved VMs, summed by pair of hosts
+	    std::vector <MoneyTransfer> transfers;
+
+	    /// The hosts by decreasing cpu time left, the first one should receive the next provisioned VM
+	    std::vector <std::string> placement;
+
+	    /// The hosts whose daemon did not answer
+	    std::vector <std::string> unreached;
+
+	    /**
+	     * @returns: the plan in json
+	     */
+	    nlohmann::json dump () const;
+	};
+
+	/**
+	 * The coordinator of the cpu markets of several hosts
+	 * Each daemon runs its own market over its cpus, a VM starved on a full host cannot use the cycles left on the other hosts.
+	 * The coordinator collects the supply and demand of the markets (cf. HostSummary), and runs a clearing of the cluster :
+	 *    - the hosts missing more than minPressure of their cpus (the demand their VMs failed to buy, and the guarantees over their cpus) are sources, the most starved first
+	 *    - the starved VMs of a source (all its VMs when its market was not cleared) are moved by decreasing money (the cluster market is won by the richest bidders), to the host with the most cycles left
+	 *    - a VM moves if that host can hold its whole demand, or if the cpu time it gives back to the source exceeds what it misses on the host by minPressure of the cpus of the source
+	 *    - a source stops moving VMs once the cpu time freed covers its pressure
+	 * The cpu money of a moved VM follows it, the transfers between the accountings of the hosts are emitted with the migrations
+	 * @info: the plan is only a hint, the migrations and transfers are executed by the operator (or an orchestrator)
+	 */
+	class Coordinator {
+
+	    /**
+	     * A summary request sent to one daemon, and its result
+	     */
+	    struct request {
+		/// The name of the host
+		std::string host;
+
+		/// The port of the daemon
+		unsigned short port;
+
+		/// The maximal time of the exchange in seconds
+		float timeout;
+
+		/// True iif the daemon answered a summary
+		bool reached = false;
+
+		/// The error if the daemon was not reached
+		std::string message;
+
+		/// The summary of the host
+		HostSummary summary;
+
+		/// The thread executing the request
+		monitor::concurrency::thread th;
+	    };
+
+	    /// The configuration of the coordinator
+	    ClusterConfig _config;
+
+	    /// The daemons of the cluster (host, port)
+	    std::vector <std::pair <std::string, unsigned short> > _hosts;
+
+	public:
+
+	    /**
+	     * @params:
+	     *   - hosts: the daemons of the cluster (host[:port])
+	     *   - defaultPort: the port of the daemons not given in hosts
+	     * @throws:
+	     *   - utils::exception: if the port of a host is unknown
+	     */
+	    Coordinator (const std::vector <std::string> & hosts, unsigned short defaultPort);
+
+	    /**
+	     * Change the configuration of the coordinator
+	     */
+	    void setConfig (const ClusterConfig & cfg);
+
+	    /**
+	     * @returns: the configuration of the coordinator
+	     */
+	    const ClusterConfig & getConfig () const;
+
+	    /**
+	     * Collect the summaries of all the daemons concurrently, and clear the cluster
+	     */
+	    ClusterPlan run ();
+
+	    /**
+	     * Collect the summaries of all the daemons concurrently (a dead host only costs the timeout)
+	     * @params:
+	     *   - unreached: the list to which the hosts that did not answer are appended
+	     * @returns: the summaries of the hosts that answered
+	     */
+	    std::vector <HostSummary> collect (std::vector <std::string> & unreached);
+
+	    /**
+	     * Clear the cluster
+	     * @params:
+	     *   - hosts: the summaries of the hosts (with their name)
+	     * @returns: the migrations, transfers and placement (without unreached hosts)
+	     */
+	    ClusterPlan clear (const std::vector <HostSummary> & hosts) const;
+
+	private:
+
+	    /**
+	     * Ask a summary to a daemon
+	     * @info: never throws, the errors are written in the request
+	     */
+	    static void fetch (monitor::concurrency::thread, request * req);
+
+	};
+
+    }
+
+}
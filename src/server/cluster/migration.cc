@@ -0,0 +1,332 @@
+#include "migration.hh"
+#include <algorithm>
+#include <monitor/net/_.hh>
+#include <monitor/libvirt/proto.hh>
+#include <monitor/utils/log.hh>
+#include <monitor/utils/toml.hh>
+#include <monitor/utils/exception.hh>
+#include <server/cluster/coordinator.hh>
+
+using namespace monitor;
+using namespace monitor::net;
+using namespace monitor::libvirt;
+using namespace monitor::utils;
+using json = nlohmann::json;
+
+namespace server {
+
+    namespace cluster {
+
+	MigrationConfig MigrationConfig::parse (const json & j) {
+	    MigrationConfig read;
+	    read.period = j.contains ("period") ? j.at ("period").get<float> () : 10.0f;
+	    read.window = j.contains ("window") ? j.at ("window").get<unsigned int> () : 3;
+	    read.minPressure = j.contains ("min-pressure") ? j.at ("min-pressure").get<float> () / 100.0f : 0.05f;
+	    read.bandwidth = j.contains ("bandwidth") ? j.at ("bandwidth").get<unsigned long> () : 100;
+	    read.ratio = j.contains ("ratio") ? j.at ("ratio").get<float> () : 2.0f;
+	    read.cooldown = j.contains ("cooldown") ? j.at ("cooldown").get<unsigned int> () : 6;
+	    read.timeout = j.contains ("timeout") ? j.at ("timeout").get<float> () : 5.0f;
+	    read.peers = j.contains ("peers") ? j.at ("peers").get<std::vector <std::string> > () : std::vector <std::string> ();
+	    read.port = j.contains ("port") ? j.at ("port").get<unsigned short> () : 0;
+	    read.uri = j.contains ("uri") ? j.at ("uri").get<std::string> () : "qemu+ssh://%s/system";
+	    read.sharedStorage = j.contains ("shared-storage") && j.at ("shared-storage").get<bool> ();
+
+	    if (read.period <= 0.0f) throw utils::exception ("period must be positive");
+	    if (read.window == 0) throw utils::exception ("window must be positive");
+	    if (read.minPressure <= 0.0f || read.minPressure > 1.0f) throw utils::exception ("min-pressure must be in ]0, 100]");
+	    if (read.bandwidth == 0) throw utils::exception ("bandwidth must be positive");
+	    if (read.ratio < 0.0f) throw utils::exception ("ratio must be positive");
+	    if (read.timeout <= 0.0f) throw utils::exception ("timeout must be positive");
+	    if (read.uri.find ("%s") == std::string::npos) throw utils::exception ("uri must contain %s");
+	    for (auto & p : read.peers) {
+		auto sep = p.find (':');
+		if (sep == std::string::npos) {
+		    if (read.port == 0) throw utils::exception ("no port for peer " + p);
+		} else {
+		    try {
+			SockAddrV4::parsePort (p.substr (sep + 1));
+		    } catch (const utils::addr_error & e) {
+			throw utils::exception ("invalid port for peer " + p + " (" + e.msg + ")");
+		    }
+		}
+	    }
+
+	    return read;
+	}
+
+	bool VMHandover::send (TcpStream & stream) const {
+	    auto content = this-> dump ().dump ();
+	    stream.sendInt (VMProtocol::ADOPT);
+	    stream.sendInt (content.length ());
+	    stream.send (content);
+
+	    auto answer = stream.receiveInt ();
+	    if (answer == VMProtocol::OK) return true;
+
+	    // The VM was adopted by an earlier handover whose answer was lost, its money was credited then
+	    return answer == VMProtocol::ERR && stream.receiveInt () == VMProtocolError::ALREADY_EXISTS;
+	}
+
+	json VMHandover::dump () const {
+	    return {
+		{"spec", this-> spec},
+		{"ip", this-> ip},
+		{"mac", this-> mac},
+		{"money", this-> money}
+	    };
+	}
+
+	VMHandover VMHandover::parse (const json & j) {
+	    VMHandover read;
+	    read.spec = j.at ("spec").get<std::string> ();
+	    read.ip = j.at ("ip").get<std::string> ();
+	    read.mac = j.at ("mac").get<std::string> ();
+	    read.money = j.at ("money").get<unsigned long> ();
+	    return read;
+	}
+
+	Migrator::~Migrator () {}
+
+	LibvirtMigrator::LibvirtMigrator (LibvirtClient & libvirt) :
+	    _libvirt (libvirt),
+	    _uri ("qemu+ssh://%s/system"),
+	    _sharedStorage (false)
+	{}
+
+	void LibvirtMigrator::setConfig (const MigrationConfig & cfg) {
+	    this-> _uri = cfg.uri;
+	    this-> _sharedStorage = cfg.sharedStorage;
+	}
+
+	bool LibvirtMigrator::migrate (const std::string & vm, const std::string & peer, unsigned long bandwidth) {
+	    auto uri = this-> _uri;
+	    uri.replace (uri.find ("%s"), 2, peer.substr (0, peer.find (':')));
+
+	    try {
+		this-> _libvirt.migrate (vm, uri, bandwidth, this-> _sharedStorage);
+		return true;
+	    } catch (const utils::exception & e) {
+		logging::error (e.msg);
+		return false;
+	    }
+	}
+
+	json MigrationDecision::dump () const {
+	    json j = {
+		{"migrated", this-> migrated},
+		{"reason", this-> reason},
+		{"pressure", this-> pressure},
+		{"streak", this-> streak}
+	    };
+
+	    if (this-> vm != "") {
+		j ["vm"] = this-> vm;
+		j ["peer"] = this-> peer;
+		j ["benefit"] = this-> benefit;
+		j ["cost"] = this-> cost;
+	    }
+
+	    if (!this-> unreached.empty ()) j ["unreached"] = this-> unreached;
+	    if (!this-> pending.empty ()) j ["pending"] = this-> pending;
+	    return j;
+	}
+
+	MigrationOrchestrator::MigrationOrchestrator (LibvirtClient & libvirt, server::market::Accounting & accounting, Migrator & migrator) :
+	    _libvirt (libvirt),
+	    _accounting (accounting),
+	    _migrator (migrator)
+	{}
+
+	void MigrationOrchestrator::setConfig (const MigrationConfig & cfg) {
+	    this-> _config = cfg;
+	}
+
+	const MigrationConfig & MigrationOrchestrator::getConfig () const {
+	    return this-> _config;
+	}
+
+	MigrationDecision MigrationOrchestrator::run (const HostSummary & local) {
+	    MigrationDecision decision;
+	    decision.pressure = local.pressure ();
+	    this-> retryAdoptions ();
+
+	    // The VMs that left the host are forgotten
+	    std::map <std::string, unsigned int> streaks;
+	    for (auto & v : local.vms) {
+		// When the market is not cleared no VM buys anything, they all miss the cycles the guarantees could not give
+		if (v.unmet > 0 || local.excess > 0) {
+		    auto it = this-> _streaks.find (v.id);
+		    streaks [v.id] = (it == this-> _streaks.end () ? 0 : it-> second) + 1;
+		}
+	    }
+
+	    this-> _streaks = std::move (streaks);
+	    if (decision.pressure > 0 && decision.pressure >= local.capacity * this-> _config.minPressure) this-> _hostStreak += 1;
+	    else this-> _hostStreak = 0;
+	    decision.streak = this-> _hostStreak;
+
+	    if (this-> _cooldown > 0) {
+		this-> _cooldown -= 1;
+		decision.reason = "cooldown";
+	    } else if (this-> _hostStreak == 0) {
+		decision.reason = "no-pressure";
+	    } else if (this-> _hostStreak < this-> _config.window) {
+		decision.reason = "pressure";
+	    } else {
+		Coordinator coordinator (this-> _config.peers, this-> _config.port);
+		ClusterConfig cfg;
+		cfg.timeout = this-> _config.timeout;
+		coordinator.setConfig (cfg);
+
+		std::vector <std::string> unreached;
+		auto peers = coordinator.collect (unreached);
+
+		decision = this-> choose (local, peers);
+		decision.unreached = std::move (unreached);
+		if (decision.reason == "") {
+		    auto outcome = this-> migrate (decision);
+		    decision.migrated = (outcome != MigrationOutcome::FAILED);
+		    decision.reason = outcome == MigrationOutcome::ADOPTED ? "migrated" : (outcome == MigrationOutcome::NOT_ADOPTED ? "not-adopted" : "failed");
+
+		    // A failed migration is not retried at once, the peer is probably not ready
+		    this-> _cooldown = this-> _config.cooldown;
+		    this-> _hostStreak = 0;
+		    if (decision.migrated) this-> _streaks.erase (decision.vm);
+		}
+	    }
+
+	    for (auto & p : this-> _pending) decision.pending.push_back (p.vm);
+	    this-> _last = decision;
+	    return decision;
+	}
+
+	MigrationDecision MigrationOrchestrator::choose (const HostSummary & local, const std::vector <HostSummary> & peers) const {
+	    MigrationDecision decision;
+	    decision.pressure = local.pressure ();
+	    decision.streak = this-> _hostStreak;
+
+	    // The candidates missed cycles during the whole window
+	    std::vector <const VMSummary*> candidates;
+	    for (auto & v : local.vms) {
+		auto it = this-> _streaks.find (v.id);
+		if (it != this-> _streaks.end () && it-> second >= this-> _config.window) candidates.push_back (&v);
+	    }
+
+	    if (candidates.empty ()) {
+		decision.reason = "no-candidate";
+		return decision;
+	    }
+
+	    // The cpu time a VM costs is its demand during the copy of its memory (dirtied pages, and the final pause of the VM)
+	    auto bandwidth = (double) this-> _config.bandwidth;
+	    auto cost = [bandwidth] (const VMSummary * v) {
+		return ((double) (v-> usage + v-> unmet)) / 1000000.0 * ((double) v-> memory) / bandwidth;
+	    };
+
+	    // The cheapest to move first, then the ones giving back the most cycles
+	    std::sort (candidates.begin (), candidates.end (), [&cost] (const VMSummary * a, const VMSummary * b) {
+		if (cost (a) != cost (b)) return cost (a) < cost (b);
+		if (a-> usage + a-> unmet != b-> usage + b-> unmet) return a-> usage + a-> unmet > b-> usage + b-> unmet;
+		return a-> id < b-> id;
+	    });
+
+	    // The pressure is expected to last at least as long as it already did
+	    double sustained = this-> _hostStreak * this-> _config.period;
+	    decision.reason = "no-peer";
+	    for (auto & v : candidates) {
+		auto demand = v-> usage + v-> unmet;
+		std::size_t best = peers.size ();
+		for (std::size_t p = 0 ; p < peers.size () ; p++) {
+		    if (best == peers.size () || peers [p].slack () > peers [best].slack () || (peers [p].slack () == peers [best].slack () && peers [p].host < peers [best].host)) best = p;
+		}
+
+		if (best == peers.size ()) break;
+
+		// As in the clearing of the coordinator, a VM too large for every peer moves if it gives back much more than it misses on the peer
+		auto relieved = std::min (demand, decision.pressure);
+		auto overflow = peers [best].slack () < demand ? demand - peers [best].slack () : 0;
+		if (overflow >= relieved || relieved - overflow < local.capacity * this-> _config.minPressure) continue;
+
+		double benefit = ((double) (relieved - overflow)) / 1000000.0 * sustained;
+		if (benefit >= this-> _config.ratio * cost (v) || decision.vm == "") {
+		    // The cheapest VM that could move is reported when none is worth it
+		    decision.vm = v-> id;
+		    decision.peer = peers [best].host;
+		    decision.benefit = benefit;
+		    decision.cost = cost (v);
+		}
+
+		if (benefit >= this-> _config.ratio * cost (v)) {
+		    decision.reason = "";
+		    return decision;
+		}
+
+		decision.reason = "below-ratio";
+	    }
+
+	    return decision;
+	}
+
+	MigrationOutcome MigrationOrchestrator::migrate (MigrationDecision & decision) {
+	    auto vm = this-> _libvirt.getVM (decision.vm);
+	    if (vm == nullptr) return MigrationOutcome::FAILED;
+
+	    pending handover;
+	    handover.vm = decision.vm;
+	    handover.peer = decision.peer;
+	    handover.handover.spec = toml::dump (vm-> spec ());
+	    handover.handover.ip = vm-> ip ();
+	    handover.handover.mac = vm-> mac ();
+
+	    logging::info ("Migrate", decision.vm, "to", decision.peer, "benefit", decision.benefit, "cost", decision.cost);
+	    if (!this-> _migrator.migrate (decision.vm, decision.peer, this-> _config.bandwidth)) {
+		return MigrationOutcome::FAILED;
+	    }
+
+	    // The cpu money follows the VM, it only leaves the accounting once the daemon of the peer took it
+	    handover.handover.money = this-> _accounting.balance (decision.vm, server::market::resource::CPU);
+	    if (this-> adopt (handover)) {
+		this-> _accounting.debit (decision.vm, server::market::resource::CPU, handover.handover.money);
+		return MigrationOutcome::ADOPTED;
+	    }
+
+	    // The VM left the host, its wallet would be forgotten at the next tick of the market, the money is held until the peer adopts it
+	    logging::error ("VM", decision.vm, "runs on", decision.peer, "but was not adopted by its daemon, retrying at the next period");
+	    handover.handover.money = this-> _accounting.debit (decision.vm, server::market::resource::CPU, handover.handover.money);
+	    this-> _pending.push_back (std::move (handover));
+	    return MigrationOutcome::NOT_ADOPTED;
+	}
+
+	bool MigrationOrchestrator::adopt (const pending & handover) const {
+	    auto sep = handover.peer.find (':');
+	    try {
+		TcpStream client (SockAddrV4 (Ipv4Address::resolve (handover.peer.substr (0, sep)), SockAddrV4::parsePort (handover.peer.substr (sep + 1))));
+		client.connect (this-> _config.timeout);
+		auto adopted = handover.handover.send (client);
+		client.close ();
+		return adopted;
+	    } catch (const utils::exception & e) {
+		logging::error (e.msg);
+	    } catch (const std::exception & e) {
+		logging::error (e.what ());
+	    }
+
+	    return false;
+	}
+
+	void MigrationOrchestrator::retryAdoptions () {
+	    for (auto it = this-> _pending.begin () ; it != this-> _pending.end () ; ) {
+		if (this-> adopt (*it)) {
+		    logging::info ("VM", it-> vm, "adopted by", it-> peer);
+		    it = this-> _pending.erase (it);
+		} else it++;
+	    }
+	}
+
+	json MigrationOrchestrator::dumpLogs () const {
+	    return this-> _last.dump ();
+	}
+
+    }
+
+}
@@ -0,0 +1,314 @@
+#pragma once
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <monitor/libvirt/_.hh>
+#include <monitor/net/stream.hh>
+#include <server/market/accounting.hh>
+#include <server/cluster/summary.hh>
+#include <nlohmann/json.hpp>
+
+namespace server {
+
+    namespace cluster {
+
+	struct MigrationConfig {
+	    /// The time between two decisions of the orchestrator in seconds
+	    float period = 10.0f;
+
+	    /// The number of consecutive periods the host must be under pressure before a VM is moved
+	    unsigned int window = 3;
+
+	    /// The share of the cpus missing on the host (demand not bought, or guarantees over the cpus) to be under pressure
+	    float minPressure = 0.05f;
+
+	    /// The maximal bandwidth of a migration in MiB/s
+	    unsigned long bandwidth = 100;
+
+	    /// The minimal ratio between the cpu time a migration gives back and the cpu time it costs
+	    float ratio = 2.0f;
+
+	    /// The number of periods without migration after a migration (or a failed one)
+	    unsigned int cooldown = 6;
+
+	    /// The maximal time of connection and of each exchange with a peer in seconds
+	    float timeout = 5.0f;
+
+	    /// The daemons of the hosts that can receive the VMs (host[:port], the port is required if port is not set)
+	    std::vector <std::string> peers;
+
+	    /// The port of the peers not given in peers
+	    unsigned short port = 0;
+
+	    /// The uri of the hypervisor of a peer (%s is replaced by the name of the host)
+	    std::string uri = "qemu+ssh://%s/system";
+
+	    /// True iif the drives of the VMs are reachable from the peers at the same path (they are copied otherwise)
+	    bool sharedStorage = false;
+
+	    /**
+	     * Read a configuration from the content of a migration.json file
+	     * @throws:
+	     *   - utils::exception: if a value is invalid, or if the port of a peer is unknown
+	     *   - nlohmann::json::exception: if a key has the wrong type
+	     */
+	    static MigrationConfig parse (const nlohmann::json & j);
+	};
+
+	/**
+	 * A VM running on a peer after its migration, and that its daemon must adopt (cf. VMProtocol::ADOPT)
+	 */
+	struct VMHandover {
+	    /// The specification of the VM (as given to the dio-client)
+	    std::string spec;
+
+	    /// The ip address of the VM
+	    std::string ip;
+
+	    /// The mac address of the VM
+	    std::string mac;
+
+	    /// The cpu money following the VM
+	    unsigned long money = 0;
+
+	    /**
+	     * Send the handover to the daemon of the peer
+	     * @returns: true iif the daemon adopted the VM, now or at an earlier handover (it answers ALREADY_EXISTS)
+	     */
+	    bool send (monitor::net::TcpStream & stream) const;
+
+	    /**
+	     * @returns: the handover in json
+	     */
+	    nlohmann::json dump () const;
+
+	    /**
+	     * Read a handover sent by a daemon
+	     * @throws:
+	     *   - nlohmann::json::exception: if a key is missing, or has the wrong type
+	     */
+	    static VMHandover parse (const nlohmann::json & j);
+	};
+
+	/**
+	 * The mover of the VMs to the peers
+	 */
+	class Migrator {
+	public:
+
+	    /**
+	     * Move a running VM to a peer
+	     * @params:
+	     *   - vm: the name of the VM
+	     *   - peer: the daemon of the peer (host:port)
+	     *   - bandwidth: the maximal bandwidth of the migration in MiB/s
+	     * @returns: true iif the VM runs on the peer, and not anymore here
+	     */
+	    virtual bool migrate (const std::string & vm, const std::string & peer, unsigned long bandwidth) = 0;
+
+	    virtual ~Migrator ();
+	};
+
+	/**
+	 * The live migration of the domains of the VMs by libvirt
+	 */
+	class LibvirtMigrator : public Migrator {
+
+	    /// The libvirt connection
+	    monitor::libvirt::LibvirtClient & _libvirt;
+
+	    /// The uri of the hypervisor of a peer (%s is replaced by the name of the host)
+	    std::string _uri;
+
+	    /// True iif the drives of the VMs are reachable from the peers
+	    bool _sharedStorage;
+
+	public:
+
+	    LibvirtMigrator (monitor::libvirt::LibvirtClient & libvirt);
+
+	    /**
+	     * Change the uri of the peers, and the storage of the VMs
+	     */
+	    void setConfig (const MigrationConfig & cfg);
+
+	    bool migrate (const std::string & vm, const std::string & peer, unsigned long bandwidth) override;
+
+	};
+
+	/**
+	 * The outcome of the migration of a VM
+	 */
+	enum class MigrationOutcome {
+	    /// The VM still runs on the host
+	    FAILED,
+	    /// The VM runs on the peer, but its daemon did not adopt it (its money is held by the orchestrator)
+	    NOT_ADOPTED,
+	    /// The VM runs on the peer, and its daemon took it with its money
+	    ADOPTED
+	};
+
+	/**
+	 * The outcome of a period of the migration orchestrator
+	 */
+	struct MigrationDecision {
+	    /// True iif a VM left the host (even if the daemon of the peer did not adopt it)
+	    bool migrated = false;
+
+	    /// Why a VM was moved or not (pressure, cooldown, no-candidate, failed, not-adopted, migrated, ...)
+	    std::string reason;
+
+	    /// The cpu time missing on the host
+	    unsigned long pressure = 0;
+
+	    /// The number of consecutive periods the host was under pressure
+	    unsigned int streak = 0;
+
+	    /// The VM chosen (if any)
+	    std::string vm;
+
+	    /// The peer chosen (if any)
+	    std::string peer;
+
+	    /// The cpu time (in seconds of one cpu) the migration gives back
+	    double benefit = 0.0;
+
+	    /// The cpu time (in seconds of one cpu) the migration costs
+	    double cost = 0.0;
+
+	    /// The peers whose daemon did not answer
+	    std::vector <std::string> unreached;
+
+	    /// The VMs moved to a peer whose daemon did not adopt them yet
+	    std::vector <std::string> pending;
+
+	    /**
+	     * @returns: the decision in json
+	     */
+	    nlohmann::json dump () const;
+	};
+
+	/**
+	 * The orchestrator of the live migrations of the VMs of a host under a sustained market pressure
+	 * The cpu market of a host cannot do anything when the guaranteed cycles are over the cpus, or when its VMs fail to buy cycles tick after tick.
+	 * At each period, the orchestrator reads the last summary of the market (cf. HostSummary) :
+	 *    - the host is under pressure if the cpu time it misses is more than minPressure of its cpus, it must stay so window periods
+	 *    - the VMs that missed cycles during the whole window are the candidates, the cheapest to move first (the time to copy their memory at the bandwidth)
+	 *    - a candidate is moved if the cpu time it gives back (its demand, bounded by the pressure, during the time the pressure already lasted) is ratio times its cost (its demand during the copy)
+	 *    - it is moved to the peer with the most cycles left that can hold its whole demand, and the daemon of the peer adopts it with its cpu money
+	 * After a migration (or a failed one), no VM is moved during cooldown periods, so the markets of both hosts settle before the next decision.
+	 * The money of a moved VM leaves the accounting only once the daemon of the peer adopted it, the adoptions that failed are retried at each period.
+	 */
+	class MigrationOrchestrator {
+
+	    /**
+	     * A VM moved to a peer, that its daemon must adopt
+	     */
+	    struct pending {
+		/// The name of the VM
+		std::string vm;
+
+		/// The daemon of the peer (host:port)
+		std::string peer;
+
+		/// The VM and its money
+		VMHandover handover;
+	    };
+
+	    /// The libvirt connection
+	    monitor::libvirt::LibvirtClient & _libvirt;
+
+	    /// The accounting of the money of the VMs
+	    server::market::Accounting & _accounting;
+
+	    /// The mover of the VMs
+	    Migrator & _migrator;
+
+	    /// The configuration of the orchestrator
+	    MigrationConfig _config;
+
+	    /// The number of consecutive periods each VM missed cycles
+	    std::map <std::string, unsigned int> _streaks;
+
+	    /// The number of consecutive periods the host was under pressure
+	    unsigned int _hostStreak = 0;
+
+	    /// The number of periods left without migration
+	    unsigned int _cooldown = 0;
+
+	    /// The last decision of the orchestrator
+	    MigrationDecision _last;
+
+	    /// The VMs moved to a peer whose daemon did not adopt them yet
+	    std::list <pending> _pending;
+
+	public:
+
+	    /**
+	     * @params:
+	     *   - libvirt: the client owning the running VMs
+	     *   - accounting: the accounting of the money of the VMs
+	     *   - migrator: the mover of the VMs
+	     */
+	    MigrationOrchestrator (monitor::libvirt::LibvirtClient & libvirt, server::market::Accounting & accounting, Migrator & migrator);
+
+	    /**
+	     * Change the configuration of the orchestrator
+	     * @info: the pressure already observed is kept
+	     */
+	    void setConfig (const MigrationConfig & cfg);
+
+	    /**
+	     * @returns: the configuration of the orchestrator
+	     */
+	    const MigrationConfig & getConfig () const;
+
+	    /**
+	     * Run a period of the orchestrator
+	     * @params:
+	     *   - local: the summary of the last tick of the cpu market of the host
+	     * @returns: the decision of the period
+	     * @warning: blocks during the migration of a VM
+	     */
+	    MigrationDecision run (const HostSummary & local);
+
+	    /**
+	     * Choose the VM to move, and its peer
+	     * @params:
+	     *   - local: the summary of the host
+	     *   - peers: the summaries of the peers (with their name)
+	     * @returns: the decision (reason is no-candidate, no-peer or below-ratio if no VM should move)
+	     */
+	    MigrationDecision choose (const HostSummary & local, const std::vector <HostSummary> & peers) const;
+
+	    /**
+	     * @returns: the last decision in json
+	     */
+	    nlohmann::json dumpLogs () const;
+
+	private:
+
+	    /**
+	     * Move a VM to a peer, and hand it over to the daemon of the peer
+	     * @returns: FAILED if the VM still runs here, NOT_ADOPTED if the daemon of the peer did not take it (it is then pending)
+	     */
+	    MigrationOutcome migrate (MigrationDecision & decision);
+
+	    /**
+	     * Send a handover to the daemon of its peer
+	     * @returns: true iif the daemon adopted the VM
+	     * @info: never throws, the errors are logged
+	     */
+	    bool adopt (const pending & handover) const;
+
+	    /**
+	     * Send again the handovers the daemons of the peers did not adopt
+	     */
+	    void retryAdoptions ();
+
+	};
+
+    }
+
+}
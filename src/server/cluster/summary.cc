@@ -0,0 +1,173 @@
+#include "summary.hh"
+#include <algorithm>
+#include <map>
+#include <monitor/libvirt/proto.hh>
+
+using namespace monitor::libvirt;
+using json = nlohmann::json;
+
+namespace server {
+
+    namespace cluster {
+
+	json VMSummary::dump () const {
+	    return {
+		{"id", this-> id},
+		{"vcpus", this-> vcpus},
+		{"memory", this-> memory},
+		{"usage", this-> usage},
+		{"allocated", this-> allocated},
+		{"unmet", this-> unmet},
+		{"money", this-> money}
+	    };
+	}
+
+	VMSummary VMSummary::parse (const json & j) {
+	    VMSummary read;
+	    read.id = j.at ("id").get<std::string> ();
+	    read.vcpus = j.at ("vcpus").get<int> ();
+	    read.memory = j.at ("memory").get<int> ();
+	    read.usage = j.at ("usage").get<unsigned long> ();
+	    read.allocated = j.at ("allocated").get<unsigned long> ();
+	    read.unmet = j.at ("unmet").get<unsigned long> ();
+	    read.money = j.at ("money").get<unsigned long> ();
+	    return read;
+	}
+
+	unsigned long HostSummary::demand () const {
+	    unsigned long total = 0;
+	    for (auto & v : this-> vms) total += v.usage + v.unmet;
+	    return total;
+	}
+
+	unsigned long HostSummary::unmet () const {
+	    unsigned long total = 0;
+	    for (auto & v : this-> vms) total += v.unmet;
+	    return total;
+	}
+
+	unsigned long HostSummary::slack () const {
+	    auto sold = (unsigned long) (this-> capacity * this-> supply);
+	    auto wanted = this-> demand ();
+	    return sold > wanted ? sold - wanted : 0;
+	}
+
+	unsigned long HostSummary::pressure () const {
+	    return this-> unmet () + this-> excess;
+	}
+
+	/**
+	 * @returns: the cpu time wanted above its allocation by an entry of the market (a vcpu, or a VM)
+	 * @params:
+	 *   - max: the maximal allocation of the entry
+	 */
+	static unsigned long refused (unsigned long allocated, unsigned long buying, unsigned long max, const server::market::VCPUMarketConfig & cfg) {
+	    if (buying == 0) return 0;
+
+	    auto wanted = std::min (max, (unsigned long) (allocated * (1.0 + cfg.increasingSpeed)));
+	    return std::max (buying, wanted > allocated ? wanted - allocated : 0UL);
+	}
+
+	HostSummary HostSummary::collect (LibvirtClient & client, server::market::Accounting & accounting, const server::market::VCPUMarketConfig & cfg, float supply) {
+	    HostSummary summary;
+	    int nbCpus = cfg.nbCpus > 0 ? cfg.nbCpus : client.getNbCpus ();
+	    summary.capacity = ((unsigned long) nbCpus) * 1000000;
+	    summary.supply = supply;
+
+	    for (auto & v : client.getRunningVMs ()) {
+		VMSummary vm;
+		vm.id = v-> id ();
+		vm.vcpus = v-> vcpus ();
+		vm.memory = v-> memory ();
+		vm.money = accounting.available (v-> id (), server::market::resource::CPU);
+		if (cfg.vmLevel) { // the market allocates the cycles to the whole VM
+		    auto & cpu = v-> getCPUController ();
+		    vm.usage = cpu.getConsumption ();
+		    vm.allocated = cpu.allocated ();
+		    vm.unmet = refused (cpu.allocated (), cpu.buying (), cpu.getMaxConsumption (), cfg);
+		} else {
+		    for (auto & vcpu : v-> getVCPUControllers ()) {
+			vm.usage += vcpu.getConsumption ();
+			vm.allocated += vcpu.allocated ();
+			vm.unmet += refused (vcpu.allocated (), vcpu.buying (), 1000000, cfg);
+		    }
+		}
+
+		summary.vms.push_back (vm);
+	    }
+
+	    return summary;
+	}
+
+	HostSummary HostSummary::mean (const std::vector <HostSummary> & ticks) {
+	    if (ticks.empty ()) return HostSummary ();
+
+	    auto summary = ticks.back ();
+	    std::map <std::string, std::size_t> index;
+	    for (std::size_t i = 0 ; i < summary.vms.size () ; i++) {
+		index.emplace (summary.vms [i].id, i);
+		summary.vms [i].usage = 0;
+		summary.vms [i].allocated = 0;
+		summary.vms [i].unmet = 0;
+	    }
+
+	    summary.excess = 0;
+	    for (auto & t : ticks) {
+		summary.excess += t.excess;
+		for (auto & v : t.vms) {
+		    auto it = index.find (v.id);
+		    if (it == index.end ()) continue; // the VM left the host during the period
+
+		    auto & vm = summary.vms [it-> second];
+		    vm.usage += v.usage;
+		    vm.allocated += v.allocated;
+		    vm.unmet += v.unmet;
+		}
+	    }
+
+	    auto nb = (unsigned long) ticks.size ();
+	    summary.excess /= nb;
+	    for (auto & vm : summary.vms) {
+		vm.usage /= nb;
+		vm.allocated /= nb;
+		vm.unmet /= nb;
+	    }
+
+	    return summary;
+	}
+
+	void HostSummary::send (monitor::net::TcpStream & stream) const {
+	    auto content = this-> dump ().dump ();
+	    stream.sendInt (VMProtocol::SUMMARY);
+	    stream.sendInt (content.length ());
+	    stream.send (content);
+	}
+
+	json HostSummary::dump () const {
+	    json vms = json::array ();
+	    for (auto & v : this-> vms) vms.push_back (v.dump ());
+
+	    json j = {
+		{"capacity", this-> capacity},
+		{"supply", this-> supply},
+		{"excess", this-> excess},
+		{"vms", vms}
+	    };
+
+	    if (this-> host != "") j ["host"] = this-> host;
+	    return j;
+	}
+
+	HostSummary HostSummary::parse (const json & j) {
+	    HostSummary read;
+	    read.host = j.contains ("host") ? j.at ("host").get<std::string> () : "";
+	    read.capacity = j.at ("capacity").get<unsigned long> ();
+	    read.supply = j.at ("supply").get<float> ();
+	    read.excess = j.contains ("excess") ? j.at ("excess").get<unsigned long> () : 0;
+	    for (auto & v : j.at ("vms")) read.vms.push_back (VMSummary::parse (v));
+	    return read;
+	}
+
+    }
+
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <monitor/libvirt/_.hh>
+#include <monitor/net/stream.hh>
+#include <server/market/accounting.hh>
+#include <server/market/vcpu.hh>
+#include <nlohmann/json.hpp>
+
+namespace server {
+
+    namespace cluster {
+
+	/**
+	 * The demand of a VM during the last tick of the cpu market of its host
+	 * @info: the cpu times are in microseconds per second (1000000 is one cpu), as the allocations of the markets
+	 */
+	struct VMSummary {
+	    /// The name of the VM
+	    std::string id;
+
+	    /// The number of vcpus of the VM
+	    int vcpus = 0;
+
+	    /// The memory of the VM in MB (the cost of its migration)
+	    int memory = 0;
+
+	    /// The cpu time consumed by the VM
+	    unsigned long usage = 0;
+
+	    /// The cpu time allocated to the VM by the market
+	    unsigned long allocated = 0;
+
+	    /// The cpu time the VM wanted above its allocation (cf. HostSummary::collect)
+	    unsigned long unmet = 0;
+
+	    /// The cpu money available to the VM
+	    unsigned long money = 0;
+
+	    /**
+	     * @returns: the summary in json
+	     */
+	    nlohmann::json dump () const;
+
+	    /**
+	     * Read a summary dumped by a daemon
+	     * @throws:
+	     *   - nlohmann::json::exception: if a key is missing, or has the wrong type
+	     */
+	    static VMSummary parse (const nlohmann::json & j);
+	};
+
+	/**
+	 * The supply and the demand of the cpu market of a host, sent by the daemons to the cluster coordinator (cf. VMProtocol::SUMMARY)
+	 */
+	struct HostSummary {
+	    /// The address of the daemon (host:port, set by the coordinator)
+	    std::string host;
+
+	    /// The cpu time of all the cpus of the host
+	    unsigned long capacity = 0;
+
+	    /// The share of the cpus sold by the market
+	    float supply = 1.0f;
+
+	    /// The cpu time by which the guaranteed cycles exceeded the cpus (the market could not be cleared)
+	    unsigned long excess = 0;
+
+	    /// The VMs running on the host
+	    std::vector <VMSummary> vms;
+
+	    /**
+	     * @returns: the cpu time wanted by the VMs (consumed or not bought)
+	     */
+	    unsigned long demand () const;
+
+	    /**
+	     * @returns: the cpu time the VMs wanted to buy, and could not
+	     */
+	    unsigned long unmet () const;
+
+	    /**
+	     * @returns: the cpu time sold by the market that no VM wants
+	     */
+	    unsigned long slack () const;
+
+	    /**
+	     * @returns: the cpu time missing on the host (the demand not bought, and the guarantees not held by the cpus)
+	     */
+	    unsigned long pressure () const;
+
+	    /**
+	     * Summarize the last tick of the cpu market of a host
+	     * @info: the demand of a vcpu refused by the market is hidden by its quota (it consumes its whole allocation, and bids a percent more when its consumption is stable),
+	     * so it is assumed to want the increment of the market above its allocation, as a vcpu over the increment trigger, instead of what it bid at this tick
+	     * @params:
+	     *   - client: the client owning the running VMs
+	     *   - accounting: the accounting of the money of the VMs
+	     *   - cfg: the configuration of the cpu market (its number of cpus, and its mode)
+	     *   - supply: the share of the cpus sold by the market
+	     * @warning: must be called between two ticks of the market
+	     */
+	    static HostSummary collect (monitor::libvirt::LibvirtClient & client, server::market::Accounting & accounting, const server::market::VCPUMarketConfig & cfg, float supply);
+
+	    /**
+	     * Summarize a period of several ticks of the cpu market of a host
+	     * @info: the cpu times of a VM are averaged over all the ticks (a tick where the VM was not running counts for nothing), its money is the one of the last tick
+	     * @params:
+	     *   - ticks: the summaries of the ticks of the period, in order
+	     * @returns: the mean of the ticks, with the VMs still running at the last tick
+	     */
+	    static HostSummary mean (const std::vector <HostSummary> & ticks);
+
+	    /**
+	     * Send the summary to a coordinator (the answer of a VMProtocol::SUMMARY request)
+	     */
+	    void send (monitor::net::TcpStream & stream) const;
+
+	    /**
+	     * @returns: the summary in json
+	     */
+	    nlohmann::json dump () const;
+
+	    /**
+	     * Read a summary dumped by a daemon
+	     * @throws:
+	     *   - nlohmann::json::exception: if a key is missing, or has the wrong type
+	     */
+	    static HostSummary parse (const nlohmann::json & j);
+	};
+
+    }
+
+}
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <sys/sysinfo.h>
 #include <monitor/utils/log.hh>
 
 using namespace monitor;
@@ -15,12 +16,59 @@ using json = nlohmann::json;
 
 namespace server {
 
-    Controller::Controller (monitor::libvirt::LibvirtClient & client) :
+    Controller::Controller (monitor::libvirt::LibvirtClient & client, Journal & journal) :
 	_libvirt (client),
+	_journal (journal),
 	_vcpuMarketEnabled (false),
-	_vcpuMarket (client)
+	_configPath ("/usr/lib/dio"),
+	_hasPendingConfig (false),
+	_pendingEnabled (false),
+	_vcpuMarket (client, _accounting),
+	_cpuMarket (client, _accounting),
+	_cpuMarketVMLevel (false),
+	_memMarketEnabled (false),
+	_memPeriod (5.0f),
+	_memMarket (client, _accounting),
+	_ioMarketEnabled (false),
+	_ioPeriod (2.0f),
+	_ioMarket (client, _accounting),
+	_placementEnabled (false),
+	_placement (client),
+	_dvfsEnabled (false),
+	_dvfs (client),
+	_energy (client),
+	_powerCapEnabled (false),
+	_migrationEnabled (false),
+	_migrator (client),
+	_orchestrator (client, _accounting, _migrator)
     {
-	this-> readCpuMarketConfig ();
+	this-> readAccountingConfig ();
+
+	market::VCPUMarketConfig cfg;
+	if (!this-> readCpuMarketConfig (this-> _vcpuMarketEnabled, cfg)) {
+	    this-> _vcpuMarketEnabled = false;
+	}
+
+	if (this-> _vcpuMarketEnabled) {
+	    this-> _vcpuMarket.setConfig (cfg);
+	    this-> _cpuMarket.setConfig (cfg);
+	    this-> _cpuMarketVMLevel = cfg.vmLevel;
+	    logging::info ("CPU Market enabled", cfg.vmLevel ? "(VM level)" : "(vcpu level)");
+	} else {
+	    logging::warn ("CPU Market disabled");
+	}
+
+	this-> readMemMarketConfig ();
+	this-> readIOMarketConfig ();
+	this-> readPlacementConfig ();
+	if (this-> _placementEnabled && this-> _placement.getConfig ().frequencyTiers && this-> _vcpuMarketEnabled && !cfg.realCycles) {
+	    // The quotas would be computed for the frequency of the host, and the slowed down VMs would not get their nominal cycles
+	    logging::warn ("Frequency tiers without real-cycles in the cpu market");
+	}
+
+	this-> readDvfsConfig ();
+	this-> readPowerCapConfig ();
+	this-> readMigrationConfig ();
 	
     	fs::create_directories ("/var/log/dio");
 	::remove (fs::path ("/var/log/dio/control-log.json").c_str ());
@@ -29,6 +77,18 @@ namespace server {
 
     void Controller::start () {
 	this-> _cpuLoopTh = monitor::concurrency::spawn (this, &Controller::cpuControlLoop);
+	this-> _configTh = monitor::concurrency::spawn (this, &Controller::configWatchLoop);
+	if (this-> _memMarketEnabled) {
+	    this-> _memLoopTh = monitor::concurrency::spawn (this, &Controller::memControlLoop);
+	}
+
+	if (this-> _ioMarketEnabled) {
+	    this-> _ioLoopTh = monitor::concurrency::spawn (this, &Controller::ioControlLoop);
+	}
+
+	if (this-> _migrationEnabled) {
+	    this-> _migLoopTh = monitor::concurrency::spawn (this, &Controller::migrationLoop);
+	}
     }
 
     void Controller::join () {
@@ -37,32 +97,121 @@ namespace server {
 
     void Controller::kill () {
 	monitor::concurrency::kill (this-> _cpuLoopTh);
+	monitor::concurrency::kill (this-> _configTh);
+	if (this-> _memMarketEnabled) {
+	    monitor::concurrency::kill (this-> _memLoopTh);
+	}
+
+	if (this-> _ioMarketEnabled) {
+	    monitor::concurrency::kill (this-> _ioLoopTh);
+	}
+
+	if (this-> _migrationEnabled) {
+	    monitor::concurrency::kill (this-> _migLoopTh);
+	}
+
+	// The cpus are not left slowed down when the monitor stops
+	if (this-> _placementEnabled) {
+	    this-> _placement.release ();
+	}
+
+	if (this-> _dvfsEnabled) {
+	    this-> _dvfs.release ();
+	}
     }
 
     void Controller::resetMarketCounters () {
 	this-> _mutex.lock ();
+	this-> _vcpuMutex.lock ();
 	if (this-> _vcpuMarketEnabled) {
-	    this-> _vcpuMutex.lock ();
+	    // Both markets use the money of the VMs
 	    this-> _vcpuMarket.reset ();
-	    this-> _vcpuMutex.unlock ();
 	}
+	this-> _vcpuMutex.unlock ();
+
+	this-> _memMutex.lock ();
+	this-> _memMarket.reset ();
+	this-> _memMutex.unlock ();
+
+	this-> _ioMutex.lock ();
+	this-> _ioMarket.reset ();
+	this-> _ioMutex.unlock ();
 
 	::remove (fs::path ("/var/log/dio/control-log.json").c_str ());
 	this-> _mutex.unlock ();
     }
     
+    market::Accounting & Controller::getAccounting () {
+	return this-> _accounting;
+    }
+
+    json Controller::getLastLogs () {
+	this-> _mutex.lock ();
+	auto ret = this-> _lastLogs;
+	this-> _mutex.unlock ();
+	
+	return ret;
+    }
+
+    cluster::HostSummary Controller::getLastSummary () {
+	this-> _mutex.lock ();
+	auto ret = this-> _lastSummary;
+	this-> _mutex.unlock ();
+
+	return ret;
+    }
+
+    cluster::HostSummary Controller::takePeriodSummary () {
+	this-> _mutex.lock ();
+	auto ret = this-> _periodSummaries.empty () ? this-> _lastSummary : cluster::HostSummary::mean (this-> _periodSummaries);
+	this-> _periodSummaries.clear ();
+	this-> _mutex.unlock ();
+
+	return ret;
+    }
+    
     void Controller::cpuControlLoop (monitor::concurrency::thread th) {
 	int i = 0; 
 	for (;;) {
+	    if (this-> _libvirt.hasRemoved ()) this-> releaseRemovedVMs ();
 	    this-> _libvirt.updateVCPUControllers ();
 	    if (i == 1) {
 		this-> _libvirt.updateVCPUBeforeMarket ();
+		if (this-> _placementEnabled) this-> _placement.run ();
+
+		this-> _vcpuMutex.lock ();
+		this-> swapCpuMarketConfig ();
+		if (this-> _powerCapEnabled) {
+		    // The power of the last tick, read when its logs were dumped
+		    auto supply = this-> _powerCap.run (this-> _rapl.getPower ());
+		    this-> _vcpuMarket.setSupply (supply);
+		    this-> _cpuMarket.setSupply (supply);
+		}
+		if (this-> _vcpuMarketEnabled) {
+		    if (this-> _cpuMarketVMLevel) {
+			this-> _cpuMarket.run ();
+		    } else {
+			this-> _vcpuMarket.run ();
+		    }
+		}
+
+		auto summary = cluster::HostSummary::collect (this-> _libvirt, this-> _accounting, this-> _vcpuMarket.getConfig (), this-> _vcpuMarket.getSupply ());
 		if (this-> _vcpuMarketEnabled) {
-		    this-> _vcpuMutex.lock ();
-		    this-> _vcpuMarket.run ();
-		    this-> _vcpuMutex.unlock ();
+		    summary.excess = this-> _cpuMarketVMLevel ? this-> _cpuMarket.getExcess () : this-> _vcpuMarket.getExcess ();
 		}
-		
+		this-> _vcpuMutex.unlock ();
+
+		this-> _mutex.lock ();
+		if (this-> _migrationEnabled) this-> _periodSummaries.push_back (summary);
+		this-> _lastSummary = std::move (summary);
+		this-> _mutex.unlock ();
+
+		if (this-> _dvfsEnabled) {
+		    if (this-> _placementEnabled) this-> _dvfs.setCeilings (this-> _placement.getFrequencyLimits ());
+		    this-> _dvfs.run ();
+		}
+
+		this-> _journal.recordTick (this-> _libvirt.getRunningVMs (), this-> _accounting);
 		this-> dumpCpuLogs ();
 		i = 0;
 	    }	    
@@ -71,6 +220,83 @@ namespace server {
 	}
     }
     
+    void Controller::memControlLoop (monitor::concurrency::thread th) {
+	for (;;) {
+	    this-> _memT.reset ();
+
+	    // The VMs migrated away are released with the mutex
+	    this-> _memMutex.lock ();
+	    this-> _libvirt.updateMemoryControllers ();
+	    this-> _memMarket.run ();
+	    this-> _memMutex.unlock ();
+
+	    auto r = this-> _memPeriod - this-> _memT.time_since_start ();
+	    if (r > 0.f) {
+		this-> _memT.sleep (r);
+	    }
+	}
+    }
+
+    void Controller::ioControlLoop (monitor::concurrency::thread th) {
+	for (;;) {
+	    this-> _ioT.reset ();
+
+	    this-> _ioMutex.lock ();
+	    this-> _libvirt.updateIOControllers ();
+	    this-> _ioMarket.run ();
+	    this-> _ioMutex.unlock ();
+
+	    auto r = this-> _ioPeriod - this-> _ioT.time_since_start ();
+	    if (r > 0.f) {
+		this-> _ioT.sleep (r);
+	    }
+	}
+    }
+
+    void Controller::migrationLoop (monitor::concurrency::thread th) {
+	for (;;) {
+	    this-> _migT.reset ();
+	    cluster::MigrationDecision decision;
+	    try {
+		decision = this-> _orchestrator.run (this-> takePeriodSummary ());
+	    } catch (const utils::exception & e) {
+		logging::error ("Migration period failed :", e.msg);
+		decision.reason = "error";
+	    } catch (const std::exception & e) {
+		logging::error ("Migration period failed :", e.what ());
+		decision.reason = "error";
+	    }
+
+	    // A VM not adopted by the daemon of the peer still left the host
+	    if (decision.migrated) {
+		this-> _journal.recordKill (decision.vm);
+		if (decision.reason == "not-adopted") logging::warn ("VM", decision.vm, "moved to", decision.peer, "but not adopted yet");
+	    } else if (decision.reason == "failed") {
+		logging::warn ("Migration of", decision.vm, "to", decision.peer, "failed");
+	    }
+
+	    this-> _mutex.lock ();
+	    this-> _lastMigration = decision.dump ();
+	    this-> _mutex.unlock ();
+
+	    auto r = this-> _orchestrator.getConfig ().period - this-> _migT.time_since_start ();
+	    if (r > 0.f) {
+		this-> _migT.sleep (r);
+	    }
+	}
+    }
+
+    void Controller::releaseRemovedVMs () {
+	// Called by the cpu loop between two frames, the other loops using the VMs are waited for
+	this-> _vcpuMutex.lock ();
+	this-> _memMutex.lock ();
+	this-> _ioMutex.lock ();
+	this-> _libvirt.releaseRemoved ();
+	this-> _ioMutex.unlock ();
+	this-> _memMutex.unlock ();
+	this-> _vcpuMutex.unlock ();
+    }
+
     void Controller::waitCpuFrame () {
 	auto s = std::chrono::system_clock::now ();
 	auto r = 1.f - this-> _cpuT.time_since_start ();
@@ -82,51 +308,382 @@ namespace server {
     }    
 
     
-    void Controller::readCpuMarketConfig (const fs::path & path) {
-	std::ifstream f (path / "cpu-market.json");	
+    bool Controller::readCpuMarketConfig (bool & enabled, market::VCPUMarketConfig & cfg) {
+	std::ifstream f (this-> _configPath / "cpu-market.json");
+	if (!f.good ()) {
+	    enabled = false;
+	    return true;
+	}
+
+	std::stringstream ss;
+	ss << f.rdbuf ();
+	f.close ();
+
+	try {
+	    auto j = json::parse (ss.str ());
+	    auto isEnabled = j.contains ("enable") && j["enable"].is_boolean () && j["enable"].get<bool> ();
+	    if (!isEnabled) {
+		enabled = false;
+		return true;
+	    }
+
+	    auto read = market::VCPUMarketConfig::parse (j);
+	    enabled = true;
+	    cfg = read;
+	    return true;
+	} catch (const utils::exception & e) {
+	    logging::error ("Invalid cpu market configuration :", e.msg);
+	} catch (const json::exception & e) {
+	    logging::error ("Invalid cpu market configuration :", e.what ());
+	}
+
+	return false;
+    }
+
+    void Controller::readAccountingConfig () {
+	std::ifstream f (this-> _configPath / "accounting.json");
+	market::AccountingConfig cfg;
+	cfg.ledgerPath = "/var/log/dio/ledger.json";
 	if (f.good ()) {
 	    std::stringstream ss;
 	    ss << f.rdbuf ();
 	    f.close ();
-	    auto j = json::parse (ss.str ());
 
-	    if (j.contains ("enable") && j["enable"].is_boolean ()) {
-		this-> _vcpuMarketEnabled = j["enable"].get<bool> ();
-	    }
-
-	    if (this-> _vcpuMarketEnabled) {
-		auto marketConfig = market::VCPUMarketConfig {
-		    j["frequency"].get<int> (),
-		    j["trigger-increment"].get<float> () / 100.0f,
-		    j["trigger-decrement"].get<float> () / 100.0f,
-		    j["increment-speed"].get<float> () / 100.0f,
-		    j["decrement-speed"].get<float> () / 100.0f,
-		    j["window-size"].get<unsigned long> ()
-		};
-		this-> _vcpuMarket.setConfig (marketConfig);
-	    }	    	    
+	    try {
+		auto j = json::parse (ss.str ());
+		cfg.decay = j.contains ("decay") ? j["decay"].get<float> () / 100.0f : 0.0f;
+		cfg.exchange = j.contains ("exchange") && j["exchange"].get<bool> ();
+		if (j.contains ("ledger") && !j["ledger"].get<bool> ()) cfg.ledgerPath = "";
+		if (cfg.decay < 0.0f || cfg.decay > 1.0f) throw utils::exception ("decay must be in [0, 100]");
+
+		for (int r = 0 ; r < (int) market::resource::NB ; r++) {
+		    auto name = market::Accounting::name ((market::resource) r);
+		    if (j.contains ("rates") && j["rates"].contains (name)) {
+			cfg.rates [r] = j["rates"][name].get<double> ();
+			if (cfg.rates [r] <= 0.0) throw utils::exception ("rates must be positive");
+		    }
+
+		    if (j.contains ("caps") && j["caps"].contains (name)) {
+			cfg.caps [r] = j["caps"][name].get<unsigned long> ();
+		    }
+		}
+	    } catch (const utils::exception & e) {
+		logging::error ("Invalid accounting configuration :", e.msg);
+		cfg = market::AccountingConfig ();
+		cfg.ledgerPath = "/var/log/dio/ledger.json";
+	    } catch (const json::exception & e) {
+		logging::error ("Invalid accounting configuration :", e.what ());
+		cfg = market::AccountingConfig ();
+		cfg.ledgerPath = "/var/log/dio/ledger.json";
+	    }
+	}
+
+	if (!cfg.ledgerPath.empty ()) {
+	    fs::create_directories (cfg.ledgerPath.parent_path ());
+	}
+
+	this-> _accounting.setConfig (cfg);
+    }
+
+    void Controller::readMemMarketConfig () {
+	std::ifstream f (this-> _configPath / "mem-market.json");
+	this-> _memMarketEnabled = false;
+	if (f.good ()) {
+	    std::stringstream ss;
+	    ss << f.rdbuf ();
+	    f.close ();
+
+	    try {
+		auto j = json::parse (ss.str ());
+		if (j.contains ("enable") && j["enable"].is_boolean () && j["enable"].get<bool> ()) {
+		    // By default, the whole memory of the host is sold, except 2GB kept for the host
+		    struct sysinfo info;
+		    sysinfo (&info);
+		    unsigned long total = ((unsigned long) info.totalram * info.mem_unit) / 1024;
+		    unsigned long reserved = std::min (total / 2, (unsigned long) 2097152);
+
+		    auto marketConfig = market::MemoryMarketConfig {
+			j.contains ("memory") ? j["memory"].get<unsigned long> () * 1024 : total - reserved,
+			j["trigger-increment"].get<float> () / 100.0f,
+			j["increment-speed"].get<float> () / 100.0f,
+			j["trigger-decrement"].get<float> () / 100.0f,
+			j["decrement-speed"].get<float> () / 100.0f,
+			j["window-size"].get<unsigned long> () * 1024
+		    };
+
+		    this-> _memPeriod = j.contains ("period") ? j["period"].get<float> () : 5.0f;
+		    if (this-> _memPeriod <= 0.0f) throw utils::exception ("period must be positive");
+		    if (marketConfig.triggerDecrement > marketConfig.triggerIncrement) throw utils::exception ("trigger-decrement must be lower than trigger-increment");
+		    if (marketConfig.windowSize == 0) throw utils::exception ("window-size must be positive");
+
+		    this-> _memMarket.setConfig (marketConfig);
+		    this-> _memMarketEnabled = true;
+		}
+	    } catch (const utils::exception & e) {
+		logging::error ("Invalid memory market configuration :", e.msg);
+	    } catch (const json::exception & e) {
+		logging::error ("Invalid memory market configuration :", e.what ());
+	    }
+	}
+
+	if (this-> _memMarketEnabled) {
+	    logging::info ("Memory Market enabled");
 	} else {
-	    this-> _vcpuMarketEnabled = false;
+	    logging::warn ("Memory Market disabled");
 	}
+    }
 
-	if (this-> _vcpuMarketEnabled) {
-	    logging::info ("CPU Market enabled");
+    void Controller::readIOMarketConfig () {
+	std::ifstream f (this-> _configPath / "io-market.json");
+	this-> _ioMarketEnabled = false;
+	if (f.good ()) {
+	    std::stringstream ss;
+	    ss << f.rdbuf ();
+	    f.close ();
+
+	    try {
+		auto j = json::parse (ss.str ());
+		if (j.contains ("enable") && j["enable"].is_boolean () && j["enable"].get<bool> ()) {
+		    auto marketConfig = market::IOMarketConfig {
+			j["disk-bandwidth"].get<unsigned long> () * 1024,
+			j["disk-iops"].get<unsigned long> (),
+			j["net-bandwidth"].get<unsigned long> () * 1024,
+			j["trigger-increment"].get<float> () / 100.0f,
+			j["increment-speed"].get<float> () / 100.0f,
+			j["trigger-decrement"].get<float> () / 100.0f,
+			j["decrement-speed"].get<float> () / 100.0f,
+			j.contains ("window-size") ? j["window-size"].get<float> () / 100.0f : 0.1f
+		    };
+
+		    this-> _ioPeriod = j.contains ("period") ? j["period"].get<float> () : 2.0f;
+		    if (this-> _ioPeriod <= 0.0f) throw utils::exception ("period must be positive");
+		    if (marketConfig.triggerDecrement > marketConfig.triggerIncrement) throw utils::exception ("trigger-decrement must be lower than trigger-increment");
+		    if (marketConfig.decreasingSpeed <= 0.0f || marketConfig.decreasingSpeed > 1.0f) throw utils::exception ("decrement-speed must be in ]0, 100]");
+		    if (marketConfig.windowSize <= 0.0f) throw utils::exception ("window-size must be positive");
+
+		    this-> _ioMarket.setConfig (marketConfig);
+		    this-> _ioMarketEnabled = true;
+		}
+	    } catch (const utils::exception & e) {
+		logging::error ("Invalid io market configuration :", e.msg);
+	    } catch (const json::exception & e) {
+		logging::error ("Invalid io market configuration :", e.what ());
+	    }
+	}
+
+	if (this-> _ioMarketEnabled) {
+	    logging::info ("IO Market enabled");
 	} else {
-	    logging::warn ("CPU Market disabled");
+	    logging::warn ("IO Market disabled");
+	}
+    }
+
+    void Controller::readPlacementConfig () {
+	std::ifstream f (this-> _configPath / "placement.json");
+	this-> _placementEnabled = false;
+	if (f.good ()) {
+	    std::stringstream ss;
+	    ss << f.rdbuf ();
+	    f.close ();
+
+	    try {
+		auto j = json::parse (ss.str ());
+		if (j.contains ("enable") && j["enable"].is_boolean () && j["enable"].get<bool> ()) {
+		    this-> _placement.setConfig (placement::NumaPlacementConfig::parse (j));
+		    this-> _placement.discover ();
+		    this-> _placementEnabled = true;
+		}
+	    } catch (const utils::exception & e) {
+		logging::error ("Invalid placement configuration :", e.msg);
+	    } catch (const json::exception & e) {
+		logging::error ("Invalid placement configuration :", e.what ());
+	    }
+	}
+
+	if (this-> _placementEnabled) {
+	    logging::info ("NUMA placement enabled");
+	} else {
+	    logging::warn ("NUMA placement disabled");
+	}
+    }
+
+    void Controller::readDvfsConfig () {
+	std::ifstream f (this-> _configPath / "dvfs.json");
+	this-> _dvfsEnabled = false;
+	if (f.good ()) {
+	    std::stringstream ss;
+	    ss << f.rdbuf ();
+	    f.close ();
+
+	    try {
+		auto j = json::parse (ss.str ());
+		if (j.contains ("enable") && j["enable"].is_boolean () && j["enable"].get<bool> ()) {
+		    this-> _dvfs.setConfig (power::DvfsConfig::parse (j));
+		    this-> _dvfs.discover ();
+		    this-> _dvfsEnabled = true;
+		}
+	    } catch (const utils::exception & e) {
+		logging::error ("Invalid dvfs configuration :", e.msg);
+	    } catch (const json::exception & e) {
+		logging::error ("Invalid dvfs configuration :", e.what ());
+	    }
+	}
+
+	if (this-> _dvfsEnabled) {
+	    logging::info ("DVFS enabled");
+	} else {
+	    logging::warn ("DVFS disabled");
+	}
+    }
+
+    void Controller::readPowerCapConfig () {
+	std::ifstream f (this-> _configPath / "power-cap.json");
+	this-> _powerCapEnabled = false;
+	if (f.good ()) {
+	    std::stringstream ss;
+	    ss << f.rdbuf ();
+	    f.close ();
+
+	    try {
+		auto j = json::parse (ss.str ());
+		if (j.contains ("enable") && j["enable"].is_boolean () && j["enable"].get<bool> ()) {
+		    this-> _powerCap.setConfig (power::PowerCapConfig::parse (j));
+		    this-> _powerCap.reset ();
+		    this-> _powerCapEnabled = true;
+		}
+	    } catch (const utils::exception & e) {
+		logging::error ("Invalid power cap configuration :", e.msg);
+	    } catch (const json::exception & e) {
+		logging::error ("Invalid power cap configuration :", e.what ());
+	    }
+	}
+
+	if (this-> _powerCapEnabled && !this-> _rapl.isEnabled ()) {
+	    logging::error ("Power cap without readable rapl counters");
+	    this-> _powerCapEnabled = false;
+	}
+
+	if (this-> _powerCapEnabled) {
+	    logging::info ("Power cap enabled");
+	} else {
+	    logging::warn ("Power cap disabled");
+	}
+    }
+
+    void Controller::readMigrationConfig () {
+	std::ifstream f (this-> _configPath / "migration.json");
+	this-> _migrationEnabled = false;
+	if (f.good ()) {
+	    std::stringstream ss;
+	    ss << f.rdbuf ();
+	    f.close ();
+
+	    try {
+		auto j = json::parse (ss.str ());
+		if (j.contains ("enable") && j["enable"].is_boolean () && j["enable"].get<bool> ()) {
+		    auto cfg = cluster::MigrationConfig::parse (j);
+		    if (cfg.peers.empty ()) throw utils::exception ("no peers");
+
+		    this-> _migrator.setConfig (cfg);
+		    this-> _orchestrator.setConfig (cfg);
+		    this-> _migrationEnabled = true;
+		}
+	    } catch (const utils::exception & e) {
+		logging::error ("Invalid migration configuration :", e.msg);
+	    } catch (const json::exception & e) {
+		logging::error ("Invalid migration configuration :", e.what ());
+	    }
+	}
+
+	if (this-> _migrationEnabled && !this-> _vcpuMarketEnabled) {
+	    // The pressure is read from the summaries of the cpu market
+	    logging::warn ("Migrations without cpu market");
+	}
+
+	if (this-> _migrationEnabled) {
+	    logging::info ("Migrations enabled");
+	} else {
+	    logging::warn ("Migrations disabled");
+	}
+    }
+
+    void Controller::configWatchLoop (monitor::concurrency::thread) {
+	try {
+	    concurrency::FileWatcher watcher (this-> _configPath / "cpu-market.json");
+	    while (watcher.wait ()) {
+		bool enabled = false;
+		market::VCPUMarketConfig cfg;
+		if (!this-> readCpuMarketConfig (enabled, cfg)) {
+		    logging::warn ("CPU Market configuration unchanged");
+		    continue;
+		}
+
+		this-> _vcpuMutex.lock ();
+		this-> _pendingEnabled = enabled;
+		this-> _pendingConfig = cfg;
+		this-> _hasPendingConfig = true;
+		this-> _vcpuMutex.unlock ();
+	    }
+	} catch (const utils::exception & e) {
+	    logging::warn ("CPU Market configuration will not be reloaded :", e.msg);
+	}
+    }
+
+    void Controller::swapCpuMarketConfig () {
+	if (!this-> _hasPendingConfig) return;
+	this-> _hasPendingConfig = false;
+
+	if (this-> _pendingEnabled) {
+	    this-> _vcpuMarket.setConfig (this-> _pendingConfig);
+	    this-> _cpuMarket.setConfig (this-> _pendingConfig);
+	    if (this-> _vcpuMarketEnabled && this-> _pendingConfig.vmLevel != this-> _cpuMarketVMLevel) {
+		// The limits of the previous granularity would stay under the limits of the new one
+		this-> unlimitCpuMarket (this-> _cpuMarketVMLevel);
+		logging::info ("CPU Market switched to", this-> _pendingConfig.vmLevel ? "VM level" : "vcpu level");
+	    }
+	    this-> _cpuMarketVMLevel = this-> _pendingConfig.vmLevel;
+	    logging::info ("CPU Market configuration reloaded");
+	} else if (this-> _vcpuMarketEnabled) {
+	    // The market will not update the quotas anymore, they must not stay capped
+	    this-> unlimitCpuMarket (this-> _cpuMarketVMLevel);
 	}
+
+	if (this-> _pendingEnabled != this-> _vcpuMarketEnabled) {
+	    if (this-> _pendingEnabled) logging::info ("CPU Market enabled");
+	    else logging::warn ("CPU Market disabled");
+	}
+
+	this-> _vcpuMarketEnabled = this-> _pendingEnabled;
     }
 
 
+    void Controller::unlimitCpuMarket (bool vmLevel) {
+	for (auto & v : this-> _libvirt.getRunningVMs ()) {
+	    if (vmLevel) {
+		v-> getCPUController ().unlimit ();
+	    } else {
+		for (auto & vt : v-> getVCPUControllers ()) {
+		    vt.unlimit ();
+		}
+	    }
+	}
+    }
+
     void Controller::dumpCpuLogs () {
 	json j;
 	j["time"] = logging::get_time ();
 	j["cpu-duration"] = this-> _cpuT.time_since_start ();
+	unsigned long energy = 0, cycles = 0;
 	if (this-> _rapl.isEnabled ()) {
-	    j["rapl0"] = this-> _rapl.readPP0 ();
-	    j["rapl1"] = this-> _rapl.readPP1 ();
+	    this-> _rapl.read ();
+	    j["rapl0"] = this-> _rapl.getPackageEnergy (0);
+	    j["rapl1"] = this-> _rapl.getPackageEnergy (1);
+	    j["rapl"] = this-> _rapl.dumpLogs ();
+	    energy = this-> _rapl.getEnergy ();
+	    this-> _energy.run (energy);
 	}
 	
-	json j2, money, freq;
+	json j2, money, freq, mem, io;
 	int i = 0;	    
 	for (auto j : this-> _libvirt.getLastCPUFrequency ()) {
 	    freq[i] = j;
@@ -139,21 +696,77 @@ namespace server {
 		json all;
 		for (auto & vt : v-> getVCPUControllers ()) {
 		    all [i] = vt.dumpLogs ();
+		    cycles += vt.getDeliveredCycles ();
 		    i += 1;
 		}
 		j2 [v-> id ()] = all;
-		money[v-> id()] = v-> money ();
+		money[v-> id()] = this-> _accounting.wallets (v-> id ());
+	    }
+
+	    // The memory and io controllers are updated by their loops
+	    this-> _memMutex.lock ();
+	    for (auto & v : this-> _libvirt.getRunningVMs ()) {
+		mem [v-> id ()] = v-> getMemoryController ().dumpLogs ();
+	    }
+	    this-> _memMutex.unlock ();
+
+	    this-> _ioMutex.lock ();
+	    for (auto & v : this-> _libvirt.getRunningVMs ()) {
+		io [v-> id ()] = v-> getIOController ().dumpLogs ();
 	    }
+	    this-> _ioMutex.unlock ();
+
 	    j["cpu-control"] = j2;
 	    j["accounts"] = money;
+	    j["memory-control"] = mem;
+	    j["io-control"] = io;
+	    if (this-> _placementEnabled) {
+		j["placement"] = this-> _placement.dumpLogs ();
+	    }
+	    if (this-> _dvfsEnabled) {
+		j["dvfs"] = this-> _dvfs.dumpLogs ();
+	    }
+	    if (this-> _rapl.isEnabled ()) {
+		j["energy"] = this-> _energy.dumpLogs ();
+	    }
+	    if (this-> _powerCapEnabled) {
+		j["power-cap"] = this-> _powerCap.dumpLogs ();
+	    }
+	    if (energy != 0 && cycles != 0) {
+		// micro joules per cycle * 1000 are nano joules per cycle
+		j["energy-per-cycle"] = ((double) energy) * 1000.0 / ((double) cycles);
+	    }
+	    if (this-> _vcpuMarketEnabled && this-> _cpuMarketVMLevel) {
+		j["vm-cpu-control"] = this-> _cpuMarket.dumpLogs ();
+		j["cpu-budget"] = this-> _cpuMarket.getBudget ().dumpLogs ();
+	    } else if (this-> _vcpuMarketEnabled) {
+		j["cpu-budget"] = this-> _vcpuMarket.getBudget ().dumpLogs ();
+	    }
+	}
+
+	if (this-> _memMarketEnabled) {
+	    this-> _memMutex.lock ();
+	    j["memory-market"] = this-> _memMarket.dumpLogs ();
+	    this-> _memMutex.unlock ();
+	}
+
+	if (this-> _ioMarketEnabled) {
+	    this-> _ioMutex.lock ();
+	    j["io-market"] = this-> _ioMarket.dumpLogs ();
+	    this-> _ioMutex.unlock ();
 	}
 	
 	j["freq"] = freq;	
 
 	this-> _mutex.lock ();
+	if (this-> _migrationEnabled) {
+	    j["migration"] = this-> _lastMigration;
+	}
+
 	std::ofstream f (this-> _logPath, std::ios_base::app);
 	f << j.dump () << std::endl;
 	f.close ();
+	this-> _lastLogs = std::move (j);
 	this-> _mutex.unlock ();
     }
     
@@ -3,8 +3,19 @@
 #include <monitor/concurrency/_.hh>
 #include <monitor/libvirt/_.hh>
 #include <server/market/vcpu.hh>
+#include <server/market/cpu.hh>
+#include <server/market/memory.hh>
+#include <server/market/io.hh>
+#include <server/market/accounting.hh>
+#include <server/placement/numa.hh>
+#include <server/power/dvfs.hh>
+#include <server/power/rapl.hh>
+#include <server/power/energy.hh>
+#include <server/power/cap.hh>
+#include <server/cluster/summary.hh>
+#include <server/cluster/migration.hh>
 #include <nlohmann/json.hpp>
-#include "rapl.hh"
+#include "journal.hh"
 
 namespace server {
 
@@ -19,12 +30,30 @@ namespace server {
 	/// The libvirt connection
 	monitor::libvirt::LibvirtClient & _libvirt;
 
+	/// The journal in which the market informations are recorded
+	Journal & _journal;
+
 	/// The id of the thread managing the control of cpu
 	monitor::concurrency::thread _cpuLoopTh;
+
+	/// The id of the thread watching the configuration files
+	monitor::concurrency::thread _configTh;
 	
 	/// True iif the cpu market has to be executed
 	bool _vcpuMarketEnabled;
 
+	/// The path of the config directory of the controller
+	std::filesystem::path _configPath;
+
+	/// True iif a new cpu market configuration was read, and is waiting for the next market tick
+	bool _hasPendingConfig;
+
+	/// The enabling of the cpu market in the pending configuration
+	bool _pendingEnabled;
+
+	/// The pending configuration of the cpu market
+	market::VCPUMarketConfig _pendingConfig;
+
 	/// The path of the log file
 	std::filesystem::path _logPath;
 
@@ -34,19 +63,113 @@ namespace server {
 	/// The mutex used to synchronize cpu market access
 	monitor::concurrency::mutex _vcpuMutex;
 
+	/// The accounting of the money of the VMs, shared by all the markets
+	market::Accounting _accounting;
+
 	/// The market running the auction for vcpu cycles selling
 	market::VCPUMarket _vcpuMarket;
 
-	/// The reader of rapl values
-	RaplReader _rapl;
+	/// The market running the auction for cycles selling at the granularity of the VMs
+	market::CpuMarket _cpuMarket;
+
+	/// True iif the cpu market allocates the cycles to the VMs (_cpuMarket) instead of the vcpus (_vcpuMarket)
+	bool _cpuMarketVMLevel;
+
+	/// The timer used to run the memory controller at the correct pace
+	monitor::concurrency::timer _memT;
+
+	/// The id of the thread managing the control of memory
+	monitor::concurrency::thread _memLoopTh;
+
+	/// True iif the memory market has to be executed
+	bool _memMarketEnabled;
+
+	/// The time between two memory market ticks in seconds
+	float _memPeriod;
+
+	/// The mutex used to synchronize memory market access
+	monitor::concurrency::mutex _memMutex;
+
+	/// The market running the auction for memory selling
+	market::MemoryMarket _memMarket;
+
+	/// The timer used to run the io controller at the correct pace
+	monitor::concurrency::timer _ioT;
+
+	/// The id of the thread managing the control of io
+	monitor::concurrency::thread _ioLoopTh;
+
+	/// True iif the io market has to be executed
+	bool _ioMarketEnabled;
+
+	/// The time between two io market ticks in seconds
+	float _ioPeriod;
+
+	/// The mutex used to synchronize io market access
+	monitor::concurrency::mutex _ioMutex;
+
+	/// The market running the auction for io selling
+	market::IOMarket _ioMarket;
+
+	/// True iif the vcpus and the memory of the VMs are placed on the numa nodes and caches of the host
+	bool _placementEnabled;
+
+	/// The placement of the VMs on the numa nodes and caches of the host
+	placement::NumaPlacement _placement;
+
+	/// True iif the frequency of the cpus is set after each cpu market tick
+	bool _dvfsEnabled;
+
+	/// The actuator setting the frequency of the cpus from the outcome of the cpu market
+	power::DvfsActuator _dvfs;
+
+	/// The reader of the energy counters of the host
+	power::RaplReader _rapl;
+
+	/// The attribution of the energy of the host to the VMs
+	power::EnergyAttribution _energy;
+
+	/// True iif the cycles sold by the cpu market are limited to keep the power of the host under a budget
+	bool _powerCapEnabled;
+
+	/// The controller of the power of the host, computing the supply of the cpu market
+	power::PowerCap _powerCap;
+
+	/// The log of the last cpu market tick (sent to the clients asking for stats)
+	nlohmann::json _lastLogs;
+
+	/// The supply and demand of the last cpu market tick (sent to the cluster coordinator)
+	cluster::HostSummary _lastSummary;
+
+	/// The summaries of the cpu market ticks since the last period of the migration orchestrator
+	std::vector <cluster::HostSummary> _periodSummaries;
+
+	/// The timer used to run the migration orchestrator at the correct pace
+	monitor::concurrency::timer _migT;
+
+	/// The id of the thread running the migration orchestrator
+	monitor::concurrency::thread _migLoopTh;
+
+	/// True iif the VMs are migrated to the peers when the cpu market stays under pressure
+	bool _migrationEnabled;
+
+	/// The live migration of the VMs by libvirt
+	cluster::LibvirtMigrator _migrator;
+
+	/// The orchestrator choosing the VMs to migrate
+	cluster::MigrationOrchestrator _orchestrator;
+
+	/// The last decision of the migration orchestrator
+	nlohmann::json _lastMigration;
 	
     public:
 
 	/**
 	 * @params: 
 	 *  - the libvirt client that communicate with libvirt
+	 *  - the journal recording the market informations
 	 */
-	Controller (monitor::libvirt::LibvirtClient & libvirt);
+	Controller (monitor::libvirt::LibvirtClient & libvirt, Journal & journal);
 	
 	/**
 	 * Start the thread controller resource affectations
@@ -58,6 +181,25 @@ namespace server {
 	 */
 	void resetMarketCounters () ;
 
+	/**
+	 * @returns: the accounting of the money of the VMs
+	 */
+	market::Accounting & getAccounting ();
+
+	/**
+	 * @returns: the log dumped by the last cpu market tick
+	 */
+	nlohmann::json getLastLogs ();
+
+	/**
+	 * @returns: the supply and demand of the last cpu market tick
+	 */
+	cluster::HostSummary getLastSummary ();
+
+	/**
+	 * @returns: the mean of the cpu market ticks since the last call (cf. HostSummary::mean), or the last tick if none ran
+	 */
+	cluster::HostSummary takePeriodSummary ();
 	
 	/**
 	 * Wait for the end of the control loop
@@ -72,17 +214,102 @@ namespace server {
     private :
 	
 	/**
-	 * Read the configuration file of the cpu market 
+	 * Read and validate the configuration file of the cpu market (_configPath / cpu-market.json)
 	 * @params: 
-	 *   - path: the path of the config directory of the controller
+	 *   - enabled: true iif the market is enabled (@return)
+	 *   - cfg: the configuration of the market (@return)
+	 * @returns: false if the file is invalid (enabled and cfg are left untouched)
+	 * @info: a missing file disables the market
+	 */
+	bool readCpuMarketConfig (bool & enabled, market::VCPUMarketConfig & cfg);
+
+	/**
+	 * Read the configuration file of the accounting (_configPath / accounting.json)
+	 * @info: a missing, or invalid file keeps the default configuration (no decay, no cap, no exchange)
+	 */
+	void readAccountingConfig ();
+
+	/**
+	 * Read the configuration file of the memory market (_configPath / mem-market.json)
+	 * @info: a missing, or invalid file disables the memory market
+	 */
+	void readMemMarketConfig ();
+
+	/**
+	 * Main loop of the memory control (running at its own pace)
 	 */
-	void readCpuMarketConfig (const std::filesystem::path & path = "/usr/lib/dio");
+	void memControlLoop (monitor::concurrency::thread t);
+
+	/**
+	 * Read the configuration file of the io market (_configPath / io-market.json)
+	 * @info: a missing, or invalid file disables the io market
+	 */
+	void readIOMarketConfig ();
+
+	/**
+	 * Read the configuration file of the placement (_configPath / placement.json)
+	 * @info: a missing, or invalid file disables the placement
+	 */
+	void readPlacementConfig ();
+
+	/**
+	 * Read the configuration file of the dvfs actuator (_configPath / dvfs.json)
+	 * @info: a missing, or invalid file disables the actuator
+	 */
+	void readDvfsConfig ();
+
+	/**
+	 * Read the configuration file of the power cap (_configPath / power-cap.json)
+	 * @info: a missing, or invalid file disables the power cap, as a host without readable rapl counters
+	 */
+	void readPowerCapConfig ();
+
+	/**
+	 * Main loop of the io control (running at its own pace)
+	 */
+	void ioControlLoop (monitor::concurrency::thread t);
+
+	/**
+	 * Read the configuration file of the migration orchestrator (_configPath / migration.json)
+	 * @info: a missing, or invalid file disables the migrations
+	 */
+	void readMigrationConfig ();
+
+	/**
+	 * Main loop of the migration orchestrator (running at its own pace, on the summaries of the cpu market)
+	 */
+	void migrationLoop (monitor::concurrency::thread t);
+
+	/**
+	 * Watch the configuration file of the cpu market, and push the valid modifications as pending configuration
+	 */
+	void configWatchLoop (monitor::concurrency::thread t);
+
+	/**
+	 * Apply the pending configuration of the cpu market if there is one
+	 * @warning: must be called with _vcpuMutex locked, between two market ticks
+	 */
+	void swapCpuMarketConfig ();
+
+	/**
+	 * Remove the cpu limits set by one of the cpu markets
+	 * @warning: must be called with _vcpuMutex locked
+	 * @params:
+	 *   - vmLevel: if true remove the limits of the VMs, the limits of the vcpus otherwise
+	 */
+	void unlimitCpuMarket (bool vmLevel);
 	
 	/**
 	 * Main loop control the resource affectations
 	 */
 	void cpuControlLoop (monitor::concurrency::thread t);
 
+	/**
+	 * Release the VMs killed by the VM server, or migrated away by the migration loop
+	 * @info: takes the mutexes of the three markets, so no loop is using the VMs
+	 */
+	void releaseRemovedVMs ();
+
 	/**
 	 * Wait for the next frame
 	 */
@@ -1,20 +1,61 @@
 #include "daemon.hh"
+#include <monitor/utils/log.hh>
+#include <monitor/utils/toml.hh>
 
+using namespace monitor;
+using namespace monitor::utils;
 
 namespace server {
 
     Daemon::Daemon () :
-	_controller (this-> _libvirt),
-	_vms (this-> _libvirt, this-> _controller)
+	_clean (false),
+	_controller (this-> _libvirt, this-> _journal),
+	_vms (this-> _libvirt, this-> _controller, this-> _journal)
     {}
 
-    void Daemon::start () {
+    void Daemon::start (bool clean) {
+	this-> _clean = clean;
 	this-> _libvirt.setKeyPath ("/usr/lib/dio/keys");
 	this-> _libvirt.connect ();
+	if (this-> _clean) {
+	    this-> _libvirt.killAllRunningDomains ();
+	    this-> _journal.clear ();
+	} else {
+	    this-> recover ();
+	}
+
 	this-> _vms.start ();
 	this-> _controller.start ();
     }
 
+    void Daemon::recover () {
+	for (auto & it : this-> _journal.recover ()) {
+	    try {
+		auto vm = this-> _libvirt.adoptVM (toml::parse (it.second.spec), it.second.ip, it.second.mac);
+		if (vm == nullptr) {
+		    logging::warn ("VM", it.first, "is not running anymore");
+		    this-> _journal.recordKill (it.first);
+		    continue;
+		}
+
+		this-> _controller.getAccounting ().restore (vm-> id (), it.second.wallets);
+		auto & vcpus = vm-> getVCPUControllers ();
+		for (std::size_t i = 0 ; i < vcpus.size () && i < it.second.history.size () ; i++) {
+		    vcpus [i].restoreHistory (it.second.history [i]);
+		}
+
+		logging::success ("VM", vm-> id (), "recovered at ip : ", vm-> ip ());
+	    } catch (const utils::exception & e) {
+		logging::error ("VM", it.first, "cannot be recovered :", e.msg);
+		this-> _journal.recordKill (it.first);
+	    }
+	}
+
+	// The domains that are not in the journal cannot be managed (their configuration is unknown)
+	this-> _libvirt.killUnknownDomains ();
+	this-> _journal.compact ();
+    }
+
     void Daemon::join () {
 	this-> _vms.join ();
 	this-> _controller.kill ();
@@ -22,8 +63,13 @@ namespace server {
 
     void Daemon::kill () {
 	this-> _vms.kill ();
-	this-> _controller.kill ();	
-	this-> _libvirt.killAllRunningDomains ();
+	this-> _controller.kill ();
+	if (this-> _clean) {
+	    this-> _libvirt.killAllRunningDomains ();
+	    this-> _journal.clear ();
+	}
+
+	this-> _journal.close ();
 	this-> _libvirt.disconnect ();
     }
 
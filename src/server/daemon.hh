@@ -2,6 +2,7 @@
 
 #include "vm.hh"
 #include "control.hh"
+#include "journal.hh"
 
 namespace server {
     
@@ -14,6 +15,12 @@ namespace server {
 
 	/// The libvirt connection
 	monitor::libvirt::LibvirtClient _libvirt;
+
+	/// The journal of the state of the daemon (used to recover the VMs after a restart)
+	Journal _journal;
+
+	/// True iif the VMs are killed at the start, and at the end of the daemon (no recovery)
+	bool _clean;
 	
 	/// The controller of the vms
 	Controller _controller;
@@ -27,8 +34,10 @@ namespace server {
 
 	/**
 	 * Start the different part of the daemon
+	 * @params:
+	 *   - clean: if true, the running VMs are killed instead of being recovered from the journal, and they are killed when the daemon is killed
 	 */
-	void start ();
+	void start (bool clean = false);
 
 	/**
 	 * Wait for the end of the parts of the dameon 
@@ -40,6 +49,13 @@ namespace server {
 	 * Force the killing of the daemon
 	 */
 	void kill ();
+
+    private :
+
+	/**
+	 * Adopt the VMs recorded in the journal that are still running, and kill the other domains managed by the daemon
+	 */
+	void recover ();
 	
     };
 
@@ -0,0 +1,314 @@
+#include "journal.hh"
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <fstream>
+#include <monitor/utils/log.hh>
+#include <monitor/utils/toml.hh>
+#include <monitor/utils/exception.hh>
+
+using namespace monitor;
+using namespace monitor::libvirt;
+using namespace monitor::utils;
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace server {
+
+    /**
+     * Disable the cancellation of the current thread during its lifetime
+     * A thread killed by the daemon never leaves a half written record, or a locked mutex
+     */
+    struct no_cancel {
+	int old;
+	no_cancel () { pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, &this-> old); }
+	~no_cancel () { pthread_setcancelstate (this-> old, nullptr); }
+    };
+
+    Journal::Journal (const fs::path & path, unsigned int syncEvery, std::size_t maxSize) :
+	_path (path),
+	_fd (-1),
+	_syncEvery (syncEvery),
+	_unsynced (0),
+	_size (0),
+	_maxSize (maxSize)
+    {}
+
+    /**
+     * ================================================================================
+     * ================================================================================
+     * =========================           RECOVERY           =========================
+     * ================================================================================
+     * ================================================================================
+     */
+
+    std::map <std::string, JournalVM> Journal::recover () {
+	no_cancel nc;
+	this-> _mutex.lock ();
+	this-> _state.clear ();
+
+	std::ifstream f (this-> _path, std::ios::binary);
+	std::vector <std::uint8_t> content ((std::istreambuf_iterator<char> (f)), std::istreambuf_iterator<char> ());
+	f.close ();
+
+	std::size_t cursor = 0, nb = 0;
+	while (cursor + 8 <= content.size ()) {
+	    std::uint32_t len = 0, sum = 0;
+	    ::memcpy (&len, content.data () + cursor, 4);
+	    ::memcpy (&sum, content.data () + cursor + 4, 4);
+	    if (cursor + 8 + len > content.size () || checksum (content.data () + cursor + 8, len) != sum) break;
+
+	    try {
+		this-> apply (json::from_cbor (content.begin () + cursor + 8, content.begin () + cursor + 8 + len));
+	    } catch (const json::exception & e) {
+		break;
+	    }
+
+	    cursor += 8 + len;
+	    nb += 1;
+	}
+
+	if (cursor != content.size ()) {
+	    logging::warn ("Journal :", content.size () - cursor, "bytes of corrupted records ignored");
+	}
+
+	logging::info ("Journal :", nb, "records read,", this-> _state.size (), "VMs to recover");
+	auto ret = this-> _state;
+	this-> _mutex.unlock ();
+
+	return ret;
+    }
+
+    void Journal::apply (const json & record) {
+	auto op = record ["op"].get<std::string> ();
+	if (op == "vm") {
+	    auto & vm = this-> _state [record ["name"].get<std::string> ()];
+	    vm.spec = record ["spec"].get<std::string> ();
+	    vm.ip = record ["ip"].get<std::string> ();
+	    vm.mac = record ["mac"].get<std::string> ();
+	} else if (op == "kill") {
+	    this-> _state.erase (record ["name"].get<std::string> ());
+	} else if (op == "tick") {
+	    for (auto & it : record ["vms"].items ()) {
+		auto vm = this-> _state.find (it.key ());
+		if (vm != this-> _state.end ()) {
+		    if (it.value ().contains ("wallets")) {
+			vm-> second.wallets = it.value () ["wallets"].get<std::vector <unsigned long> > ();
+		    } else { // journal written before the accounting, the money was only for the cpu
+			vm-> second.wallets = {it.value () ["money"].get<unsigned long> ()};
+		    }
+		    vm-> second.history = it.value () ["history"].get<std::vector <std::vector <float> > > ();
+		}
+	    }
+	}
+    }
+
+    /**
+     * ================================================================================
+     * ================================================================================
+     * =========================            RECORDS           =========================
+     * ================================================================================
+     * ================================================================================
+     */
+
+    void Journal::recordVM (const LibvirtVM & vm) {
+	json j;
+	j ["op"] = "vm";
+	j ["name"] = vm.id ();
+	j ["spec"] = toml::dump (vm.spec ());
+	j ["ip"] = vm.ip ();
+	j ["mac"] = vm.mac ();
+
+	no_cancel nc;
+	this-> _mutex.lock ();
+	this-> append (j, true);
+	this-> _mutex.unlock ();
+    }
+
+    void Journal::recordKill (const std::string & name) {
+	json j;
+	j ["op"] = "kill";
+	j ["name"] = name;
+
+	no_cancel nc;
+	this-> _mutex.lock ();
+	this-> append (j, true);
+	this-> _mutex.unlock ();
+    }
+
+    void Journal::recordTick (const std::vector <LibvirtVM*> & vms, market::Accounting & accounting) {
+	json j, all = json::object ();
+	j ["op"] = "tick";
+	for (auto & v : vms) {
+	    json history = json::array ();
+	    for (auto & vt : v-> getVCPUControllers ()) {
+		history.push_back (vt.getHistory ());
+	    }
+
+	    all [v-> id ()] = {{"wallets", accounting.wallets (v-> id ())}, {"history", history}};
+	}
+	j ["vms"] = all;
+
+	no_cancel nc;
+	this-> _mutex.lock ();
+	this-> _unsynced += 1;
+	this-> append (j, this-> _unsynced >= this-> _syncEvery);
+	if (this-> _size > this-> _maxSize) {
+	    this-> writeSnapshot ();
+	}
+	this-> _mutex.unlock ();
+    }
+
+    void Journal::append (const json & record, bool sync) {
+	this-> apply (record);
+	try {
+	    if (this-> _fd < 0) this-> open ();
+
+	    auto bytes = encode (record);
+	    if (::write (this-> _fd, bytes.data (), bytes.size ()) != (ssize_t) bytes.size ()) {
+		logging::error ("Journal : write failed :", strerror (errno));
+		return;
+	    }
+
+	    this-> _size += bytes.size ();
+	    if (sync) {
+		::fdatasync (this-> _fd);
+		this-> _unsynced = 0;
+	    }
+	} catch (const utils::exception & e) {
+	    logging::error ("Journal :", e.msg);
+	}
+    }
+
+    /**
+     * ================================================================================
+     * ================================================================================
+     * =========================          COMPACTION          =========================
+     * ================================================================================
+     * ================================================================================
+     */
+
+    void Journal::compact () {
+	no_cancel nc;
+	this-> _mutex.lock ();
+	this-> writeSnapshot ();
+	this-> _mutex.unlock ();
+    }
+
+    void Journal::clear () {
+	no_cancel nc;
+	this-> _mutex.lock ();
+	this-> _state.clear ();
+	this-> writeSnapshot ();
+	this-> _mutex.unlock ();
+    }
+
+    void Journal::writeSnapshot () {
+	std::vector <std::uint8_t> content;
+	json tick, all = json::object ();
+	tick ["op"] = "tick";
+	for (auto & it : this-> _state) {
+	    json j;
+	    j ["op"] = "vm";
+	    j ["name"] = it.first;
+	    j ["spec"] = it.second.spec;
+	    j ["ip"] = it.second.ip;
+	    j ["mac"] = it.second.mac;
+
+	    auto bytes = encode (j);
+	    content.insert (content.end (), bytes.begin (), bytes.end ());
+	    all [it.first] = {{"wallets", it.second.wallets}, {"history", it.second.history}};
+	}
+
+	tick ["vms"] = all;
+	auto bytes = encode (tick);
+	content.insert (content.end (), bytes.begin (), bytes.end ());
+
+	// The snapshot is written next to the journal, and renamed, so a crash leaves either the old, or the new journal
+	fs::create_directories (this-> _path.parent_path ());
+	auto tmpPath = fs::path (this-> _path.string () + ".tmp");
+	auto fd = ::open (tmpPath.c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0 || ::write (fd, content.data (), content.size ()) != (ssize_t) content.size () || ::fdatasync (fd) != 0) {
+	    logging::error ("Journal : snapshot failed :", strerror (errno));
+	    if (fd >= 0) ::close (fd);
+	    return;
+	}
+
+	::close (fd);
+	::rename (tmpPath.c_str (), this-> _path.c_str ());
+
+	auto dir = ::open (this-> _path.parent_path ().c_str (), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir >= 0) {
+	    ::fsync (dir);
+	    ::close (dir);
+	}
+
+	if (this-> _fd >= 0) ::close (this-> _fd);
+	this-> _fd = -1;
+	this-> _unsynced = 0;
+	try {
+	    this-> open ();
+	} catch (const utils::exception & e) {
+	    logging::error ("Journal :", e.msg);
+	}
+    }
+
+    /**
+     * ================================================================================
+     * ================================================================================
+     * =========================             FILE             =========================
+     * ================================================================================
+     * ================================================================================
+     */
+
+    void Journal::open () {
+	fs::create_directories (this-> _path.parent_path ());
+	this-> _fd = ::open (this-> _path.c_str (), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+	if (this-> _fd < 0) {
+	    throw utils::file_error ("Cannot open journal " + this-> _path.string () + " : " + strerror (errno));
+	}
+
+	this-> _size = ::lseek (this-> _fd, 0, SEEK_END);
+    }
+
+    void Journal::close () {
+	no_cancel nc;
+	this-> _mutex.lock ();
+	if (this-> _fd >= 0) {
+	    ::fdatasync (this-> _fd);
+	    ::close (this-> _fd);
+	    this-> _fd = -1;
+	}
+	this-> _mutex.unlock ();
+    }
+
+    Journal::~Journal () {
+	this-> close ();
+    }
+
+    std::vector <std::uint8_t> Journal::encode (const json & record) {
+	auto payload = json::to_cbor (record);
+	std::uint32_t len = payload.size ();
+	std::uint32_t sum = checksum (payload.data (), payload.size ());
+
+	std::vector <std::uint8_t> bytes (8 + payload.size ());
+	::memcpy (bytes.data (), &len, 4);
+	::memcpy (bytes.data () + 4, &sum, 4);
+	::memcpy (bytes.data () + 8, payload.data (), payload.size ());
+
+	return bytes;
+    }
+
+    std::uint32_t Journal::checksum (const std::uint8_t * data, std::size_t len) {
+	std::uint32_t hash = 2166136261u;
+	for (std::size_t i = 0 ; i < len ; i++) {
+	    hash ^= data [i];
+	    hash *= 16777619u;
+	}
+
+	return hash;
+    }
+
+}
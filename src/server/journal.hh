@@ -0,0 +1,169 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <monitor/concurrency/_.hh>
+#include <monitor/libvirt/_.hh>
+#include <server/market/accounting.hh>
+#include <nlohmann/json.hpp>
+
+namespace server {
+
+    /**
+     * The state of a VM as recorded in the journal
+     */
+    struct JournalVM {
+
+	/// The configuration used to provision the VM (toml)
+	std::string spec;
+
+	/// The ip address of the VM
+	std::string ip;
+
+	/// The mac address of the VM
+	std::string mac;
+
+	/// The wallets of the VM in the last recorded market tick (indexed by market::resource)
+	std::vector <unsigned long> wallets;
+
+	/// The consumption history of each vcpu in the last recorded market tick
+	std::vector <std::vector <float> > history;
+
+    };
+
+    /**
+     * Append only journal of the state of the monitor (provisionned VMs, accounts, and consumption histories)
+     * The journal is used to adopt the running VMs again when the monitor is restarted (upgrade, crash, etc.)
+     *
+     * The journal file is a sequence of records : [length (4 bytes), checksum (4 bytes), cbor payload]
+     * A torn record at the end of the file (crash during a write) is detected by the checksum, and ignored at recovery
+     * The provisionning and killing records are synced immediately, the market ticks are synced by batch
+     * When the file becomes too big, it is compacted (replaced by a snapshot of the current state)
+     */
+    class Journal {
+
+	/// The path of the journal file
+	std::filesystem::path _path;
+
+	/// The file descriptor of the journal file opened in append mode (-1 if not opened)
+	int _fd;
+
+	/// The mutex synchronizing the records of the different threads
+	monitor::concurrency::mutex _mutex;
+
+	/// The state of the VMs as recorded in the journal
+	std::map <std::string, JournalVM> _state;
+
+	/// The number of market ticks between two syncs of the journal file
+	unsigned int _syncEvery;
+
+	/// The number of market ticks written since the last sync
+	unsigned int _unsynced;
+
+	/// The size of the journal file
+	std::size_t _size;
+
+	/// The size of the journal file that triggers a compaction
+	std::size_t _maxSize;
+
+    public:
+
+	/**
+	 * @params:
+	 *   - path: the path of the journal file
+	 *   - syncEvery: the number of market ticks between two syncs
+	 *   - maxSize: the size in bytes of the journal file before compaction
+	 */
+	Journal (const std::filesystem::path & path = "/var/lib/dio/journal", unsigned int syncEvery = 5, std::size_t maxSize = 4 * 1024 * 1024);
+
+	/**
+	 * Read the journal file
+	 * @info: the records after a corrupted one are ignored
+	 * @returns: the state of the VMs that were running at the end of the previous run
+	 */
+	std::map <std::string, JournalVM> recover ();
+
+	/**
+	 * Record the provisionning (or adoption) of a VM
+	 * @info: the record is synced before returning
+	 */
+	void recordVM (const monitor::libvirt::LibvirtVM & vm);
+
+	/**
+	 * Record the killing of a VM
+	 * @info: the record is synced before returning
+	 */
+	void recordKill (const std::string & name);
+
+	/**
+	 * Record the market informations (wallets, and histories) of the running VMs
+	 * @params:
+	 *   - vms: the running VMs
+	 *   - accounting: the accounting holding the wallets of the VMs
+	 */
+	void recordTick (const std::vector <monitor::libvirt::LibvirtVM*> & vms, market::Accounting & accounting);
+
+	/**
+	 * Replace the journal file by a snapshot of the current state
+	 */
+	void compact ();
+
+	/**
+	 * Forget the state, and empty the journal file
+	 */
+	void clear ();
+
+	/**
+	 * Sync, and close the journal file
+	 */
+	void close ();
+
+	/**
+	 * this-> close ()
+	 */
+	~Journal ();
+
+    private:
+
+	/**
+	 * Write a record at the end of the journal file, and apply it to the current state
+	 * @warning: must be called with the mutex locked
+	 * @params:
+	 *   - record: the record to write
+	 *   - sync: if true, the file is synced before returning
+	 */
+	void append (const nlohmann::json & record, bool sync);
+
+	/**
+	 * Apply a record to the current state
+	 */
+	void apply (const nlohmann::json & record);
+
+	/**
+	 * Write a snapshot of the current state in a new journal file, and replace the old one
+	 * @warning: must be called with the mutex locked
+	 */
+	void writeSnapshot ();
+
+	/**
+	 * Open the journal file in append mode
+	 * @throws:
+	 *   - utils::file_error: if the file cannot be opened
+	 */
+	void open ();
+
+	/**
+	 * Encode a record (length, checksum, payload)
+	 */
+	static std::vector <std::uint8_t> encode (const nlohmann::json & record);
+
+	/**
+	 * @returns: the checksum of a payload (fnv-1a)
+	 */
+	static std::uint32_t checksum (const std::uint8_t * data, std::size_t len);
+
+    };
+
+}
@@ -2,6 +2,7 @@
 #include "daemon.hh"
 #include <signal.h>
 #include <monitor/concurrency/thread.hh>
+#include <monitor/foreign/CLI11.hpp>
 
 server::Daemon dam;
 
@@ -11,9 +12,20 @@ void terminateSigHandler (int) {
 }
 
 
-int main () {
+int main (int argc, char ** argv) {
+    CLI::App app {"monitor"};
+
+    bool clean = false;
+    app.add_flag ("--clean", clean, "kill the running VMs at startup, and when the monitor is stopped, instead of recovering them");
+
+    try {
+	app.parse (argc, argv);
+    } catch (const CLI::ParseError &e) {
+	return app.exit (e);
+    }
+
     signal(SIGINT, &terminateSigHandler);
     
-    dam.start ();
+    dam.start (clean);
     dam.join ();
 }
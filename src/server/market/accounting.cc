@@ -0,0 +1,286 @@
+#include "accounting.hh"
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+#include <monitor/utils/log.hh>
+
+using namespace monitor::libvirt;
+using namespace monitor::utils;
+using json = nlohmann::json;
+
+namespace server {
+
+    namespace market {
+
+	Accounting::Accounting () {
+	    this-> _ticks.fill (0);
+	}
+
+	void Accounting::setConfig (const AccountingConfig & cfg) {
+	    this-> _mutex.lock ();
+	    this-> _config = cfg;
+	    this-> _mutex.unlock ();
+	}
+
+	/**
+	 * ================================================================================
+	 * ================================================================================
+	 * =========================           WALLETS            =========================
+	 * ================================================================================
+	 * ================================================================================
+	 */
+
+	unsigned long Accounting::balance (const std::string & vm, resource res) {
+	    this-> _mutex.lock ();
+	    auto ret = this-> _wallets [vm][(int) res];
+	    this-> _mutex.unlock ();
+
+	    return ret;
+	}
+
+	unsigned long Accounting::available (const std::string & vm, resource res) {
+	    this-> _mutex.lock ();
+	    auto & w = this-> _wallets [vm];
+	    unsigned long ret = w [(int) res];
+	    if (this-> _config.exchange) {
+		for (int r = 0 ; r < (int) resource::NB ; r++) {
+		    if (r != (int) res) {
+			ret += (unsigned long) (w [r] * this-> _config.rates [r] / this-> _config.rates [(int) res]);
+		    }
+		}
+	    }
+	    this-> _mutex.unlock ();
+
+	    return ret;
+	}
+
+	void Accounting::credit (const std::string & vm, resource res, unsigned long money, unsigned long cap) {
+	    this-> _mutex.lock ();
+	    auto & w = this-> _wallets [vm];
+	    this-> _ledger [(int) res][vm].earned += money;
+	    this-> add (vm, w, res, money, cap);
+	    this-> _mutex.unlock ();
+	}
+
+	unsigned long Accounting::debit (const std::string & vm, resource res, unsigned long money) {
+	    this-> _mutex.lock ();
+	    auto & w = this-> _wallets [vm];
+	    auto & e = this-> _ledger [(int) res][vm];
+
+	    unsigned long rest = money - std::min (money, w [(int) res]);
+	    w [(int) res] -= money - rest;
+
+	    // The rest is converted from the other wallets at the exchange rates
+	    if (this-> _config.exchange) {
+		for (int r = 0 ; r < (int) resource::NB && rest != 0 ; r++) {
+		    if (r == (int) res || w [r] == 0) continue;
+
+		    double rate = this-> _config.rates [r] / this-> _config.rates [(int) res];
+		    auto needed = (unsigned long) std::ceil (rest / rate);
+		    auto given = std::min (needed, w [r]);
+		    auto received = std::min (rest, (unsigned long) (given * rate));
+
+		    w [r] -= given;
+		    this-> _ledger [r][vm].exchangedOut += given;
+		    e.exchangedIn += received;
+		    rest -= received;
+		}
+	    }
+
+	    e.spent += money - rest;
+	    this-> _mutex.unlock ();
+
+	    return money - rest;
+	}
+
+	Accounting::tab Accounting::open (const std::string & vm, resource res, unsigned long cap) {
+	    tab t;
+	    t.vm = vm;
+	    t.res = res;
+
+	    this-> _mutex.lock ();
+	    auto & w = this-> _wallets [vm];
+	    t.balance = w [(int) res];
+	    if (this-> _config.exchange) {
+		for (int r = 0 ; r < (int) resource::NB ; r++) {
+		    if (r != (int) res) {
+			t.others += (unsigned long) (w [r] * this-> _config.rates [r] / this-> _config.rates [(int) res]);
+		    }
+		}
+	    }
+
+	    t.cap = this-> _config.caps [(int) res];
+	    if (cap != 0 && (t.cap == 0 || cap < t.cap)) t.cap = cap;
+	    this-> _mutex.unlock ();
+
+	    return t;
+	}
+
+	void Accounting::settle (const tab & t) {
+	    if (t.earned != 0) {
+		this-> _mutex.lock ();
+		this-> _ledger [(int) t.res][t.vm].earned += t.earned;
+		this-> add (t.vm, this-> _wallets [t.vm], t.res, t.earned, t.cap);
+		this-> _mutex.unlock ();
+	    }
+
+	    // The exchange of the debit is computed on the wallets of now, the other markets may have spent them
+	    if (t.spent != 0) this-> debit (t.vm, t.res, t.spent);
+	}
+
+	unsigned long Accounting::tab::available () const {
+	    auto money = this-> balance + this-> earned;
+	    if (this-> earned != 0 && this-> cap != 0 && money > this-> cap) money = this-> cap;
+
+	    return money + this-> others - std::min (money + this-> others, this-> spent);
+	}
+
+	void Accounting::tab::credit (unsigned long money) {
+	    this-> earned += money;
+	}
+
+	unsigned long Accounting::tab::debit (unsigned long money) {
+	    auto debited = std::min (money, this-> available ());
+	    this-> spent += debited;
+
+	    return debited;
+	}
+
+	void Accounting::add (const std::string & vm, wallet & w, resource res, unsigned long money, unsigned long vmCap) {
+	    auto cap = this-> _config.caps [(int) res];
+	    if (vmCap != 0 && (cap == 0 || vmCap < cap)) cap = vmCap;
+
+	    w [(int) res] += money;
+	    if (cap != 0 && w [(int) res] > cap) {
+		this-> _ledger [(int) res][vm].capped += w [(int) res] - cap;
+		w [(int) res] = cap;
+	    }
+	}
+
+	/**
+	 * ================================================================================
+	 * ================================================================================
+	 * =========================            TICKS             =========================
+	 * ================================================================================
+	 * ================================================================================
+	 */
+
+	void Accounting::close (resource res, float share) {
+	    this-> _mutex.lock ();
+	    if (share < 0.0f) share = this-> _config.decay;
+	    if (share > 0.0f) {
+		for (auto & it : this-> _wallets) {
+		    auto decayed = std::min (it.second [(int) res], (unsigned long) (it.second [(int) res] * share));
+		    it.second [(int) res] -= decayed;
+		    this-> _ledger [(int) res][it.first].decayed += decayed;
+		}
+	    }
+
+	    this-> exportLedger (res);
+	    this-> _ledger [(int) res].clear ();
+	    this-> _ticks [(int) res] += 1;
+	    this-> _mutex.unlock ();
+	}
+
+	void Accounting::exportLedger (resource res) {
+	    if (this-> _config.ledgerPath.empty ()) return;
+
+	    json entries = json::object ();
+	    for (auto & it : this-> _wallets) {
+		auto e = this-> _ledger [(int) res][it.first];
+		entries [it.first] = {
+		    {"earned", e.earned},
+		    {"spent", e.spent},
+		    {"decayed", e.decayed},
+		    {"capped", e.capped},
+		    {"exchanged-in", e.exchangedIn},
+		    {"exchanged-out", e.exchangedOut},
+		    {"balance", it.second [(int) res]},
+		    {"value", it.second [(int) res] * this-> _config.rates [(int) res]}
+		};
+	    }
+
+	    json j;
+	    j ["time"] = logging::get_time ();
+	    j ["resource"] = name (res);
+	    j ["tick"] = this-> _ticks [(int) res];
+	    j ["entries"] = entries;
+
+	    std::ofstream f (this-> _config.ledgerPath, std::ios_base::app);
+	    f << j.dump () << std::endl;
+	    f.close ();
+	}
+
+	void Accounting::prune (const std::vector <LibvirtVM*> & vms) {
+	    this-> _mutex.lock ();
+	    std::map <std::string, wallet> wallets;
+	    for (auto & v : vms) {
+		auto fnd = this-> _wallets.find (v-> id ());
+		if (fnd != this-> _wallets.end ()) wallets [v-> id ()] = fnd-> second;
+		else wallets [v-> id ()].fill (0);
+	    }
+
+	    this-> _wallets = std::move (wallets);
+	    this-> _mutex.unlock ();
+	}
+
+	void Accounting::reset (resource res) {
+	    this-> _mutex.lock ();
+	    for (auto & it : this-> _wallets) {
+		it.second [(int) res] = 0;
+	    }
+	    this-> _mutex.unlock ();
+	}
+
+	/**
+	 * ================================================================================
+	 * ================================================================================
+	 * =========================           JOURNAL            =========================
+	 * ================================================================================
+	 * ================================================================================
+	 */
+
+	std::vector <unsigned long> Accounting::wallets (const std::string & vm) {
+	    this-> _mutex.lock ();
+	    auto & w = this-> _wallets [vm];
+	    std::vector <unsigned long> ret (w.begin (), w.end ());
+	    this-> _mutex.unlock ();
+
+	    return ret;
+	}
+
+	void Accounting::restore (const std::string & vm, const std::vector <unsigned long> & balances) {
+	    this-> _mutex.lock ();
+	    auto & w = this-> _wallets [vm];
+	    w.fill (0);
+	    for (std::size_t i = 0 ; i < balances.size () && i < w.size () ; i++) {
+		w [i] = balances [i];
+	    }
+	    this-> _mutex.unlock ();
+	}
+
+	nlohmann::json Accounting::dumpLogs (resource res) {
+	    json j = json::object ();
+	    this-> _mutex.lock ();
+	    for (auto & it : this-> _wallets) {
+		j [it.first] = it.second [(int) res];
+	    }
+	    this-> _mutex.unlock ();
+
+	    return j;
+	}
+
+	const char* Accounting::name (resource res) {
+	    switch (res) {
+	    case resource::CPU : return "cpu";
+	    case resource::MEMORY : return "memory";
+	    case resource::DISK : return "disk";
+	    case resource::IOPS : return "iops";
+	    case resource::NET : return "net";
+	    default : return "";
+	    }
+	}
+
+    }
+
+}
@@ -0,0 +1,246 @@
+#pragma once
+#include <monitor/libvirt/_.hh>
+#include <monitor/concurrency/_.hh>
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+
+namespace server {
+
+    namespace market {
+
+	/**
+	 * The resources sold by the markets, each VM has a wallet for each of them
+	 * The money of a resource is in the unit of the resource (cycles, KB, KB/s, operations per second)
+	 */
+	enum class resource : int {
+	    CPU = 0,
+	    MEMORY,
+	    DISK,
+	    IOPS,
+	    NET,
+	    NB
+	};
+
+	struct AccountingConfig {
+	    /// The share of the wallets lost at each tick of their market (in [0, 1])
+	    float decay = 0.0f;
+
+	    /// True iif a VM can pay with the money of its other wallets when a wallet is empty
+	    bool exchange = false;
+
+	    /// The value of one unit of money of each resource in credits (the common currency)
+	    std::array <double, (int) resource::NB> rates = {1.0, 1.0, 1.0, 1.0, 1.0};
+
+	    /// The maximal balance of the wallets of each resource (0 for no cap)
+	    std::array <unsigned long, (int) resource::NB> caps = {0, 0, 0, 0, 0};
+
+	    /// The file in which the ledger is exported (empty for no export)
+	    std::filesystem::path ledgerPath;
+	};
+
+	/**
+	 * The accounting of the money of the VMs for all the markets
+	 * Each VM has a wallet per resource, credited by the VMs using less than their nominal, and debited when they buy above it
+	 * The wallets are bounded (decay at each market tick, and cap), so an idle VM cannot hoard money and starve the others later
+	 * The operations of each market tick are summed in a ledger (one entry per VM), exported for billing and analysis
+	 * @info: the markets run in different threads, all the operations are synchronized
+	 */
+	class Accounting {
+	public:
+
+	    /**
+	     * The money of a VM in the wallet of a resource during one market tick, used without synchronization by the thread computing the VM
+	     * A tab is opened from the wallets, and settled into them at the end of the tick (cf. open, settle)
+	     * @warning: all the credits of a tick must happen before its debits (the base of the markets is sold before the bidding)
+	     */
+	    struct tab {
+		/// The VM owning the wallet
+		std::string vm;
+
+		/// The resource of the wallet
+		resource res = resource::CPU;
+
+		/// The balance of the wallet at the opening
+		unsigned long balance = 0;
+
+		/// The value of the other wallets at the opening, in money of the resource (0 if the exchange is disabled)
+		unsigned long others = 0;
+
+		/// The cap of the wallet (0 for no cap)
+		unsigned long cap = 0;
+
+		/// The money credited during the tick
+		unsigned long earned = 0;
+
+		/// The money debited during the tick
+		unsigned long spent = 0;
+
+		/**
+		 * @returns: the money the VM can still spend (as Accounting::available)
+		 */
+		unsigned long available () const;
+
+		/**
+		 * Add money to the tab (capped when settled)
+		 */
+		void credit (unsigned long money);
+
+		/**
+		 * Remove money from the tab
+		 * @returns: the money that was actually debited (at most available ())
+		 */
+		unsigned long debit (unsigned long money);
+	    };
+
+	private:
+
+	    /**
+	     * The operations on a wallet during one market tick
+	     */
+	    struct entry {
+		/// The money earned by selling the unused nominal
+		unsigned long earned = 0;
+
+		/// The money spent to buy resource above the nominal
+		unsigned long spent = 0;
+
+		/// The money lost by the decay
+		unsigned long decayed = 0;
+
+		/// The money lost because the wallet reached its cap
+		unsigned long capped = 0;
+
+		/// The money received from the other wallets
+		unsigned long exchangedIn = 0;
+
+		/// The money given to the other wallets
+		unsigned long exchangedOut = 0;
+	    };
+
+	    /// The balances of the wallets of a VM
+	    typedef std::array <unsigned long, (int) resource::NB> wallet;
+
+	    /// The configuration of the accounting
+	    AccountingConfig _config;
+
+	    /// The wallets of the running VMs
+	    std::map <std::string, wallet> _wallets;
+
+	    /// The ledger entries of the current tick of each resource
+	    std::array <std::map <std::string, entry>, (int) resource::NB> _ledger;
+
+	    /// The number of ticks closed for each resource
+	    std::array <unsigned long, (int) resource::NB> _ticks;
+
+	    /// The mutex synchronizing the markets
+	    monitor::concurrency::mutex _mutex;
+
+	public:
+
+	    Accounting ();
+
+	    /**
+	     * Change the configuration of the accounting
+	     */
+	    void setConfig (const AccountingConfig & cfg);
+
+	    /**
+	     * @returns: the money of a VM in the wallet of a resource
+	     */
+	    unsigned long balance (const std::string & vm, resource res);
+
+	    /**
+	     * @returns: the money a VM can spend on a resource (its wallet, and the value of its other wallets if the exchange is enabled)
+	     */
+	    unsigned long available (const std::string & vm, resource res);
+
+	    /**
+	     * Add money to the wallet of a VM
+	     * @info: the money above the cap of the resource is lost
+	     * @params:
+	     *   - cap: the cap of the wallet of this VM (0 for the cap of the resource only), the lowest of the two caps is applied
+	     */
+	    void credit (const std::string & vm, resource res, unsigned long money, unsigned long cap = 0);
+
+	    /**
+	     * Remove money from the wallet of a VM
+	     * @info: if the wallet is not sufficient, and the exchange is enabled, the rest is paid with the other wallets
+	     * @returns: the money that was actually debited (at most available (vm, res))
+	     */
+	    unsigned long debit (const std::string & vm, resource res, unsigned long money);
+
+	    /**
+	     * Open the tab of a VM on a resource for the current tick
+	     * @params:
+	     *   - cap: the cap of the wallet of this VM (as credit)
+	     */
+	    tab open (const std::string & vm, resource res, unsigned long cap = 0);
+
+	    /**
+	     * Apply the operations of a tab on the wallets (its credits, then its debits)
+	     */
+	    void settle (const tab & t);
+
+	    /**
+	     * Close the tick of a market : apply the decay on the wallets of the resource, and export the ledger of the tick
+	     * @info: must be called by each market at the end of its tick
+	     * @params:
+	     *   - share: the share of the wallets lost (in [0, 1]), negative to use the decay of the configuration
+	     */
+	    void close (resource res, float share = -1.0f);
+
+	    /**
+	     * Remove the wallets of the VMs that are not running anymore
+	     */
+	    void prune (const std::vector <monitor::libvirt::LibvirtVM*> & vms);
+
+	    /**
+	     * Empty the wallets of all the VMs for a resource
+	     */
+	    void reset (resource res);
+
+	    /**
+	     * @returns: the balances of all the wallets of a VM (indexed by resource)
+	     */
+	    std::vector <unsigned long> wallets (const std::string & vm);
+
+	    /**
+	     * Restore the wallets of a VM (recovered from the journal)
+	     * @params:
+	     *   - balances: the balances indexed by resource (missing resources are empty)
+	     */
+	    void restore (const std::string & vm, const std::vector <unsigned long> & balances);
+
+	    /**
+	     * @returns: the balances of the wallets of a resource
+	     */
+	    nlohmann::json dumpLogs (resource res);
+
+	    /**
+	     * @returns: the name of a resource (cpu, memory, disk, iops, net)
+	     */
+	    static const char* name (resource res);
+
+	private:
+
+	    /**
+	     * Add money to a wallet, and cap it
+	     * @warning: must be called with the mutex locked
+	     */
+	    void add (const std::string & vm, wallet & w, resource res, unsigned long money, unsigned long vmCap);
+
+	    /**
+	     * Write the ledger of a tick in the ledger file
+	     * @warning: must be called with the mutex locked
+	     */
+	    void exportLedger (resource res);
+
+	};
+
+    }
+
+}
@@ -0,0 +1,97 @@
+#include "budget.hh"
+#include <algorithm>
+
+using namespace monitor::libvirt;
+
+namespace server {
+
+    namespace market {
+
+	CpuBudget::CpuBudget (Accounting & accounting) :
+	    _accounting (accounting)
+	{}
+
+	void CpuBudget::setConfig (const BudgetConfig & cfg) {
+	    this-> _config = cfg;
+	}
+
+	void CpuBudget::open (const std::vector <LibvirtVM*> & vms, int cpuFreq) {
+	    this-> _accounting.prune (vms);
+
+	    std::map <std::string, bucket> buckets;
+	    for (auto & v : vms) {
+		// The market ticks every second, one second of nominal is worth nominal money
+		double nominal = v-> getCPUController ().getNominal (cpuFreq);
+		auto capacity = (unsigned long) (nominal * this-> _config.burstSize);
+		auto refill = (unsigned long) (nominal * this-> _config.burstRate);
+
+		auto fnd = this-> _buckets.find (v-> id ());
+		auto & b = buckets [v-> id ()];
+		if (fnd == this-> _buckets.end ()) { // a new VM can burst directly
+		    b.tokens = capacity;
+		} else {
+		    b.tokens = std::min (capacity, fnd-> second.tokens + refill);
+		}
+
+		b.capacity = capacity;
+		b.cap = (unsigned long) (nominal * this-> _config.creditCap);
+		b.spent = 0;
+		b.tab = this-> _accounting.open (v-> id (), resource::CPU, b.cap);
+	    }
+
+	    this-> _buckets = std::move (buckets);
+	}
+
+	// The buckets are only read during the tick (find never inserts), so the shards of the market can use them concurrently
+	void CpuBudget::credit (LibvirtVM & vm, unsigned long money) {
+	    this-> _buckets.at (vm.id ()).tab.credit (money);
+	}
+
+	unsigned long CpuBudget::available (LibvirtVM & vm) {
+	    auto & b = this-> _buckets.at (vm.id ());
+	    auto money = b.tab.available ();
+	    if (this-> _config.burstSize <= 0.0f) return money;
+
+	    return std::min (money, b.tokens);
+	}
+
+	void CpuBudget::debit (LibvirtVM & vm, unsigned long money) {
+	    auto & b = this-> _buckets.at (vm.id ());
+	    auto debited = b.tab.debit (money);
+	    auto spent = std::min (b.tokens, debited);
+	    b.tokens -= spent;
+	    b.spent += spent;
+	}
+
+	void CpuBudget::close () {
+	    for (auto & it : this-> _buckets) {
+		this-> _accounting.settle (it.second.tab);
+		it.second.tab = Accounting::tab ();
+	    }
+
+	    // The decay of the cpu market replaces the decay of the accounting on the cpu wallets
+	    this-> _accounting.close (resource::CPU, this-> _config.decay > 0.0f ? this-> _config.decay : -1.0f);
+	}
+
+	void CpuBudget::reset () {
+	    this-> _accounting.reset (resource::CPU);
+	    this-> _buckets.clear ();
+	}
+
+	nlohmann::json CpuBudget::dumpLogs () const {
+	    nlohmann::json j = nlohmann::json::object ();
+	    for (auto & it : this-> _buckets) {
+		j [it.first] = {
+		    {"tokens", it.second.tokens},
+		    {"capacity", it.second.capacity},
+		    {"spent", it.second.spent},
+		    {"cap", it.second.cap}
+		};
+	    }
+
+	    return j;
+	}
+
+    }
+
+}
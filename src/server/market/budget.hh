@@ -0,0 +1,127 @@
+#pragma once
+#include <monitor/libvirt/_.hh>
+#include <server/market/accounting.hh>
+#include <map>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace server {
+
+    namespace market {
+
+	/**
+	 * The limits on the money a VM can earn and spend in the cpu markets
+	 * @info: the durations are in seconds of the nominal of the VM (the sum of the nominals of its vcpus)
+	 */
+	struct BudgetConfig {
+	    /// The share of the cpu wallets lost at each market tick (in [0, 1]), an idle VM loses its savings exponentially
+	    /// When positive, it replaces the decay of the accounting on the cpu wallets (0 to use the decay of the accounting)
+	    float decay = 0.0f;
+
+	    /// The maximal money of a VM, in seconds of its nominal (0 for no cap)
+	    float creditCap = 0.0f;
+
+	    /// The size of the burst bucket of a VM, in seconds of its nominal (0 to disable the burst budgeting)
+	    float burstSize = 0.0f;
+
+	    /// The share of the nominal of a VM that can be bought above the nominal on the long run (the refill rate of the bucket)
+	    float burstRate = 1.0f;
+	};
+
+	/**
+	 * The budget of the VMs in the cpu markets, the money is earned and spent through it
+	 * It bounds the money of the VMs, so an idle VM cannot hoard money and outbid all the active VMs for a long time :
+	 *  - the money decays at each tick, and is capped to some seconds of nominal
+	 *  - the cycles bought above the nominal are taken from a token bucket, a VM can burst for some seconds, then only at the refill rate
+	 * @info: one unit of money is a cycle per second bought during one market tick (one second), the same unit as the tokens of the buckets
+	 * @info: between open and close, the money of a VM is kept in its tab, settled in the accounting on close, so different VMs can be credited and debited by different threads without synchronization
+	 */
+	class CpuBudget {
+
+	    /**
+	     * The token bucket of a VM
+	     */
+	    struct bucket {
+		/// The number of tokens that can still be spent
+		unsigned long tokens = 0;
+
+		/// The maximal number of tokens
+		unsigned long capacity = 0;
+
+		/// The maximal money of the VM
+		unsigned long cap = 0;
+
+		/// The tokens spent during the current tick
+		unsigned long spent = 0;
+
+		/// The cpu money of the VM during the current tick
+		Accounting::tab tab;
+	    };
+
+	    /// The accounting of the money of the VMs (cpu wallets)
+	    Accounting & _accounting;
+
+	    /// The configuration of the budget
+	    BudgetConfig _config;
+
+	    /// The buckets of the running VMs
+	    std::map <std::string, bucket> _buckets;
+
+	public:
+
+	    /**
+	     * @params:
+	     *   - accounting: the accounting of the money of the VMs
+	     */
+	    CpuBudget (Accounting & accounting);
+
+	    /**
+	     * Change the configuration of the budget
+	     */
+	    void setConfig (const BudgetConfig & cfg);
+
+	    /**
+	     * Start a market tick, the buckets of the VMs are refilled, the tabs of the VMs are opened, and the buckets of the killed VMs are removed
+	     * @params:
+	     *   - vms: the running VMs
+	     *   - cpuFreq: the frequency of the host (to compute the nominal of the VMs)
+	     */
+	    void open (const std::vector <monitor::libvirt::LibvirtVM*> & vms, int cpuFreq);
+
+	    /**
+	     * Give money to a VM that is using less than its nominal
+	     * @info: the money above the credit cap of the VM is lost
+	     */
+	    void credit (monitor::libvirt::LibvirtVM & vm, unsigned long money);
+
+	    /**
+	     * @returns: the cycles a VM can buy (bounded by its money, and by the tokens of its bucket)
+	     */
+	    unsigned long available (monitor::libvirt::LibvirtVM & vm);
+
+	    /**
+	     * Take the money and the tokens of cycles bought by a VM
+	     */
+	    void debit (monitor::libvirt::LibvirtVM & vm, unsigned long money);
+
+	    /**
+	     * End the market tick (settlement of the tabs, decay of the money, and export of the ledger)
+	     */
+	    void close ();
+
+	    /**
+	     * Empty the wallets, and refill the buckets of the VMs
+	     */
+	    void reset ();
+
+	    /**
+	     * @returns: the state of the buckets of the VMs
+	     */
+	    nlohmann::json dumpLogs () const;
+
+	};
+
+    }
+
+}
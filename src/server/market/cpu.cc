@@ -1,214 +1,222 @@
 #include "cpu.hh"
-#include <sys/sysinfo.h>
+#include "waterfill.hh"
 #include <algorithm>  
 #include <monitor/utils/log.hh>
 
 using namespace monitor::libvirt;
+using namespace monitor::libvirt::control;
 using namespace monitor::utils;
 
 namespace server {
 
     namespace market {
 
-	CpuMarket::CpuMarket (monitor::libvirt::LibvirtClient & client) :
-	    _libvirt (client)
+	CpuMarket::CpuMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting) :
+	    _libvirt (client),
+	    _budget (accounting)
 	{}
 	
-	CpuMarket::CpuMarket (monitor::libvirt::LibvirtClient & client, CpuMarketConfig cfg) :
+	CpuMarket::CpuMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting, VCPUMarketConfig cfg) :
 	    _libvirt (client),
+	    _budget (accounting),
 	    _config (cfg)
-	{}
+	{
+	    this-> _budget.setConfig (cfg.budget);
+	    this-> _forecast.setConfig (cfg.forecast);
+	}
 
-	void CpuMarket::setConfig (CpuMarketConfig cfg) {
+	void CpuMarket::setConfig (VCPUMarketConfig cfg) {
 	    this-> _config = cfg;
+	    this-> _budget.setConfig (cfg.budget);
+	    this-> _forecast.setConfig (cfg.forecast);
+	}
+
+	void CpuMarket::setSupply (float share) {
+	    this-> _supply = std::max (0.0f, std::min (1.0f, share));
+	}
+
+	float CpuMarket::getSupply () const {
+	    return this-> _supply;
+	}
+
+	unsigned long CpuMarket::getExcess () const {
+	    return this-> _excess;
 	}
 
 	void CpuMarket::reset () {
-	    this-> _accounts.clear ();
+	    this-> _budget.reset ();
+	}
+
+	const CpuBudget & CpuMarket::getBudget () const {
+	    return this-> _budget;
 	}
 	
 	nlohmann::json CpuMarket::dumpLogs () const {
 	    nlohmann::json j;
-	    nlohmann::json j2;
-	    for (auto & v : this-> _accounts) {
-		j2 [v.first] = v.second;
+	    for (auto & v : this-> _libvirt.getRunningVMs ()) {
+		j [v-> id ()] = v-> getCPUController ().dumpLogs ();
 	    }
-	    
-	    j ["accounts"] = j2;
 
 	    return j;
 	}
 	
-	
 	void CpuMarket::run () {
-	    // auto & vms = this-> _libvirt.getRunningVMs ();
-	    // if (vms.size () == 0) return;
-
-	    // /// The market is the number micro seconds in one second * the number of CPUs on the machine
-	    // /// everything in the market is reported to the second, the VMInfo, and GroupManager make the relation to tick, it is easier that way
-	    // unsigned long market = ((unsigned long) (get_nprocs () * 1000000));
-	    // std::map <std::string, unsigned long> buyers;
-
-	    // /// Sell the base, cycle and compute the list of VMs, that needs more cycles than what they are consuming
-	    // auto allocated = this-> sellBaseCycles (vms, market, buyers);
-	    // /// Run the auction, for the VMs that needs more cycles than the nominal
-	    // unsigned long allNeeded = 0;
-	    // this-> buyCycles (allocated, buyers, market, allNeeded);
-
-	    // // Rest some cycle that have not been sold, so there is some room for optimization	
-	    // if (market > 0) {
-	    // 	long notSold = market;
-	    // 	long rest = std::min (allNeeded, market);
-	    // 	for (auto & v : buyers) { // we split the rest of the market between all the VMs that failed to buy
-	    // 	    float percent = (float) (v.second) / (float) allNeeded; // Implication of the VMs in the market 
-	    // 	    unsigned long add = (unsigned long) (percent * rest);
-	    // 	    allocated [v.first] += add;
-	    // 	    notSold -= add;	   
-	    // 	}	    
-	    // }
-
-	    // for (auto it : allocated) {
-	    // 	vms.find (it.first)-> second-> getCpuController ().setQuota (it.second, 100000); // the period has a strong impact on the memory access (I suppose it makes some synchronization when a thread has no slice left)
-	    // }
+	    auto & vms = this-> _libvirt.getRunningVMs ();
+	    this-> _excess = 0;
+	    if (vms.size () == 0) return;
+	    this-> _budget.open (vms, this-> _config.cpuFreq);
+	    if (this-> _config.forecast.enabled) this-> _forecast.open (vms);
+
+	    /// The market is the number micro seconds in one second * the number of CPUs on the machine
+	    int nbCpus = this-> _config.nbCpus > 0 ? this-> _config.nbCpus : this-> _libvirt.getNbCpus ();
+	    long market = ((long) nbCpus) * 1000000;
+	    long withheld = market - (long) (market * this-> _supply);
+	    auto buyers = this-> sellBaseCycles (vms, market);
+
+	    // over allocation, can't do much here (the excess is reported to the migration orchestrator)
+	    if (market < 0) {
+		this-> _excess = -market;
+		this-> _budget.close ();
+		return;
+	    }
+
+	    // The cycles withheld by the supply are taken from the cycles left after the guarantees
+	    market = std::max (0L, market - withheld);
+
+	    auto fails = this-> buyCycles (buyers, market);
+	    this-> sellRest (vms, fails, market);
+
+	    for (auto & v : vms) { // apply the VM allocations
+		v-> getCPUController ().setQuota (v-> getCPUController ().allocated (), 100000);
+	    }
+
+	    this-> _budget.close ();
 	}
 
-	void CpuMarket::buyCycles (std::map <std::string, unsigned long> & allocated,
-				   std::map <std::string, unsigned long> & buyers,
-				   unsigned long & market,
-				   unsigned long & allNeeded)
-	
+	std::list <LibvirtCPUController*> CpuMarket::buyCycles (std::list <LibvirtCPUController*> & buyers,
+								long & market)
 	{
-	    // /// The list of VMs that failed their bidding, because they have no money
-	    // std::map <std::string, unsigned long> failed;
-	    // while (market > 0 && buyers.size () > 0) {
-	    // 	for (auto v = buyers.cbegin () ; v != buyers.cend () ; ) { // we cannot use : for (auto & v : buyers), because we need to erase elements in the map
-	    // 	    auto money = this-> _accounts [v-> first];
-	    // 	    if (v-> second != 0) {
-	    // 		unsigned long windowSize = std::min (this-> _config.windowSize, money);
-
-	    // 		/// The VM can buy at most, what they can (money, as windowSize), what they need (v-> second), or what is left in the market
-	    // 		auto bought = std::min (std::min (windowSize, v-> second), market);
-	    // 		if (bought != 0) { /// The VM bought some cycles
-	    // 		    this-> _accounts [v-> first] = money - bought; // we remove the money from its account
-	    // 		    allocated [v-> first] = allocated [v-> first] + bought; // we update its allocation
-	    // 		    market = market - bought; // we remove the bought cycles from the market
-	    // 		    buyers [v-> first] -= bought; // we remove the needs
-	    // 		    v ++; // next iteration 
-	    // 		} else { // bought nothing (or the VM has no money, or the market is empty)
-	    // 		    failed.emplace (v-> first, v-> second); // Insert in failed for final phase
-	    // 		    allNeeded += v-> second; // sum of all the failed
-	    // 		    buyers.erase (v ++); // remove the VM from the buyers, the next iteration would fail as well
-	    // 		}
-	    // 	    } else {
-	    // 		buyers.erase (v ++); // The VM has no need, we remove it from the buyers
-	    // 	    }
-	    // 	}
-	    // }
-
-	    // buyers = std::move (failed); // The buyers that are staying in the buyers queue are those who failed to buy (no money, or empty market)
+	    /// The list of VMs that failed their bidding, because they have no money
+	    std::list <LibvirtCPUController*> fails;
+	    while (market > 0 && buyers.size () > 0) {
+		for (auto v = buyers.cbegin () ; v != buyers.cend () ; ) { // we cannot use : for (auto & v : buyers), because we need to erase elements in the list
+		    auto money = this-> _budget.available ((*v)-> vm ());
+		    if ((*v)-> buying () != 0) {
+			// A VM bids for all its vcpus, its window is as large as the windows of its vcpus in the VCPUMarket
+			unsigned long windowSize = std::min (this-> _config.windowSize * (*v)-> vm ().vcpus (), money);
+
+			/// The VM can buy at most, what they can (money, as windowSize), what they need, or what is left in the market
+			auto bought = std::min (std::min (windowSize, (*v)-> buying ()), (unsigned long) market);
+			if (bought != 0) { /// The VM bought some cycles
+			    (*v)-> allocated () += bought;
+			    this-> _budget.debit ((*v)-> vm (), bought);
+			    (*v)-> buying () -= bought;
+			    market -= bought;
+			    v++;
+			} else { // bought nothing (or the VM has no money, or the market is empty)
+			    fails.push_back (*v);
+			    buyers.erase (v++);
+			}
+		    } else {
+			buyers.erase (v++); // The VM has no need, we remove it from the buyers
+		    }
+		}
+	    }
+
+	    return fails;
 	}
 
+	void CpuMarket::sellRest (std::vector <LibvirtVM*> & vms, std::list <LibvirtCPUController*> & fails, long & market) {
+	    if (market > 0 && !fails.empty ()) { // the VMs that failed to buy get what they still need, by max-min fairness
+		std::vector <unsigned long> wanted;
+		for (auto & cpu : fails) wanted.push_back (cpu-> buying ());
+
+		auto given = waterfill (wanted, market);
+		auto g = given.begin ();
+		for (auto & cpu : fails) {
+		    cpu-> allocated () += *g;
+		    cpu-> buying () -= *g;
+		    market -= *g;
+		    g++;
+		}
+	    }
 
-	std::map <std::string, unsigned long> CpuMarket::sellBaseCycles (const std::map <std::string, LibvirtVM*> & vms,
-									 unsigned long & market,
-									 std::map <std::string, unsigned long> & buyers)
-	{
-	    std::map <std::string, unsigned long> allocated;
-	    // for (auto & v : vms) {
-	    // 	unsigned long usage = v.second-> getCpuController ().getConsumption ();
-	    // 	unsigned long max = v.second-> vcpus () * 1000000;
-	    // 	unsigned long min = 500000; // 1/4 de vcpus is the lowest 
-		
-	    // 	unsigned long nominal = ((float) v.second-> freq ()) / ((float) this-> _config.cpuFreq) * max;
-	    // 	unsigned long capp = v.second-> getCpuController ().getAbsoluteCapping ();
-
-		
-	    // 	float perc_usage = v.second-> getCpuController ().getRelativePercentConsumption () / 100.0f;
-	    // 	double slope = v.second-> getCpuController ().getSlope ();	    
-	    // 	/**
-	    // 	 * We have three cases : 
-	    // 	 *  - 1) The VMs uses less than the decrease trigger
-	    // 	 */
-	    // 	if (slope > -0.1f && slope < 0.1f) {
-	    // 	    unsigned long increase = std::min (max, (unsigned long) (usage + max * 0.01));
-	    // 	    unsigned long current = std::max (min, std::min (nominal, increase));
-	    // 	    allocated [v.first] = current;
-	    // 	    market -= current;
-	    // 	    if (increase > nominal) {
-	    // 		this-> increaseMoney (v.first, 0);
-	    // 		buyers [v.first] = std::min (max - nominal, increase - nominal);
-	    // 	    } else {
-	    // 		this-> increaseMoney (v.first, nominal - increase);
-	    // 	    }		    
-	    // 	} else if (perc_usage < this-> _config.triggerDecrement) {
-	    // 	    /// We decrease the speed of the VM by a bit 
-	    // 	    unsigned long decrease = std::max (min, std::max (usage, (unsigned long) (capp * (1.0 - this-> _config.decreasingSpeed))));
-	    // 	    unsigned long current = std::min (nominal, decrease);
-	    // 	    allocated [v.first] = current;
-	    // 	    market -= current;
-
-	    // 	    /// If the VM needs more than nominal, we add it to the buyers for bidding
-	    // 	    if (decrease > nominal) {
-	    // 		this-> increaseMoney (v.first, 0);
-	    // 		buyers [v.first] = std::min (max - nominal, decrease - nominal);
-	    // 	    } else {
-	    // 		this-> increaseMoney (v.first, nominal - decrease);
-	    // 	    }
-	    // 	}
-
-	    // 	/**
-	    // 	 *   - 2) The VM usage is higher than the increase trigger
-	    // 	 */
-	    // 	else if (perc_usage > this-> _config.triggerIncrement) {
-	    // 	    /// We increase the speed of the VM by a bit
-	    // 	    unsigned long increase = capp * (1.0 + this-> _config.increasingSpeed);
-	    // 	    unsigned long current = std::max (min, std::min (nominal, increase));
-	    // 	    allocated [v.first] = current;
-	    // 	    market -= current;
-
-	    // 	    /// If the VM needs more than nominal, we add it to the buyers for bidding
-	    // 	    if (increase > nominal) {
-	    // 		this-> increaseMoney (v.first, 0);
-	    // 		//market += (capp * this-> _config.increasingSpeed) / 3; // recycling
-	    // 		buyers [v.first] = std::min (max - nominal, increase - nominal);
-	    // 	    } else {
-	    // 		this-> increaseMoney (v.first, nominal - increase);
-	    // 	    }
-		    
-	    // 	}
-
-	    // 	/**
-	    // 	 *   - 3) The VM usage is between the two triggers, or the slope is really flat
-	    // 	 */
-	    // 	else {
-	    // 	    unsigned long current = std::max (min, std::min (nominal, capp));		
-	    // 	    allocated [v.first] = current;
-	    // 	    market -= current;
-		    
-	    // 	    /// If the VM needs more than nominal, we add it to the buyers for bidding
-	    // 	    if (capp > nominal) {
-	    // 		this-> increaseMoney (v.first, 0);
-	    // 		buyers [v.first] = std::min (max - nominal, capp - nominal);
-	    // 	    } else {
-	    // 		this-> increaseMoney (v.first, nominal - capp);
-	    // 	    }
-	    // 	}
-	    // }
-	    
-	    return allocated;
+	    if (market > 0 && this-> _config.spareHeadroom) { // the cycles that are still not sold are headroom for the running VMs, an idle VM would not use them
+		std::vector <LibvirtCPUController*> running;
+		std::vector <unsigned long> headroom;
+		for (auto & v : vms) {
+		    auto & cpu = v-> getCPUController ();
+		    auto max = cpu.getMaxConsumption ();
+		    if (cpu.getConsumption () < max / 100 || cpu.allocated () >= max) continue;
+		    running.push_back (&cpu);
+		    headroom.push_back (max - cpu.allocated ());
+		}
+
+		auto given = waterfill (headroom, market);
+		for (std::size_t i = 0 ; i < running.size () ; i++) {
+		    running [i]-> allocated () += given [i];
+		    market -= given [i];
+		}
+	    }
 	}
 
-	void CpuMarket::increaseMoney (const std::string & vmName, unsigned long money) {
-	    auto fnd = this-> _accounts.find (vmName);
-	    if (fnd == this-> _accounts.end ()) {
-		this-> _accounts [vmName] = money;
-	    } else {
-		fnd-> second = fnd-> second + money;
+	std::list <LibvirtCPUController*> CpuMarket::sellBaseCycles (std::vector <LibvirtVM*> & vms, long & market) {
+	    std::list <LibvirtCPUController*> ret;
+	    for (auto & v : vms) {
+		if (this-> sellBaseCycles (v-> getCPUController (), market)) {
+		    ret.push_back (&v-> getCPUController ());
+		}
 	    }
+
+	    return ret;
 	}
 
+	bool CpuMarket::sellBaseCycles (LibvirtCPUController & v, long & market) {
+	    unsigned long usage = v.getConsumption ();
+	    unsigned long max = v.getMaxConsumption ();
+	    unsigned long min = max / 100;
+
+	    unsigned long nominal = v.getNominal (this-> _config.cpuFreq);
+	    unsigned long capp = v.getAbsoluteCapping ();
+
+	    float perc_usage = v.getRelativePercentConsumption () / 100.0f;
+	    double slope = v.getSlope ();
+
+	    /**
+	     * The VM wants the same cycles as a vcpu in the same situation in the VCPUMarket (its forecast demand with the forecast), otherwise : 
+	     *  - 1) The consumption is stable, a bit more than the usage
+	     *  - 2) The usage is lower than the decrease trigger, the capping is decreased
+	     *  - 3) The usage is higher than the increase trigger, the capping is increased
+	     *  - 4) The usage is between the two triggers, the capping is kept
+	     */
+	    unsigned long wanted = capp;
+	    if (this-> _config.forecast.enabled) {
+		// The demand of a throttled VM is hidden by its capping, it is observed as increasing as with the trigger
+		double observed = usage;
+		if (perc_usage > this-> _config.triggerIncrement) observed = std::max (observed, capp * (1.0 + this-> _config.increasingSpeed));
+
+		wanted = std::min (max, (unsigned long) (this-> _forecast.next (v.vm ().id (), 0, observed) + max * 0.01));
+	    } else if (slope > -0.1f && slope < 0.1f) {
+		wanted = std::min (max, (unsigned long) (usage + max * 0.01));
+	    } else if (perc_usage < this-> _config.triggerDecrement) {
+		wanted = std::max (min, std::max (usage, (unsigned long) (capp * (1.0 - this-> _config.decreasingSpeed))));
+	    } else if (perc_usage > this-> _config.triggerIncrement) {
+		wanted = capp * (1.0 + this-> _config.increasingSpeed);
+	    }
+
+	    unsigned long current = std::max (min, std::min (nominal, wanted));
+	    v.allocated () = current;
+	    market -= current;
+
+	    if (wanted > nominal) {
+		v.buying () = std::min (max - nominal, wanted - nominal);
+		return true;
+	    } else {
+		this-> _budget.credit (v.vm (), nominal - wanted);
+		return false;
+	    }
+	}
 	
     }
     
-
 }
@@ -1,51 +1,79 @@
 #pragma once
 #include <monitor/libvirt/_.hh>
-#include <map>
+#include <server/market/vcpu.hh>
 #include <string>
+#include <vector>
+#include <list>
 #include <nlohmann/json.hpp>
 
 namespace server {
 
     namespace market {
 
-	struct CpuMarketConfig {
-	    int cpuFreq; 
-	    float triggerIncrement;
-	    float triggerDecrement;
-	    float increasingSpeed;
-	    float decreasingSpeed;
-	    unsigned long windowSize;
-	};
-
-
 	/**
-	 * Market for the cpu resource allocations
+	 * Market for the cpu resource allocations at the granularity of the VMs
+	 * Each VM buys the cycles for all its vcpus, and the allocation is applied with one limit on the cgroup of the VM
+	 * The guest scheduler balances the cycles between the vcpus, and the market has one entry per VM instead of one per vcpu
 	 */
 	class CpuMarket {
 
 	    /// The libvirt connection
 	    monitor::libvirt::LibvirtClient & _libvirt;
 
-	    /// The accounts of the running vms
-	    std::map <std::string, unsigned long> _accounts;
+	    /// The budget of the VMs, through which the cpu wallets (shared with the VCPUMarket) are credited and debited
+	    CpuBudget _budget;
 
 	    /// The configuration of the market
-	    CpuMarketConfig _config;
+	    VCPUMarketConfig _config;
+
+	    /// The forecast of the demand of the entries of the market (if enabled in the configuration)
+	    DemandForecast _forecast;
+
+	    /// The share of the cpus sold at each tick (cf. setSupply)
+	    float _supply = 1.0f;
+
+	    /// The cpu time by which the guaranteed cycles exceeded the cpus at the last tick (0 if the market was cleared)
+	    unsigned long _excess = 0;
 	    
 	public:
 
-	    CpuMarket (monitor::libvirt::LibvirtClient & client);
+	    /**
+	     * @params: 
+	     *   - client: the libvirt client
+	     *   - accounting: the accounting of the money of the VMs
+	     */
+	    CpuMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting);
 	    
 	    /**
 	     * @params: 
 	     *   - client: the libvirt client
+	     *   - accounting: the accounting of the money of the VMs
+	     *   - config: the configuration of the market
 	     */
-	    CpuMarket (monitor::libvirt::LibvirtClient & client, CpuMarketConfig config);
+	    CpuMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting, VCPUMarketConfig config);
 
 	    /**
 	     * Change the config of the market
 	     */
-	    void setConfig (CpuMarketConfig cfg);
+	    void setConfig (VCPUMarketConfig cfg);
+
+	    /**
+	     * Limit the cycles sold at each tick to a share of the cpus (e.g. to stay under a power cap)
+	     * @params:
+	     *   - share: the share of the cpus sold (1 for all the cpus)
+	     * @info: the guarantees of the VMs (their nominal frequency) are always sold, the supply only limits the cycles sold above them
+	     */
+	    void setSupply (float share);
+
+	    /**
+	     * @returns: the share of the cpus sold at each tick
+	     */
+	    float getSupply () const;
+
+	    /**
+	     * @returns: the cpu time by which the guaranteed cycles exceeded the cpus at the last tick, the market was not cleared if it is not 0
+	     */
+	    unsigned long getExcess () const;
 	    
 	    /**
 	     * Execute an iteration of the market
@@ -57,6 +85,11 @@ namespace server {
 	     * Reset the accounts
 	     */
 	    void reset ();
+
+	    /**
+	     * @returns: the budget of the VMs
+	     */
+	    const CpuBudget & getBudget () const;
 	    
 	    /**
 	     * @returns: a json containing the market informations of the current tick
@@ -68,22 +101,29 @@ namespace server {
 	    /**
 	     * Bidding part of the market 
 	     */
-	    void buyCycles (std::map <std::string, unsigned long> & allocated,
-			    std::map <std::string, unsigned long> & buyers,
-			    unsigned long & market,
-			    unsigned long & allNeeded);
+	    std::list <monitor::libvirt::control::LibvirtCPUController*> buyCycles (std::list <monitor::libvirt::control::LibvirtCPUController*> & buyers,
+										    long & market);
+
+	    /**
+	     * Selling the cycles left after the bidding
+	     * The VMs that failed to buy share them first, by max-min fairness on what they still need
+	     * The rest is shared by max-min fairness on the headroom of the VMs that are not idle (up to all their vcpus), if enabled (cf. VCPUMarketConfig::spareHeadroom)
+	     */
+	    void sellRest (std::vector <monitor::libvirt::LibvirtVM*> & vms,
+			   std::list <monitor::libvirt::control::LibvirtCPUController*> & fails,
+			   long & market);
 
 	    /**
 	     * Selling the base cycles of the VMs (guarantee of nominal frequency)
 	     */
-	    std::map <std::string, unsigned long> sellBaseCycles (const std::map <std::string, monitor::libvirt::LibvirtVM*> & vms,
-								  unsigned long & market,
-								  std::map <std::string, unsigned long> & buyers);
+	    std::list <monitor::libvirt::control::LibvirtCPUController*> sellBaseCycles (std::vector <monitor::libvirt::LibvirtVM*> & vms,
+											 long & market);
 
 	    /**
-	     * Increase the account money of a given VM
+	     * Selling the base cycles for the VM (guarantee of the nominal frequency of all its vcpus)
 	     */
-	    void increaseMoney (const std::string & vmName, unsigned long money);
+	    bool sellBaseCycles (monitor::libvirt::control::LibvirtCPUController & cpu,
+				 long & market);
 	};
 	
     }
@@ -0,0 +1,55 @@
+#include "forecast.hh"
+#include <algorithm>
+#include <cmath>
+
+using namespace monitor::libvirt;
+
+namespace server {
+
+    namespace market {
+
+	void DemandForecast::setConfig (const ForecastConfig & cfg) {
+	    this-> _config = cfg;
+	}
+
+	void DemandForecast::open (const std::vector <LibvirtVM*> & vms) {
+	    std::map <std::string, std::vector <state> > running;
+	    for (auto & v : vms) {
+		auto it = this-> _vms.find (v-> id ());
+		if (it != this-> _vms.end ()) running.emplace (v-> id (), std::move (it-> second));
+		else running.emplace (v-> id (), std::vector <state> ());
+	    }
+
+	    this-> _vms = std::move (running);
+	}
+
+	double DemandForecast::next (const std::string & vm, unsigned int id, double consumption) {
+	    auto & states = this-> _vms.at (vm); // never inserts, the shards of the vcpu market call it concurrently
+	    if (states.size () <= id) states.resize (id + 1);
+
+	    auto & s = states [id];
+	    if (!s.seen) {
+		s.level = consumption;
+		s.trend = 0;
+		s.error = 0;
+		s.seen = true;
+	    } else {
+		auto alpha = this-> _config.alpha, beta = this-> _config.beta;
+		auto forecast = s.level + s.trend;
+		s.error = alpha * std::abs (consumption - forecast) + (1.0 - alpha) * s.error;
+
+		auto level = alpha * consumption + (1.0 - alpha) * forecast;
+		s.trend = beta * (level - s.level) + (1.0 - beta) * s.trend;
+		s.level = level;
+	    }
+
+	    return std::max (0.0, s.level + s.trend + this-> _config.margin * s.error);
+	}
+
+	void DemandForecast::reset () {
+	    this-> _vms.clear ();
+	}
+
+    }
+
+}
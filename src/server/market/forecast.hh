@@ -0,0 +1,92 @@
+#pragma once
+#include <monitor/libvirt/_.hh>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace server {
+
+    namespace market {
+
+	/**
+	 * The forecast of the demand of the vcpus, replacing the slope and the triggers of the cpu markets
+	 */
+	struct ForecastConfig {
+	    /// True iif the bids of the vcpus are their forecast demand
+	    bool enabled = false;
+
+	    /// The smoothing of the level of the demand (in ]0, 1], 1 to forecast the last consumption)
+	    float alpha = 0.5f;
+
+	    /// The smoothing of the trend of the demand (in [0, 1], 0 for an exponential smoothing without trend)
+	    float beta = 0.3f;
+
+	    /// The share of the mean error of the forecast added to the bids
+	    float margin = 1.0f;
+	};
+
+	/**
+	 * The forecast of the consumption of the vcpus (or the VMs) at the next market tick, by double exponential smoothing (Holt)
+	 * The level and the trend of each entry are updated incrementally with the consumption of each tick, as its history
+	 * The forecast is the level plus the trend, plus a margin of the mean absolute error of the past forecasts, so the entries whose consumption is erratic get more room
+	 * @info: the entries of the VMs that left are removed when a tick opens
+	 */
+	class DemandForecast {
+
+	    /**
+	     * The state of the forecast of one entry
+	     */
+	    struct state {
+		/// The smoothed consumption
+		double level = 0;
+
+		/// The smoothed change of consumption per tick
+		double trend = 0;
+
+		/// The mean absolute error of the forecasts
+		double error = 0;
+
+		/// True iif the entry was observed once
+		bool seen = false;
+	    };
+
+	    /// The configuration of the forecast
+	    ForecastConfig _config;
+
+	    /// The states of the entries of each VM (indexed by the id of the vcpus, or 0 for a whole VM)
+	    std::map <std::string, std::vector <state> > _vms;
+
+	public:
+
+	    /**
+	     * Change the configuration of the forecast
+	     * @info: the states are kept
+	     */
+	    void setConfig (const ForecastConfig & cfg);
+
+	    /**
+	     * Start a market tick, the states of the VMs that left are removed, and the states of the new VMs are created
+	     * @info: after the opening, the entries of different VMs can be updated by different threads
+	     */
+	    void open (const std::vector <monitor::libvirt::LibvirtVM*> & vms);
+
+	    /**
+	     * Update the forecast of an entry with its consumption of the tick
+	     * @params:
+	     *   - vm: the name of the VM
+	     *   - id: the id of the vcpu (0 for a whole VM)
+	     *   - consumption: the consumption of the tick
+	     * @returns: the consumption forecast for the next tick, with the margin (in the unit of the consumption)
+	     */
+	    double next (const std::string & vm, unsigned int id, double consumption);
+
+	    /**
+	     * Forget all the states
+	     */
+	    void reset ();
+
+	};
+
+    }
+
+}
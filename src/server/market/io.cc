@@ -0,0 +1,153 @@
+#include "io.hh"
+#include <algorithm>
+#include <monitor/utils/log.hh>
+
+using namespace monitor::libvirt;
+using namespace monitor::libvirt::control;
+using namespace monitor::utils;
+
+namespace server {
+
+    namespace market {
+
+	IOMarket::IOMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting) :
+	    _libvirt (client),
+	    _accounting (accounting)
+	{}
+
+	void IOMarket::setConfig (IOMarketConfig cfg) {
+	    this-> _config = cfg;
+	}
+
+	void IOMarket::reset () {
+	    this-> _accounting.reset (resource::DISK);
+	    this-> _accounting.reset (resource::IOPS);
+	    this-> _accounting.reset (resource::NET);
+	}
+
+	void IOMarket::run () {
+	    auto & vms = this-> _libvirt.getRunningVMs ();
+	    if (vms.size () == 0) return;
+
+	    // The wallets of the killed VMs are removed
+	    this-> _accounting.prune (vms);
+
+	    this-> runResource (vms, &LibvirtIOController::disk, resource::DISK, this-> _config.diskBandwidth);
+	    this-> runResource (vms, &LibvirtIOController::iops, resource::IOPS, this-> _config.diskIops);
+	    this-> runResource (vms, &LibvirtIOController::net, resource::NET, this-> _config.netBandwidth);
+
+	    for (auto & v : vms) { // apply the io allocations
+		v-> getIOController ().applyAllocation ();
+	    }
+
+	    this-> _accounting.close (resource::DISK);
+	    this-> _accounting.close (resource::IOPS);
+	    this-> _accounting.close (resource::NET);
+	}
+
+	nlohmann::json IOMarket::dumpLogs () const {
+	    nlohmann::json j;
+	    j ["disk"] = this-> _accounting.dumpLogs (resource::DISK);
+	    j ["iops"] = this-> _accounting.dumpLogs (resource::IOPS);
+	    j ["net"] = this-> _accounting.dumpLogs (resource::NET);
+
+	    return j;
+	}
+
+	void IOMarket::runResource (std::vector <LibvirtVM*> & vms, accessor get, resource res, unsigned long capacity) {
+	    long market = capacity;
+	    std::list <LibvirtIOController*> buyers;
+	    for (auto & v : vms) {
+		auto & io = v-> getIOController ();
+		auto & r = (io.*get) ();
+		r.max = capacity;
+		if (this-> sellBase (v-> id (), r, res, market)) {
+		    buyers.push_back (&io);
+		}
+	    }
+
+	    // over allocation, the nominals are applied, nothing can be sold
+	    if (market < 0) return;
+
+	    unsigned long allNeeded = 0;
+	    auto fails = this-> buy (buyers, get, res, market, allNeeded);
+	    if (market > 0 && allNeeded > 0) {
+		long rest = std::min (allNeeded, (unsigned long) market);
+		for (auto & io : fails) { // we split the rest of the market between all the VMs that failed to buy
+		    auto & r = ((*io).*get) ();
+		    float percent = (float) (r.buying) / (float) allNeeded; // Implication of the VMs in the market
+		    unsigned long add = std::min (r.buying, (unsigned long) (percent * rest));
+		    r.allocated += add;
+		    r.buying -= add;
+		}
+	    }
+	}
+
+	std::list <LibvirtIOController*> IOMarket::buy (std::list <LibvirtIOController*> & buyers,
+							 accessor get,
+							 resource res,
+							 long & market,
+							 unsigned long & allNeeded)
+	{
+	    /// The list of VMs that failed their bidding, because they have no money
+	    std::list <LibvirtIOController*> fails;
+	    while (market > 0 && buyers.size () > 0) {
+		for (auto v = buyers.cbegin () ; v != buyers.cend () ; ) { // we cannot use : for (auto & v : buyers), because we need to erase elements in the list
+		    auto & r = ((**v).*get) ();
+		    auto money = this-> _accounting.available ((*v)-> vm ().id (), res);
+		    if (r.buying != 0) {
+			unsigned long window = std::max ((unsigned long) 1, (unsigned long) (r.nominal * this-> _config.windowSize));
+			unsigned long windowSize = std::min (window, money);
+
+			/// The VM can buy at most, what they can (money, as windowSize), what they need, or what is left in the market
+			auto bought = std::min (std::min (windowSize, r.buying), (unsigned long) market);
+			if (bought != 0) { /// The VM bought some io
+			    r.allocated += bought;
+			    r.buying -= bought;
+			    this-> _accounting.debit ((*v)-> vm ().id (), res, bought);
+			    market -= bought;
+			    v++;
+			} else { // bought nothing (or the VM has no money, or the market is empty)
+			    allNeeded += r.buying;
+			    fails.push_back (*v);
+			    buyers.erase (v++);
+			}
+		    } else {
+			buyers.erase (v++); // The VM has no need, we remove it from the buyers
+		    }
+		}
+	    }
+
+	    return fails;
+	}
+
+	bool IOMarket::sellBase (const std::string & vm, io_resource & r, resource res, long & market) {
+	    unsigned long nominal = std::min (r.nominal, r.max);
+	    unsigned long min = std::max (nominal / 10, (unsigned long) 1);
+	    unsigned long capp = r.limit < 0 ? r.max : r.limit;
+	    float percUsage = capp == 0 ? 0.0f : ((float) r.usage) / ((float) capp);
+
+	    // The limit follows the usage, as the vcpu cappings
+	    unsigned long wanted = capp;
+	    if (percUsage > this-> _config.triggerIncrement) {
+		wanted = std::min (r.max, (unsigned long) (capp * (1.0 + this-> _config.increasingSpeed)));
+	    } else if (percUsage < this-> _config.triggerDecrement) {
+		wanted = std::max (r.usage, (unsigned long) (capp * (1.0 - this-> _config.decreasingSpeed)));
+	    }
+	    wanted = std::max (min, wanted);
+
+	    r.allocated = std::min (nominal, wanted);
+	    market -= r.allocated;
+	    if (wanted > nominal) {
+		r.buying = wanted - nominal;
+		return true;
+	    } else {
+		r.buying = 0;
+		this-> _accounting.credit (vm, res, nominal - wanted);
+		return false;
+	    }
+	}
+
+    }
+
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <monitor/libvirt/_.hh>
+#include <server/market/accounting.hh>
+#include <map>
+#include <list>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace server {
+
+    namespace market {
+
+	struct IOMarketConfig {
+	    /// The disk bandwidth of the host sold to the VMs in KB/s
+	    unsigned long diskBandwidth;
+
+	    /// The disk operations per second of the host sold to the VMs
+	    unsigned long diskIops;
+
+	    /// The network bandwidth of the host sold to the VMs in KB/s
+	    unsigned long netBandwidth;
+
+	    /// The percentage of usage of an io limit before an increment of the allocation
+	    float triggerIncrement;
+
+	    /// The speed of the increment of the allocation
+	    float increasingSpeed;
+
+	    /// The percentage of usage of an io limit before a decrement of the allocation
+	    float triggerDecrement;
+
+	    /// The speed of the decrement of the allocation
+	    float decreasingSpeed;
+
+	    /// The bidding window size in percentage of the nominal of the VMs
+	    float windowSize;
+	};
+
+	/**
+	 * Market for the io resource allocations (disk bandwidth, disk operations, and network bandwidth)
+	 * Each resource is sold independently with the same mechanics as the memory market :
+	 * the VMs are guaranteed the io of their specification, the VMs using less than their nominal earn money, that they spend to buy io above it
+	 * @info: each resource has its own wallet in the accounting
+	 */
+	class IOMarket {
+
+	    /// The accessor of a resource in the io controllers
+	    typedef monitor::libvirt::control::io_resource & (monitor::libvirt::control::LibvirtIOController::*accessor) ();
+
+	    /// The libvirt connection
+	    monitor::libvirt::LibvirtClient & _libvirt;
+
+	    /// The accounting of the money of the VMs (disk, iops, and net wallets)
+	    Accounting & _accounting;
+
+	    /// The configuration of the market
+	    IOMarketConfig _config;
+
+	public :
+
+	    /**
+	     * @params:
+	     *   - client: the libvirt client
+	     *   - accounting: the accounting of the money of the VMs
+	     */
+	    IOMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting);
+
+	    /**
+	     * Change the configuration of the market
+	     */
+	    void setConfig (IOMarketConfig cfg);
+
+	    /**
+	     * Execute an iteration of the market
+	     * @info: this automatically updates the io limits of the VMs
+	     */
+	    void run ();
+
+	    /**
+	     * Reset the accounts
+	     */
+	    void reset ();
+
+	    /**
+	     * @returns: a json containing the market information of the current tick
+	     */
+	    nlohmann::json dumpLogs () const;
+
+	private :
+
+	    /**
+	     * Run the auction of one resource
+	     * @params:
+	     *    - vms: the list of running VMs
+	     *    - get: the accessor of the resource in the io controllers
+	     *    - res: the resource to sell
+	     *    - capacity: the quantity of the resource on the host
+	     */
+	    void runResource (std::vector <monitor::libvirt::LibvirtVM*> & vms, accessor get, resource res, unsigned long capacity);
+
+	    /**
+	     * Bidding part of the market
+	     * @params:
+	     *   - buyers: the list of buyers
+	     *   - market: the quantity of resource that can be sold
+	     * @returns:
+	     *   - allNeeded: the sum of unsold resource
+	     *   - market: the quantity of resource that was not sold
+	     *   - .0: the list of io controllers that failed to buy
+	     */
+	    std::list <monitor::libvirt::control::LibvirtIOController*> buy (std::list <monitor::libvirt::control::LibvirtIOController*> & buyers,
+									     accessor get,
+									     resource res,
+									     long & market,
+									     unsigned long & allNeeded);
+
+	    /**
+	     * Selling the base alloc of a VM (guaranteing its nominal)
+	     * @params:
+	     *    - vm: the name of the VM
+	     *    - r: the resource of the VM
+	     *    - res: the kind of the resource
+	     * @returns: true iif the VM wants to buy more than its nominal
+	     */
+	    bool sellBase (const std::string & vm, monitor::libvirt::control::io_resource & r, resource res, long & market);
+
+	};
+
+    }
+
+}
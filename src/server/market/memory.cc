@@ -1,12 +1,19 @@
 #include "memory.hh"
+#include <algorithm>
+#include <monitor/utils/log.hh>
 
+using namespace monitor::libvirt;
+using namespace monitor::libvirt::control;
+using namespace monitor::utils;
 
 namespace server {
 
     namespace market {
 
 
-	MemoryMarket::MemoryMarket (monitor::libvirt::LibvirtClient & client) : _libvirt (client)
+	MemoryMarket::MemoryMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting) :
+	    _libvirt (client),
+	    _accounting (accounting)
 	{}
 
 	void MemoryMarket::setConfig (MemoryMarketConfig cfg) {
@@ -14,136 +21,139 @@ namespace server {
 	}
 
 	void MemoryMarket::reset () {
-	    this-> _accounts.clear ();
+	    this-> _accounting.reset (resource::MEMORY);
 	}
-	
+
 	void MemoryMarket::run () {
-	    // auto & vms = this-> _libvirt.getRunningVMs ();
-	    // if (vms.size () == 0) return;
-
-	    // // The market is the quantity of memory the host is providing to the VMs
-	    // unsigned long market = this-> _config.memory;
-	    // std::map <std::string, unsigned long> buyers;
-
-	    // auto allocated = this-> sellBaseKbs (vms, market, buyers);
-
-	    // // Run the auction, for the VMs that needs more memory than the guaranteed nominal
-	    // unsigned long allNeeded = 0;
-	    // this-> buyKbs (allocated, buyers, market, allNeeded);
-
-	    // if (market > 0) {
-	    // 	long notSold = market;
-	    // 	long rest = std::min (allNeeded, market);
-	    // 	for (auto & v : buyers) { // we split the rest of the market between all the VMs that failed to buy
-	    // 	    float percent = (float) (v.second) / (float) allNeeded; // Implication of the VMs in the market 
-	    // 	    unsigned long add = (unsigned long) (percent * rest);
-	    // 	    allocated [v.first] += add;
-	    // 	    notSold -= add;	   
-	    // 	}	    
-	    // }
-
-	    // for (auto it : allocated) {
-	    // 	vms.find (it.first)-> second-> getMemoryController ().setAllocatedMemory (it.second); 
-	    // }
+	    auto & vms = this-> _libvirt.getRunningVMs ();
+	    if (vms.size () == 0) return;
+
+	    // The wallets of the killed VMs are removed
+	    this-> _accounting.prune (vms);
+
+	    // The market is the quantity of memory the host is providing to the VMs
+	    long market = this-> _config.memory;
+	    auto buyers = this-> sellBaseKbs (vms, market);
+
+	    // over allocation, the nominal memories are applied, nothing can be sold
+	    if (market >= 0) {
+		// Run the auction, for the VMs that needs more memory than the guaranteed nominal
+		unsigned long allNeeded = 0;
+		auto fails = this-> buyKbs (buyers, market, allNeeded);
+
+		if (market > 0 && allNeeded > 0) {
+		    long notSold = market;
+		    long rest = std::min (allNeeded, (unsigned long) market);
+		    for (auto & mem : fails) { // we split the rest of the market between all the VMs that failed to buy
+			float percent = (float) (mem-> buying ()) / (float) allNeeded; // Implication of the VMs in the market
+			unsigned long add = std::min (mem-> buying (), (unsigned long) (percent * rest));
+			mem-> allocated () += add;
+			mem-> buying () -= add;
+			notSold -= add;
+		    }
+		    market = notSold;
+		}
+	    }
+
+	    for (auto & v : vms) { // apply the memory allocations
+		v-> getMemoryController ().applyAllocation ();
+	    }
+
+	    this-> _accounting.close (resource::MEMORY);
 	}
 
 	nlohmann::json MemoryMarket::dumpLogs () const {
 	    nlohmann::json j;
-	    nlohmann::json j2;
-	    for (auto & v : this-> _accounts) {
-		j2 [v.first] = v.second;
-	    }
-	    
-	    j ["accounts"] = j2;
+	    j ["accounts"] = this-> _accounting.dumpLogs (resource::MEMORY);
 
 	    return j;
 	}
 
-	void MemoryMarket::buyKbs (std::map <std::string, unsigned long> & allocated,
-				     std::map <std::string, unsigned long> & buyers,
-				     unsigned long & market,
-				     unsigned long & allNeeded)
+	std::list <LibvirtMemoryController*> MemoryMarket::buyKbs (std::list <LibvirtMemoryController*> & buyers,
+								   long & market,
+								   unsigned long & allNeeded)
 	{
 	    /// The list of VMs that failed their bidding, because they have no money
-	    std::map <std::string, unsigned long> failed;
-	    // while (market > 0 && buyers.size () > 0) {
-	    // 	for (auto v = buyers.cbegin () ; v != buyers.cend () ; ) { // we cannot use : for (auto & v : buyers), because we need to erase elements in the map
-	    // 	    auto money = this-> _accounts [v-> first];
-	    // 	    if (v-> second != 0) {
-	    // 		unsigned long windowSize = std::min (this-> _config.windowSize, money);
-
-	    // 		/// The VM can buy at most, what they can (money, as windowSize), what they need (v-> second), or what is left in the market
-	    // 		auto bought = std::min (std::min (windowSize, v-> second), market);
-	    // 		if (bought != 0) { /// The VM bought some Kbs
-	    // 		    this-> _accounts [v-> first] = money - bought; // we remove the money from its account
-	    // 		    allocated [v-> first] = allocated [v-> first] + bought; // we update its allocation
-	    // 		    market = market - bought; // we remove the bought Kbs from the market
-	    // 		    buyers [v-> first] -= bought; // we remove the needs
-	    // 		    v ++; // next iteration 
-	    // 		} else { // bought nothing (or the VM has no money, or the market is empty)
-	    // 		    failed.emplace (v-> first, v-> second); // Insert in failed for final phase
-	    // 		    allNeeded += v-> second; // sum of all the failed
-	    // 		    buyers.erase (v ++); // remove the VM from the buyers, the next iteration would fail as well
-	    // 		}
-	    // 	    } else {
-	    // 		buyers.erase (v ++); // The VM has no need, we remove it from the buyers
-	    // 	    }
-	    // 	}
-	    // }
-
-	    // buyers = std::move (failed); // The buyers that are staying in the buyers queue are those who failed to buy (no money, or empty market)
+	    std::list <LibvirtMemoryController*> fails;
+	    while (market > 0 && buyers.size () > 0) {
+		for (auto v = buyers.cbegin () ; v != buyers.cend () ; ) { // we cannot use : for (auto & v : buyers), because we need to erase elements in the list
+		    auto money = this-> _accounting.available ((*v)-> vm ().id (), resource::MEMORY);
+		    if ((*v)-> buying () != 0) {
+			unsigned long windowSize = std::min (this-> _config.windowSize, money);
+
+			/// The VM can buy at most, what they can (money, as windowSize), what they need, or what is left in the market
+			auto bought = std::min (std::min (windowSize, (*v)-> buying ()), (unsigned long) market);
+			if (bought != 0) { /// The VM bought some Kbs
+			    (*v)-> allocated () += bought;
+			    (*v)-> buying () -= bought;
+			    this-> _accounting.debit ((*v)-> vm ().id (), resource::MEMORY, bought);
+			    market -= bought;
+			    v++;
+			} else { // bought nothing (or the VM has no money, or the market is empty)
+			    allNeeded += (*v)-> buying ();
+			    fails.push_back (*v);
+			    buyers.erase (v++);
+			}
+		    } else {
+			buyers.erase (v++); // The VM has no need, we remove it from the buyers
+		    }
+		}
+	    }
+
+	    return fails;
 	}
 
 
-	std::map <std::string, unsigned long> MemoryMarket::sellBaseKbs (
-	    const std::map <std::string, monitor::libvirt::LibvirtVM*> & vms,
-	    unsigned long & market,
-	    std::map <std::string, unsigned long> & buyers)
-	{
-	    std::map <std::string, unsigned long> allocated;
-	    // for (auto & v : vms) {
-	    // 	unsigned long usage = v.second-> getMemoryController ().getGuestUsed () + v.second-> getMemoryController ().getSwapping ();
-	    // 	unsigned long max = v.second-> getMemoryController ().getMaxMemory ();
-	    // 	unsigned long capp = v.second-> getMemoryController ().getAllocated ();
-	    // 	auto percUsage = v.second-> getMemoryController ().getRelativePercentUsed ();
-	    // 	float slope = v.second-> getMemoryController ().getSlope ();
-	    // 	unsigned long min = 1048576; // 1GB is the minimal
-	    // 	auto nominal = v.second-> getMemoryController ().getMinGuarantee ();
-	    // 	unsigned long current = min;
-
-	    // 	current = std::max (min, std::min (usage + min, max));
-	    // 	if (slope < -0.1f || slope > 0.1f) {
-	    // 	    if (percUsage > this-> _config.triggerIncrement) {
-	    // 		current = std::max (min, std::min (max, (unsigned long) ((usage + min) * (1.0 + this-> _config.increasingSpeed))));
-	    // 	    } else if (percUsage < this-> _config.triggerDecrement) {
-	    // 		current = std::max (min, std::min (max, (unsigned long) ((capp + min) * (1.0 - this-> _config.decreasingSpeed))));
-	    // 	    }		
-	    // 	} 
-
-	    // 	if (current > nominal) {
-	    // 	    allocated [v.first] = nominal;
-	    // 	    buyers [v.first] = current - nominal;
-	    // 	} else {
-	    // 	    allocated[v.first] = current;
-	    // 	    this-> increaseMoney (v.first, nominal - current);
-	    // 	}
-		
-	    // 	market -= allocated[v.first];
-	    // }
-	    return allocated;
+	std::list <LibvirtMemoryController*> MemoryMarket::sellBaseKbs (std::vector <LibvirtVM*> & vms, long & market) {
+	    std::list <LibvirtMemoryController*> ret;
+	    for (auto & v : vms) {
+		if (this-> sellBaseKbs (v-> getMemoryController (), market)) {
+		    ret.push_back (&v-> getMemoryController ());
+		}
+	    }
+
+	    return ret;
 	}
 
-	void MemoryMarket::increaseMoney (const std::string & vmName, unsigned long money) {
-	    auto fnd = this-> _accounts.find (vmName);
-	    if (fnd == this-> _accounts.end ()) {
-		this-> _accounts [vmName] = money;
+	bool MemoryMarket::sellBaseKbs (LibvirtMemoryController & mem, long & market) {
+	    unsigned long max = mem.getMaxMemory ();
+	    unsigned long capp = mem.getBalloon ();
+	    unsigned long nominal = mem.getNominal ();
+	    unsigned long min = std::min (max, (unsigned long) 1048576); // 1GB is the minimal
+
+	    // If the guest did not report its usage (booting, no balloon driver), its allocation is not changed
+	    unsigned long current = capp;
+	    if (mem.isSampled ()) {
+		// The memory the guest had to read back from its swap disk is needed, even if it is not used anymore
+		unsigned long usage = mem.getGuestUsed () + mem.getSwapping ();
+		float percUsage = mem.getRelativePercentUsed () / 100.0f;
+		float slope = mem.getSlope ();
+		bool thrashing = mem.getSwapping () != 0 || mem.getPressure () > 0.0f;
+
+		// By default the VM keeps a margin above its usage
+		current = std::max (min, std::min (usage + min, max));
+		if (slope < -0.1f || slope > 0.1f) {
+		    if (percUsage > this-> _config.triggerIncrement) {
+			current = std::max (min, std::min (max, (unsigned long) ((usage + min) * (1.0 + this-> _config.increasingSpeed))));
+		    } else if (percUsage < this-> _config.triggerDecrement && !thrashing) {
+			current = std::max (current, std::min (max, (unsigned long) (capp * (1.0 - this-> _config.decreasingSpeed))));
+		    }
+		}
+	    }
+
+	    if (current > nominal) {
+		mem.allocated () = nominal;
+		mem.buying () = current - nominal;
 	    } else {
-		fnd-> second = fnd-> second + money;
+		mem.allocated () = current;
+		mem.buying () = 0;
+		this-> _accounting.credit (mem.vm ().id (), resource::MEMORY, nominal - current);
 	    }
+
+	    market -= mem.allocated ();
+	    return mem.buying () != 0;
 	}
-		
+
     }
-    
-}
 
-    
+}
@@ -1,7 +1,10 @@
 #pragma once
 #include <monitor/libvirt/_.hh>
+#include <server/market/accounting.hh>
 #include <map>
+#include <list>
 #include <string>
+#include <vector>
 #include <nlohmann/json.hpp>
 
 namespace server {
@@ -10,7 +13,7 @@ namespace server {
 
 
 	struct MemoryMarketConfig {
-	    /// The quantity of memory available on the host in Kb
+	    /// The quantity of memory available on the host for the VMs in Kb
 	    unsigned long memory;
 	    
 	    /// The percentage of usage of memory in VM before an increment of memory allocation
@@ -25,27 +28,33 @@ namespace server {
 	    /// The speed of the decrement of memory
 	    float decreasingSpeed;
 
-	    /// The bidding window size
+	    /// The bidding window size in Kb
 	    unsigned long windowSize;
 	};
 	
 	/**
 	 * Market for the memory resource allocations
+	 * Each VM is guaranteed its nominal memory (memory * memorySLA), the VMs using less than their nominal earn money, that they spend to buy memory above it
 	 */
 	class MemoryMarket {
 
 	    /// The libvirt connection
 	    monitor::libvirt::LibvirtClient & _libvirt;
 
+	    /// The accounting of the money of the VMs (memory wallets)
+	    Accounting & _accounting;
+
 	    /// The configuration of the market
 	    MemoryMarketConfig _config;
 
-	    /// The accounts of the running VMs
-	    std::map <std::string, unsigned long> _accounts;
-
 	public :
-	    
-	    MemoryMarket (monitor::libvirt::LibvirtClient & client);
+
+	    /**
+	     * @params:
+	     *   - client: the libvirt client
+	     *   - accounting: the accounting of the money of the VMs
+	     */
+	    MemoryMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting);
 
 	    /**
 	     * Change the configuration of the market
@@ -54,7 +63,7 @@ namespace server {
 	    
 	    /**
 	     * Execute an iteration of the market
-	     * @info: this automatically updates the memory quotas of the VMs
+	     * @info: this automatically updates the memory allocations of the VMs
 	     */
 	    void run ();
 
@@ -73,19 +82,16 @@ namespace server {
 	    /**
 	     * Bidding part of the market
 	     * @params: 
-	     *   - allocated: the current allocation (@return)
 	     *   - buyers: the list of buyers
 	     *   - market: the quantity of memory that can be sold
 	     * @returns: 
 	     *   - allNeeded: the sum of unsold memory
 	     *   - market: the quantity of memory that was not sold
-	     *   - buyers: the list of VM that failed to buy 
-	     *   - allocated: the new allocations
+	     *   - .0: the list of memory controllers that failed to buy
 	     */
-	    void buyKbs (std::map <std::string, unsigned long> & allocated,
-			   std::map <std::string, unsigned long> & buyers,
-			   unsigned long & market,
-			   unsigned long & allNeeded);
+	    std::list <monitor::libvirt::control::LibvirtMemoryController*> buyKbs (std::list <monitor::libvirt::control::LibvirtMemoryController*> & buyers,
+										    long & market,
+										    unsigned long & allNeeded);
 	    
 
 	    /**
@@ -94,20 +100,17 @@ namespace server {
 	     *    - vms: the list of running VMs
 	     *    - market: the quantity of memory (in Kb) available on the host
 	     * @returns: 
-	     *   - buyers: the list of VMs that will participate to the bidding (associated to the quantity of alloc they will try to buy)
-	     *   - .0: the default allocations
+	     *   - market: the quantity of memory left after the base allocations
+	     *   - .0: the list of memory controllers that will participate to the bidding
 	     */
-	    std::map <std::string, unsigned long> sellBaseKbs (const std::map <std::string, monitor::libvirt::LibvirtVM*> & vms,
-								 unsigned long & market,
-								 std::map <std::string, unsigned long> & buyers);
+	    std::list <monitor::libvirt::control::LibvirtMemoryController*> sellBaseKbs (std::vector <monitor::libvirt::LibvirtVM*> & vms,
+											 long & market);
 
 	    /**
-	     * Increase the accounts of a given VM
-	     * @params: 
-	     *   - vmName: the name of the VM
-	     *   - money: the quantity of memory to add to the VM
+	     * Selling the base alloc of a VM (guaranteing minimal allocation)
+	     * @returns: true iif the VM wants to buy more than its nominal memory
 	     */
-	    void increaseMoney (const std::string & vmName, unsigned long money);
+	    bool sellBaseKbs (monitor::libvirt::control::LibvirtMemoryController & mem, long & market);
 	    
 	};
 	
@@ -1,7 +1,8 @@
 #include "vcpu.hh"
-#include <sys/sysinfo.h>
+#include "waterfill.hh"
 #include <algorithm>  
 #include <monitor/utils/log.hh>
+#include <monitor/utils/exception.hh>
 
 using namespace monitor::libvirt;
 using namespace monitor::libvirt::control;
@@ -11,113 +12,320 @@ namespace server {
 
     namespace market {
 
-	VCPUMarket::VCPUMarket (monitor::libvirt::LibvirtClient & client) :
-	    _libvirt (client)
+	VCPUMarketConfig VCPUMarketConfig::parse (const nlohmann::json & j) {
+	    auto read = VCPUMarketConfig {
+		j.at ("frequency").get<int> (),
+		j.at ("trigger-increment").get<float> () / 100.0f,
+		j.at ("trigger-decrement").get<float> () / 100.0f,
+		j.at ("increment-speed").get<float> () / 100.0f,
+		j.at ("decrement-speed").get<float> () / 100.0f,
+		j.at ("window-size").get<unsigned long> ()
+	    };
+
+	    auto mode = j.contains ("mode") ? j.at ("mode").get<std::string> () : std::string ("vcpu");
+	    if (mode != "vcpu" && mode != "vm") throw monitor::utils::exception ("mode must be vcpu or vm");
+	    read.vmLevel = (mode == "vm");
+
+	    read.budget.decay = j.contains ("decay") ? j.at ("decay").get<float> () / 100.0f : 0.0f;
+	    read.budget.creditCap = j.contains ("credit-cap") ? j.at ("credit-cap").get<float> () : 0.0f;
+	    if (j.contains ("burst")) {
+		read.budget.burstSize = j.at ("burst").at ("size").get<float> ();
+		read.budget.burstRate = j.at ("burst").at ("rate").get<float> () / 100.0f;
+	    }
+
+	    read.spareHeadroom = j.contains ("spare-headroom") ? j.at ("spare-headroom").get<bool> () : false;
+	    read.realCycles = j.contains ("real-cycles") ? j.at ("real-cycles").get<bool> () : false;
+	    if (j.contains ("forecast")) {
+		auto & f = j.at ("forecast");
+		read.forecast.enabled = f.contains ("enable") ? f.at ("enable").get<bool> () : true;
+		read.forecast.alpha = f.contains ("alpha") ? f.at ("alpha").get<float> () / 100.0f : 0.5f;
+		read.forecast.beta = f.contains ("beta") ? f.at ("beta").get<float> () / 100.0f : 0.3f;
+		read.forecast.margin = f.contains ("margin") ? f.at ("margin").get<float> () / 100.0f : 1.0f;
+	    }
+
+	    read.threads = j.contains ("threads") ? j.at ("threads").get<unsigned int> () : 1;
+
+	    if (read.cpuFreq <= 0) throw monitor::utils::exception ("frequency must be positive");
+	    if (read.triggerIncrement < 0.0f || read.triggerIncrement > 1.0f) throw monitor::utils::exception ("trigger-increment must be in [0, 100]");
+	    if (read.triggerDecrement < 0.0f || read.triggerDecrement > read.triggerIncrement) throw monitor::utils::exception ("trigger-decrement must be in [0, trigger-increment]");
+	    if (read.increasingSpeed <= 0.0f) throw monitor::utils::exception ("increment-speed must be positive");
+	    if (read.decreasingSpeed <= 0.0f || read.decreasingSpeed > 1.0f) throw monitor::utils::exception ("decrement-speed must be in ]0, 100]");
+	    if (read.windowSize == 0) throw monitor::utils::exception ("window-size must be positive");
+	    if (read.budget.decay < 0.0f || read.budget.decay > 1.0f) throw monitor::utils::exception ("decay must be in [0, 100]");
+	    if (read.budget.creditCap < 0.0f) throw monitor::utils::exception ("credit-cap must be positive");
+	    if (read.budget.burstSize < 0.0f) throw monitor::utils::exception ("burst size must be positive");
+	    if (read.budget.burstRate < 0.0f) throw monitor::utils::exception ("burst rate must be positive");
+	    if (read.forecast.alpha <= 0.0f || read.forecast.alpha > 1.0f) throw monitor::utils::exception ("forecast alpha must be in ]0, 100]");
+	    if (read.forecast.beta < 0.0f || read.forecast.beta > 1.0f) throw monitor::utils::exception ("forecast beta must be in [0, 100]");
+	    if (read.forecast.margin < 0.0f) throw monitor::utils::exception ("forecast margin must be positive");
+	    if (read.threads == 0) throw monitor::utils::exception ("threads must be positive");
+
+	    return read;
+	}
+
+	VCPUMarket::VCPUMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting) :
+	    _libvirt (client),
+	    _budget (accounting)
 	{}
 	
-	VCPUMarket::VCPUMarket (monitor::libvirt::LibvirtClient & client, VCPUMarketConfig cfg) :
+	VCPUMarket::VCPUMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting, VCPUMarketConfig cfg) :
 	    _libvirt (client),
+	    _budget (accounting),
 	    _config (cfg)
-	{}
+	{
+	    this-> _budget.setConfig (cfg.budget);
+	    this-> _forecast.setConfig (cfg.forecast);
+	}
 
 	void VCPUMarket::setConfig (VCPUMarketConfig cfg) {
 	    this-> _config = cfg;
+	    this-> _budget.setConfig (cfg.budget);
+	    this-> _forecast.setConfig (cfg.forecast);
+	}
+
+	void VCPUMarket::setSupply (float share) {
+	    this-> _supply = std::max (0.0f, std::min (1.0f, share));
+	}
+
+	const VCPUMarketConfig & VCPUMarket::getConfig () const {
+	    return this-> _config;
+	}
+
+	float VCPUMarket::getSupply () const {
+	    return this-> _supply;
+	}
+
+	unsigned long VCPUMarket::getExcess () const {
+	    return this-> _excess;
 	}
 
 	void VCPUMarket::reset () {
-	    for (auto & vm : this-> _libvirt.getRunningVMs ()) {
-		vm-> money () = 0;
-	    }
+	    this-> _budget.reset ();
+	}
+
+	VCPUMarket::~VCPUMarket () {
+	    this-> stopWorkers ();
+	}
+
+	const CpuBudget & VCPUMarket::getBudget () const {
+	    return this-> _budget;
 	}
 
 	void VCPUMarket::run () {
 	    auto & vms = this-> _libvirt.getRunningVMs ();
+	    this-> _excess = 0;
 	    if (vms.size () == 0) return;
+	    this-> _budget.open (vms, this-> _config.cpuFreq);
+	    if (this-> _config.forecast.enabled) this-> _forecast.open (vms);
 	    
-	    long market = ((unsigned long) (get_nprocs () * 1000000));
-	    unsigned long nbVcpus = 0;
-	    auto buyers = this-> sellBaseCycles (vms, market, nbVcpus);
+	    int nbCpus = this-> _config.nbCpus > 0 ? this-> _config.nbCpus : this-> _libvirt.getNbCpus ();
+	    long market = ((long) nbCpus) * 1000000;
+	    long withheld = market - (long) (market * this-> _supply);
+	    this-> split (vms);
+	    this-> parallel (&VCPUMarket::sellShard);
+	    for (auto & sold : this-> _sold) market -= sold;
 	    
-	    // over allocation, can't do much
-	    if (market < 0) return;
+	    // over allocation, can't do much here (the excess is reported to the migration orchestrator)
+	    if (market < 0) {
+		this-> _excess = -market;
+		this-> _budget.close ();
+		return;
+	    }
+
+	    // The cycles withheld by the supply are taken from the cycles left after the guarantees
+	    market = std::max (0L, market - withheld);
 	    
-	    unsigned long allNeeded = 0;
-	    auto fails = this-> buyCycles (buyers, market, allNeeded);
+	    auto fails = this-> buyCycles (market);
+	    this-> sellRest (vms, fails, market);
+
+	    this-> parallel (&VCPUMarket::applyShard); // apply the vcpu allocations
+
+	    this-> _budget.close ();
+	}
+
+
+	std::list <LibvirtVCPUController*> VCPUMarket::buyCycles (long & market) {
+	    std::list <LibvirtVCPUController*> fails;
+	    while (market > 0) {
+		unsigned long windows = 0, buyers = 0;
+		for (auto & shard : this-> _buyers) {
+		    buyers += shard.size ();
+		    if (this-> _shards.size () == 1) continue;
+		    for (auto & v : shard) windows += std::min (this-> _config.windowSize, v-> buying ());
+		}
+
+		if (buyers == 0) break;
+		if (this-> _shards.size () > 1 && windows <= (unsigned long) market) { // no vcpu can be limited by the market, the shards are independent
+		    this-> _market = market;
+		    this-> parallel (&VCPUMarket::bidShard);
+		    for (unsigned int s = 0 ; s < this-> _shards.size () ; s++) {
+			market -= this-> _sold [s];
+			fails.splice (fails.end (), this-> _fails [s]);
+		    }
+		} else {
+		    for (auto & shard : this-> _buyers) {
+			this-> bidRound (shard, market, fails);
+		    }
+		}
+	    }
 	    
-	    if (market > 0) {
-		long notSold = market;
-		long rest = std::min (allNeeded, (unsigned long) market);
-		for (auto & vcpu : fails) { // we split the rest of the market between all the VMs that failed to buy
-		    float percent = (float) (vcpu-> buying ()) / (float) allNeeded; // Implication of the VMs in the market 
-		    unsigned long add = std::min (vcpu-> buying (), (unsigned long) (percent * rest));
-		    vcpu-> allocated () += add;
-		    vcpu-> buying () -= add;
-		    notSold -= add;	   
+	    return fails;
+	}
+
+	void VCPUMarket::bidRound (std::list <LibvirtVCPUController*> & buyers, long & market, std::list <LibvirtVCPUController*> & fails) {
+	    for (auto v = buyers.cbegin () ; v != buyers.cend () ; ) { // we cannot use : for (auto & v : buyers), because we need to erase elements in the map
+		auto money = this-> _budget.available ((*v)-> vm ());
+		if ((*v)-> buying () != 0) {
+		    unsigned long windowSize = std::min (this-> _config.windowSize, money);
+		    
+		    /// The vcpu can buy at most, what they can (money, as windowSize), what they need (v-> second), or what is left in the market
+		    auto bought = std::min (std::min (windowSize, (*v)-> buying ()), (unsigned long) market);
+		    if (bought != 0) { /// The vcpu bought some cycles
+			(*v)-> allocated () += bought;
+			this-> _budget.debit ((*v)-> vm (), bought);
+			(*v)-> buying () -= bought;
+			market -= bought;
+			v++;
+		    } else {
+			fails.push_back (*v);
+			buyers.erase (v++);
+		    }
+		} else {
+		    buyers.erase (v++);
+		}
+	    }
+	}
+
+	void VCPUMarket::sellRest (std::vector <LibvirtVM*> & vms, std::list <LibvirtVCPUController*> & fails, long & market) {
+	    if (market > 0 && !fails.empty ()) { // the vcpus that failed to buy get what they still need, by max-min fairness
+		std::vector <unsigned long> wanted;
+		for (auto & vcpu : fails) wanted.push_back (vcpu-> buying ());
+
+		auto given = waterfill (wanted, market);
+		auto g = given.begin ();
+		for (auto & vcpu : fails) {
+		    vcpu-> allocated () += *g;
+		    vcpu-> buying () -= *g;
+		    market -= *g;
+		    g++;
 		}
-		market = notSold;
 	    }
 
-	    if (market > 0) {
-		unsigned long percent = market / nbVcpus;		
+	    if (market > 0 && this-> _config.spareHeadroom) { // the cycles that are still not sold are headroom for the running vcpus, an idle vcpu would not use them
+		std::vector <LibvirtVCPUController*> running;
+		std::vector <unsigned long> headroom;
 		for (auto & v : vms) {
 		    for (auto & vcpu : v-> getVCPUControllers ()) {
-			auto old = vcpu.allocated ();
-			auto max = std::min ((unsigned long) 1000000, old + percent);
-			vcpu.allocated () = max;
+			if (vcpu.getAbsoluteConsumption () < 1000000 / 100 || vcpu.allocated () >= 1000000) continue;
+			running.push_back (&vcpu);
+			headroom.push_back (1000000 - vcpu.allocated ());
 		    }
 		}
+
+		auto given = waterfill (headroom, market);
+		for (std::size_t i = 0 ; i < running.size () ; i++) {
+		    running [i]-> allocated () += given [i];
+		    market -= given [i];
+		}
 	    }
+	}
+
+	void VCPUMarket::split (const std::vector <LibvirtVM*> & vms) {
+	    unsigned long nbVcpus = 0;
+	    for (auto & v : vms) nbVcpus += v-> vcpus ();
 
-	    for (auto & v : vms) { // apply the vcpu allocations
-	    	v-> applyMarketAllocation (100000);
-	    }	    
+	    auto nbShards = std::max (1UL, std::min ((unsigned long) this-> _config.threads, (unsigned long) vms.size ()));
+	    this-> _shards.assign (nbShards, {});
+	    this-> _buyers.assign (nbShards, {});
+	    this-> _fails.assign (nbShards, {});
+	    this-> _sold.assign (nbShards, 0);
+
+	    // The shards are contiguous, so the order of the vcpus is the order of the serial market
+	    unsigned long s = 0, filled = 0;
+	    for (auto & v : vms) {
+		if (s + 1 < nbShards && !this-> _shards [s].empty () && filled * nbShards >= nbVcpus * (s + 1)) s += 1;
+		this-> _shards [s].push_back (v);
+		filled += v-> vcpus ();
+	    }
 	}
 
+	void VCPUMarket::parallel (void (VCPUMarket::*phase) (monitor::concurrency::thread, unsigned int)) {
+	    if (this-> _shards.size () == 1) {
+		if (this-> _config.threads == 1) this-> stopWorkers (); // the threads were set back to 1 by a reload
+		(this->* phase) (pthread_self (), 0);
+		return;
+	    }
 
-	std::list <LibvirtVCPUController*> VCPUMarket::buyCycles (std::list <LibvirtVCPUController*> & buyers,
-								  long & market,
-								  unsigned long & allNeeded) {
-	    std::list <LibvirtVCPUController*> fails;
-	    while (market > 0 && buyers.size () > 0) {
-		for (auto v = buyers.cbegin () ; v != buyers.cend () ; ) { // we cannot use : for (auto & v : buyers), because we need to erase elements in the map
-		    auto money = (*v)-> vm ().money ();
-		    if ((*v)-> buying () != 0) {
-			unsigned long windowSize = std::min (this-> _config.windowSize, money);
-			
-			/// The vcpu can buy at most, what they can (money, as windowSize), what they need (v-> second), or what is left in the market
-			auto bought = std::min (std::min (windowSize, (*v)-> buying ()), (unsigned long) market);
-			if (bought != 0) { /// The vcpu bought some cycles
-			    (*v)-> allocated () += bought;
-			    (*v)-> vm ().money () -= bought;
-			    (*v)-> buying () -= bought;
-			    market -= bought;
-			    v++;
-			} else {
-			    allNeeded += (*v)-> buying ();
-			    fails.push_back (*v);
-			    buyers.erase (v++);
-			}
-		    } else {
-			buyers.erase (v++);
-		    }
-		}
+	    if (this-> _workers.size () + 1 != this-> _config.threads) {
+		this-> stopWorkers ();
+		this-> startWorkers (this-> _config.threads - 1);
 	    }
-	    
-	    return fails;
-	}	    	
 
-	std::list <LibvirtVCPUController*> VCPUMarket::sellBaseCycles (std::vector <LibvirtVM*> & vms, long & market, unsigned long & nbVcpus) {
-	    std::list <LibvirtVCPUController*> ret;
-	    for (auto & v : vms) {
+	    // The workers read the phase once released, and the shards are written before the end barrier
+	    this-> _phase = phase;
+	    this-> _begin-> wait ();
+	    (this->* phase) (pthread_self (), 0);
+	    this-> _end-> wait ();
+	}
+
+	void VCPUMarket::startWorkers (unsigned int nbWorkers) {
+	    this-> _begin = std::make_unique <monitor::concurrency::barrier> (nbWorkers + 1);
+	    this-> _end = std::make_unique <monitor::concurrency::barrier> (nbWorkers + 1);
+	    for (unsigned int s = 1 ; s <= nbWorkers ; s++) {
+		this-> _workers.push_back (monitor::concurrency::spawn (this, &VCPUMarket::work, s));
+	    }
+	}
+
+	void VCPUMarket::stopWorkers () {
+	    if (this-> _workers.empty ()) return;
+
+	    this-> _phase = nullptr;
+	    this-> _begin-> wait ();
+	    for (auto & th : this-> _workers) {
+		monitor::concurrency::join (th);
+	    }
+
+	    this-> _workers.clear ();
+	    this-> _begin.reset ();
+	    this-> _end.reset ();
+	}
+
+	void VCPUMarket::work (monitor::concurrency::thread self, unsigned int shard) {
+	    for (;;) {
+		this-> _begin-> wait ();
+		auto phase = this-> _phase;
+		if (phase == nullptr) return;
+
+		// There are less shards than threads when there are less VMs
+		if (shard < this-> _shards.size ()) (this->* phase) (self, shard);
+		this-> _end-> wait ();
+	    }
+	}
+
+	void VCPUMarket::sellShard (monitor::concurrency::thread, unsigned int shard) {
+	    long market = 0;
+	    auto & buyers = this-> _buyers [shard];
+	    for (auto & v : this-> _shards [shard]) {
 		for (auto & c : v-> getVCPUControllers ()) {
 		    if (this-> sellBaseCycles (c, market)) {
-			ret.push_back (&c);
+			buyers.push_back (&c);
 		    }
-		    nbVcpus += 1;
 		}
 	    }
 
-	    return ret;
+	    this-> _sold [shard] = -market;
+	}
+
+	void VCPUMarket::bidShard (monitor::concurrency::thread, unsigned int shard) {
+	    long market = this-> _market;
+	    this-> bidRound (this-> _buyers [shard], market, this-> _fails [shard]);
+	    this-> _sold [shard] = this-> _market - market;
+	}
+
+	void VCPUMarket::applyShard (monitor::concurrency::thread, unsigned int shard) {
+	    for (auto & v : this-> _shards [shard]) {
+		v-> applyMarketAllocation (100000);
+	    }
 	}
 
 	bool VCPUMarket::sellBaseCycles (LibvirtVCPUController & v, long & market) {
@@ -126,10 +334,39 @@ namespace server {
 	    unsigned long min = max / 100; 
 		
 	    unsigned long nominal = ((float) v.getNominalFreq ()) / ((float) this-> _config.cpuFreq) * max;
+
+	    // A vcpu running on throttled cpus needs more cpu time to execute the cycles of its nominal frequency
+	    auto delivered = v.getDeliveredFrequency () / 1000;
+	    if (this-> _config.realCycles && delivered != 0) {
+		nominal = std::min (max, (unsigned long) (((float) v.getNominalFreq ()) / ((float) delivered) * max));
+	    }
 	    unsigned long capp = v.getAbsoluteCapping ();
 
 	    float perc_usage = v.getRelativePercentConsumption () / 100.0f;
 	    double slope = v.getSlope ();	    
+
+	    /**
+	     * With the forecast, the vcpu wants its forecast demand, instead of following its slope
+	     */
+	    if (this-> _config.forecast.enabled) {
+		// The demand of a throttled vcpu is hidden by its capping, it is observed as increasing as with the trigger
+		double observed = usage;
+		if (perc_usage > this-> _config.triggerIncrement) observed = std::max (observed, capp * (1.0 + this-> _config.increasingSpeed));
+
+		auto forecast = this-> _forecast.next (v.vm ().id (), v.getId (), observed);
+		unsigned long wanted = std::min (max, (unsigned long) (forecast + max * 0.01));
+		unsigned long current = std::max (min, std::min (nominal, wanted));
+		v.allocated () = current;
+		market -= current;
+
+		if (wanted > nominal) {
+		    v.buying () = std::min (max - nominal, wanted - nominal);
+		    return true;
+		} else {
+		    this-> _budget.credit (v.vm (), nominal - wanted);
+		    return false;
+		}
+	    }
 	    
 	    /**
 	     * We have three cases : 
@@ -145,7 +382,7 @@ namespace server {
 		    v.buying () = std::min (max - nominal, increase - nominal);
 		    return true;
 		} else {
-		    v.vm ().money () += nominal - increase;
+		    this-> _budget.credit (v.vm (), nominal - increase);
 		    return false;
 		}		    
 	    }
@@ -163,7 +400,7 @@ namespace server {
 		    v.buying () = std::min (max - nominal, decrease - nominal);
 		    return true;
 		} else {
-		    v.vm ().money () += nominal - decrease;
+		    this-> _budget.credit (v.vm (), nominal - decrease);
 		    return false;
 		}
 	    }
@@ -181,7 +418,7 @@ namespace server {
 		    v.buying () = std::min (max - nominal, increase - nominal);
 		    return true;
 		} else {
-		    v.vm ().money () += nominal - increase;
+		    this-> _budget.credit (v.vm (), nominal - increase);
 		    return false;
 		}		    
 	    }
@@ -198,7 +435,7 @@ namespace server {
 		    v.buying () = std::min (max - nominal, capp - nominal);
 		    return true;
 		} else {
-		    v.vm ().money () += nominal - capp;
+		    this-> _budget.credit (v.vm (), nominal - capp);
 		    return false;
 		}
 	    }
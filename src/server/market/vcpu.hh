@@ -1,9 +1,15 @@
 #pragma once
 #include <monitor/libvirt/_.hh>
+#include <monitor/concurrency/thread.hh>
+#include <monitor/concurrency/barrier.hh>
+#include <server/market/accounting.hh>
+#include <server/market/budget.hh>
+#include <server/market/forecast.hh>
 #include <string>
 #include <nlohmann/json.hpp>
 #include <vector>
 #include <list>
+#include <memory>
 
 namespace server {
 
@@ -16,33 +22,137 @@ namespace server {
 	    float increasingSpeed;
 	    float decreasingSpeed;
 	    unsigned long windowSize;
+
+	    /// True iif the market allocates the cycles to the whole VMs instead of their vcpus (cf. CpuMarket)
+	    bool vmLevel = false;
+
+	    /// The limits on the money of the VMs (decay, cap and burst)
+	    BudgetConfig budget;
+
+	    /// The number of cpus sold by the market (0 for all the cpus of the host)
+	    int nbCpus = 0;
+
+	    /// True iif the cycles still left after the failed buyers are given as headroom to the entries that are not idle, without being paid
+	    bool spareHeadroom = false;
+
+	    /// True iif the nominal of the vcpus is computed with the frequency they were delivered (cycles / cpu time, from the hardware counters) instead of the frequency of the host
+	    bool realCycles = false;
+
+	    /// The forecast of the demand of the vcpus, replacing the slope and the triggers when enabled
+	    ForecastConfig forecast;
+
+	    /// The number of threads computing the market, the VMs are split in as many shards (1 for the serial market)
+	    unsigned int threads = 1;
+
+	    /**
+	     * Read a configuration from the content of a cpu-market.json file (the key enable is ignored)
+	     * @throws:
+	     *   - utils::exception: if a value is invalid
+	     *   - nlohmann::json::exception: if a key is missing, or has the wrong type
+	     */
+	    static VCPUMarketConfig parse (const nlohmann::json & j);
 	};
 
 	/**	   
 	 * Market for the vcpu resource allocations
+	 * With several threads, the VMs are split in contiguous shards (balanced by number of vcpus) :
+	 *    - the base cycles are sold by the shards in parallel, and their totals are subtracted from the market in the order of the shards
+	 *    - a bidding round runs in parallel when the market cannot run out during it (the sum of the windows of the buyers is lower than the market), serially otherwise
+	 *    - the quotas are applied by the shards in parallel
+	 * The shards are computed by a pool of threads living as long as the market, released on each phase (and each parallel round) by a barrier
+	 * The state of a VM (money, bucket, forecast) is only touched by its shard, in the order of its vcpus, so the allocations are the same as the serial market
 	 */
 	class VCPUMarket {
 
 	    /// The libvirt connection monitoring the vcpu consumptions
 	    monitor::libvirt::LibvirtClient & _libvirt;
 
+	    /// The budget of the VMs, through which the cpu wallets are credited and debited
+	    CpuBudget _budget;
+
 	    /// THe configuration of the market
 	    VCPUMarketConfig _config;
 
+	    /// The forecast of the demand of the entries of the market (if enabled in the configuration)
+	    DemandForecast _forecast;
+
+	    /// The share of the cpus sold at each tick (cf. setSupply)
+	    float _supply = 1.0f;
+
+	    /// The cpu time by which the guaranteed cycles exceeded the cpus at the last tick (0 if the market was cleared)
+	    unsigned long _excess = 0;
+
+	    /// The VMs of each shard of the market
+	    std::vector <std::vector <monitor::libvirt::LibvirtVM*> > _shards;
+
+	    /// The vcpus of each shard that are still buying
+	    std::vector <std::list <monitor::libvirt::control::LibvirtVCPUController*> > _buyers;
+
+	    /// The vcpus of each shard that failed to buy during the last round
+	    std::vector <std::list <monitor::libvirt::control::LibvirtVCPUController*> > _fails;
+
+	    /// The cycles sold by each shard during the last phase
+	    std::vector <long> _sold;
+
+	    /// The cycles left in the market at the start of a parallel bidding round
+	    long _market = 0;
+
+	    /// The threads computing the shards 1 .. threads - 1 (the shard 0 is computed by the thread running the market)
+	    std::vector <monitor::concurrency::thread> _workers;
+
+	    /// The barrier releasing the workers on a phase
+	    std::unique_ptr <monitor::concurrency::barrier> _begin;
+
+	    /// The barrier on which the thread running the market waits for the end of a phase
+	    std::unique_ptr <monitor::concurrency::barrier> _end;
+
+	    /// The phase run by the workers once released (nullptr to stop them)
+	    void (VCPUMarket::*_phase) (monitor::concurrency::thread, unsigned int) = nullptr;
+
 	public:
 
-	    VCPUMarket (monitor::libvirt::LibvirtClient & client);
+	    /**
+	     * @params: 
+	     *   - client: the libvirt client
+	     *   - accounting: the accounting of the money of the VMs
+	     */
+	    VCPUMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting);
 	    
 	    /**
 	     * @params: 
 	     *   - client: the libvirt client
+	     *   - accounting: the accounting of the money of the VMs
+	     *   - config: the configuration of the market
 	     */
-	    VCPUMarket (monitor::libvirt::LibvirtClient & client, VCPUMarketConfig config);
+	    VCPUMarket (monitor::libvirt::LibvirtClient & client, Accounting & accounting, VCPUMarketConfig config);
 
 	    /**
 	     * Change the config of the market
 	     */
 	    void setConfig (VCPUMarketConfig cfg);
+
+	    /**
+	     * @returns: the configuration of the market
+	     */
+	    const VCPUMarketConfig & getConfig () const;
+
+	    /**
+	     * Limit the cycles sold at each tick to a share of the cpus (e.g. to stay under a power cap)
+	     * @params:
+	     *   - share: the share of the cpus sold (1 for all the cpus)
+	     * @info: the guarantees of the VMs (their nominal frequency) are always sold, the supply only limits the cycles sold above them
+	     */
+	    void setSupply (float share);
+
+	    /**
+	     * @returns: the share of the cpus sold at each tick
+	     */
+	    float getSupply () const;
+
+	    /**
+	     * @returns: the cpu time by which the guaranteed cycles exceeded the cpus at the last tick, the market was not cleared if it is not 0
+	     */
+	    unsigned long getExcess () const;
 	    
 	    /**
 	     * Execute an iteration of the market
@@ -54,23 +164,88 @@ namespace server {
 	     * Reset the accounts
 	     */
 	    void reset ();
+
+	    /**
+	     * Stop the threads computing the shards
+	     */
+	    ~VCPUMarket ();
+
+	    /**
+	     * @returns: the budget of the VMs
+	     */
+	    const CpuBudget & getBudget () const;
 	    	    
 	private :
 	    
 	    /**
 	     * Bidding part of the market 
+	     * @returns: the vcpus that failed to buy all they wanted
 	     */
-	    std::list <monitor::libvirt::control::LibvirtVCPUController*> buyCycles (std::list <monitor::libvirt::control::LibvirtVCPUController*> & buyers,
-										     long & market,
-										     unsigned long & allNeeded);
+	    std::list <monitor::libvirt::control::LibvirtVCPUController*> buyCycles (long & market);
 
 	    /**
-	     * Selling the base cycles of the VMs (guarantee of nominal frequency)	     
+	     * A bidding round of the vcpus of a shard
+	     * @params:
+	     *   - buyers: the vcpus still buying (those that are done are removed)
+	     *   - market: the cycles left in the market
+	     *   - fails: the list to which the vcpus that failed to buy are appended
 	     */
-	    std::list <monitor::libvirt::control::LibvirtVCPUController*> sellBaseCycles (std::vector <monitor::libvirt::LibvirtVM*> & vms,
-											  long & market,
-		unsigned long & nbVcpus);
-	    
+	    void bidRound (std::list <monitor::libvirt::control::LibvirtVCPUController*> & buyers,
+			   long & market,
+			   std::list <monitor::libvirt::control::LibvirtVCPUController*> & fails);
+
+	    /**
+	     * Selling the cycles left after the bidding
+	     * The vcpus that failed to buy share them first, by max-min fairness on what they still need
+	     * The rest is shared by max-min fairness on the headroom of the vcpus that are not idle, if enabled (cf. VCPUMarketConfig::spareHeadroom)
+	     */
+	    void sellRest (std::vector <monitor::libvirt::LibvirtVM*> & vms,
+			   std::list <monitor::libvirt::control::LibvirtVCPUController*> & fails,
+			   long & market);
+
+	    /**
+	     * Split the running VMs in shards balanced by number of vcpus (at most one per thread)
+	     */
+	    void split (const std::vector <monitor::libvirt::LibvirtVM*> & vms);
+
+	    /**
+	     * Run a phase of the market on all the shards, the first shard in the calling thread
+	     * @info: the pool of workers is (re)started if the number of threads of the configuration changed
+	     */
+	    void parallel (void (VCPUMarket::*phase) (monitor::concurrency::thread, unsigned int));
+
+	    /**
+	     * Start the pool of workers
+	     * @params:
+	     *   - nbWorkers: the number of workers (the number of threads minus the one running the market)
+	     */
+	    void startWorkers (unsigned int nbWorkers);
+
+	    /**
+	     * Stop the pool of workers, and wait for their end
+	     */
+	    void stopWorkers ();
+
+	    /**
+	     * The main loop of a worker, running the phases on its shard until it is stopped
+	     */
+	    void work (monitor::concurrency::thread, unsigned int shard);
+
+	    /**
+	     * Selling the base cycles of the VMs of a shard (guarantee of nominal frequency)
+	     */
+	    void sellShard (monitor::concurrency::thread, unsigned int shard);
+
+	    /**
+	     * A bidding round of a shard, the market cannot run out during it
+	     */
+	    void bidShard (monitor::concurrency::thread, unsigned int shard);
+
+	    /**
+	     * Apply the allocations of the vcpus of a shard
+	     */
+	    void applyShard (monitor::concurrency::thread, unsigned int shard);
+
 	    /**
 	     * Selling the base cycles for the vcpu (guarantee of the nominal frequency)
 	     */
@@ -0,0 +1,29 @@
+#include "waterfill.hh"
+#include <algorithm>
+#include <numeric>
+
+namespace server {
+
+    namespace market {
+
+	std::vector <unsigned long> waterfill (const std::vector <unsigned long> & wanted, unsigned long capacity) {
+	    std::vector <std::size_t> order (wanted.size ());
+	    std::iota (order.begin (), order.end (), 0);
+	    std::sort (order.begin (), order.end (), [&wanted] (std::size_t a, std::size_t b) { return wanted [a] < wanted [b]; });
+
+	    // The smallest demands are fully served, the others share what remains equally
+	    std::vector <unsigned long> given (wanted.size (), 0);
+	    unsigned long rest = capacity;
+	    for (std::size_t k = 0 ; k < order.size () ; k++) {
+		auto share = rest / (order.size () - k);
+		auto g = std::min (wanted [order [k]], share);
+		given [order [k]] = g;
+		rest -= g;
+	    }
+
+	    return given;
+	}
+
+    }
+
+}
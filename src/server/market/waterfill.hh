@@ -0,0 +1,22 @@
+#pragma once
+#include <vector>
+
+namespace server {
+
+    namespace market {
+
+	/**
+	 * Share a quantity of resource between consumers by max-min fairness (water-filling)
+	 * The consumers are sorted by demand, the smallest demands are fully served, and the consumers left share the rest equally
+	 * No consumer can get more without taking from a consumer that got less than it
+	 * @params:
+	 *   - wanted: the quantity wanted by each consumer
+	 *   - capacity: the quantity to share
+	 * @returns: the quantity given to each consumer, never more than it wanted, and never more than the capacity in total
+	 * @info: the shares are rounded down, at most wanted.size () - 1 units of the capacity are left when the demand exceeds it
+	 */
+	std::vector <unsigned long> waterfill (const std::vector <unsigned long> & wanted, unsigned long capacity);
+
+    }
+
+}
@@ -0,0 +1,618 @@
+#include "numa.hh"
+#include <algorithm>
+#include <numeric>
+#include <monitor/utils/log.hh>
+#include <monitor/utils/exception.hh>
+
+using namespace monitor::libvirt;
+using namespace monitor::libvirt::control;
+using namespace monitor::utils;
+using json = nlohmann::json;
+
+namespace server {
+
+    namespace placement {
+
+	NumaPlacementConfig NumaPlacementConfig::parse (const json & j) {
+	    NumaPlacementConfig read;
+	    read.overcommit = j.contains ("overcommit") ? j.at ("overcommit").get<float> () : 1.0f;
+	    read.maxMoves = j.contains ("max-moves") ? j.at ("max-moves").get<unsigned int> () : 2;
+	    read.imbalance = j.contains ("imbalance") ? j.at ("imbalance").get<float> () / 100.0f : 0.25f;
+	    read.bindMemory = j.contains ("bind-memory") ? j.at ("bind-memory").get<bool> () : true;
+	    read.frequencyTiers = j.contains ("frequency-tiers") ? j.at ("frequency-tiers").get<bool> () : false;
+	    read.frequencyStep = j.contains ("frequency-step") ? j.at ("frequency-step").get<unsigned int> () : 100;
+
+	    if (read.overcommit <= 0.0f) throw monitor::utils::exception ("overcommit must be positive");
+	    if (read.imbalance < 0.0f) throw monitor::utils::exception ("imbalance must be positive");
+	    if (read.frequencyStep == 0) throw monitor::utils::exception ("frequency-step must be positive");
+
+	    return read;
+	}
+
+	NumaPlacement::NumaPlacement (LibvirtClient & client) :
+	    _libvirt (client),
+	    _events (json::array ())
+	{}
+
+	void NumaPlacement::setConfig (NumaPlacementConfig cfg) {
+	    this-> _config = cfg;
+	}
+
+	const NumaPlacementConfig & NumaPlacement::getConfig () const {
+	    return this-> _config;
+	}
+
+	void NumaPlacement::discover () {
+	    this-> release ();
+	    this-> _caches.clear ();
+	    this-> _groups.clear ();
+
+	    HostBackend::topology t;
+	    auto backend = this-> _libvirt.getBackend ();
+	    if (backend != nullptr) {
+		t = backend-> readTopology ();
+	    } else {
+		t.cpus.resize (this-> _libvirt.getNbCpus ());
+		t.memory.push_back (0);
+	    }
+
+	    // The caches are ordered by their first cpu
+	    std::map <unsigned int, unsigned int> index;
+	    for (unsigned int cpu = 0 ; cpu < t.cpus.size () ; cpu++) {
+		auto & p = t.cpus [cpu];
+		auto it = index.find (p.llc);
+		if (it == index.end ()) {
+		    it = index.emplace (p.llc, this-> _caches.size ()).first;
+		    this-> _caches.push_back (cache {p.node, {}, 0});
+		}
+
+		this-> _caches [it-> second].cpus.push_back (cpu);
+		if (p.node >= t.memory.size ()) t.memory.resize (p.node + 1, 0);
+	    }
+
+	    this-> _nodeMemory = t.memory;
+	    this-> _nodeUsed.assign (t.memory.size (), 0.0);
+
+	    // The caches whose cpus share a frequency domain are in the same group
+	    std::vector <unsigned int> parent (this-> _caches.size ());
+	    std::iota (parent.begin (), parent.end (), 0);
+	    auto root = [&parent] (unsigned int i) {
+		while (parent [i] != i) i = parent [i] = parent [parent [i]];
+		return i;
+	    };
+
+	    std::map <unsigned int, unsigned int> domains;
+	    for (unsigned int i = 0 ; i < this-> _caches.size () ; i++) {
+		for (auto & cpu : this-> _caches [i].cpus) {
+		    auto it = domains.emplace (t.cpus [cpu].domain, i).first;
+		    parent [root (i)] = root (it-> second);
+		}
+	    }
+
+	    std::map <unsigned int, unsigned int> groups;
+	    for (unsigned int i = 0 ; i < this-> _caches.size () ; i++) {
+		auto it = groups.find (root (i));
+		if (it == groups.end ()) {
+		    it = groups.emplace (root (i), this-> _groups.size ()).first;
+		    this-> _groups.push_back (freq_group {});
+		}
+
+		auto & c = this-> _caches [i];
+		auto & g = this-> _groups [it-> second];
+		c.group = it-> second;
+		g.cpus.insert (g.cpus.end (), c.cpus.begin (), c.cpus.end ());
+		for (auto & cpu : c.cpus) {
+		    g.minFreq = std::max (g.minFreq, t.cpus [cpu].minFreq);
+		    g.maxFreq = std::max (g.maxFreq, t.cpus [cpu].maxFreq);
+		}
+	    }
+
+	    for (auto & g : this-> _groups) std::sort (g.cpus.begin (), g.cpus.end ());
+
+	    logging::info ("Placement on", this-> _caches.size (), "caches of", this-> _nodeMemory.size (), "numa nodes");
+	    if (this-> _config.frequencyTiers) {
+		logging::info ("Frequency tiers on", this-> _groups.size (), "groups of cpus");
+	    }
+	}
+
+	void NumaPlacement::run () {
+	    this-> _events = json::array ();
+
+	    std::map <std::string, LibvirtVM*> running;
+	    for (auto & v : this-> _libvirt.getRunningVMs ()) {
+		running.emplace (v-> id (), v);
+	    }
+
+	    bool changed = false;
+	    for (auto it = this-> _placed.begin () ; it != this-> _placed.end () ; ) {
+		if (running.find (it-> first) == running.end ()) {
+		    this-> account (it-> second, -1.0f);
+		    this-> _events.push_back ({{"vm", it-> first}, {"event", "left"}});
+		    it = this-> _placed.erase (it);
+		    changed = true;
+		} else it++;
+	    }
+
+	    // The biggest VMs are placed first, when the caches are the least fragmented
+	    std::vector <LibvirtVM*> arrivals;
+	    for (auto & it : running) {
+		if (this-> _placed.find (it.first) == this-> _placed.end ()) arrivals.push_back (it.second);
+	    }
+
+	    std::stable_sort (arrivals.begin (), arrivals.end (), [] (LibvirtVM * a, LibvirtVM * b) {
+		return a-> vcpus () > b-> vcpus ();
+	    });
+
+	    for (auto & v : arrivals) {
+		auto d = this-> choose (v-> vcpus (), v-> memory (), this-> tierOf (*v));
+		this-> account (d, 1.0f);
+		this-> _placed.emplace (v-> id (), d);
+		if (!this-> apply (*v, d)) {
+		    logging::warn ("VM", v-> id (), "could not be pinned");
+		}
+
+		auto e = this-> describe (d);
+		e ["vm"] = v-> id ();
+		e ["event"] = "placed";
+		this-> _events.push_back (e);
+		logging::info ("VM", v-> id (), "placed on cpus", e ["cpus"].get<std::string> (), "(" + e ["level"].get<std::string> () + ")");
+		changed = true;
+	    }
+
+	    if (changed) {
+		this-> rebalance ();
+		if (this-> _config.frequencyTiers) this-> applyFrequencies ();
+	    }
+	}
+
+	void NumaPlacement::release () {
+	    for (auto & it : this-> _placed) {
+		auto vm = this-> _libvirt.getVM (it.first);
+		if (vm == nullptr) continue;
+
+		for (auto & vt : vm-> getVCPUControllers ()) {
+		    vt.setAffinity ({});
+		}
+
+		if (this-> _config.bindMemory) vm-> getCPUController ().setMemoryNodes ({});
+	    }
+
+	    // The cpus run at their maximal frequency again
+	    auto backend = this-> _libvirt.getBackend ();
+	    for (auto & g : this-> _groups) {
+		if (g.limit != 0 && g.maxFreq != 0 && backend != nullptr) {
+		    for (auto & cpu : g.cpus) backend-> setMaxFrequency (cpu, g.maxFreq);
+		}
+
+		g.limit = 0;
+		g.tiers.clear ();
+	    }
+
+	    for (auto & c : this-> _caches) c.load = 0;
+	    std::fill (this-> _nodeUsed.begin (), this-> _nodeUsed.end (), 0.0);
+	    this-> _placed.clear ();
+	}
+
+	std::size_t NumaPlacement::nbCaches () const {
+	    return this-> _caches.size ();
+	}
+
+	unsigned long NumaPlacement::nbMoves () const {
+	    return this-> _moves;
+	}
+
+	std::vector <unsigned int> NumaPlacement::getFrequencyLimits () const {
+	    std::vector <unsigned int> limits;
+	    for (auto & g : this-> _groups) {
+		for (auto & cpu : g.cpus) {
+		    if (cpu >= limits.size ()) limits.resize (cpu + 1, 0);
+		    limits [cpu] = g.limit;
+		}
+	    }
+
+	    return limits;
+	}
+
+	/**
+	 * ================================================================================
+	 * ================================================================================
+	 * =========================           CHOOSING           =========================
+	 * ================================================================================
+	 * ================================================================================
+	 */
+
+	NumaPlacement::decision NumaPlacement::choose (unsigned int vcpus, unsigned long memory, unsigned int tier) const {
+	    decision best;
+	    best.vcpus = vcpus;
+	    best.memory = memory;
+	    best.tier = tier;
+
+	    // The least loaded cache that can run all the vcpus (spreading the VMs reduces the contention on the caches), among the caches running the tier of the VM
+	    float bestFree = -1.0f;
+	    int bestAffinity = 4;
+	    for (unsigned int i = 0 ; i < this-> _caches.size () ; i++) {
+		auto & c = this-> _caches [i];
+		float free = this-> capacity (c) - c.load - vcpus;
+		if (c.cpus.size () < vcpus || free < 0.0f) continue;
+
+		auto a = this-> affinity (c, tier);
+		if (a > bestAffinity || (a == bestAffinity && free <= bestFree)) continue;
+		if (!this-> fitsMemory ({c.node}, memory)) continue;
+
+		bestFree = free;
+		bestAffinity = a;
+		best.lvl = level::LLC;
+		best.caches = {i};
+		best.nodes = {c.node};
+	    }
+
+	    if (best.lvl == level::LLC) return best;
+
+	    struct node_load {
+		unsigned int node;
+		std::size_t cpus = 0;
+		float free = 0;
+		std::vector <unsigned int> caches;
+	    };
+
+	    std::vector <node_load> nodes;
+	    for (unsigned int n = 0 ; n < this-> _nodeMemory.size () ; n++) nodes.push_back (node_load {n});
+	    for (unsigned int i = 0 ; i < this-> _caches.size () ; i++) {
+		auto & c = this-> _caches [i];
+		auto & n = nodes [c.node];
+		n.cpus += c.cpus.size ();
+		n.free += this-> capacity (c) - c.load;
+		n.caches.push_back (i);
+	    }
+
+	    // The least loaded node that can run all the vcpus
+	    for (auto & n : nodes) {
+		float free = n.free - vcpus;
+		if (n.cpus < vcpus || free < 0.0f || free <= bestFree) continue;
+		if (!this-> fitsMemory ({n.node}, memory)) continue;
+
+		bestFree = free;
+		best.lvl = level::NODE;
+		best.caches = n.caches;
+		best.nodes = {n.node};
+	    }
+
+	    if (best.lvl == level::NODE) return best;
+
+	    // The fewest nodes that can run the VM, all the nodes if the host is overloaded
+	    std::stable_sort (nodes.begin (), nodes.end (), [] (const node_load & a, const node_load & b) {
+		return a.free > b.free;
+	    });
+
+	    best.caches.clear ();
+	    best.nodes.clear ();
+	    std::size_t cpus = 0;
+	    float free = 0.0f;
+	    for (auto & n : nodes) {
+		if (n.cpus == 0) continue;
+
+		best.nodes.push_back (n.node);
+		best.caches.insert (best.caches.end (), n.caches.begin (), n.caches.end ());
+		cpus += n.cpus;
+		free += n.free;
+		if (cpus >= vcpus && free >= vcpus && this-> fitsMemory (best.nodes, memory)) break;
+	    }
+
+	    std::sort (best.caches.begin (), best.caches.end ());
+	    std::sort (best.nodes.begin (), best.nodes.end ());
+	    return best;
+	}
+
+	void NumaPlacement::account (const decision & d, float sign) {
+	    std::size_t total = 0;
+	    for (auto & i : d.caches) total += this-> _caches [i].cpus.size ();
+	    if (total == 0) return;
+
+	    // The vcpus are spread on the caches in proportion of their cpus
+	    for (auto & i : d.caches) {
+		auto & c = this-> _caches [i];
+		c.load += sign * ((float) d.vcpus) * ((float) c.cpus.size ()) / ((float) total);
+	    }
+
+	    for (auto & n : d.nodes) {
+		this-> _nodeUsed [n] += sign * ((double) d.memory) / ((double) d.nodes.size ());
+	    }
+
+	    if (d.tier == 0) return;
+
+	    // The VM is counted once in each group, even if it is placed on several of its caches
+	    std::vector <unsigned int> groups;
+	    for (auto & i : d.caches) groups.push_back (this-> _caches [i].group);
+	    std::sort (groups.begin (), groups.end ());
+	    groups.erase (std::unique (groups.begin (), groups.end ()), groups.end ());
+
+	    for (auto & g : groups) {
+		auto & tiers = this-> _groups [g].tiers;
+		if (sign > 0.0f) {
+		    tiers [d.tier] += 1;
+		} else {
+		    auto it = tiers.find (d.tier);
+		    if (it != tiers.end () && --it-> second == 0) tiers.erase (it);
+		}
+	    }
+	}
+
+	int NumaPlacement::affinity (const cache & c, unsigned int tier) const {
+	    if (tier == 0) return 0;
+
+	    auto & tiers = this-> _groups [c.group].tiers;
+	    if (tiers.empty ()) return 1;
+
+	    auto top = tiers.rbegin ()-> first;
+	    if (top == tier) return 0;
+	    return top > tier ? 2 : 3;
+	}
+
+	unsigned int NumaPlacement::tierOf (LibvirtVM & vm) const {
+	    if (!this-> _config.frequencyTiers) return 0;
+
+	    unsigned long frequency = 0;
+	    for (auto & vt : vm.getVCPUControllers ()) {
+		frequency = std::max (frequency, vt.getNominalFreq ());
+	    }
+
+	    unsigned long step = this-> _config.frequencyStep;
+	    return (unsigned int) ((frequency + step - 1) / step * step * 1000);
+	}
+
+	bool NumaPlacement::apply (LibvirtVM & vm, const decision & d) {
+	    auto list = this-> cpus (d);
+	    std::size_t total = 0;
+	    for (auto & c : this-> _caches) total += c.cpus.size ();
+
+	    // A VM placed on the whole host is not pinned
+	    if (list.size () == total) list.clear ();
+
+	    bool pinned = true;
+	    for (auto & vt : vm.getVCPUControllers ()) {
+		pinned = vt.setAffinity (list) && pinned;
+	    }
+
+	    if (this-> _config.bindMemory) {
+		auto nodes = d.nodes.size () == this-> _nodeMemory.size () ? std::vector <unsigned int> () : d.nodes;
+		if (!vm.getCPUController ().setMemoryNodes (nodes)) {
+		    logging::warn ("Memory of VM", vm.id (), "could not be bound to its nodes");
+		}
+	    }
+
+	    return pinned;
+	}
+
+	/**
+	 * ================================================================================
+	 * ================================================================================
+	 * =========================          REBALANCE           =========================
+	 * ================================================================================
+	 * ================================================================================
+	 */
+
+	unsigned int NumaPlacement::rebalance () {
+	    unsigned int moves = 0;
+
+	    // The VMs spread over several caches are moved to a single cache (or node) as soon as one has room, the least local first
+	    std::vector <std::string> spread;
+	    for (auto & it : this-> _placed) {
+		if (it.second.lvl != level::LLC) spread.push_back (it.first);
+	    }
+
+	    std::stable_sort (spread.begin (), spread.end (), [this] (const std::string & a, const std::string & b) {
+		auto & da = this-> _placed.at (a);
+		auto & db = this-> _placed.at (b);
+		if (da.lvl != db.lvl) return (int) da.lvl > (int) db.lvl;
+		return da.vcpus > db.vcpus;
+	    });
+
+	    for (auto & name : spread) {
+		if (moves >= this-> _config.maxMoves) return moves;
+
+		auto current = this-> _placed.at (name);
+		this-> account (current, -1.0f);
+		auto d = this-> choose (current.vcpus, current.memory, current.tier);
+		this-> account (current, 1.0f);
+
+		if ((int) d.lvl < (int) current.lvl) {
+		    this-> move (name, d, "locality");
+		    moves += 1;
+		}
+	    }
+
+	    // The VMs running on cpus faster than their tier are moved to a group of their tier (or an empty one), the slowest first
+	    if (this-> _config.frequencyTiers) {
+		std::vector <std::string> faster;
+		for (auto & it : this-> _placed) {
+		    auto & d = it.second;
+		    if (d.lvl == level::LLC && this-> affinity (this-> _caches [d.caches [0]], d.tier) == 2) faster.push_back (it.first);
+		}
+
+		std::stable_sort (faster.begin (), faster.end (), [this] (const std::string & a, const std::string & b) {
+		    return this-> _placed.at (a).tier < this-> _placed.at (b).tier;
+		});
+
+		for (auto & name : faster) {
+		    if (moves >= this-> _config.maxMoves) return moves;
+
+		    auto current = this-> _placed.at (name);
+		    this-> account (current, -1.0f);
+		    auto d = this-> choose (current.vcpus, current.memory, current.tier);
+		    this-> account (current, 1.0f);
+
+		    if (d.lvl != level::LLC || this-> _caches [d.caches [0]].group == this-> _caches [current.caches [0]].group) continue;
+		    if (this-> affinity (this-> _caches [d.caches [0]], d.tier) < 2) {
+			this-> move (name, d, "frequency");
+			moves += 1;
+		    }
+		}
+	    }
+
+	    // Then the VMs of the most loaded cache are moved to the least loaded cache of their tier, while it reduces the maximal load
+	    while (moves < this-> _config.maxMoves && this-> _caches.size () > 1) {
+		unsigned int hi = 0;
+		for (unsigned int i = 1 ; i < this-> _caches.size () ; i++) {
+		    if (this-> _caches [i].load / this-> capacity (this-> _caches [i]) > this-> _caches [hi].load / this-> capacity (this-> _caches [hi])) hi = i;
+		}
+
+		auto & from = this-> _caches [hi];
+		float fHi = from.load / this-> capacity (from);
+
+		std::string best;
+		unsigned int bestTo = hi;
+		float bestMax = fHi;
+		for (auto & it : this-> _placed) {
+		    auto & d = it.second;
+		    if (d.lvl != level::LLC || d.caches [0] != hi) continue;
+
+		    for (unsigned int i = 0 ; i < this-> _caches.size () ; i++) {
+			auto & to = this-> _caches [i];
+			if (i == hi || d.vcpus > to.cpus.size ()) continue;
+			if (to.group != from.group && this-> affinity (to, d.tier) > 1) continue;
+
+			float fTo = to.load / this-> capacity (to);
+			if (fHi - fTo <= this-> _config.imbalance) continue;
+			if (to.node != from.node && !this-> fitsMemory ({to.node}, d.memory)) continue;
+
+			float after = std::max ((from.load - d.vcpus) / this-> capacity (from), (to.load + d.vcpus) / this-> capacity (to));
+			if (after < bestMax - 1e-6f) {
+			    best = it.first;
+			    bestTo = i;
+			    bestMax = after;
+			}
+		    }
+		}
+
+		if (best.empty ()) break;
+
+		auto d = this-> _placed.at (best);
+		d.caches = {bestTo};
+		d.nodes = {this-> _caches [bestTo].node};
+		this-> move (best, d, "balance");
+		moves += 1;
+	    }
+
+	    return moves;
+	}
+
+	void NumaPlacement::move (const std::string & name, const decision & to, const std::string & reason) {
+	    auto & current = this-> _placed.at (name);
+	    this-> account (current, -1.0f);
+	    this-> account (to, 1.0f);
+	    current = to;
+	    this-> _moves += 1;
+
+	    auto vm = this-> _libvirt.getVM (name);
+	    if (vm != nullptr && !this-> apply (*vm, to)) {
+		logging::warn ("VM", name, "could not be pinned");
+	    }
+
+	    auto e = this-> describe (to);
+	    e ["vm"] = name;
+	    e ["event"] = "moved";
+	    e ["reason"] = reason;
+	    this-> _events.push_back (e);
+	    logging::info ("VM", name, "moved to cpus", e ["cpus"].get<std::string> (), "(" + reason + ")");
+	}
+
+	/**
+	 * ================================================================================
+	 * ================================================================================
+	 * =========================            UTILS             =========================
+	 * ================================================================================
+	 * ================================================================================
+	 */
+
+	void NumaPlacement::applyFrequencies () {
+	    auto backend = this-> _libvirt.getBackend ();
+	    if (backend == nullptr) return;
+
+	    for (auto & g : this-> _groups) {
+		auto frequency = this-> frequencyOf (g);
+		if (frequency == 0 || frequency == g.limit) continue;
+
+		bool written = true;
+		for (auto & cpu : g.cpus) {
+		    written = backend-> setMaxFrequency (cpu, frequency) && written;
+		}
+
+		if (!written) {
+		    logging::warn ("Frequency of cpus", HostBackend::formatList (g.cpus), "could not be limited");
+		    continue;
+		}
+
+		g.limit = frequency;
+		this-> _events.push_back ({{"event", "frequency"}, {"cpus", HostBackend::formatList (g.cpus)}, {"frequency", frequency}});
+	    }
+	}
+
+	unsigned int NumaPlacement::frequencyOf (const freq_group & g) const {
+	    if (g.tiers.empty ()) return g.maxFreq;
+
+	    auto frequency = g.tiers.rbegin ()-> first;
+	    if (g.maxFreq != 0) frequency = std::min (frequency, g.maxFreq);
+	    return std::max (frequency, g.minFreq);
+	}
+
+	float NumaPlacement::capacity (const cache & c) const {
+	    return ((float) c.cpus.size ()) * this-> _config.overcommit;
+	}
+
+	bool NumaPlacement::fitsMemory (const std::vector <unsigned int> & nodes, unsigned long memory) const {
+	    double free = 0.0;
+	    for (auto & n : nodes) {
+		// The memory of the node is unknown, it is assumed to be large enough
+		if (this-> _nodeMemory [n] == 0) return true;
+		free += ((double) this-> _nodeMemory [n]) - this-> _nodeUsed [n];
+	    }
+
+	    return free >= (double) memory;
+	}
+
+	std::vector <unsigned int> NumaPlacement::cpus (const decision & d) const {
+	    std::vector <unsigned int> list;
+	    for (auto & i : d.caches) {
+		auto & c = this-> _caches [i].cpus;
+		list.insert (list.end (), c.begin (), c.end ());
+	    }
+
+	    std::sort (list.begin (), list.end ());
+	    return list;
+	}
+
+	json NumaPlacement::describe (const decision & d) const {
+	    static const char * levels [] = {"llc", "node", "host"};
+
+	    json j;
+	    j ["level"] = levels [(int) d.lvl];
+	    j ["cpus"] = HostBackend::formatList (this-> cpus (d));
+	    j ["nodes"] = d.nodes;
+	    if (d.tier != 0) j ["tier"] = d.tier;
+	    return j;
+	}
+
+	json NumaPlacement::dumpLogs () const {
+	    json vms = json::object (), caches = json::array ();
+	    for (auto & it : this-> _placed) {
+		vms [it.first] = this-> describe (it.second);
+	    }
+
+	    for (auto & c : this-> _caches) {
+		json jc = {{"node", c.node}, {"cpus", HostBackend::formatList (c.cpus)}, {"load", c.load}};
+		if (this-> _config.frequencyTiers) jc ["frequency"] = this-> _groups [c.group].limit;
+		caches.push_back (jc);
+	    }
+
+	    json j;
+	    j ["vms"] = vms;
+	    j ["caches"] = caches;
+	    j ["moves"] = this-> _moves;
+	    j ["events"] = this-> _events;
+
+	    return j;
+	}
+
+    }
+
+}
@@ -0,0 +1,282 @@
+#pragma once
+#include <monitor/libvirt/_.hh>
+#include <nlohmann/json.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace server {
+
+    namespace placement {
+
+	struct NumaPlacementConfig {
+	    /// The number of vcpus placed on each cpu of a cache (1 for no overcommit)
+	    float overcommit = 1.0f;
+
+	    /// The maximal number of VMs moved at each rebalance
+	    unsigned int maxMoves = 2;
+
+	    /// The difference of load (in vcpus per cpu) between two caches above which VMs are moved from one to the other
+	    float imbalance = 0.25f;
+
+	    /// True iif the memory of the VMs is bound to the nodes of their cpus
+	    bool bindMemory = true;
+
+	    /// True iif the VMs are grouped by nominal frequency, and the maximal frequency of each group of cpus is limited to the highest nominal frequency of its VMs
+	    bool frequencyTiers = false;
+
+	    /// The nominal frequencies of the VMs are rounded up to a multiple of this step to form the tiers (in MHz)
+	    unsigned int frequencyStep = 100;
+
+	    /**
+	     * Read a configuration from the content of a placement.json file (the key enable is ignored)
+	     * @throws:
+	     *   - utils::exception: if a value is invalid
+	     *   - nlohmann::json::exception: if a key has the wrong type
+	     */
+	    static NumaPlacementConfig parse (const nlohmann::json & j);
+	};
+
+	/**
+	 * The placement of the vcpus, and of the memory of the VMs on the numa nodes and the last level caches of the host
+	 * A VM is placed on the least loaded cache that can hold all its vcpus, then on the least loaded node, and is spread over the fewest nodes otherwise
+	 * All the vcpus of a VM are pinned on the cpus of its caches (the host scheduler still balances them inside), and its memory is bound to their nodes
+	 * The VMs are placed when they arrive, and the placement is rebalanced when VMs arrive or leave, moving at most maxMoves VMs
+	 * With the frequency tiers, the VMs of similar nominal frequency are placed on the same caches, and the cpus are limited (scaling_max_freq) to the highest frequency of their VMs
+	 * so the low tier VMs run on slow cpus, and the high tier VMs at full speed
+	 * @info: the load of a cache is the number of vcpus placed on it, the consumption of the vcpus is left to the cpu market
+	 */
+	class NumaPlacement {
+
+	    /**
+	     * The precision of a placement, from the most local to the least local
+	     */
+	    enum class level : int {
+		LLC = 0,
+		NODE = 1,
+		HOST = 2
+	    };
+
+	    /**
+	     * A group of cpus sharing a last level cache
+	     */
+	    struct cache {
+		/// The numa node of the cpus
+		unsigned int node;
+
+		/// The ids of the cpus
+		std::vector <unsigned int> cpus;
+
+		/// The number of vcpus placed on the cache
+		float load = 0;
+
+		/// The group of cpus sharing their frequency with the cache (index in _groups)
+		unsigned int group = 0;
+	    };
+
+	    /**
+	     * A group of caches whose cpus share their frequency domains, they all run at the same maximal frequency
+	     */
+	    struct freq_group {
+		/// The ids of the cpus
+		std::vector <unsigned int> cpus;
+
+		/// The minimal frequency of the cpus in KHz (0 if unknown)
+		unsigned int minFreq = 0;
+
+		/// The maximal frequency of the cpus in KHz (0 if unknown)
+		unsigned int maxFreq = 0;
+
+		/// The number of VMs of each tier placed on the group
+		std::map <unsigned int, unsigned int> tiers;
+
+		/// The maximal frequency written on the cpus in KHz (0 if never written)
+		unsigned int limit = 0;
+	    };
+
+	    /**
+	     * The place of a VM
+	     */
+	    struct decision {
+		/// The precision of the placement
+		level lvl = level::HOST;
+
+		/// The caches of the VM (indexes in _caches)
+		std::vector <unsigned int> caches;
+
+		/// The numa nodes of the caches
+		std::vector <unsigned int> nodes;
+
+		/// The number of vcpus of the VM
+		unsigned int vcpus = 0;
+
+		/// The memory of the VM in MB
+		unsigned long memory = 0;
+
+		/// The tier of the VM (its nominal frequency rounded up in KHz, 0 without tiers)
+		unsigned int tier = 0;
+	    };
+
+	    /// The libvirt client managing the running VMs
+	    monitor::libvirt::LibvirtClient & _libvirt;
+
+	    /// The configuration of the placement
+	    NumaPlacementConfig _config;
+
+	    /// The last level caches of the host
+	    std::vector <cache> _caches;
+
+	    /// The groups of cpus sharing their frequency
+	    std::vector <freq_group> _groups;
+
+	    /// The memory of each numa node in MB (0 if unknown)
+	    std::vector <unsigned long> _nodeMemory;
+
+	    /// The memory of the VMs placed on each numa node in MB
+	    std::vector <double> _nodeUsed;
+
+	    /// The places of the VMs
+	    std::map <std::string, decision> _placed;
+
+	    /// The placements decided at the last run
+	    nlohmann::json _events;
+
+	    /// The number of VMs moved since the placement started
+	    unsigned long _moves = 0;
+
+	public:
+
+	    /**
+	     * @params:
+	     *   - client: the libvirt client
+	     */
+	    NumaPlacement (monitor::libvirt::LibvirtClient & client);
+
+	    /**
+	     * Change the configuration of the placement
+	     * @info: the VMs already placed are not moved
+	     */
+	    void setConfig (NumaPlacementConfig cfg);
+
+	    /**
+	     * @returns: the configuration of the placement
+	     */
+	    const NumaPlacementConfig & getConfig () const;
+
+	    /**
+	     * Read the topology of the host from the backend of the client
+	     * @info: must be called before the first run, the VMs already placed are released
+	     */
+	    void discover ();
+
+	    /**
+	     * Place the VMs that arrived since the last run, forget the VMs that left, and rebalance the placement if it changed
+	     */
+	    void run ();
+
+	    /**
+	     * Unpin all the VMs placed, and remove the frequency limits of the cpus
+	     */
+	    void release ();
+
+	    /**
+	     * @returns: the number of caches of the host
+	     */
+	    std::size_t nbCaches () const;
+
+	    /**
+	     * @returns: the number of VMs moved since the placement started
+	     */
+	    unsigned long nbMoves () const;
+
+	    /**
+	     * @returns: the maximal frequency of each cpu written by the placement in KHz (0 if not limited)
+	     */
+	    std::vector <unsigned int> getFrequencyLimits () const;
+
+	    /**
+	     * @returns: the places of the VMs, the loads of the caches, and the placements decided at the last run
+	     */
+	    nlohmann::json dumpLogs () const;
+
+	private:
+
+	    /**
+	     * Search the best place of a VM in the current load
+	     * @params:
+	     *   - vcpus: the number of vcpus of the VM
+	     *   - memory: the memory of the VM in MB
+	     *   - tier: the tier of the VM (0 without tiers)
+	     */
+	    decision choose (unsigned int vcpus, unsigned long memory, unsigned int tier) const;
+
+	    /**
+	     * @returns: the preference of a cache for a VM of a tier, 0 if its group runs the tier, 1 if it is empty, 2 if it runs faster, and 3 if it runs slower (always 0 without tiers)
+	     */
+	    int affinity (const cache & c, unsigned int tier) const;
+
+	    /**
+	     * @returns: the tier of a VM, its highest nominal frequency rounded up to the frequency step in KHz (0 without tiers)
+	     */
+	    unsigned int tierOf (monitor::libvirt::LibvirtVM & vm) const;
+
+	    /**
+	     * Limit the maximal frequency of the groups whose tiers changed
+	     */
+	    void applyFrequencies ();
+
+	    /**
+	     * @returns: the maximal frequency of a group in KHz, the highest tier of its VMs bounded by the frequencies of its cpus (its maximal frequency if it has no VM)
+	     */
+	    unsigned int frequencyOf (const freq_group & g) const;
+
+	    /**
+	     * Add (or remove) the load of a VM to its caches and nodes
+	     * @params:
+	     *   - d: the place of the VM
+	     *   - sign: 1 to add, -1 to remove
+	     */
+	    void account (const decision & d, float sign);
+
+	    /**
+	     * Pin the vcpus, and bind the memory of a VM to its place
+	     * @returns: false if the backend could not pin the VM
+	     */
+	    bool apply (monitor::libvirt::LibvirtVM & vm, const decision & d);
+
+	    /**
+	     * Move the VMs that are not placed on a single cache, then the VMs running on cpus faster than their tier, then the VMs of the most loaded caches
+	     * @returns: the number of VMs moved
+	     */
+	    unsigned int rebalance ();
+
+	    /**
+	     * Move a VM to a new place, and record the event
+	     */
+	    void move (const std::string & name, const decision & to, const std::string & reason);
+
+	    /**
+	     * @returns: the capacity of a cache in vcpus
+	     */
+	    float capacity (const cache & c) const;
+
+	    /**
+	     * @returns: true iif the memory of a VM fits on a set of nodes
+	     */
+	    bool fitsMemory (const std::vector <unsigned int> & nodes, unsigned long memory) const;
+
+	    /**
+	     * @returns: the cpus of a set of caches
+	     */
+	    std::vector <unsigned int> cpus (const decision & d) const;
+
+	    /**
+	     * @returns: the description of a decision in the logs
+	     */
+	    nlohmann::json describe (const decision & d) const;
+
+	};
+
+    }
+
+}
@@ -0,0 +1,63 @@
+#include "cap.hh"
+#include <algorithm>
+#include <monitor/utils/exception.hh>
+
+using json = nlohmann::json;
+
+namespace server {
+
+    namespace power {
+
+	PowerCapConfig PowerCapConfig::parse (const json & j) {
+	    PowerCapConfig read;
+	    read.watts = j.at ("watts").get<float> ();
+	    read.kp = j.contains ("kp") ? j.at ("kp").get<float> () : 0.5f;
+	    read.ki = j.contains ("ki") ? j.at ("ki").get<float> () : 0.2f;
+	    read.minSupply = j.contains ("min-supply") ? j.at ("min-supply").get<float> () / 100.0f : 0.1f;
+
+	    if (read.watts <= 0.0f) throw monitor::utils::exception ("watts must be positive");
+	    if (read.kp < 0.0f || read.ki < 0.0f) throw monitor::utils::exception ("kp and ki must be positive");
+	    if (read.kp == 0.0f && read.ki == 0.0f) throw monitor::utils::exception ("kp or ki must be non zero");
+	    if (read.minSupply < 0.0f || read.minSupply > 1.0f) throw monitor::utils::exception ("min-supply must be in [0, 100]");
+
+	    return read;
+	}
+
+	void PowerCap::setConfig (PowerCapConfig cfg) {
+	    this-> _config = cfg;
+	}
+
+	float PowerCap::run (double watts) {
+	    if (watts <= 0.0) return (float) this-> _supply;
+
+	    this-> _ticks += 1;
+	    this-> _power = watts;
+	    if (watts > this-> _config.watts) this-> _over += 1;
+
+	    // Positive when the host can consume more
+	    double error = (this-> _config.watts - watts) / this-> _config.watts;
+	    this-> _supply += this-> _config.kp * (error - this-> _error) + this-> _config.ki * error;
+	    this-> _supply = std::max ((double) this-> _config.minSupply, std::min (1.0, this-> _supply));
+	    this-> _error = error;
+
+	    return (float) this-> _supply;
+	}
+
+	void PowerCap::reset () {
+	    this-> _supply = 1.0;
+	    this-> _error = 0.0;
+	}
+
+	json PowerCap::dumpLogs () const {
+	    return {
+		{"budget", this-> _config.watts},
+		{"power", this-> _power},
+		{"supply", this-> _supply},
+		{"over", this-> _over},
+		{"ticks", this-> _ticks}
+	    };
+	}
+
+    }
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <nlohmann/json.hpp>
+
+namespace server {
+
+    namespace power {
+
+	struct PowerCapConfig {
+	    /// The power budget of the host in watts
+	    float watts = 0.0f;
+
+	    /// The proportional gain of the controller (share of the cpus per share of the budget)
+	    float kp = 0.5f;
+
+	    /// The integral gain of the controller (share of the cpus per share of the budget and per tick)
+	    float ki = 0.2f;
+
+	    /// The minimal share of the cpus sold by the market
+	    float minSupply = 0.1f;
+
+	    /**
+	     * Read a configuration from the content of a power-cap.json file (the key enable is ignored)
+	     * @throws:
+	     *   - utils::exception: if a value is invalid
+	     *   - nlohmann::json::exception: if the budget is missing, or a key has the wrong type
+	     */
+	    static PowerCapConfig parse (const nlohmann::json & j);
+	};
+
+	/**
+	 * The controller keeping the power of the host under a budget, by changing the share of the cpus sold by the cpu market (cf. VCPUMarket::setSupply)
+	 * It is a PI controller in velocity form : at each tick the supply moves by kp times the change of the error, plus ki times the error (in share of the budget)
+	 * so it does not wind up while the supply is saturated (all the cpus sold under the budget, or only the guarantees of the VMs sold above it)
+	 * @info: the power is the one measured at the previous tick, the supply reacts with one tick of delay
+	 */
+	class PowerCap {
+
+	    /// The configuration of the controller
+	    PowerCapConfig _config;
+
+	    /// The share of the cpus sold by the market
+	    double _supply = 1.0;
+
+	    /// The error of the last tick in share of the budget (0 before the first tick)
+	    double _error = 0.0;
+
+	    /// The power measured at the last tick in watts
+	    double _power = 0.0;
+
+	    /// The number of ticks where the power was above the budget
+	    unsigned long _over = 0;
+
+	    /// The number of ticks since the controller started
+	    unsigned long _ticks = 0;
+
+	public:
+
+	    /**
+	     * Change the configuration of the controller
+	     */
+	    void setConfig (PowerCapConfig cfg);
+
+	    /**
+	     * Compute the supply of the market from the power of the host
+	     * @params:
+	     *   - watts: the power of the host during the last tick (0 if unknown, the supply is then unchanged)
+	     * @returns: the share of the cpus sold by the market
+	     */
+	    float run (double watts);
+
+	    /**
+	     * Sell all the cpus again, and forget the error
+	     */
+	    void reset ();
+
+	    /**
+	     * @returns: the budget, the power of the last tick, the supply, and the number of ticks above the budget
+	     */
+	    nlohmann::json dumpLogs () const;
+
+	};
+
+    }
+
+}
@@ -0,0 +1,227 @@
+#include "dvfs.hh"
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <monitor/utils/log.hh>
+#include <monitor/utils/exception.hh>
+
+using namespace monitor::libvirt;
+using namespace monitor::libvirt::control;
+using namespace monitor::utils;
+using json = nlohmann::json;
+
+namespace server {
+
+    namespace power {
+
+	DvfsConfig DvfsConfig::parse (const json & j) {
+	    DvfsConfig read;
+	    read.utilization = j.contains ("target-utilization") ? j.at ("target-utilization").get<float> () / 100.0f : 0.9f;
+	    read.headroom = j.contains ("headroom") ? j.at ("headroom").get<float> () / 100.0f : 0.1f;
+	    read.frequencyStep = j.contains ("frequency-step") ? j.at ("frequency-step").get<unsigned int> () : 100;
+	    read.hysteresis = j.contains ("hysteresis") ? j.at ("hysteresis").get<float> () / 100.0f : 0.1f;
+	    read.rateLimit = j.contains ("rate-limit") ? j.at ("rate-limit").get<unsigned int> () : 2;
+
+	    if (read.utilization <= 0.0f || read.utilization > 1.0f) throw monitor::utils::exception ("target-utilization must be in ]0, 100]");
+	    if (read.headroom < 0.0f) throw monitor::utils::exception ("headroom must be positive");
+	    if (read.frequencyStep == 0) throw monitor::utils::exception ("frequency-step must be positive");
+	    if (read.hysteresis < 0.0f || read.hysteresis >= 1.0f) throw monitor::utils::exception ("hysteresis must be in [0, 100[");
+
+	    return read;
+	}
+
+	/// The share of the time a cpu (or of its allocation a vcpu) is busy above which its demand is unknown
+	const double SATURATION = 0.95;
+
+	DvfsActuator::DvfsActuator (LibvirtClient & client) :
+	    _libvirt (client)
+	{}
+
+	void DvfsActuator::setConfig (DvfsConfig cfg) {
+	    this-> _config = cfg;
+	}
+
+	void DvfsActuator::discover () {
+	    this-> release ();
+	    this-> _domains.clear ();
+	    this-> _cpuDomain.clear ();
+
+	    auto backend = this-> _libvirt.getBackend ();
+	    if (backend == nullptr) return;
+
+	    auto t = backend-> readTopology ();
+	    std::map <unsigned int, unsigned int> index;
+	    for (unsigned int cpu = 0 ; cpu < t.cpus.size () ; cpu++) {
+		auto & p = t.cpus [cpu];
+		auto it = index.find (p.domain);
+		if (it == index.end ()) {
+		    it = index.emplace (p.domain, this-> _domains.size ()).first;
+		    this-> _domains.push_back (domain {});
+		}
+
+		auto & d = this-> _domains [it-> second];
+		d.cpus.push_back (cpu);
+		d.minFreq = std::max (d.minFreq, p.minFreq);
+		d.maxFreq = std::max (d.maxFreq, p.maxFreq);
+		this-> _cpuDomain.push_back (it-> second);
+	    }
+
+	    unsigned int unknown = 0;
+	    for (auto & d : this-> _domains) {
+		if (d.maxFreq == 0) unknown += 1;
+	    }
+
+	    logging::info ("DVFS on", this-> _domains.size (), "frequency domains");
+	    if (unknown != 0) {
+		logging::warn ("The frequencies of", unknown, "domains are unknown, they are not controlled");
+	    }
+	}
+
+	void DvfsActuator::setCeilings (const std::vector <unsigned int> & limits) {
+	    std::vector <unsigned int> ceilings (this-> _domains.size (), 0);
+	    for (unsigned int cpu = 0 ; cpu < limits.size () && cpu < this-> _cpuDomain.size () ; cpu++) {
+		auto & c = ceilings [this-> _cpuDomain [cpu]];
+		c = std::max (c, limits [cpu]);
+	    }
+
+	    for (unsigned int i = 0 ; i < this-> _domains.size () ; i++) {
+		// The frequency was overwritten by the placement, it is written again
+		if (this-> _domains [i].ceiling != ceilings [i]) this-> _domains [i].limit = 0;
+		this-> _domains [i].ceiling = ceilings [i];
+	    }
+	}
+
+	void DvfsActuator::run () {
+	    this-> _tick += 1;
+	    this-> _cycles = 0;
+	    if (this-> _domains.empty ()) return;
+
+	    auto & frequencies = this-> _libvirt.getLastCPUFrequency ();
+	    std::vector <double> needed (this-> _cpuDomain.size (), 0.0);
+	    std::vector <double> minimal (this-> _cpuDomain.size (), 0.0);
+	    std::vector <double> busy (this-> _cpuDomain.size (), 0.0);
+	    std::vector <std::tuple <LibvirtVCPUController*, unsigned int, double> > allocations;
+
+	    for (auto & v : this-> _libvirt.getRunningVMs ()) {
+		for (auto & vt : v-> getVCPUControllers ()) {
+		    this-> _cycles += vt.getDeliveredCycles ();
+
+		    auto cpu = vt.readCpu ();
+		    if (cpu >= needed.size ()) continue;
+
+		    // The frequency the vcpu ran at during the last tick in KHz
+		    double delivered = vt.getDeliveredFrequency ();
+		    if (delivered == 0.0) delivered = cpu < frequencies.size () ? frequencies [cpu] : 0.0;
+
+		    double usage = vt.getAbsoluteConsumption ();
+		    double allocated = vt.allocated ();
+		    busy [cpu] += usage;
+		    if (allocated != 0.0) allocations.emplace_back (&vt, cpu, delivered);
+		    if (allocated != 0.0 && usage >= allocated * SATURATION) {
+			// The vcpu was throttled, its demand is unknown, it gets its allocation at its nominal frequency at least
+			double frequency = std::max (delivered, (double) vt.getNominalFreq () * 1000.0);
+			needed [cpu] += allocated * frequency;
+			minimal [cpu] = std::max (minimal [cpu], frequency);
+		    } else {
+			needed [cpu] += usage * (1.0 + this-> _config.headroom) * delivered;
+		    }
+		}
+	    }
+
+	    for (auto & d : this-> _domains) {
+		if (d.maxFreq == 0) continue;
+		auto highest = this-> highest (d);
+
+		// The microseconds * KHz executed in one second, in the share of the second the cpu can be busy
+		double frequency = 0.0;
+		for (auto & cpu : d.cpus) {
+		    frequency = std::max (frequency, needed [cpu] / (1000000.0 * this-> _config.utilization));
+		    frequency = std::max (frequency, minimal [cpu]);
+
+		    // The cpu is saturated, the demand of its vcpus is unknown
+		    if (busy [cpu] >= 1000000.0 * SATURATION) frequency = highest;
+		}
+
+		unsigned long step = ((unsigned long) this-> _config.frequencyStep) * 1000;
+		auto target = ((unsigned long) frequency + step - 1) / step * step;
+		d.target = (unsigned int) std::max ((unsigned long) d.minFreq, std::min ((unsigned long) highest, target));
+
+		if (d.limit == 0 || d.target > d.limit) {
+		    this-> write (d, d.target);
+		} else if (d.target < d.limit * (1.0f - this-> _config.hysteresis) && this-> _tick - d.lastWrite >= this-> _config.rateLimit) {
+		    this-> write (d, d.target);
+		}
+	    }
+
+	    // The allocations of the market are cpu time at the frequency the vcpus were delivered, they are stretched to execute the same cycles on the slowed down cpus
+	    for (auto & it : allocations) {
+		auto & vt = *std::get <0> (it);
+		auto delivered = std::get <2> (it);
+		auto & d = this-> _domains [this-> _cpuDomain [std::get <1> (it)]];
+		if (d.limit == 0 || d.limit >= delivered) continue;
+
+		auto stretched = std::min (1000000.0, ((double) vt.allocated ()) * delivered / ((double) d.limit));
+		vt.allocated () = (unsigned long) stretched;
+		vt.setQuota (vt.allocated (), vt.getPeriod ());
+	    }
+	}
+
+	void DvfsActuator::release () {
+	    for (auto & d : this-> _domains) {
+		if (d.limit != 0 && d.maxFreq != 0) this-> write (d, d.maxFreq);
+		d.limit = 0;
+		d.target = 0;
+	    }
+	}
+
+	unsigned long DvfsActuator::getCycles () const {
+	    return this-> _cycles;
+	}
+
+	unsigned long DvfsActuator::nbWrites () const {
+	    return this-> _writes;
+	}
+
+	json DvfsActuator::dumpLogs () const {
+	    json domains = json::array ();
+	    for (auto & d : this-> _domains) {
+		domains.push_back ({{"cpus", HostBackend::formatList (d.cpus)}, {"target", d.target}, {"frequency", d.limit}});
+	    }
+
+	    json j;
+	    j ["domains"] = domains;
+	    j ["writes"] = this-> _writes;
+	    j ["cycles"] = this-> _cycles;
+	    return j;
+	}
+
+	bool DvfsActuator::write (domain & d, unsigned int frequency) {
+	    auto backend = this-> _libvirt.getBackend ();
+	    if (backend == nullptr) return false;
+
+	    bool written = true;
+	    for (auto & cpu : d.cpus) {
+		written = backend-> setMaxFrequency (cpu, frequency) && written;
+	    }
+
+	    d.lastWrite = this-> _tick;
+	    if (!written) {
+		// The domain is not controlled anymore, instead of failing at each tick
+		logging::warn ("Frequency of cpus", HostBackend::formatList (d.cpus), "could not be written, they are not controlled");
+		d.maxFreq = 0;
+		return false;
+	    }
+
+	    d.limit = frequency;
+	    this-> _writes += 1;
+	    return true;
+	}
+
+	unsigned int DvfsActuator::highest (const domain & d) const {
+	    if (d.ceiling != 0 && d.ceiling < d.maxFreq) return d.ceiling;
+	    return d.maxFreq;
+	}
+
+    }
+
+}
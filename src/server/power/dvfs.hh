@@ -0,0 +1,161 @@
+#pragma once
+#include <monitor/libvirt/_.hh>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+namespace server {
+
+    namespace power {
+
+	struct DvfsConfig {
+	    /// The utilization of the cpus targeted by the frequency (the cpus are slowed down until they are busy this share of the time)
+	    float utilization = 0.9f;
+
+	    /// The cycles the vcpus can use above their consumption of the last tick, in share of their consumption
+	    float headroom = 0.1f;
+
+	    /// The frequencies are rounded up to a multiple of this step (in MHz)
+	    unsigned int frequencyStep = 100;
+
+	    /// The frequency of a domain is decreased only if its target is lower than its frequency by this share
+	    float hysteresis = 0.1f;
+
+	    /// The minimal number of market ticks between two decreases of the frequency of a domain
+	    unsigned int rateLimit = 2;
+
+	    /**
+	     * Read a configuration from the content of a dvfs.json file (the key enable is ignored)
+	     * @throws:
+	     *   - utils::exception: if a value is invalid
+	     *   - nlohmann::json::exception: if a key has the wrong type
+	     */
+	    static DvfsConfig parse (const nlohmann::json & j);
+	};
+
+	/**
+	 * The frequency of the cpus computed from the outcome of the cpu market
+	 * After each market tick, each cpu gets the frequency at which the vcpus it runs execute the cycles they need in the time they are allocated :
+	 *    - a vcpu consuming less than its allocation needs its consumption (plus the headroom), at the frequency it was delivered
+	 *    - a vcpu throttled by its allocation needs its allocation at its nominal frequency (or the frequency it was delivered if it is higher)
+	 * The frequency of a domain is the highest frequency of its cpus, it is written in scaling_max_freq (the governor still chooses the frequency below it)
+	 * The frequencies are increased as soon as needed, and decreased with an hysteresis, at most once every rateLimit ticks
+	 */
+	class DvfsActuator {
+
+	    /**
+	     * A group of cpus whose frequency is set together (a cpufreq policy)
+	     */
+	    struct domain {
+		/// The ids of the cpus
+		std::vector <unsigned int> cpus;
+
+		/// The minimal frequency of the cpus in KHz (0 if unknown)
+		unsigned int minFreq = 0;
+
+		/// The maximal frequency of the cpus in KHz (0 if unknown, the domain is then not controlled)
+		unsigned int maxFreq = 0;
+
+		/// The highest frequency the domain can be set to in KHz, limited by the placement (0 for maxFreq)
+		unsigned int ceiling = 0;
+
+		/// The frequency computed at the last tick in KHz
+		unsigned int target = 0;
+
+		/// The frequency written in KHz (0 if not written yet)
+		unsigned int limit = 0;
+
+		/// The tick of the last write
+		unsigned long lastWrite = 0;
+	    };
+
+	    /// The libvirt client managing the running VMs
+	    monitor::libvirt::LibvirtClient & _libvirt;
+
+	    /// The configuration of the actuator
+	    DvfsConfig _config;
+
+	    /// The frequency domains of the host
+	    std::vector <domain> _domains;
+
+	    /// The domain of each cpu (index in _domains)
+	    std::vector <unsigned int> _cpuDomain;
+
+	    /// The number of market ticks since the actuator started
+	    unsigned long _tick = 0;
+
+	    /// The number of frequencies written since the actuator started
+	    unsigned long _writes = 0;
+
+	    /// The cycles executed by the vcpus during the last tick
+	    unsigned long _cycles = 0;
+
+	public:
+
+	    /**
+	     * @params:
+	     *   - client: the libvirt client
+	     */
+	    DvfsActuator (monitor::libvirt::LibvirtClient & client);
+
+	    /**
+	     * Change the configuration of the actuator
+	     */
+	    void setConfig (DvfsConfig cfg);
+
+	    /**
+	     * Read the frequency domains of the host from the backend of the client
+	     * @info: must be called before the first run, the frequencies already written are restored
+	     */
+	    void discover ();
+
+	    /**
+	     * Limit the frequency of the cpus below the limits of the placement (cf. NumaPlacement::getFrequencyLimits)
+	     * @params:
+	     *   - limits: the maximal frequency of each cpu in KHz (0 if not limited)
+	     */
+	    void setCeilings (const std::vector <unsigned int> & limits);
+
+	    /**
+	     * Compute the frequency of the cpus from the allocations of the last market tick, and write the ones that changed
+	     * @info: must be called after the market, before the allocations of the vcpus are reset
+	     */
+	    void run ();
+
+	    /**
+	     * Restore the maximal frequency of all the cpus
+	     */
+	    void release ();
+
+	    /**
+	     * @returns: the cycles executed by the vcpus during the last tick
+	     */
+	    unsigned long getCycles () const;
+
+	    /**
+	     * @returns: the number of frequencies written since the actuator started
+	     */
+	    unsigned long nbWrites () const;
+
+	    /**
+	     * @returns: the target and the written frequency of each domain, and the number of writes
+	     */
+	    nlohmann::json dumpLogs () const;
+
+	private:
+
+	    /**
+	     * Write the frequency of a domain
+	     * @returns: false if the backend could not write it
+	     */
+	    bool write (domain & d, unsigned int frequency);
+
+	    /**
+	     * @returns: the highest frequency a domain can be set to in KHz, its maximal frequency bounded by its ceiling
+	     */
+	    unsigned int highest (const domain & d) const;
+
+	};
+
+    }
+
+}
@@ -0,0 +1,71 @@
+#include "energy.hh"
+
+using namespace monitor::libvirt;
+using json = nlohmann::json;
+
+namespace server {
+
+    namespace power {
+
+	EnergyAttribution::EnergyAttribution (LibvirtClient & client) :
+	    _libvirt (client)
+	{}
+
+	void EnergyAttribution::run (double energy) {
+	    std::map <std::string, account> running;
+	    unsigned long cycles = 0;
+	    for (auto & v : this-> _libvirt.getRunningVMs ()) {
+		auto it = this-> _vms.find (v-> id ());
+		auto & acc = running [v-> id ()];
+		if (it != this-> _vms.end ()) acc = it-> second;
+
+		acc.cycles = 0;
+		for (auto & vt : v-> getVCPUControllers ()) {
+		    acc.cycles += vt.getDeliveredCycles ();
+		}
+
+		cycles += acc.cycles;
+	    }
+
+	    this-> _vms = std::move (running);
+	    if (cycles == 0) {
+		this-> _unattributed += energy;
+	    }
+
+	    for (auto & it : this-> _vms) {
+		auto & acc = it.second;
+		acc.tick = cycles != 0 ? energy * ((double) acc.cycles) / ((double) cycles) : 0.0;
+		acc.total += acc.tick;
+	    }
+	}
+
+	double EnergyAttribution::getEnergy (const std::string & name) const {
+	    auto it = this-> _vms.find (name);
+	    if (it == this-> _vms.end ()) return 0.0;
+
+	    return it-> second.total;
+	}
+
+	double EnergyAttribution::getLastEnergy (const std::string & name) const {
+	    auto it = this-> _vms.find (name);
+	    if (it == this-> _vms.end ()) return 0.0;
+
+	    return it-> second.tick;
+	}
+
+	double EnergyAttribution::getUnattributed () const {
+	    return this-> _unattributed;
+	}
+
+	json EnergyAttribution::dumpLogs () const {
+	    json j;
+	    for (auto & it : this-> _vms) {
+		j [it.first] = {{"energy", it.second.tick}, {"total", it.second.total}, {"cycles", it.second.cycles}};
+	    }
+
+	    return j;
+	}
+
+    }
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <monitor/libvirt/_.hh>
+#include <nlohmann/json.hpp>
+#include <map>
+#include <string>
+
+namespace server {
+
+    namespace power {
+
+	/**
+	 * The attribution of the energy of the host to the VMs
+	 * At each tick, the energy consumed by the host is shared between the running VMs in proportion of the cycles their vcpus executed (cf. LibvirtVCPUController::getDeliveredCycles)
+	 * The energy of the ticks where no cycle was executed is not attributed
+	 * @info: the idle and static power of the host is attributed with the rest, a VM executing a share of the cycles pays the same share of the host
+	 */
+	class EnergyAttribution {
+
+	    /**
+	     * The energy attributed to a VM
+	     */
+	    struct account {
+		/// The energy attributed at the last tick in micro joules
+		double tick = 0;
+
+		/// The energy attributed since the VM is running in micro joules
+		double total = 0;
+
+		/// The cycles executed by the VM at the last tick
+		unsigned long cycles = 0;
+	    };
+
+	    /// The libvirt client managing the running VMs
+	    monitor::libvirt::LibvirtClient & _libvirt;
+
+	    /// The energy attributed to the running VMs
+	    std::map <std::string, account> _vms;
+
+	    /// The energy that was not attributed since the attribution started in micro joules
+	    double _unattributed = 0;
+
+	public:
+
+	    /**
+	     * @params:
+	     *   - client: the libvirt client
+	     */
+	    EnergyAttribution (monitor::libvirt::LibvirtClient & client);
+
+	    /**
+	     * Share the energy of a tick between the running VMs, the VMs that left are forgotten
+	     * @params:
+	     *   - energy: the energy consumed by the host during the tick in micro joules
+	     * @info: must be called after the update of the vcpus, so their cycles are the ones of the tick
+	     */
+	    void run (double energy);
+
+	    /**
+	     * @returns: the energy attributed to a VM since it is running in micro joules (0 if unknown)
+	     */
+	    double getEnergy (const std::string & name) const;
+
+	    /**
+	     * @returns: the energy attributed to a VM at the last tick in micro joules (0 if unknown)
+	     */
+	    double getLastEnergy (const std::string & name) const;
+
+	    /**
+	     * @returns: the energy that was not attributed since the attribution started in micro joules
+	     */
+	    double getUnattributed () const;
+
+	    /**
+	     * @returns: the energy attributed to each VM at the last tick and since it is running
+	     */
+	    nlohmann::json dumpLogs () const;
+
+	};
+
+    }
+
+}
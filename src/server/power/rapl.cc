@@ -0,0 +1,169 @@
+#include "rapl.hh"
+#include <monitor/utils/log.hh>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using namespace monitor::utils;
+using json = nlohmann::json;
+
+namespace server {
+
+    namespace power {
+
+	RaplReader::RaplReader (const fs::path & root) :
+	    _root (root)
+	{
+	    this-> discover ();
+	}
+
+	bool RaplReader::isEnabled () const {
+	    return !this-> _zones.empty ();
+	}
+
+	void RaplReader::discover () {
+	    std::error_code err;
+	    if (!fs::is_directory (this-> _root, err)) return;
+
+	    // The zones are the entries <control>:<package>[:<subzone>] (e.g. intel-rapl:0:2), the entry <control> alone is the control type
+	    std::vector <std::string> ids;
+	    for (auto & entry : fs::directory_iterator (this-> _root, err)) {
+		auto id = entry.path ().filename ().string ();
+		if (id.find (':') != std::string::npos) ids.push_back (id);
+	    }
+
+	    // The packages are before their subzones, and the zones of intel-rapl-mmio (duplicating the packages of intel-rapl on recent cpus) are last
+	    auto mmio = [] (const std::string & id) { return id.rfind ("intel-rapl-mmio", 0) == 0; };
+	    std::sort (ids.begin (), ids.end (), [&mmio] (const std::string & a, const std::string & b) {
+		if (mmio (a) != mmio (b)) return mmio (b);
+		return a < b;
+	    });
+
+	    std::map <std::string, int> index;
+	    for (auto & id : ids) {
+		zone z;
+		z.id = id;
+
+		std::ifstream name (this-> _root / id / "name");
+		name >> z.name;
+
+		std::ifstream range (this-> _root / id / "max_energy_range_uj");
+		range >> z.range;
+
+		auto parentId = id.substr (0, id.rfind (':'));
+		auto parent = index.find (parentId);
+		if (parent != index.end ()) {
+		    z.parent = parent-> second;
+		} else if (parentId.find (':') != std::string::npos) {
+		    continue; // the package of the subzone was skipped
+		} else if (std::any_of (this-> _zones.begin (), this-> _zones.end (), [&z] (const zone & o) { return o.parent == -1 && o.name == z.name; })) {
+		    // The same package is exposed by two control types (intel-rapl and intel-rapl-mmio), it is counted once
+		    continue;
+		}
+
+		// The counters are only readable by root on recent kernels
+		z.fd = ::open ((this-> _root / id / "energy_uj").c_str (), O_RDONLY);
+		if (z.fd < 0 || !this-> readCounter (z, z.value)) {
+		    if (z.fd >= 0) ::close (z.fd);
+		    logging::warn ("Energy of powercap zone", id, "is not readable");
+		    continue;
+		}
+
+		index.emplace (id, this-> _zones.size ());
+		this-> _zones.push_back (z);
+	    }
+
+	    this-> _last = std::chrono::steady_clock::now ();
+	    if (!this-> _zones.empty ()) {
+		logging::info ("RAPL energy read on", this-> _zones.size (), "powercap zones");
+	    }
+	}
+
+	void RaplReader::read () {
+	    auto now = std::chrono::steady_clock::now ();
+	    this-> _elapsed = std::chrono::duration <double> (now - this-> _last).count ();
+	    this-> _last = now;
+
+	    for (auto & z : this-> _zones) {
+		unsigned long value;
+		if (!this-> readCounter (z, value)) {
+		    z.energy = 0;
+		    continue;
+		}
+
+		if (value >= z.value) {
+		    z.energy = value - z.value;
+		} else {
+		    // The counter wrapped after its range (its range is unknown on old kernels, it then wrapped at the last value read at least)
+		    z.energy = (z.range != 0 ? z.range - z.value : 0) + value;
+		    z.wraps += 1;
+		}
+
+		z.value = value;
+	    }
+	}
+
+	unsigned long RaplReader::getEnergy () const {
+	    unsigned long energy = 0;
+	    for (auto & z : this-> _zones) {
+		if (this-> isHostEnergy (z)) energy += z.energy;
+	    }
+
+	    return energy;
+	}
+
+	double RaplReader::getPower () const {
+	    if (this-> _elapsed <= 0.0) return 0.0;
+
+	    // micro joules per second are micro watts
+	    return ((double) this-> getEnergy ()) / this-> _elapsed / 1000000.0;
+	}
+
+	unsigned long RaplReader::getPackageEnergy (unsigned int package) const {
+	    auto name = "package-" + std::to_string (package);
+	    for (auto & z : this-> _zones) {
+		if (z.parent == -1 && z.name == name) return z.energy;
+	    }
+
+	    return 0;
+	}
+
+	json RaplReader::dumpLogs () const {
+	    json j;
+	    for (auto & z : this-> _zones) {
+		auto name = z.parent == -1 ? z.name : this-> _zones [z.parent].name + "/" + z.name;
+		j [name] = {{"zone", z.id}, {"energy", z.energy}, {"wraps", z.wraps}};
+	    }
+
+	    return j;
+	}
+
+	bool RaplReader::readCounter (const zone & z, unsigned long & value) const {
+	    char buf [32];
+	    auto len = ::pread (z.fd, buf, sizeof (buf) - 1, 0);
+	    if (len <= 0) return false;
+
+	    buf [len] = '\0';
+	    char * end = nullptr;
+	    value = std::strtoul (buf, &end, 10);
+	    return end != buf;
+	}
+
+	bool RaplReader::isHostEnergy (const zone & z) const {
+	    if (z.name == "dram") return true;
+	    return z.parent == -1 && z.name.rfind ("package", 0) == 0;
+	}
+
+	RaplReader::~RaplReader () {
+	    for (auto & z : this-> _zones) {
+		::close (z.fd);
+	    }
+	}
+
+    }
+
+}
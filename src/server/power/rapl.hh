@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace server {
+
+    namespace power {
+
+	/**
+	 * The reader of the energy counters of the powercap framework (rapl)
+	 * All the zones of the host are read : the packages, and their subzones (core, uncore, dram)
+	 * The counters are read with file descriptors kept open, and the wraparound of the counters (max_energy_range_uj) is handled
+	 * @info: the energy of the host is the energy of the packages plus the energy of the dram (the core and uncore subzones are part of their package, psys covers the whole platform)
+	 * @warning: a counter wrapping more than once between two reads is missed (several minutes at full power on a server)
+	 */
+	class RaplReader {
+
+	    /**
+	     * A zone of the powercap framework
+	     */
+	    struct zone {
+		/// The id of the zone in the powercap directory (e.g. intel-rapl:0:1)
+		std::string id;
+
+		/// The name of the zone (e.g. package-0, core, uncore, dram, psys)
+		std::string name;
+
+		/// The index of the parent zone in _zones (-1 for a package)
+		int parent = -1;
+
+		/// The file descriptor of energy_uj
+		int fd = -1;
+
+		/// The range of the counter in micro joules, it wraps to 0 after it (0 if unknown)
+		unsigned long range = 0;
+
+		/// The value of the counter at the last read
+		unsigned long value = 0;
+
+		/// The energy consumed between the last two reads in micro joules
+		unsigned long energy = 0;
+
+		/// The number of times the counter wrapped since it was opened
+		unsigned long wraps = 0;
+	    };
+
+	    /// The directory of the powercap framework
+	    std::filesystem::path _root;
+
+	    /// The zones of the host
+	    std::vector <zone> _zones;
+
+	    /// The instant of the last read
+	    std::chrono::steady_clock::time_point _last;
+
+	    /// The time between the last two reads in seconds
+	    double _elapsed = 0;
+
+	public:
+
+	    /**
+	     * @params:
+	     *   - root: the directory of the powercap framework (can be moved to read a copy)
+	     */
+	    RaplReader (const std::filesystem::path & root = "/sys/class/powercap");
+
+	    RaplReader (const RaplReader &) = delete;
+	    void operator= (const RaplReader &) = delete;
+
+	    /**
+	     * Read all the counters, the energy consumed since the last read is then returned by getEnergy
+	     */
+	    void read ();
+
+	    /**
+	     * @returns: the energy consumed by the host between the last two reads in micro joules
+	     */
+	    unsigned long getEnergy () const;
+
+	    /**
+	     * @returns: the mean power of the host between the last two reads in watts (0 before the first read)
+	     */
+	    double getPower () const;
+
+	    /**
+	     * @returns: the energy consumed by a package between the last two reads in micro joules (0 if it does not exist)
+	     */
+	    unsigned long getPackageEnergy (unsigned int package) const;
+
+	    /**
+	     * @returns: true if at least one zone is readable
+	     */
+	    bool isEnabled () const;
+
+	    /**
+	     * @returns: the energy of each zone between the last two reads, and the number of wraps of their counters
+	     */
+	    nlohmann::json dumpLogs () const;
+
+	    /**
+	     * Close the counters
+	     */
+	    ~RaplReader ();
+
+	private:
+
+	    /**
+	     * Discover the zones of the powercap framework, and open their counters
+	     */
+	    void discover ();
+
+	    /**
+	     * Read the current value of a counter
+	     * @returns: false if the counter could not be read
+	     */
+	    bool readCounter (const zone & z, unsigned long & value) const;
+
+	    /**
+	     * @returns: true iif the energy of a zone is part of the energy of the host
+	     */
+	    bool isHostEnergy (const zone & z) const;
+
+	};
+
+    }
+
+}
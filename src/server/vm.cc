@@ -15,10 +15,11 @@ using json = nlohmann::json;
 
 namespace server {
 
-    VMServer::VMServer (monitor::libvirt::LibvirtClient & client, Controller & control) :
+    VMServer::VMServer (monitor::libvirt::LibvirtClient & client, Controller & control, Journal & journal) :
 	_listener (net::SockAddrV4 (net::Ipv4Address (0, 0, 0, 0), 0)),
 	_libvirt (client),
-	_controller (control)
+	_controller (control),
+	_journal (journal)
     {}
     
 
@@ -65,6 +66,18 @@ namespace server {
 		this-> treatResetCounters (client);
 		break;
 	    }
+	    case VMProtocol::STATS: {
+		this-> treatStats (client);
+		break;
+	    }
+	    case VMProtocol::SUMMARY: {
+		this-> treatSummary (client);
+		break;
+	    }
+	    case VMProtocol::ADOPT: {
+		this-> treatAdopt (client);
+		break;
+	    }
 	    default: {
 		client.sendInt (VMProtocol::ERR);
 		client.sendInt (VMProtocolError::PROTOCOL);
@@ -83,6 +96,7 @@ namespace server {
 	    auto name = inner.get<std::string> ("name");
 	    if (!this-> _libvirt.hasVM (name)) {
 		auto vm = this-> _libvirt.provision (cfg);
+		this-> _journal.recordVM (*vm);
 		stream.sendInt (VMProtocol::IP);
 		auto ip = vm-> ip ();
 		stream.sendInt (ip.length ());
@@ -105,6 +119,7 @@ namespace server {
 	try {
 	    if (this-> _libvirt.hasVM (name)) {
 		this-> _libvirt.kill (name);
+		this-> _journal.recordKill (name);
 		stream.sendInt (VMProtocol::OK);
 		stream.close ();
 		return;
@@ -171,6 +186,55 @@ namespace server {
     }
     
 
+    void VMServer::treatStats (net::TcpStream & stream) {
+	auto logs = this-> _controller.getLastLogs ().dump ();
+	stream.sendInt (VMProtocol::STATS);
+	stream.sendInt (logs.length ());
+	stream.send (logs);
+	stream.close ();
+    }
+
+    void VMServer::treatSummary (net::TcpStream & stream) {
+	this-> _controller.getLastSummary ().send (stream);
+	stream.close ();
+    }
+
+    void VMServer::treatAdopt (net::TcpStream & stream) {
+	auto len = stream.receiveInt ();
+	auto content = stream.receive (len);
+	try {
+	    auto handover = server::cluster::VMHandover::parse (json::parse (content));
+	    auto spec = utils::toml::parse (handover.spec);
+
+	    // A handover sent again (its answer was lost) must not adopt the VM, nor credit its money, twice
+	    if (this-> _libvirt.hasVM (spec.get<utils::config::dict> ("vm").get<std::string> ("name"))) {
+		stream.sendInt (VMProtocol::ERR);
+		stream.sendInt (VMProtocolError::ALREADY_EXISTS);
+		stream.close ();
+		return;
+	    }
+
+	    auto vm = this-> _libvirt.adoptVM (spec, handover.ip, handover.mac);
+	    if (vm != nullptr) {
+		this-> _controller.getAccounting ().credit (vm-> id (), server::market::resource::CPU, handover.money);
+		this-> _journal.recordVM (*vm);
+		logging::success ("VM", vm-> id (), "is adopted");
+		stream.sendInt (VMProtocol::OK);
+		stream.close ();
+		return;
+	    }
+	} catch (utils::exception & e) {
+	    e.print ();
+	} catch (json::exception & e) {
+	    logging::error ("Invalid handover :", e.what ());
+	}
+
+	stream.sendInt (VMProtocol::ERR);
+	stream.sendInt (VMProtocolError::NOT_FOUND);
+	stream.close ();
+    }
+    
+
     void VMServer::dumpConfig (const std::filesystem::path & path) const {
 	json j;
 	j ["port"] = this-> _listener.port ();
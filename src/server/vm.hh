@@ -4,6 +4,7 @@
 #include <monitor/libvirt/_.hh>
 #include <filesystem>
 #include "control.hh"
+#include "journal.hh"
 
 namespace server {    
     
@@ -24,13 +25,18 @@ namespace server {
 	/// The controller of markets
 	Controller & _controller;
 
+	/// The journal in which the provisionned, and killed VMs are recorded
+	Journal & _journal;
+
     public:
 
 	/**
 	 * @params: 
 	 *  - the libvirt client that communicate with libvirt
+	 *  - the controller of the markets
+	 *  - the journal recording the provisionned VMs
 	 */
-	VMServer (monitor::libvirt::LibvirtClient & libvirt, Controller & controller);
+	VMServer (monitor::libvirt::LibvirtClient & libvirt, Controller & controller, Journal & journal);
 	
 	/**
 	 * Start the server thread waiting for new connections
@@ -83,6 +89,21 @@ namespace server {
 	 * Treat a reset counter request
 	 */
 	void treatResetCounters (monitor::net::TcpStream & client);
+
+	/**
+	 * Treat a stats request
+	 */
+	void treatStats (monitor::net::TcpStream & client);
+
+	/**
+	 * Treat a summary request (cluster coordinator)
+	 */
+	void treatSummary (monitor::net::TcpStream & client);
+
+	/**
+	 * Treat an adoption request (VM migrated from another host by its migration orchestrator)
+	 */
+	void treatAdopt (monitor::net::TcpStream & client);
 	
 	/**
 	 * Create the configuration file, in order to access the server from outside process
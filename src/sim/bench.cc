@@ -0,0 +1,121 @@
+#include "bench.hh"
+#include "host.hh"
+#include "report.hh"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sys/sysinfo.h>
+#include <server/market/accounting.hh>
+
+using namespace monitor::libvirt;
+using namespace server::market;
+using json = nlohmann::json;
+
+namespace sim {
+
+    MarketBench::MarketBench (const VCPUMarketConfig & cfg, int nbCpus, unsigned long vcpus, int vcpusPerVM, unsigned long ticks) :
+	_config (cfg),
+	_vcpus (vcpus),
+	_vcpusPerVM (vcpusPerVM),
+	_ticks (ticks)
+    {
+	this-> _config.nbCpus = nbCpus;
+	this-> _config.vmLevel = false;
+    }
+
+    json MarketBench::run (unsigned int maxThreads) {
+	std::vector <unsigned long> serial;
+	auto base = this-> runWith (1, serial);
+	auto mean = [] (const std::vector <double> & values) {
+	    return values.empty () ? 0.0 : std::accumulate (values.begin (), values.end (), 0.0) / values.size ();
+	};
+
+	json runs = json::array ();
+	for (unsigned int threads = 1 ; threads <= std::max (1u, maxThreads) ; threads *= 2) {
+	    std::vector <unsigned long> outcome;
+	    auto times = threads == 1 ? base : this-> runWith (threads, outcome);
+	    runs.push_back ({
+		    {"threads", threads},
+		    {"mean-us", mean (times)},
+		    {"p99-us", Report::percentile (times, 0.99)},
+		    {"speedup", mean (times) > 0.0 ? mean (base) / mean (times) : 0.0},
+		    {"identical", threads == 1 || outcome == serial}
+		});
+	}
+
+	json j;
+	j ["vcpus"] = this-> _vcpus;
+	j ["cpus"] = this-> _config.nbCpus;
+	j ["ticks"] = this-> _ticks;
+	j ["cores"] = get_nprocs (); // the speedup cannot exceed the cores running the bench
+	j ["runs"] = runs;
+	return j;
+    }
+
+    std::vector <double> MarketBench::runWith (unsigned int threads, std::vector <unsigned long> & outcome) {
+	auto cfg = this-> _config;
+	cfg.threads = threads;
+
+	auto client = LibvirtClient::offline ();
+	Accounting accounting;
+	VCPUMarket market (client, accounting, cfg);
+
+	// The guarantees of the VMs are half of the host, the rest is bid on
+	auto frequency = std::max (1, std::min (cfg.cpuFreq, (int) (((double) cfg.cpuFreq) * cfg.nbCpus / (2.0 * this-> _vcpus))));
+	std::vector <std::unique_ptr <LibvirtVM> > vms;
+	for (unsigned long i = 0 ; i * this-> _vcpusPerVM < this-> _vcpus ; i++) {
+	    auto n = std::min ((unsigned long) this-> _vcpusPerVM, this-> _vcpus - i * this-> _vcpusPerVM);
+	    vms.push_back (std::make_unique <LibvirtVM> (vmSpec ("bench-" + std::to_string (i), n, 2048, frequency, 0.5f)));
+	    client.attach (vms.back ().get ());
+	    vms.back ()-> getCPUController ().enable ();
+	}
+
+	// The same consumptions are replayed by every run
+	std::mt19937 random (0);
+	std::uniform_int_distribution <unsigned long> demand (0, 1000000);
+	std::uniform_int_distribution <int> idle (0, 2);
+
+	std::vector <double> times;
+	for (unsigned long tick = 0 ; tick < this-> _ticks ; tick++) {
+	    for (auto & vm : vms) {
+		for (auto & vcpu : vm-> getVCPUControllers ()) {
+		    auto consumption = demand (random);
+		    vcpu.feed (idle (random) == 0 ? 0 : consumption, 1.0f, cfg.cpuFreq * 1000);
+		    vcpu.updateBeforeMarket ();
+		}
+
+		vm-> getCPUController ().updateBeforeMarket ();
+	    }
+
+	    auto start = std::chrono::steady_clock::now ();
+	    market.run ();
+	    auto end = std::chrono::steady_clock::now ();
+	    times.push_back (std::chrono::duration <double, std::micro> (end - start).count ());
+
+	    for (auto & vm : vms) {
+		outcome.push_back (accounting.balance (vm-> id (), resource::CPU));
+		for (auto & vcpu : vm-> getVCPUControllers ()) {
+		    outcome.push_back (vcpu.allocated ());
+		    outcome.push_back (vcpu.getQuota ());
+		}
+	    }
+	}
+
+	for (auto & vm : vms) client.detach (vm-> id ());
+	return times;
+    }
+
+    void MarketBench::print (const json & result, std::ostream & out) {
+	out << std::fixed << std::setprecision (3);
+	out << "host   : " << result ["vcpus"].get<unsigned long> () << " vcpus, " << result ["cpus"].get<int> () << " cpus, "
+	    << result ["ticks"].get<unsigned long> () << " market ticks, on " << result ["cores"].get<int> () << " cores" << std::endl;
+	for (auto & r : result ["runs"]) {
+	    out << "market : " << r ["threads"].get<unsigned int> () << " threads, " << r ["mean-us"].get<double> () << " us (p99 " << r ["p99-us"].get<double> ()
+		<< "), speedup " << r ["speedup"].get<double> () << ", " << (r ["identical"].get<bool> () ? "identical to" : "DIFFERENT from") << " the serial market" << std::endl;
+	}
+    }
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <iostream>
+#include <server/market/vcpu.hh>
+#include <nlohmann/json.hpp>
+
+namespace sim {
+
+    /**
+     * A benchmark of the sharded VCPUMarket (cf. VCPUMarketConfig::threads), on an offline host
+     * The same host (same VMs, same consumptions at each tick) is run with 1, 2, 4 ... threads, the cpu time of each market tick is measured,
+     * and the allocations, the quotas and the money of the VMs are compared to the ones of the serial market
+     */
+    class MarketBench {
+
+	/// The configuration of the market
+	server::market::VCPUMarketConfig _config;
+
+	/// The number of vcpus of the host
+	unsigned long _vcpus;
+
+	/// The number of vcpus of each VM
+	int _vcpusPerVM;
+
+	/// The number of market ticks of each run
+	unsigned long _ticks;
+
+    public:
+
+	/**
+	 * @params:
+	 *   - cfg: the configuration of the market
+	 *   - nbCpus: the number of cpus of the host
+	 *   - vcpus: the number of vcpus of the host
+	 *   - vcpusPerVM: the number of vcpus of each VM
+	 *   - ticks: the number of market ticks of each run
+	 */
+	MarketBench (const server::market::VCPUMarketConfig & cfg, int nbCpus, unsigned long vcpus, int vcpusPerVM, unsigned long ticks);
+
+	/**
+	 * Run the market with 1 thread, then twice as many threads until maxThreads
+	 * @returns: the cpu time of the market for each number of threads, its speedup, and whether its outcome is identical to the serial one
+	 */
+	nlohmann::json run (unsigned int maxThreads);
+
+	/**
+	 * Print the result of a benchmark
+	 */
+	static void print (const nlohmann::json & result, std::ostream & out);
+
+    private:
+
+	/**
+	 * Run the market with a number of threads
+	 * @params:
+	 *   - threads: the number of threads of the market
+	 *   - outcome: the list to which the money, the allocations and the quotas of the VMs at each tick are appended
+	 * @returns: the cpu time of each market tick in microseconds
+	 */
+	std::vector <double> runWith (unsigned int threads, std::vector <unsigned long> & outcome);
+
+    };
+
+}
@@ -0,0 +1,236 @@
+#include "check.hh"
+#include "host.hh"
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <server/market/accounting.hh>
+#include <server/market/cpu.hh>
+#include <server/market/waterfill.hh>
+
+using namespace monitor::libvirt;
+using namespace server::market;
+using json = nlohmann::json;
+
+namespace sim {
+
+    /// The properties checked, in the order they are printed
+    const std::vector <std::string> PROPERTIES = {"bounded", "supply", "conserving", "fair", "market-supply", "market-idle", "parallel"};
+
+    /// The allocations may exceed the cpus sold by the rounding of the supply, in microseconds
+    const unsigned long ROUNDING = 16;
+
+    PropertyCheck::PropertyCheck (const VCPUMarketConfig & cfg, unsigned long seed) :
+	_config (cfg),
+	_random (seed)
+    {
+	this-> _failures ["seed"] = seed;
+	for (auto & p : PROPERTIES) this-> _failures [p] = {{"failures", 0}};
+    }
+
+    json PropertyCheck::run (unsigned long instances) {
+	for (unsigned long i = 0 ; i < instances ; i++) {
+	    this-> checkWaterfill ();
+	    this-> checkMarket (i);
+	}
+
+	this-> _failures ["instances"] = instances;
+	return this-> _failures;
+    }
+
+    void PropertyCheck::checkWaterfill () {
+	std::uniform_int_distribution <std::size_t> size (0, 32);
+	std::uniform_int_distribution <int> kind (0, 4);
+	std::uniform_int_distribution <unsigned long> demand (0, 1000000);
+	std::uniform_int_distribution <unsigned long> huge (1000000, 1000000000000UL);
+
+	// The demands are mixed with zeros and huge values, that are the edge cases of the sort
+	std::vector <unsigned long> wanted (size (this-> _random));
+	for (auto & w : wanted) {
+	    auto k = kind (this-> _random);
+	    w = k == 0 ? 0 : (k == 1 ? huge (this-> _random) : demand (this-> _random));
+	}
+
+	auto all = std::accumulate (wanted.begin (), wanted.end (), 0UL);
+	std::uniform_int_distribution <unsigned long> cap (0, std::min (all, 100000000000UL) * 2);
+	auto capacity = kind (this-> _random) == 0 ? all : cap (this-> _random);
+
+	auto given = waterfill (wanted, capacity);
+	auto sum = std::accumulate (given.begin (), given.end (), 0UL);
+	auto highest = given.empty () ? 0UL : *std::max_element (given.begin (), given.end ());
+	json instance = {{"wanted", wanted}, {"capacity", capacity}, {"given", given}};
+
+	bool bounded = given.size () == wanted.size (), fair = true;
+	for (std::size_t i = 0 ; i < given.size () && bounded ; i++) {
+	    if (given [i] > wanted [i]) bounded = false;
+
+	    // An unsatisfied consumer gets as much as any other one (with the rounding of the shares)
+	    if (given [i] < wanted [i] && given [i] + 1 < highest) fair = false;
+	}
+
+	if (!bounded) this-> fail ("bounded", instance);
+	if (!fair) this-> fail ("fair", instance);
+	if (sum > capacity) this-> fail ("supply", instance);
+
+	// The capacity is shared until the demand is satisfied, less the rounding of the shares
+	if (all <= capacity ? sum != all : capacity - std::min (sum, capacity) >= std::max ((std::size_t) 1, given.size ())) {
+	    this-> fail ("conserving", instance);
+	}
+    }
+
+    void PropertyCheck::checkMarket (unsigned long instance) {
+	std::uniform_int_distribution <int> cpus (1, 16);
+	std::uniform_int_distribution <int> vcpus (1, 4);
+	std::uniform_int_distribution <int> idle (0, 2);
+	std::uniform_int_distribution <unsigned long> demand (0, 1000000);
+	std::uniform_real_distribution <float> supply (0.2f, 1.0f);
+
+	host h;
+	h.config = this-> _config;
+	h.config.nbCpus = cpus (this-> _random);
+	h.config.vmLevel = (instance % 2 == 1);
+	h.config.spareHeadroom = (instance % 4 >= 2);
+	h.supply = supply (this-> _random);
+
+	// The frequencies are low enough for the guarantees of the VMs to fit in the host, so the market is never over allocated
+	std::uniform_int_distribution <int> frequency (std::max (1, h.config.cpuFreq / 10), std::max (1, h.config.cpuFreq / 4));
+	for (int total = 0 ; total < h.config.nbCpus * 4 ; ) {
+	    auto n = std::min (vcpus (this-> _random), h.config.nbCpus * 4 - total);
+	    h.frequencies.push_back (frequency (this-> _random));
+
+	    std::vector <bool> v;
+	    for (int i = 0 ; i < n ; i++) v.push_back (idle (this-> _random) == 0);
+	    h.idles.push_back (v);
+	    total += n;
+	}
+
+	for (int tick = 0 ; tick < 4 ; tick++) {
+	    std::vector <unsigned long> d;
+	    for (auto & vm : h.idles) {
+		for (bool isIdle : vm) {
+		    auto consumption = demand (this-> _random);
+		    d.push_back (isIdle ? 0 : consumption);
+		}
+	    }
+
+	    h.demands.push_back (d);
+	}
+
+	std::vector <unsigned long> serial;
+	this-> simulate (h, serial, true);
+
+	// The sharded market gives the same allocations, and leaves the same money to the VMs as the serial one
+	if (!h.config.vmLevel) {
+	    std::vector <unsigned long> sharded;
+	    h.config.threads = 2 + instance % 3;
+	    this-> simulate (h, sharded, false);
+	    if (sharded != serial) this-> fail ("parallel", h.dump ());
+	}
+    }
+
+    void PropertyCheck::simulate (const host & h, std::vector <unsigned long> & outcome, bool check) {
+	auto & cfg = h.config;
+	unsigned long capacity = ((unsigned long) cfg.nbCpus) * 1000000;
+
+	auto client = LibvirtClient::offline ();
+	Accounting accounting;
+	VCPUMarket vcpuMarket (client, accounting, cfg);
+	CpuMarket cpuMarket (client, accounting, cfg);
+	vcpuMarket.setSupply (h.supply);
+	cpuMarket.setSupply (h.supply);
+
+	std::vector <std::unique_ptr <LibvirtVM> > vms;
+	for (std::size_t i = 0 ; i < h.idles.size () ; i++) {
+	    vms.push_back (std::make_unique <LibvirtVM> (vmSpec ("check-" + std::to_string (i), h.idles [i].size (), 2048, h.frequencies [i], 0.5f)));
+	    client.attach (vms.back ().get ());
+	    vms.back ()-> getCPUController ().enable ();
+	}
+
+	for (std::size_t tick = 0 ; tick < h.demands.size () ; tick++) {
+	    std::size_t d = 0;
+	    for (auto & vm : vms) {
+		for (auto & vcpu : vm-> getVCPUControllers ()) {
+		    vcpu.feed (h.demands [tick][d++], 1.0f, cfg.cpuFreq * 1000);
+		    vcpu.updateBeforeMarket ();
+		}
+
+		vm-> getCPUController ().updateBeforeMarket ();
+	    }
+
+	    if (cfg.vmLevel) cpuMarket.run ();
+	    else vcpuMarket.run ();
+
+	    // The guarantees are always sold, the supply only limits the cycles sold above them
+	    unsigned long allocated = 0, guarantees = 0;
+	    bool idleServed = false;
+	    for (std::size_t i = 0 ; i < vms.size () ; i++) {
+		auto & cpu = vms [i]-> getCPUController ();
+		outcome.push_back (accounting.balance (vms [i]-> id (), resource::CPU));
+		if (cfg.vmLevel) {
+		    outcome.push_back (cpu.allocated ());
+		    allocated += cpu.allocated ();
+		    guarantees += std::max (cpu.getMaxConsumption () / 100, cpu.getNominal (cfg.cpuFreq));
+		    bool isIdle = std::all_of (h.idles [i].begin (), h.idles [i].end (), [] (bool b) { return b; });
+		    if (isIdle && cpu.allocated () > cpu.getMaxConsumption () / 50) idleServed = true;
+		    continue;
+		}
+
+		auto & controllers = vms [i]-> getVCPUControllers ();
+		for (std::size_t v = 0 ; v < controllers.size () ; v++) {
+		    outcome.push_back (controllers [v].allocated ());
+		    outcome.push_back (controllers [v].getQuota ());
+		    allocated += controllers [v].allocated ();
+		    guarantees += std::max (10000UL, (unsigned long) (((float) controllers [v].getNominalFreq ()) / ((float) cfg.cpuFreq) * 1000000));
+		    if (h.idles [i][v] && controllers [v].allocated () > 1000000 / 50) idleServed = true;
+		}
+	    }
+
+	    if (!check) continue;
+
+	    auto bound = std::max ((unsigned long) (capacity * h.supply), guarantees);
+	    bool over = allocated > bound + ROUNDING;
+	    if (!over && !idleServed) continue;
+
+	    auto j = h.dump ();
+	    j ["tick"] = tick;
+	    j ["allocated"] = allocated;
+	    if (over) this-> fail ("market-supply", j);
+	    if (idleServed) this-> fail ("market-idle", j);
+	}
+
+	for (auto & vm : vms) client.detach (vm-> id ());
+    }
+
+    json PropertyCheck::host::dump () const {
+	json vms = json::array ();
+	for (std::size_t i = 0 ; i < this-> idles.size () ; i++) {
+	    vms.push_back ({{"vcpus", this-> idles [i].size ()}, {"frequency", this-> frequencies [i]}, {"idle", this-> idles [i]}});
+	}
+
+	return {{"cpus", this-> config.nbCpus}, {"mode", this-> config.vmLevel ? "vm" : "vcpu"}, {"threads", this-> config.threads},
+		{"spare-headroom", this-> config.spareHeadroom}, {"supply", this-> supply}, {"vms", vms}, {"demands", this-> demands}};
+    }
+
+    void PropertyCheck::fail (const std::string & property, const json & instance) {
+	auto & p = this-> _failures [property];
+	if (p ["failures"].get<unsigned long> () == 0) p ["counterexample"] = instance;
+	p ["failures"] = p ["failures"].get<unsigned long> () + 1;
+    }
+
+    bool PropertyCheck::passed (const json & result) {
+	for (auto & p : PROPERTIES) {
+	    if (result [p]["failures"].get<unsigned long> () != 0) return false;
+	}
+
+	return true;
+    }
+
+    void PropertyCheck::print (const json & result, std::ostream & out) {
+	out << "check  : " << result ["instances"].get<unsigned long> () << " instances of each check (seed " << result ["seed"].get<unsigned long> () << ")" << std::endl;
+	for (auto & p : PROPERTIES) {
+	    auto failures = result [p]["failures"].get<unsigned long> ();
+	    out << "         " << p << " : " << (failures == 0 ? std::string ("ok") : std::to_string (failures) + " failures") << std::endl;
+	    if (failures != 0) out << "         " << result [p]["counterexample"].dump () << std::endl;
+	}
+    }
+
+}
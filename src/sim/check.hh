@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <random>
+#include <iostream>
+#include <server/market/vcpu.hh>
+#include <nlohmann/json.hpp>
+
+namespace sim {
+
+    /**
+     * Property checks of the redistribution of the cpu markets, on random instances
+     *  - waterfill: the max-min sharing (cf. server::market::waterfill) never gives more than wanted, nor more than the capacity,
+     *               leaves less than one unit per consumer of the capacity when the demand exceeds it, and no unsatisfied consumer gets less than another one
+     *  - market: the allocations of the VCPUMarket and the CpuMarket never exceed the cpus sold (or the guarantees of the VMs when they are larger),
+     *            and the idle vcpus (or VMs) get no cycles above their base allocation
+     *  - parallel: the VCPUMarket sharded on several threads gives the same allocations, and leaves the same money to the VMs as the serial one
+     * The first instance failing each property is kept in the result, so it can be replayed
+     */
+    class PropertyCheck {
+
+	/**
+	 * A random host on which the markets are checked
+	 */
+	struct host {
+	    /// The configuration of the markets (with the number of cpus, and the mode)
+	    server::market::VCPUMarketConfig config;
+
+	    /// The share of the cpus sold by the markets
+	    float supply;
+
+	    /// The frequency of each VM
+	    std::vector <int> frequencies;
+
+	    /// For each vcpu of each VM, true iif it never consumes
+	    std::vector <std::vector <bool> > idles;
+
+	    /// The consumption of all the vcpus at each tick
+	    std::vector <std::vector <unsigned long> > demands;
+
+	    /**
+	     * @returns: the host in json (the counterexample of a property)
+	     */
+	    nlohmann::json dump () const;
+	};
+
+	/// The configuration of the markets
+	server::market::VCPUMarketConfig _config;
+
+	/// The generator of the instances (seeded, so a failure can be reproduced)
+	std::mt19937 _random;
+
+	/// The number of failures of each property, and the first instance failing it
+	nlohmann::json _failures;
+
+    public:
+
+	/**
+	 * @params:
+	 *   - cfg: the configuration of the markets
+	 *   - seed: the seed of the generator of the instances
+	 */
+	PropertyCheck (const server::market::VCPUMarketConfig & cfg, unsigned long seed);
+
+	/**
+	 * Check the properties on random instances
+	 * @params:
+	 *   - instances: the number of instances of each check
+	 * @returns: the number of failures of each property, and their first counterexample
+	 */
+	nlohmann::json run (unsigned long instances);
+
+	/**
+	 * @returns: true iif no property failed in a result of run
+	 */
+	static bool passed (const nlohmann::json & result);
+
+	/**
+	 * Print the result of a check
+	 */
+	static void print (const nlohmann::json & result, std::ostream & out);
+
+    private:
+
+	/**
+	 * Check the max-min sharing on one random instance
+	 */
+	void checkWaterfill ();
+
+	/**
+	 * Check the allocations of both markets on one random host, for a few ticks
+	 */
+	void checkMarket (unsigned long instance);
+
+	/**
+	 * Run the market of a host
+	 * @params:
+	 *   - h: the host
+	 *   - outcome: the list to which the money and the allocations of the VMs at each tick are appended
+	 *   - check: true to check the allocations against the cpus sold, and the idle vcpus
+	 */
+	void simulate (const host & h, std::vector <unsigned long> & outcome, bool check);
+
+	/**
+	 * Count a failure of a property
+	 * @params:
+	 *   - property: the name of the property
+	 *   - instance: the instance failing it
+	 */
+	void fail (const std::string & property, const nlohmann::json & instance);
+
+    };
+
+}
@@ -0,0 +1,422 @@
+#include "cluster.hh"
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <monitor/libvirt/proto.hh>
+#include <monitor/utils/toml.hh>
+
+using namespace monitor;
+using namespace monitor::libvirt;
+using namespace server::market;
+using namespace server::cluster;
+using json = nlohmann::json;
+
+namespace sim {
+
+    ClusterTest::node::node (const VCPUMarketConfig & cfg) :
+	client (LibvirtClient::offline ()),
+	backend (nullptr),
+	market (client, accounting, cfg),
+	listener (net::SockAddrV4 (net::Ipv4Address (127, 0, 0, 1), 0))
+    {}
+
+    ClusterTest::ClusterTest (const VCPUMarketConfig & cfg, unsigned int nbHosts, int nbCpus) :
+	_config (cfg)
+    {
+	this-> _config.nbCpus = nbCpus;
+	this-> _config.vmLevel = false;
+	for (unsigned int i = 0 ; i < nbHosts ; i++) {
+	    auto n = std::make_unique <node> (this-> _config);
+	    auto backend = std::make_unique <control::FakeBackend> (nbCpus, this-> _config.cpuFreq * 1000);
+	    n-> backend = backend.get ();
+	    n-> client.setBackend (std::move (backend));
+
+	    n-> listener.start ();
+	    n-> th = concurrency::spawn (this, &ClusterTest::serve, n.get ());
+	    this-> _nodes.push_back (std::move (n));
+	}
+    }
+
+    ClusterTest::~ClusterTest () {
+	for (auto & n : this-> _nodes) {
+	    concurrency::kill (n-> th);
+	    concurrency::join (n-> th);
+	    n-> listener.close ();
+	    for (auto & vm : n-> vms) n-> client.detach (vm-> id ());
+	}
+    }
+
+    void ClusterTest::add (unsigned int host, const monitor::utils::config::dict & spec, double demand) {
+	this-> start (*this-> _nodes [host], spec, demand);
+    }
+
+    void ClusterTest::start (node & n, const monitor::utils::config::dict & spec, double demand) {
+	auto vm = std::make_unique <LibvirtVM> (spec);
+	n.backend-> addVM (vm-> id (), vm-> vcpus ());
+	n.client.attach (vm.get ());
+	for (auto & vt : vm-> getVCPUControllers ()) {
+	    vt.enable ();
+	}
+
+	vm-> getCPUController ().enable ();
+	this-> _demands [vm-> id ()] = demand;
+	n.vms.push_back (std::move (vm));
+    }
+
+    json ClusterTest::run (unsigned long rounds, unsigned long ticks, const ClusterConfig & cfg) {
+	std::vector <std::string> addrs;
+	for (auto & n : this-> _nodes) addrs.push_back ("127.0.0.1:" + std::to_string (n-> listener.port ()));
+
+	Coordinator coordinator (addrs, 0);
+	coordinator.setConfig (cfg);
+
+	json result = json::array ();
+	for (unsigned long r = 0 ; r < rounds ; r++) {
+	    for (unsigned long t = 0 ; t < ticks ; t++) {
+		for (auto & n : this-> _nodes) this-> tick (*n);
+	    }
+
+	    // The cpu time missing on the daemons, before the migrations
+	    unsigned long pressure = 0, capacity = 0;
+	    for (auto & n : this-> _nodes) {
+		n-> m.lock ();
+		pressure += n-> summary.pressure ();
+		capacity += n-> summary.capacity;
+		n-> m.unlock ();
+	    }
+
+	    auto plan = coordinator.run ();
+
+	    auto before = this-> money ();
+	    unsigned long moved = 0, transferred = 0;
+	    for (auto & m : plan.migrations) moved += this-> migrate (m);
+	    for (auto & t : plan.transfers) transferred += t.amount;
+
+	    json j = plan.dump ();
+	    j ["round"] = r;
+	    j ["pressure"] = capacity != 0 ? ((double) pressure) / ((double) capacity) : 0.0;
+	    j ["conserved"] = (before == this-> money () && moved == transferred);
+	    result.push_back (j);
+	}
+
+	return {
+	    {"hosts", this-> _nodes.size ()},
+	    {"cpus", this-> _config.nbCpus},
+	    {"min-pressure", cfg.minPressure},
+	    {"rounds", result},
+	    {"final", this-> final (ticks)}
+	};
+    }
+
+    json ClusterTest::orchestrate (unsigned long rounds, unsigned long ticks, MigrationConfig cfg) {
+	// One market tick per second
+	cfg.period = ticks;
+
+	std::vector <std::string> addrs;
+	for (auto & n : this-> _nodes) addrs.push_back ("127.0.0.1:" + std::to_string (n-> listener.port ()));
+
+	std::vector <std::unique_ptr <MockMigrator> > migrators;
+	std::vector <std::unique_ptr <MigrationOrchestrator> > orchestrators;
+	for (std::size_t i = 0 ; i < this-> _nodes.size () ; i++) {
+	    auto hostCfg = cfg;
+	    hostCfg.peers.clear ();
+	    for (std::size_t j = 0 ; j < addrs.size () ; j++) {
+		if (j != i) hostCfg.peers.push_back (addrs [j]);
+	    }
+
+	    migrators.push_back (std::make_unique <MockMigrator> (*this, *this-> _nodes [i]));
+	    orchestrators.push_back (std::make_unique <MigrationOrchestrator> (this-> _nodes [i]-> client, this-> _nodes [i]-> accounting, *migrators.back ()));
+	    orchestrators.back ()-> setConfig (hostCfg);
+	}
+
+	json result = json::array ();
+	for (unsigned long r = 0 ; r < rounds ; r++) {
+	    // The orchestrators see the mean of the ticks of the round, as the daemons
+	    std::vector <std::vector <HostSummary> > period (this-> _nodes.size ());
+	    for (unsigned long t = 0 ; t < ticks ; t++) {
+		for (std::size_t i = 0 ; i < this-> _nodes.size () ; i++) {
+		    this-> tick (*this-> _nodes [i]);
+		    period [i].push_back (this-> _nodes [i]-> summary); // the ticks run on this thread
+		}
+	    }
+
+	    unsigned long pressure = 0, capacity = 0;
+	    auto before = this-> money ();
+	    json decisions = json::array (), unreached = json::array ();
+	    unsigned long migrations = 0, failed = 0, notAdopted = 0;
+	    for (std::size_t i = 0 ; i < this-> _nodes.size () ; i++) {
+		auto summary = HostSummary::mean (period [i]);
+		pressure += summary.pressure ();
+		capacity += summary.capacity;
+
+		// The adoptions are answered by the daemons of the peers while the orchestrator waits
+		auto decision = orchestrators [i]-> run (summary);
+		if (decision.migrated) migrations += 1;
+		if (decision.reason == "failed") failed += 1;
+		if (decision.reason == "not-adopted") notAdopted += 1;
+		for (auto & u : decision.unreached) unreached.push_back (u);
+
+		json d = decision.dump ();
+		d ["host"] = addrs [i];
+		decisions.push_back (d);
+	    }
+
+	    result.push_back ({
+		{"round", r},
+		{"pressure", capacity != 0 ? ((double) pressure) / ((double) capacity) : 0.0},
+		{"decisions", decisions},
+		{"migrations", migrations},
+		{"failed", failed},
+		{"not-adopted", notAdopted},
+		{"unreached", unreached},
+		{"conserved", before == this-> money ()}
+	    });
+	}
+
+	double copy = 0.0;
+	for (auto & m : migrators) copy += m-> getCopyTime ();
+
+	return {
+	    {"hosts", this-> _nodes.size ()},
+	    {"cpus", this-> _config.nbCpus},
+	    {"min-pressure", cfg.minPressure},
+	    {"rounds", result},
+	    {"copy-time", copy},
+	    {"final", this-> final (ticks)}
+	};
+    }
+
+    json ClusterTest::final (unsigned long ticks) {
+	// The state of the cluster after the last migrations
+	unsigned long pressure = 0, capacity = 0;
+	for (unsigned long t = 0 ; t < ticks ; t++) {
+	    for (auto & n : this-> _nodes) this-> tick (*n);
+	}
+
+	json hosts = json::array ();
+	for (auto & n : this-> _nodes) {
+	    // The demand of the vcpus the quotas will refuse at the next tick (known by the test, not by the market)
+	    unsigned long refused = 0;
+	    for (auto & vm : n-> vms) {
+		auto demand = this-> _demands [vm-> id ()];
+		for (std::size_t i = 0 ; i < vm-> getVCPUControllers ().size () ; i++) {
+		    auto limit = n-> backend-> getLimit (vm-> id (), i);
+		    double cap = limit < 0 ? 1.0 : ((double) limit) / 100000.0;
+		    if (demand > cap) refused += (unsigned long) ((demand - cap) * 1000000);
+		}
+	    }
+
+	    n-> m.lock ();
+	    pressure += n-> summary.pressure ();
+	    capacity += n-> summary.capacity;
+	    hosts.push_back ({
+		    {"host", "127.0.0.1:" + std::to_string (n-> listener.port ())},
+		    {"vms", n-> vms.size ()},
+		    {"unmet", n-> summary.unmet ()},
+		    {"refused", refused},
+		    {"excess", n-> summary.excess},
+		    {"slack", n-> summary.slack ()}
+		});
+	    n-> m.unlock ();
+	}
+
+	return {{"pressure", capacity != 0 ? ((double) pressure) / ((double) capacity) : 0.0}, {"hosts", hosts}};
+    }
+
+    void ClusterTest::tick (node & n) {
+	for (auto & vm : n.vms) {
+	    auto demand = this-> _demands [vm-> id ()];
+	    auto & vcpus = vm-> getVCPUControllers ();
+	    for (std::size_t i = 0 ; i < vcpus.size () ; i++) {
+		// The vcpu consumes its demand, bounded by the quota written at the previous tick
+		auto limit = n.backend-> getLimit (vm-> id (), i);
+		double cap = limit < 0 ? 1.0 : ((double) limit) / 100000.0;
+		vcpus [i].feed ((unsigned long) (std::min (demand, cap) * 1000000), 1.0f, this-> _config.cpuFreq * 1000);
+		vcpus [i].updateBeforeMarket ();
+	    }
+
+	    vm-> getCPUController ().updateBeforeMarket ();
+	}
+
+	n.market.run ();
+	auto summary = HostSummary::collect (n.client, n.accounting, this-> _config, n.market.getSupply ());
+	summary.excess = n.market.getExcess ();
+
+	n.m.lock ();
+	n.summary = std::move (summary);
+	n.m.unlock ();
+    }
+
+    void ClusterTest::serve (concurrency::thread, node * n) {
+	for (;;) {
+	    auto client = n-> listener.accept ();
+	    if (!client.isOpen ()) continue;
+
+	    auto req = client.receiveInt ();
+	    if (req == VMProtocol::SUMMARY) {
+		n-> m.lock ();
+		auto summary = n-> summary;
+		n-> m.unlock ();
+
+		summary.send (client);
+	    } else if (req == VMProtocol::ADOPT) {
+		// The orchestrator of the source waits for the answer, the hosts are not ticking
+		auto len = client.receiveInt ();
+		auto handover = VMHandover::parse (json::parse (client.receive (len)));
+		auto spec = utils::toml::parse (handover.spec);
+		auto name = spec.get<utils::config::dict> ("vm").get<std::string> ("name");
+
+		if (n-> client.hasVM (name)) {
+		    client.sendInt (VMProtocol::ERR);
+		    client.sendInt (VMProtocolError::ALREADY_EXISTS);
+		} else {
+		    this-> start (*n, spec, this-> _demands [name]);
+		    n-> accounting.credit (name, resource::CPU, handover.money, 0);
+		    client.sendInt (VMProtocol::OK);
+		}
+	    } else {
+		client.sendInt (VMProtocol::ERR);
+		client.sendInt (VMProtocolError::PROTOCOL);
+	    }
+
+	    client.close ();
+	}
+    }
+
+    unsigned long ClusterTest::migrate (const MigrationHint & hint) {
+	auto from = this-> find (hint.from), to = this-> find (hint.to);
+	if (from == nullptr || to == nullptr) return 0;
+
+	auto it = std::find_if (from-> vms.begin (), from-> vms.end (), [&hint] (const std::unique_ptr <LibvirtVM> & vm) { return vm-> id () == hint.vm; });
+	if (it == from-> vms.end ()) return 0;
+
+	// The money leaves the accounting of the source, it is forgotten when the VM is pruned at the next tick
+	auto money = from-> accounting.balance (hint.vm, resource::CPU);
+	from-> accounting.debit (hint.vm, resource::CPU, money);
+
+	// The VM is started again on the destination with the same specification (its history is lost, as after a restart of the daemon)
+	auto spec = (*it)-> spec ();
+	from-> client.detach (hint.vm);
+	from-> backend-> removeVM (hint.vm);
+	from-> vms.erase (it);
+
+	this-> start (*to, spec, this-> _demands [hint.vm]);
+	to-> accounting.credit (hint.vm, resource::CPU, money, 0);
+	return money;
+    }
+
+    ClusterTest::MockMigrator::MockMigrator (ClusterTest & test, node & source) :
+	_test (test),
+	_source (source)
+    {}
+
+    bool ClusterTest::MockMigrator::migrate (const std::string & vm, const std::string & peer, unsigned long bandwidth) {
+	auto to = this-> _test.find (peer);
+	if (to == nullptr || to == &this-> _source) return false;
+
+	auto it = std::find_if (this-> _source.vms.begin (), this-> _source.vms.end (), [&vm] (const std::unique_ptr <LibvirtVM> & v) { return v-> id () == vm; });
+	if (it == this-> _source.vms.end ()) return false;
+
+	this-> _copyTime += ((double) (*it)-> memory ()) / ((double) bandwidth);
+	this-> _source.client.detach (vm);
+	this-> _source.backend-> removeVM (vm);
+	this-> _source.vms.erase (it);
+	return true;
+    }
+
+    double ClusterTest::MockMigrator::getCopyTime () const {
+	return this-> _copyTime;
+    }
+
+    ClusterTest::node * ClusterTest::find (const std::string & addr) {
+	for (auto & n : this-> _nodes) {
+	    if (addr == "127.0.0.1:" + std::to_string (n-> listener.port ())) return n.get ();
+	}
+
+	return nullptr;
+    }
+
+    unsigned long ClusterTest::money () {
+	unsigned long total = 0;
+	for (auto & n : this-> _nodes) {
+	    for (auto & vm : n-> vms) total += n-> accounting.balance (vm-> id (), resource::CPU);
+	}
+
+	return total;
+    }
+
+    bool ClusterTest::passed (const json & result) {
+	// The hosts some VMs were moved away from
+	std::set <std::string> relieved;
+	for (auto & r : result ["rounds"]) {
+	    if (!r ["unreached"].empty () || !r ["conserved"].get<bool> ()) return false;
+	    if (r.contains ("failed") && r ["failed"].get<unsigned long> () != 0) return false;
+	    if (r.contains ("not-adopted") && r ["not-adopted"].get<unsigned long> () != 0) return false;
+	    if (r.contains ("decisions")) {
+		for (auto & d : r ["decisions"]) if (d ["migrated"].get<bool> ()) relieved.insert (d ["host"].get<std::string> ());
+	    } else {
+		for (auto & m : r ["migrations"]) relieved.insert (m ["from"].get<std::string> ());
+	    }
+	}
+
+	// A host still starved at the end (the demand its quotas refuse, not what its market reports) must have been relieved, unless the other hosts had no cycles to give
+	auto & hosts = result ["final"]["hosts"];
+	auto threshold = ((double) result ["cpus"].get<int> ()) * 1000000.0 * result ["min-pressure"].get<double> ();
+	unsigned long slack = 0;
+	for (auto & h : hosts) slack += h ["slack"].get<unsigned long> ();
+
+	for (auto & h : hosts) {
+	    auto pressure = h ["refused"].get<unsigned long> () + h ["excess"].get<unsigned long> ();
+	    auto left = slack - h ["slack"].get<unsigned long> ();
+	    if (pressure > 0 && pressure >= threshold && left >= threshold && relieved.count (h ["host"].get<std::string> ()) == 0) return false;
+	}
+
+	return true;
+    }
+
+    void ClusterTest::print (const json & result, std::ostream & out) {
+	out << std::fixed << std::setprecision (3);
+	out << "cluster : " << result ["hosts"].get<unsigned long> () << " hosts of " << result ["cpus"].get<int> () << " cpus" << std::endl;
+	for (auto & r : result ["rounds"]) {
+	    out << "round " << r ["round"].get<unsigned long> () << " : " << r ["pressure"].get<double> () * 100.0 << " % of the cpus missing, "
+		<< r ["migrations"].size () << " migrations, " << r ["transfers"].size () << " transfers, "
+		<< r ["unreached"].size () << " unreachable, money " << (r ["conserved"].get<bool> () ? "conserved" : "NOT CONSERVED") << std::endl;
+	    for (auto & m : r ["migrations"]) {
+		out << "         " << m ["vm"].get<std::string> () << " : " << m ["from"].get<std::string> () << " -> " << m ["to"].get<std::string> () << std::endl;
+	    }
+	}
+
+	printFinal (result ["final"], out);
+    }
+
+    void ClusterTest::printFinal (const json & final, std::ostream & out) {
+	out << "final   : " << final ["pressure"].get<double> () * 100.0 << " % of the cpus missing" << std::endl;
+	int i = 0;
+	for (auto & h : final ["hosts"]) {
+	    out << "host " << i++ << "  : " << h ["vms"].get<unsigned long> () << " vms, " << h ["unmet"].get<unsigned long> () << " us unmet (" << h ["refused"].get<unsigned long> () << " us refused), "
+		<< h ["excess"].get<unsigned long> () << " us guaranteed over the cpus, " << h ["slack"].get<unsigned long> () << " us left" << std::endl;
+	}
+    }
+
+    void ClusterTest::printOrchestrated (const json & result, std::ostream & out) {
+	out << std::fixed << std::setprecision (3);
+	out << "cluster : " << result ["hosts"].get<unsigned long> () << " hosts of " << result ["cpus"].get<int> () << " cpus" << std::endl;
+	for (auto & r : result ["rounds"]) {
+	    out << "round " << r ["round"].get<unsigned long> () << " : " << r ["pressure"].get<double> () * 100.0 << " % of the cpus missing, "
+		<< r ["migrations"].get<unsigned long> () << " migrations, " << r ["failed"].get<unsigned long> () << " failed, " << r ["not-adopted"].get<unsigned long> () << " not adopted, "
+		<< r ["unreached"].size () << " unreachable, money " << (r ["conserved"].get<bool> () ? "conserved" : "NOT CONSERVED") << std::endl;
+	    for (auto & d : r ["decisions"]) {
+		out << "         " << d ["host"].get<std::string> () << " : " << d ["reason"].get<std::string> () << " (streak " << d ["streak"].get<unsigned int> () << ")";
+		if (d.contains ("vm")) {
+		    out << ", " << d ["vm"].get<std::string> () << " -> " << d ["peer"].get<std::string> () << ", benefit " << d ["benefit"].get<double> ()
+			<< " cpu.s, cost " << d ["cost"].get<double> () << " cpu.s";
+		}
+		out << std::endl;
+	    }
+	}
+
+	out << "copy    : " << result ["copy-time"].get<double> () << " s of memory copy" << std::endl;
+	printFinal (result ["final"], out);
+    }
+
+}
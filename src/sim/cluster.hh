@@ -0,0 +1,207 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <iostream>
+#include <monitor/libvirt/_.hh>
+#include <monitor/libvirt/controller/fake_backend.hh>
+#include <monitor/net/_.hh>
+#include <monitor/concurrency/_.hh>
+#include <server/market/accounting.hh>
+#include <server/market/vcpu.hh>
+#include <server/cluster/coordinator.hh>
+#include <server/cluster/migration.hh>
+#include <nlohmann/json.hpp>
+
+namespace sim {
+
+    /**
+     * A test of the cluster coordinator, on several fake hosts in memory
+     * Each host runs a cpu market over a FakeBackend, and answers the summary requests of the coordinator on a loopback port, as a dio-monitor.
+     * The vcpus consume their demand bounded by the quota written on the fake host at the previous tick.
+     * After some market ticks, the coordinator collects the summaries over the network and clears the cluster, its migrations and money transfers are then applied on the fake hosts.
+     * The migration orchestrators of the hosts can be run instead of the coordinator, a mock migrator moves the VMs between the fake hosts, and the daemon of the destination adopts them.
+     */
+    class ClusterTest {
+
+	struct node;
+
+	/**
+	 * The mock of a live migration, moving a VM from a fake host to another
+	 * The VM leaves the source at once, it is started on the destination when the daemon of the destination adopts it
+	 */
+	class MockMigrator : public server::cluster::Migrator {
+
+	    /// The cluster of the fake hosts
+	    ClusterTest & _test;
+
+	    /// The host running the orchestrator
+	    node & _source;
+
+	    /// The time the copies of the memory would have taken in seconds
+	    double _copyTime = 0.0;
+
+	public:
+
+	    MockMigrator (ClusterTest & test, node & source);
+
+	    /**
+	     * @returns: false if the peer is not a fake host of the cluster
+	     */
+	    bool migrate (const std::string & vm, const std::string & peer, unsigned long bandwidth) override;
+
+	    /**
+	     * @returns: the time the copies of the memory would have taken in seconds
+	     */
+	    double getCopyTime () const;
+	};
+
+	/**
+	 * A fake host, and its daemon
+	 */
+	struct node {
+	    /// The client owning the running VMs, and the fake host
+	    monitor::libvirt::LibvirtClient client;
+
+	    /// The fake host (owned by the client)
+	    monitor::libvirt::control::FakeBackend * backend;
+
+	    /// The accounting of the money of the VMs
+	    server::market::Accounting accounting;
+
+	    /// The cpu market of the host
+	    server::market::VCPUMarket market;
+
+	    /// The listener answering the summary requests
+	    monitor::net::TcpListener listener;
+
+	    /// The thread answering the summary requests
+	    monitor::concurrency::thread th;
+
+	    /// The mutex protecting the summary
+	    monitor::concurrency::mutex m;
+
+	    /// The supply and demand of the last market tick
+	    server::cluster::HostSummary summary;
+
+	    /// The VMs running on the host
+	    std::vector <std::unique_ptr <monitor::libvirt::LibvirtVM> > vms;
+
+	    node (const server::market::VCPUMarketConfig & cfg);
+	};
+
+	/// The configuration of the markets
+	server::market::VCPUMarketConfig _config;
+
+	/// The hosts of the cluster
+	std::vector <std::unique_ptr <node> > _nodes;
+
+	/// The demand of the vcpus of each VM (share of a cpu)
+	std::map <std::string, double> _demands;
+
+    public:
+
+	/**
+	 * @params:
+	 *   - cfg: the configuration of the cpu market of the hosts
+	 *   - nbHosts: the number of hosts
+	 *   - nbCpus: the number of cpus of each host
+	 */
+	ClusterTest (const server::market::VCPUMarketConfig & cfg, unsigned int nbHosts, int nbCpus);
+
+	/**
+	 * Start a VM on a host
+	 * @params:
+	 *   - host: the index of the host
+	 *   - spec: the specification of the VM (as given to the dio-client)
+	 *   - demand: the share of a cpu wanted by each of its vcpus
+	 */
+	void add (unsigned int host, const monitor::utils::config::dict & spec, double demand);
+
+	/**
+	 * Run the cluster
+	 * @params:
+	 *   - rounds: the number of clearings of the coordinator
+	 *   - ticks: the number of market ticks of the hosts before each clearing
+	 *   - cfg: the configuration of the coordinator
+	 * @returns: the cpu time missing on the cluster (demand not bought, and guarantees over the cpus), the migrations, the transfers and the money of each round
+	 */
+	nlohmann::json run (unsigned long rounds, unsigned long ticks, const server::cluster::ClusterConfig & cfg);
+
+	/**
+	 * Run the migration orchestrators of the hosts (each one has the other hosts as peers)
+	 * @params:
+	 *   - rounds: the number of periods of the orchestrators
+	 *   - ticks: the number of market ticks of the hosts in each period (the period of cfg is replaced by it)
+	 *   - cfg: the configuration of the orchestrators
+	 * @returns: the pressure of the cluster, the decisions of the orchestrators and the money of each round
+	 */
+	nlohmann::json orchestrate (unsigned long rounds, unsigned long ticks, server::cluster::MigrationConfig cfg);
+
+	/**
+	 * @returns: true iif all the daemons answered, the money was conserved by the transfers, and no host is left starved without any VM moved away while the other hosts have cycles left
+	 */
+	static bool passed (const nlohmann::json & result);
+
+	/**
+	 * Print the result of a run
+	 */
+	static void print (const nlohmann::json & result, std::ostream & out);
+
+	/**
+	 * Print the result of a run of the orchestrators
+	 */
+	static void printOrchestrated (const nlohmann::json & result, std::ostream & out);
+
+	/**
+	 * Stop the daemons of the hosts
+	 */
+	~ClusterTest ();
+
+    private:
+
+	/**
+	 * Start a VM on a host, and enable its controllers
+	 */
+	void start (node & n, const monitor::utils::config::dict & spec, double demand);
+
+	/**
+	 * Run a market tick on a host, and update its summary
+	 */
+	void tick (node & n);
+
+	/**
+	 * Answer the summary requests of the coordinator, and the adoption requests of the orchestrators
+	 */
+	void serve (monitor::concurrency::thread, node * n);
+
+	/**
+	 * Move a VM to another host, with its cpu money
+	 * @returns: the money moved with the VM
+	 */
+	unsigned long migrate (const server::cluster::MigrationHint & hint);
+
+	/**
+	 * @returns: the host of a daemon address (nullptr if unknown)
+	 */
+	node * find (const std::string & addr);
+
+	/**
+	 * @returns: the cpu money of all the VMs of the cluster
+	 */
+	unsigned long money ();
+
+	/**
+	 * @returns: the state of the hosts after some market ticks
+	 */
+	nlohmann::json final (unsigned long ticks);
+
+	/**
+	 * Print the state of the hosts at the end of a run
+	 */
+	static void printFinal (const nlohmann::json & final, std::ostream & out);
+
+    };
+
+}
@@ -0,0 +1,169 @@
+#include "host.hh"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <monitor/utils/toml.hh>
+
+using namespace monitor::libvirt;
+using namespace server::market;
+
+namespace sim {
+
+    Host::Host (const VCPUMarketConfig & cfg, int nbCpus, float tolerance, bool enabled) :
+	_client (LibvirtClient::offline ()),
+	_config (cfg),
+	_vcpuMarket (_client, _accounting, cfg),
+	_cpuMarket (_client, _accounting, cfg),
+	_nbCpus (nbCpus),
+	_enabled (enabled),
+	_report (tolerance)
+    {
+	this-> _config.nbCpus = nbCpus;
+	this-> _vcpuMarket.setConfig (this-> _config);
+	this-> _cpuMarket.setConfig (this-> _config);
+    }
+
+    void Host::add (const std::string & group, const monitor::utils::config::dict & spec, Workload workload) {
+	simulated s {std::make_unique <LibvirtVM> (spec), std::move (workload), 0, false, {}, {}, {}, 0};
+	s.report = this-> _report.addVM (s.vm-> id (), group);
+	this-> _vms.push_back (std::move (s));
+    }
+
+    const Report & Host::run (unsigned long maxDuration) {
+	unsigned long t = 0;
+	for (; t < maxDuration ; t++) {
+	    bool finished = true;
+	    for (auto & s : this-> _vms) {
+		if (!s.workload.isFinished (t)) {
+		    finished = false;
+		    break;
+		}
+	    }
+
+	    if (finished) break;
+	    this-> tick (t);
+	}
+
+	for (auto & s : this-> _vms) {
+	    if (s.workload.isJob ()) this-> _report.job (s.report, s.workload.completion (), s.workload.idealCompletion ());
+	    if (s.attached) this-> _client.detach (s.vm-> id ());
+	}
+
+	this-> _report.duration (t);
+	return this-> _report;
+    }
+
+    void Host::tick (unsigned long t) {
+	std::vector <unsigned long> all;
+	for (auto & s : this-> _vms) {
+	    bool alive = s.workload.isAlive (t);
+	    if (alive && !s.attached) {
+		this-> _client.attach (s.vm.get ());
+		s.vm-> getCPUController ().enable ();
+	    } else if (!alive && s.attached) {
+		this-> _client.detach (s.vm-> id ());
+	    }
+
+	    s.attached = alive;
+	    if (!alive) continue;
+
+	    s.workload.demand (t, s.demand);
+	    this-> applyQuotas (s);
+	    all.insert (all.end (), s.wanted.begin (), s.wanted.end ());
+	}
+
+	// The scheduler of the host shares the cpus between all the vcpus that are runnable
+	auto given = waterfill (all, ((unsigned long) this-> _nbCpus) * 1000000);
+
+	std::size_t i = 0;
+	std::vector <double> satisfaction;
+	for (auto & s : this-> _vms) {
+	    if (!s.attached) continue;
+
+	    s.received.assign (given.begin () + i, given.begin () + i + s.wanted.size ());
+	    i += s.wanted.size ();
+
+	    auto & vcpus = s.vm-> getVCPUControllers ();
+	    for (std::size_t v = 0 ; v < vcpus.size () ; v++) {
+		vcpus [v].feed (s.received [v], 1.0f, this-> _config.cpuFreq * 1000);
+	    }
+
+	    s.workload.consume (t, s.received);
+
+	    auto demand = std::accumulate (s.demand.begin (), s.demand.end (), 0UL);
+	    auto received = std::accumulate (s.received.begin (), s.received.end (), 0UL);
+	    auto wanted = std::accumulate (s.wanted.begin (), s.wanted.end (), 0UL);
+	    auto nominal = s.vm-> getCPUController ().getNominal (this-> _config.cpuFreq);
+	    this-> _report.record (s.report, demand, received, nominal, s.workload.delay (), wanted, s.allowed);
+	    if (demand != 0) satisfaction.push_back ((double) received / (double) demand);
+	}
+
+	if (!satisfaction.empty ()) this-> _report.fairness (Report::jain (satisfaction));
+	this-> market ();
+    }
+
+    void Host::applyQuotas (simulated & s) {
+	auto & vcpus = s.vm-> getVCPUControllers ();
+	if (this-> _config.vmLevel) {
+	    // The guest scheduler shares the quota of the VM between its vcpus
+	    s.allowed = std::min (s.vm-> getCPUController ().getAbsoluteCapping (), ((unsigned long) vcpus.size ()) * 1000000);
+	    s.wanted = waterfill (s.demand, s.vm-> getCPUController ().getAbsoluteCapping ());
+	    return;
+	}
+
+	s.allowed = 0;
+	s.wanted.resize (s.demand.size ());
+	for (std::size_t v = 0 ; v < vcpus.size () ; v++) {
+	    unsigned long cap = 1000000;
+	    auto quota = vcpus [v].getQuota ();
+	    if (quota >= 0) {
+		// As in LibvirtVCPUController::setQuota, a quota above 85% is not applied on the cgroup
+		auto capping = (unsigned long) (((double) quota) * 1000000.0 / vcpus [v].getPeriod ());
+		if (capping < 850000) cap = capping;
+	    }
+
+	    s.allowed += cap;
+	    s.wanted [v] = std::min (s.demand [v], cap);
+	}
+    }
+
+    void Host::market () {
+	unsigned long entries = 0;
+	for (auto & s : this-> _vms) {
+	    if (!s.attached) continue;
+
+	    for (auto & vcpu : s.vm-> getVCPUControllers ()) {
+		vcpu.updateBeforeMarket ();
+	    }
+
+	    s.vm-> getCPUController ().updateBeforeMarket ();
+	    entries += this-> _config.vmLevel ? 1 : s.vm-> vcpus ();
+	}
+
+	if (!this-> _enabled) return;
+
+	auto start = std::chrono::steady_clock::now ();
+	if (this-> _config.vmLevel) {
+	    this-> _cpuMarket.run ();
+	} else {
+	    this-> _vcpuMarket.run ();
+	}
+	auto end = std::chrono::steady_clock::now ();
+
+	this-> _report.market (std::chrono::duration <double, std::micro> (end - start).count (), entries);
+    }
+
+    monitor::utils::config::dict vmSpec (const std::string & name, int vcpus, int memory, int frequency, float memorySLA) {
+	std::stringstream ss;
+	ss << "[vm]" << std::endl;
+	ss << "name = \"" << name << "\"" << std::endl;
+	ss << "image = \"\"" << std::endl;
+	ss << "vcpus = " << vcpus << std::endl;
+	ss << "memory = " << memory << std::endl;
+	ss << "frequency = " << frequency << std::endl;
+	ss << "memorySLA = " << memorySLA << std::endl;
+
+	return monitor::utils::toml::parse (ss.str ());
+    }
+
+}
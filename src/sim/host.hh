@@ -0,0 +1,134 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <monitor/libvirt/_.hh>
+#include <monitor/utils/config.hh>
+#include <server/market/accounting.hh>
+#include <server/market/vcpu.hh>
+#include <server/market/cpu.hh>
+#include <server/market/waterfill.hh>
+#include <sim/workload.hh>
+#include <sim/report.hh>
+
+namespace sim {
+
+    /**
+     * A simulated host, running the cpu markets of the monitor on VMs whose vcpus are fed by workloads
+     * The VMs have no domain, nor cgroups, the quotas computed by the markets are only recorded, and applied by the simulation :
+     *  - a vcpu consumes at most its demand, and its quota (or the quota of its VM in the VM level market)
+     *  - the cpus of the host are shared between the vcpus by max-min fairness (as the kernel scheduler would do)
+     * The simulation runs one tick per second, and the market at each tick, as the cpu loop of the controller
+     */
+    class Host {
+
+	/**
+	 * A VM of the simulation
+	 */
+	struct simulated {
+	    /// The VM, its controllers are used by the markets
+	    std::unique_ptr <monitor::libvirt::LibvirtVM> vm;
+
+	    /// The workload running in the VM
+	    Workload workload;
+
+	    /// The index of the VM in the report
+	    int report;
+
+	    /// True iif the VM is in the running VMs of the client
+	    bool attached;
+
+	    /// The demand of the vcpus in the current tick
+	    std::vector <unsigned long> demand;
+
+	    /// The cpu time the vcpus can consume (bounded by the quotas)
+	    std::vector <unsigned long> wanted;
+
+	    /// The cpu time received by the vcpus in the current tick
+	    std::vector <unsigned long> received;
+
+	    /// The cpu time allowed by the quotas in the current tick
+	    unsigned long allowed;
+	};
+
+	/// The offline client owning the running VMs
+	monitor::libvirt::LibvirtClient _client;
+
+	/// The accounting of the money of the VMs
+	server::market::Accounting _accounting;
+
+	/// The configuration of the markets
+	server::market::VCPUMarketConfig _config;
+
+	/// The vcpu level market
+	server::market::VCPUMarket _vcpuMarket;
+
+	/// The VM level market
+	server::market::CpuMarket _cpuMarket;
+
+	/// The number of cpus of the host
+	int _nbCpus;
+
+	/// False if the VMs are not capped (the markets are not executed)
+	bool _enabled;
+
+	/// The VMs of the simulation
+	std::vector <simulated> _vms;
+
+	/// The metrics of the simulation
+	Report _report;
+
+    public:
+
+	/**
+	 * @params:
+	 *   - cfg: the configuration of the cpu market
+	 *   - nbCpus: the number of cpus of the simulated host
+	 *   - tolerance: the share of the entitlement under which a VM is in violation of its SLA
+	 *   - enabled: false to simulate a host without market (the VMs are never capped)
+	 */
+	Host (const server::market::VCPUMarketConfig & cfg, int nbCpus, float tolerance, bool enabled = true);
+
+	/**
+	 * Add a VM to the simulation
+	 * @params:
+	 *   - group: the group of VMs of the VM (for the report)
+	 *   - spec: the specification of the VM (as given to the dio-client)
+	 *   - workload: the workload running in the VM
+	 */
+	void add (const std::string & group, const monitor::utils::config::dict & spec, Workload workload);
+
+	/**
+	 * Run the simulation until all the workloads are finished
+	 * @params:
+	 *   - maxDuration: the maximal duration of the simulation in seconds
+	 * @returns: the metrics of the simulation
+	 */
+	const Report & run (unsigned long maxDuration);
+
+    private:
+
+	/**
+	 * Simulate one second
+	 */
+	void tick (unsigned long t);
+
+	/**
+	 * Compute the cpu time the vcpus of a VM can consume with the current quotas
+	 */
+	void applyQuotas (simulated & s);
+
+	/**
+	 * Run the market (as the cpu loop of the controller)
+	 */
+	void market ();
+
+    };
+
+    /**
+     * @returns: the specification of a VM, as written in the vm files given to the dio-client
+     */
+    monitor::utils::config::dict vmSpec (const std::string & name, int vcpus, int memory, int frequency, float memorySLA);
+
+}
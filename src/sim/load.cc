@@ -0,0 +1,289 @@
+#include "load.hh"
+#include "report.hh"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <cmath>
+#include <numeric>
+
+using namespace monitor::libvirt;
+using namespace server::market;
+using json = nlohmann::json;
+
+namespace sim {
+
+    LoadTest::LoadTest (const VCPUMarketConfig & cfg, int nbCpus) :
+	_client (LibvirtClient::offline ()),
+	_backend (nullptr),
+	_config (cfg),
+	_vcpuMarket (_client, _accounting, cfg),
+	_cpuMarket (_client, _accounting, cfg),
+	_placement (_client),
+	_dvfs (_client),
+	_energy (_client),
+	_random (0)
+    {
+	auto backend = std::make_unique <control::FakeBackend> (nbCpus, cfg.cpuFreq * 1000);
+	this-> _backend = backend.get ();
+	this-> _client.setBackend (std::move (backend));
+    }
+
+    void LoadTest::add (const monitor::utils::config::dict & spec) {
+	auto vm = std::make_unique <LibvirtVM> (spec);
+	this-> _backend-> addVM (vm-> id (), vm-> vcpus ());
+	this-> _client.attach (vm.get ());
+
+	for (auto & vt : vm-> getVCPUControllers ()) {
+	    vt.enable ();
+	}
+
+	vm-> getCPUController ().enable ();
+	this-> _nbVcpus += vm-> vcpus ();
+	this-> _vms.push_back (std::move (vm));
+    }
+
+    void LoadTest::enablePlacement (unsigned int nbNodes, unsigned int llcsPerNode, const server::placement::NumaPlacementConfig & cfg) {
+	this-> _backend-> setTopology (nbNodes, llcsPerNode);
+	this-> _placement.setConfig (cfg);
+	this-> _placement.discover ();
+	this-> _placementEnabled = true;
+    }
+
+    void LoadTest::enableDvfs (const server::power::DvfsConfig & cfg) {
+	this-> _dvfs.setConfig (cfg);
+	this-> _dvfs.discover ();
+	this-> _dvfsEnabled = true;
+    }
+
+    void LoadTest::enablePowerCap (const server::power::PowerCapConfig & cfg) {
+	this-> _powerCap.setConfig (cfg);
+	this-> _powerCap.reset ();
+	this-> _powerCapEnabled = true;
+    }
+
+    json LoadTest::run (unsigned long ticks) {
+	std::vector <double> updates, markets, placements, dvfs, attributions, powers, supplies;
+	auto frequencyWrites = this-> _dvfs.nbWrites ();
+	double wanted, executed, energy;
+	this-> _backend-> readCycles (wanted, executed, energy);
+	auto moves = this-> _placement.nbMoves ();
+	std::uniform_int_distribution <std::size_t> pick (0, this-> _vms.size () - 1);
+	LibvirtVM * away = nullptr;
+	auto duration = [] (std::chrono::steady_clock::time_point start) {
+	    return std::chrono::duration <double, std::micro> (std::chrono::steady_clock::now () - start).count ();
+	};
+
+	// The energy of each VM, attributed by the cycles of their vcpus, and its exact value in the model of the fake host
+	std::map <std::string, double> vmEnergy;
+	for (auto & vm : this-> _vms) vmEnergy [vm-> id ()] = this-> _backend-> readEnergy (vm-> id ());
+	double misattributed = 0.0, attributed = 0.0;
+
+	// The power of the host in percentage of its power at full load, the energy of a cycle at the maximal frequency being 1
+	auto lastPower = std::chrono::steady_clock::now ();
+	double lastEnergy = energy;
+	double fullPower = ((double) this-> _backend-> nbCpus ()) * this-> _config.cpuFreq;
+
+	auto writes = this-> _backend-> nbWrites ();
+	for (unsigned long t = 0 ; t < ticks ; t++) {
+	    if (t % 10 == 0) this-> shuffle ();
+
+	    // A VM leaves, and comes back five ticks later
+	    if (this-> _placementEnabled && t % 10 == 5 && !this-> _vms.empty ()) {
+		away = this-> _vms [pick (this-> _random)].get ();
+		this-> _client.detach (away-> id ());
+	    } else if (away != nullptr && t % 10 == 0) {
+		this-> _client.attach (away);
+		away = nullptr;
+	    }
+
+	    // Two updates of the vcpus per market tick, as the cpu loop of the controller
+	    for (int i = 0 ; i < 2 ; i++) {
+		auto start = std::chrono::steady_clock::now ();
+		this-> _client.updateVCPUControllers ();
+		updates.push_back (duration (start));
+	    }
+
+	    if (this-> _placementEnabled) {
+		auto start = std::chrono::steady_clock::now ();
+		this-> _placement.run ();
+		placements.push_back (duration (start));
+	    }
+
+	    if (this-> _powerCapEnabled) {
+		double w, e, hostEnergy;
+		this-> _backend-> readCycles (w, e, hostEnergy);
+		auto now = std::chrono::steady_clock::now ();
+		auto elapsed = std::chrono::duration <double, std::micro> (now - lastPower).count ();
+		double power = elapsed > 0.0 ? (hostEnergy - lastEnergy) / elapsed / fullPower * 100.0 : 0.0;
+		lastPower = now;
+		lastEnergy = hostEnergy;
+
+		auto supply = this-> _powerCap.run (power);
+		this-> _vcpuMarket.setSupply (supply);
+		this-> _cpuMarket.setSupply (supply);
+		powers.push_back (power);
+		supplies.push_back (supply);
+	    }
+
+	    auto start = std::chrono::steady_clock::now ();
+	    this-> _client.updateVCPUBeforeMarket ();
+	    if (this-> _config.vmLevel) {
+		this-> _cpuMarket.run ();
+	    } else {
+		this-> _vcpuMarket.run ();
+	    }
+	    markets.push_back (duration (start));
+
+	    if (this-> _dvfsEnabled) {
+		auto start = std::chrono::steady_clock::now ();
+		if (this-> _placementEnabled) this-> _dvfs.setCeilings (this-> _placement.getFrequencyLimits ());
+		this-> _dvfs.run ();
+		dvfs.push_back (duration (start));
+	    }
+
+	    double energy = 0.0;
+	    std::map <std::string, double> used;
+	    for (auto & vm : this-> _vms) {
+		auto e = this-> _backend-> readEnergy (vm-> id ());
+		if (vm.get () != away) {
+		    used [vm-> id ()] = e - vmEnergy [vm-> id ()];
+		    energy += e - vmEnergy [vm-> id ()];
+		}
+		vmEnergy [vm-> id ()] = e;
+	    }
+
+	    start = std::chrono::steady_clock::now ();
+	    this-> _energy.run (energy);
+	    attributions.push_back (duration (start));
+
+	    for (auto & it : used) {
+		misattributed += std::abs (this-> _energy.getLastEnergy (it.first) - it.second);
+		attributed += it.second;
+	    }
+	}
+
+	// The cycles executed during the run, and their energy
+	double endWanted, endExecuted, endEnergy;
+	this-> _backend-> readCycles (endWanted, endExecuted, endEnergy);
+	json cycles = {
+	    {"satisfaction", endWanted > wanted ? (endExecuted - executed) / (endWanted - wanted) : 1.0},
+	    {"energy-per-cycle", endExecuted > executed ? (endEnergy - energy) / (endExecuted - executed) : 0.0}
+	};
+
+	auto & frequencies = this-> _backend-> readFrequencies ();
+	double meanFrequency = std::accumulate (frequencies.begin (), frequencies.end (), 0.0) / std::max ((std::size_t) 1, frequencies.size ()) / 1000.0;
+
+	json placement;
+	if (this-> _placementEnabled) {
+	    auto logs = this-> _placement.dumpLogs ();
+	    float minLoad = -1.0f, maxLoad = 0.0f;
+	    for (auto & c : logs ["caches"]) {
+		auto load = c ["load"].get<float> ();
+		if (minLoad < 0.0f || load < minLoad) minLoad = load;
+		maxLoad = std::max (maxLoad, load);
+	    }
+
+	    placement = {{"caches", this-> _placement.nbCaches ()}, {"moves", this-> _placement.nbMoves () - moves}, {"min-load", minLoad}, {"max-load", maxLoad}};
+	}
+
+	if (away != nullptr) this-> _client.attach (away);
+	for (auto & vm : this-> _vms) {
+	    this-> _client.detach (vm-> id ());
+	}
+
+	auto stats = [] (const std::vector <double> & values) {
+	    double mean = values.empty () ? 0.0 : std::accumulate (values.begin (), values.end (), 0.0) / values.size ();
+	    return json {
+		{"mean-us", mean},
+		{"p50-us", Report::percentile (values, 0.5)},
+		{"p99-us", Report::percentile (values, 0.99)},
+		{"max-us", Report::percentile (values, 1.0)}
+	    };
+	};
+
+	json j;
+	j ["vms"] = this-> _vms.size ();
+	j ["vcpus"] = this-> _nbVcpus;
+	j ["cpus"] = this-> _backend-> nbCpus ();
+	j ["ticks"] = ticks;
+	j ["update"] = stats (updates);
+	j ["market"] = stats (markets);
+	j ["writes"] = this-> _backend-> nbWrites () - writes;
+	j ["mean-frequency"] = meanFrequency;
+	j ["cycles"] = cycles;
+	if (this-> _placementEnabled) {
+	    placement ["time"] = stats (placements);
+	    j ["placement"] = placement;
+	}
+
+	// The energy moved from a VM to another by the attribution (each misattributed joule is counted twice, on the VM paying it and on the VM that should have)
+	j ["energy"] = {{"time", stats (attributions)}, {"error", attributed > 0.0 ? misattributed / (2.0 * attributed) : 0.0}};
+	if (this-> _powerCapEnabled) {
+	    auto logs = this-> _powerCap.dumpLogs ();
+	    j ["power-cap"] = {
+		{"budget", logs ["budget"]},
+		{"mean-power", powers.empty () ? 0.0 : std::accumulate (powers.begin (), powers.end (), 0.0) / powers.size ()},
+		{"p99-power", Report::percentile (powers, 0.99)},
+		{"mean-supply", supplies.empty () ? 0.0 : std::accumulate (supplies.begin (), supplies.end (), 0.0) / supplies.size ()},
+		{"over", powers.empty () ? 0.0 : ((double) std::count_if (powers.begin (), powers.end (), [&logs] (double p) { return p > logs ["budget"].get<double> (); })) / powers.size ()}
+	    };
+	}
+
+	if (this-> _dvfsEnabled) {
+	    j ["dvfs"] = {{"time", stats (dvfs)}, {"writes", this-> _dvfs.nbWrites () - frequencyWrites}};
+	}
+
+	return j;
+    }
+
+    void LoadTest::shuffle () {
+	std::uniform_real_distribution <double> demand (0.0, 1.0);
+	std::uniform_real_distribution <double> ipc (0.5, 2.5);
+	for (auto & vm : this-> _vms) {
+	    for (int i = 0 ; i < vm-> vcpus () ; i++) {
+		this-> _backend-> setDemand (vm-> id (), i, demand (this-> _random));
+		this-> _backend-> setIPC (vm-> id (), i, ipc (this-> _random));
+	    }
+	}
+    }
+
+    void LoadTest::print (const json & result, std::ostream & out) {
+	auto line = [&out] (const json & s) {
+	    out << s ["mean-us"].get<double> () << " us (p50 " << s ["p50-us"].get<double> () << ", p99 " << s ["p99-us"].get<double> ()
+		<< ", max " << s ["max-us"].get<double> () << ")" << std::endl;
+	};
+
+	out << std::fixed << std::setprecision (3);
+	out << "host   : " << result ["vms"].get<unsigned long> () << " vms, " << result ["vcpus"].get<unsigned long> () << " vcpus, "
+	    << result ["cpus"].get<int> () << " cpus, " << result ["ticks"].get<unsigned long> () << " market ticks" << std::endl;
+	out << "update : "; line (result ["update"]);
+	out << "market : "; line (result ["market"]);
+	out << "writes : " << result ["writes"].get<unsigned long> () << " limits written" << std::endl;
+	out << "cycles : " << result ["cycles"]["satisfaction"].get<double> () * 100.0 << " % of the wanted cycles executed, "
+	    << result ["cycles"]["energy-per-cycle"].get<double> () << " energy per cycle (1 at the maximal frequency), "
+	    << result ["mean-frequency"].get<double> () << " MHz per cpu" << std::endl;
+	out << "energy : "; line (result ["energy"]["time"]);
+	out << "         " << result ["energy"]["error"].get<double> () * 100.0 << " % of the energy misattributed" << std::endl;
+	if (result.contains ("placement")) {
+	    auto & p = result ["placement"];
+	    out << "place  : "; line (p ["time"]);
+	    out << "         " << p ["caches"].get<unsigned long> () << " caches, " << p ["moves"].get<unsigned long> () << " moves, "
+		<< p ["min-load"].get<float> () << " to " << p ["max-load"].get<float> () << " vcpus per cache" << std::endl;
+	}
+
+	if (result.contains ("power-cap")) {
+	    auto & p = result ["power-cap"];
+	    out << "power  : " << p ["mean-power"].get<double> () << " % mean (p99 " << p ["p99-power"].get<double> () << ") for a budget of "
+		<< p ["budget"].get<double> () << " %, " << p ["over"].get<double> () * 100.0 << " % of the ticks over the budget, "
+		<< p ["mean-supply"].get<double> () * 100.0 << " % of the cpus sold" << std::endl;
+	}
+
+	if (result.contains ("dvfs")) {
+	    auto & d = result ["dvfs"];
+	    out << "dvfs   : "; line (d ["time"]);
+	    out << "         " << d ["writes"].get<unsigned long> () << " frequencies written" << std::endl;
+	}
+    }
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <random>
+#include <monitor/libvirt/_.hh>
+#include <monitor/libvirt/controller/fake_backend.hh>
+#include <monitor/utils/config.hh>
+#include <server/market/accounting.hh>
+#include <server/market/vcpu.hh>
+#include <server/market/cpu.hh>
+#include <server/placement/numa.hh>
+#include <server/power/dvfs.hh>
+#include <server/power/energy.hh>
+#include <server/power/cap.hh>
+#include <nlohmann/json.hpp>
+
+namespace sim {
+
+    /**
+     * A load test of the control loop of the cpu market, on a host that only exists in memory (cf. FakeBackend)
+     * Contrary to the Host, the controllers are the real ones : they read the usage and placement of the vcpus, and write the quotas through the backend
+     * The ticks are executed back to back, the vcpus consuming in real time, so the cost of the loop can be measured for a large number of vcpus
+     */
+    class LoadTest {
+
+	/// The client owning the running VMs, and the fake host
+	monitor::libvirt::LibvirtClient _client;
+
+	/// The fake host (owned by the client)
+	monitor::libvirt::control::FakeBackend * _backend;
+
+	/// The accounting of the money of the VMs
+	server::market::Accounting _accounting;
+
+	/// The configuration of the markets
+	server::market::VCPUMarketConfig _config;
+
+	/// The vcpu level market
+	server::market::VCPUMarket _vcpuMarket;
+
+	/// The VM level market
+	server::market::CpuMarket _cpuMarket;
+
+	/// The placement of the VMs on the numa nodes and caches of the fake host
+	server::placement::NumaPlacement _placement;
+
+	/// True iif the VMs are placed (cf. enablePlacement)
+	bool _placementEnabled = false;
+
+	/// The actuator setting the frequency of the cpus of the fake host
+	server::power::DvfsActuator _dvfs;
+
+	/// True iif the frequency of the cpus is set after each market tick (cf. enableDvfs)
+	bool _dvfsEnabled = false;
+
+	/// The controller of the power of the fake host
+	server::power::PowerCap _powerCap;
+
+	/// True iif the supply of the market follows the power of the host (cf. enablePowerCap)
+	bool _powerCapEnabled = false;
+
+	/// The attribution of the energy of the fake host to the VMs
+	server::power::EnergyAttribution _energy;
+
+	/// The VMs of the test
+	std::vector <std::unique_ptr <monitor::libvirt::LibvirtVM> > _vms;
+
+	/// The generator of the demands of the vcpus
+	std::mt19937 _random;
+
+	/// The number of vcpus of the test
+	unsigned long _nbVcpus = 0;
+
+    public:
+
+	/**
+	 * @params:
+	 *   - cfg: the configuration of the cpu market
+	 *   - nbCpus: the number of cpus of the fake host
+	 */
+	LoadTest (const server::market::VCPUMarketConfig & cfg, int nbCpus);
+
+	/**
+	 * Start a VM on the fake host, and enable its controllers
+	 * @params:
+	 *   - spec: the specification of the VM (as given to the dio-client)
+	 */
+	void add (const monitor::utils::config::dict & spec);
+
+	/**
+	 * Place the VMs on the numa nodes and caches of the fake host at each market tick
+	 * @info: one VM then leaves, and comes back every ten ticks, to measure the cost of the rebalance
+	 * @info: the cpus of the fake host can be slowed down by the frequency tiers, down to half the frequency of the market
+	 * @params:
+	 *   - nbNodes: the number of numa nodes of the host
+	 *   - llcsPerNode: the number of last level caches in each node
+	 *   - cfg: the configuration of the placement
+	 */
+	void enablePlacement (unsigned int nbNodes, unsigned int llcsPerNode, const server::placement::NumaPlacementConfig & cfg);
+
+	/**
+	 * Set the frequency of the cpus of the fake host after each market tick
+	 * @params:
+	 *   - cfg: the configuration of the actuator
+	 */
+	void enableDvfs (const server::power::DvfsConfig & cfg);
+
+	/**
+	 * Keep the power of the fake host under a budget by changing the supply of the market before each tick
+	 * @params:
+	 *   - cfg: the configuration of the controller, its budget is a percentage of the power of the fake host at full load (all the cpus busy at the maximal frequency)
+	 */
+	void enablePowerCap (const server::power::PowerCapConfig & cfg);
+
+	/**
+	 * Run the control loop
+	 * @params:
+	 *   - ticks: the number of market ticks (each one preceded by two updates of the vcpus)
+	 * @returns: the time spent in each part of the loop
+	 */
+	nlohmann::json run (unsigned long ticks);
+
+	/**
+	 * Print the result of a run
+	 */
+	static void print (const nlohmann::json & result, std::ostream & out);
+
+    private:
+
+	/**
+	 * Change the demand of the vcpus of the VMs randomly
+	 */
+	void shuffle ();
+
+    };
+
+}
@@ -0,0 +1,295 @@
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <map>
+#include <sys/sysinfo.h>
+#include <monitor/foreign/CLI11.hpp>
+#include <monitor/utils/log.hh>
+#include <sim/yaml.hh>
+#include <sim/host.hh>
+#include <sim/load.hh>
+#include <sim/check.hh>
+#include <sim/bench.hh>
+#include <sim/cluster.hh>
+
+using namespace monitor::utils;
+using json = nlohmann::json;
+
+/**
+ * The options of the simulation
+ */
+struct options {
+    std::string scenario = "";
+    std::string trace = "";
+    std::string config = "";
+    std::string output = "";
+    std::string mode = "";
+    int nbCpus = get_nprocs ();
+    int frequency = 1000;
+    unsigned long duration = 7200;
+    float tolerance = 95.0f;
+    bool noMarket = false;
+    unsigned long load = 0;
+    int vcpusPerVM = 4;
+    unsigned long ticks = 60;
+    unsigned int numa = 0;
+    unsigned int llcsPerNode = 2;
+    unsigned int tiers = 1;
+    bool dvfs = false;
+    float powerCap = 0.0f;
+    bool forecast = false;
+    unsigned long check = 0;
+    unsigned long seed = 0;
+    unsigned int threads = 0;
+    unsigned int bench = 0;
+    unsigned int cluster = 0;
+    unsigned long rounds = 4;
+    std::string migrate = "";
+    sim::WorkloadModel model;
+};
+
+std::string readFile (const std::string & path) {
+    std::ifstream f (path);
+    if (!f.good ()) throw file_error ("cannot read " + path);
+
+    std::stringstream ss;
+    ss << f.rdbuf ();
+    return ss.str ();
+}
+
+/**
+ * Create the VMs of a scenario (cf. test/scenarios)
+ * @returns: the configuration of the cpu market of the scenario (null if there is none)
+ */
+json loadScenario (const options & opts, std::vector <std::tuple <std::string, config::dict, sim::Workload> > & vms) {
+    auto j = sim::parseYaml (readFile (opts.scenario));
+    for (auto & group : j.at ("vms")) {
+	auto name = group.at ("name").get<std::string> ();
+	auto vcpus = group.value ("vcpus", 1);
+	for (int i = 0 ; i < group.value ("instances", 1) ; i++) {
+	    auto spec = sim::vmSpec (name + "-" + std::to_string (i), vcpus, group.value ("memory", 2048), group.value ("frequency", 1000), group.value ("memorySLA", 0.5f));
+	    auto test = group.contains ("test") ? group ["test"] : json ();
+	    vms.emplace_back (name, spec, sim::Workload::fromTest (test, vcpus, opts.model));
+	}
+    }
+
+    return j.contains ("cpu-market") ? j ["cpu-market"] : json ();
+}
+
+/**
+ * Create the VMs of a control log (/var/log/dio/control-log.json), whose consumptions are replayed
+ * @info: the consumptions of the vcpus were bounded by the quotas of the recorded run, they are replayed as the demands
+ */
+void loadTrace (const options & opts, std::vector <std::tuple <std::string, config::dict, sim::Workload> > & vms) {
+    std::ifstream f (opts.trace);
+    if (!f.good ()) throw file_error ("cannot read " + opts.trace);
+
+    // The samples of each VM, by market tick
+    std::map <std::string, std::pair <unsigned long, std::vector <std::vector <unsigned long> > > > samples;
+    std::string line;
+    unsigned long tick = 0;
+    while (std::getline (f, line)) {
+	if (line.empty ()) continue;
+	auto j = json::parse (line);
+	if (j.contains ("cpu-control")) {
+	    for (auto & it : j ["cpu-control"].items ()) {
+		std::vector <unsigned long> vcpus;
+		for (auto & vt : it.value ()) vcpus.push_back (vt.value ("cycles", 0UL));
+
+		auto fnd = samples.find (it.key ());
+		if (fnd == samples.end ()) {
+		    samples [it.key ()] = {tick, {vcpus}};
+		} else {
+		    auto & s = fnd-> second;
+		    s.second.resize (tick - s.first, std::vector <unsigned long> (vcpus.size (), 0)); // the VM did not appear in some ticks
+		    s.second.push_back (vcpus);
+		}
+	    }
+	}
+
+	tick += 1;
+    }
+
+    for (auto & it : samples) {
+	int vcpus = it.second.second [0].size ();
+	auto spec = sim::vmSpec (it.first, vcpus, 2048, opts.frequency, 0.5f);
+	vms.emplace_back (it.first, spec, sim::Workload::fromTrace (it.second.first, it.second.second));
+    }
+}
+
+int main (int argc, char ** argv) {
+    CLI::App app {"Offline simulation of the cpu market of the dio-monitor"};
+
+    options opts;
+    auto scenario = app.add_option ("--scenario", opts.scenario, "the scenario whose VMs are simulated (yml file of test/scenarios)");
+    auto trace = app.add_option ("--trace", opts.trace, "the control log whose consumptions are replayed (control-log.json)");
+    auto load = app.add_option ("--load", opts.load, "load test the control loop on a fake host with this number of vcpus, instead of simulating VMs");
+    auto check = app.add_option ("--check", opts.check, "check the properties of the redistribution of the cpu market on this number of random instances, instead of simulating VMs");
+    scenario-> excludes (trace);
+    load-> excludes (scenario);
+    load-> excludes (trace);
+    check-> excludes (scenario);
+    check-> excludes (trace);
+    check-> excludes (load);
+    auto cluster = app.add_option ("--cluster", opts.cluster, "test the cluster coordinator on this number of fake hosts answering over loopback, instead of simulating VMs");
+    cluster-> excludes (scenario);
+    cluster-> excludes (trace);
+    cluster-> excludes (load);
+    cluster-> excludes (check);
+    app.add_option ("--config", opts.config, "the configuration of the cpu market (cpu-market.json), replacing the configuration of the scenario");
+    app.add_option ("--mode", opts.mode, "the mode of the cpu market (vcpu or vm), replacing the mode of the configuration");
+    app.add_option ("--cpus", opts.nbCpus, "the number of cpus of the simulated host (default is the number of cpus of this machine)");
+    app.add_option ("--frequency", opts.frequency, "the frequency of the vcpus of the traced VMs, and of the VMs of the load test in MHz");
+    app.add_option ("--duration", opts.duration, "the maximal duration of the simulation in seconds");
+    app.add_option ("--tolerance", opts.tolerance, "the percentage of the entitlement of a VM under which its SLA is violated");
+    app.add_option ("--run-length", opts.model.runLength, "the duration of a run of a phoronix benchmark at full speed in seconds");
+    app.add_option ("--request-cost", opts.model.requestCost, "the cpu time of a request of a deathstar benchmark in microseconds");
+    app.add_option ("--output", opts.output, "the file in which the report is written in json");
+    app.add_flag ("--no-market", opts.noMarket, "simulate the host without market (the VMs are never capped)");
+    app.add_option ("--vcpus-per-vm", opts.vcpusPerVM, "the number of vcpus of the VMs of the load test");
+    app.add_option ("--ticks", opts.ticks, "the number of market ticks of the load test");
+    app.add_option ("--numa", opts.numa, "place the VMs of the load test on a fake host with this number of numa nodes");
+    app.add_option ("--llcs-per-node", opts.llcsPerNode, "the number of last level caches in each numa node of the load test");
+    app.add_option ("--market-threads", opts.threads, "the number of threads of the cpu market, replacing the threads of the configuration");
+    app.add_option ("--bench", opts.bench, "benchmark the cpu market on an offline host of --load vcpus with 1 to this number of threads, instead of the load test");
+    app.add_option ("--rounds", opts.rounds, "the number of clearings of the cluster coordinator, or of periods of the migration orchestrators (each one after --ticks market ticks)");
+    app.add_option ("--migrate", opts.migrate, "run the migration orchestrators of the --cluster hosts with this configuration (migration.json, its peers and period are replaced), instead of the cluster coordinator")-> needs (cluster);
+    app.add_option ("--seed", opts.seed, "the seed of the random instances of the check");
+    app.add_flag ("--forecast", opts.forecast, "the bids of the cpu market are the forecast demand of the vcpus (cf. the forecast of cpu-market.json), instead of their slope");
+    app.add_flag ("--dvfs", opts.dvfs, "set the frequency of the cpus of the load test from the outcome of the market");
+    app.add_option ("--power-cap", opts.powerCap, "keep the power of the fake host of the load test under this percentage of its power at full load, by limiting the cycles sold by the market");
+    app.add_option ("--frequency-tiers", opts.tiers, "spread the frequency of the VMs of the load test on this number of tiers (from --frequency down to --frequency / tiers), and place them by tier");
+
+    try {
+	app.parse (argc, argv);
+	if (opts.scenario == "" && opts.trace == "" && opts.load == 0 && opts.check == 0 && opts.cluster == 0) throw command_line_error ("a scenario, a trace, a load, a check or a cluster is needed");
+
+	std::vector <std::tuple <std::string, config::dict, sim::Workload> > vms;
+	json market;
+	if (opts.scenario != "") market = loadScenario (opts, vms);
+	else if (opts.trace != "") loadTrace (opts, vms);
+
+	if (opts.config != "") market = json::parse (readFile (opts.config));
+	if (market.is_null ()) throw command_line_error ("a cpu market configuration is needed (--config)");
+	if (opts.mode != "") market ["mode"] = opts.mode;
+
+	bool enabled = !opts.noMarket && market.value ("enable", true);
+	auto cfg = server::market::VCPUMarketConfig::parse (market);
+	if (opts.forecast) cfg.forecast.enabled = true;
+	if (opts.threads != 0) cfg.threads = opts.threads;
+
+	if (opts.check != 0) {
+	    sim::PropertyCheck check (cfg, opts.seed);
+	    auto result = check.run (opts.check);
+	    sim::PropertyCheck::print (result, std::cout);
+	    if (opts.output != "") {
+		std::ofstream out (opts.output);
+		out << result.dump (1) << std::endl;
+	    }
+
+	    return sim::PropertyCheck::passed (result) ? 0 : 1;
+	}
+
+	if (opts.cluster != 0) {
+	    if (opts.vcpusPerVM <= 0) throw command_line_error ("the number of vcpus per VM must be positive");
+
+	    // The first host is full (twice more vcpus than cpus, all busy), the others are half idle
+	    sim::ClusterTest test (cfg, opts.cluster, opts.nbCpus);
+	    for (unsigned int h = 0 ; h < opts.cluster ; h++) {
+		int vcpus = h == 0 ? opts.nbCpus * 2 : std::max (1, opts.nbCpus / 2);
+		for (int i = 0 ; i * opts.vcpusPerVM < vcpus ; i++) {
+		    auto n = std::min (opts.vcpusPerVM, vcpus - i * opts.vcpusPerVM);
+		    auto name = "host" + std::to_string (h) + "-" + std::to_string (i);
+		    test.add (h, sim::vmSpec (name, n, 2048, opts.frequency, 0.5f), h == 0 ? 0.9 : 0.5);
+		}
+	    }
+
+	    json result;
+	    if (opts.migrate != "") {
+		result = test.orchestrate (opts.rounds, opts.ticks, server::cluster::MigrationConfig::parse (json::parse (readFile (opts.migrate))));
+		sim::ClusterTest::printOrchestrated (result, std::cout);
+	    } else {
+		result = test.run (opts.rounds, opts.ticks, server::cluster::ClusterConfig ());
+		sim::ClusterTest::print (result, std::cout);
+	    }
+
+	    if (opts.output != "") {
+		std::ofstream out (opts.output);
+		out << result.dump (1) << std::endl;
+	    }
+
+	    return sim::ClusterTest::passed (result) ? 0 : 1;
+	}
+
+	if (opts.load != 0) {
+	    if (opts.vcpusPerVM <= 0) throw command_line_error ("the number of vcpus per VM must be positive");
+	    if (opts.bench != 0) {
+		sim::MarketBench bench (cfg, opts.nbCpus, opts.load, opts.vcpusPerVM, opts.ticks);
+		auto result = bench.run (opts.bench);
+		sim::MarketBench::print (result, std::cout);
+		if (opts.output != "") {
+		    std::ofstream out (opts.output);
+		    out << result.dump (1) << std::endl;
+		}
+
+		return 0;
+	    }
+
+	    sim::LoadTest test (cfg, opts.nbCpus);
+	    for (unsigned long i = 0 ; i * opts.vcpusPerVM < opts.load ; i++) {
+		auto vcpus = std::min ((unsigned long) opts.vcpusPerVM, opts.load - i * opts.vcpusPerVM);
+		auto tiers = std::max (1u, opts.tiers);
+		auto frequency = opts.frequency * (int) (tiers - i % tiers) / (int) tiers;
+		test.add (sim::vmSpec ("load-" + std::to_string (i), vcpus, 2048, frequency, 0.5f));
+	    }
+
+	    if (opts.numa != 0 || opts.tiers > 1) {
+		server::placement::NumaPlacementConfig placement;
+		placement.frequencyTiers = opts.tiers > 1;
+		test.enablePlacement (std::max (1u, opts.numa), opts.llcsPerNode, placement);
+	    }
+
+	    if (opts.dvfs) test.enableDvfs (server::power::DvfsConfig ());
+	    if (opts.powerCap > 0.0f) {
+		server::power::PowerCapConfig cap;
+		cap.watts = opts.powerCap;
+		test.enablePowerCap (cap);
+	    }
+
+	    auto result = test.run (opts.ticks);
+	    sim::LoadTest::print (result, std::cout);
+	    if (opts.output != "") {
+		std::ofstream out (opts.output);
+		out << result.dump (1) << std::endl;
+	    }
+
+	    return 0;
+	}
+
+	sim::Host host (cfg, opts.nbCpus, opts.tolerance / 100.0f, enabled);
+	for (auto & it : vms) {
+	    host.add (std::get <0> (it), std::get <1> (it), std::move (std::get <2> (it)));
+	}
+
+	auto & report = host.run (opts.duration);
+	report.print (std::cout);
+	if (opts.output != "") {
+	    std::ofstream out (opts.output);
+	    out << report.dump ().dump (1) << std::endl;
+	}
+
+	return 0;
+    } catch (const CLI::ParseError & e) {
+	return app.exit (e);
+    } catch (const sim::yaml_error & e) {
+	logging::error ("Invalid scenario, line", e.line, ":", e.msg);
+    } catch (const config::config_error & e) {
+	e.print ();
+    } catch (const exception & e) {
+	logging::error (e.msg);
+    } catch (const json::exception & e) {
+	logging::error ("Invalid json :", e.what ());
+    }
+
+    return 1;
+}
@@ -0,0 +1,191 @@
+#include "report.hh"
+#include <algorithm>
+#include <numeric>
+#include <iomanip>
+#include <map>
+
+using json = nlohmann::json;
+
+namespace sim {
+
+    Report::Report (float tolerance) :
+	_tolerance (tolerance)
+    {}
+
+    int Report::addVM (const std::string & name, const std::string & group) {
+	vm_stats s;
+	s.name = name;
+	s.group = group;
+	this-> _vms.push_back (s);
+
+	return this-> _vms.size () - 1;
+    }
+
+    void Report::record (int vm, unsigned long demand, unsigned long received, unsigned long nominal, float delay, unsigned long wanted, unsigned long allowed) {
+	auto & s = this-> _vms [vm];
+	auto entitled = std::min (demand, nominal);
+
+	s.demand += demand;
+	s.received += received;
+	s.seconds += 1;
+	if (received < entitled * this-> _tolerance) {
+	    s.violations += 1;
+	    s.deficit += entitled - received;
+	}
+
+	if (wanted < demand) {
+	    s.throttled += demand - wanted;
+	    if (wanted < demand * this-> _tolerance) s.throttledSeconds += 1;
+	}
+
+	if (allowed > received) s.unused += allowed - received;
+
+	if (delay > 0.0f || !s.delays.empty ()) s.delays.push_back (delay);
+    }
+
+    void Report::fairness (double j) {
+	this-> _fairness.push_back (j);
+    }
+
+    void Report::market (double micros, unsigned long entries) {
+	this-> _market.push_back (micros);
+	this-> _entries = std::max (this-> _entries, entries);
+    }
+
+    void Report::job (int vm, long completion, float ideal) {
+	this-> _vms [vm].completion = completion;
+	this-> _vms [vm].ideal = ideal;
+    }
+
+    void Report::duration (unsigned long seconds) {
+	this-> _duration = seconds;
+    }
+
+    /**
+     * ================================================================================
+     * ================================================================================
+     * =========================            OUTPUT            =========================
+     * ================================================================================
+     * ================================================================================
+     */
+
+    json Report::dump () const {
+	json vms = json::object ();
+	for (auto & s : this-> _vms) {
+	    json v;
+	    v ["group"] = s.group;
+	    v ["demand"] = s.demand / 1000000.0;
+	    v ["received"] = s.received / 1000000.0;
+	    v ["deficit"] = s.deficit / 1000000.0;
+	    v ["violations"] = s.violations;
+	    v ["throttled"] = s.throttled / 1000000.0;
+	    v ["throttled-seconds"] = s.throttledSeconds;
+	    v ["unused"] = s.unused / 1000000.0;
+	    v ["seconds"] = s.seconds;
+	    if (s.ideal > 0) {
+		v ["completion"] = s.completion;
+		v ["slowdown"] = s.completion < 0 ? -1.0 : s.completion / s.ideal;
+	    }
+
+	    if (!s.delays.empty ()) {
+		std::vector <double> d (s.delays.begin (), s.delays.end ());
+		v ["delay-p99"] = percentile (d, 0.99);
+	    }
+
+	    vms [s.name] = v;
+	}
+
+	double mean = this-> _market.empty () ? 0.0 : std::accumulate (this-> _market.begin (), this-> _market.end (), 0.0) / this-> _market.size ();
+	double fair = this-> _fairness.empty () ? 1.0 : std::accumulate (this-> _fairness.begin (), this-> _fairness.end (), 0.0) / this-> _fairness.size ();
+
+	json j;
+	j ["duration"] = this-> _duration;
+	j ["fairness"] = fair;
+	j ["fairness-p1"] = percentile (this-> _fairness, 0.01);
+	j ["market"] = {
+	    {"ticks", this-> _market.size ()},
+	    {"entries", this-> _entries},
+	    {"mean-us", mean},
+	    {"p50-us", percentile (this-> _market, 0.5)},
+	    {"p99-us", percentile (this-> _market, 0.99)},
+	    {"max-us", percentile (this-> _market, 1.0)}
+	};
+	j ["vms"] = vms;
+
+	return j;
+    }
+
+    void Report::print (std::ostream & out) const {
+	struct group {
+	    unsigned long vms = 0, seconds = 0, violations = 0, throttledSeconds = 0;
+	    double demand = 0, received = 0, deficit = 0, throttled = 0, unused = 0;
+	    std::vector <double> slowdowns, delays;
+	    unsigned long unfinished = 0;
+	};
+
+	std::map <std::string, group> groups;
+	for (auto & s : this-> _vms) {
+	    auto & g = groups [s.group];
+	    g.vms += 1;
+	    g.seconds += s.seconds;
+	    g.violations += s.violations;
+	    g.demand += s.demand;
+	    g.received += s.received;
+	    g.deficit += s.deficit;
+	    g.throttled += s.throttled;
+	    g.throttledSeconds += s.throttledSeconds;
+	    g.unused += s.unused;
+	    if (s.ideal > 0) {
+		if (s.completion < 0) g.unfinished += 1;
+		else g.slowdowns.push_back (s.completion / s.ideal);
+	    }
+	    g.delays.insert (g.delays.end (), s.delays.begin (), s.delays.end ());
+	}
+
+	auto j = this-> dump ();
+	out << std::fixed << std::setprecision (3);
+	out << "duration : " << this-> _duration << " s" << std::endl;
+	out << "fairness : " << j ["fairness"].get<double> () << " (mean jain index), " << j ["fairness-p1"].get<double> () << " (p1)" << std::endl;
+	out << "market   : " << this-> _market.size () << " ticks, " << this-> _entries << " entries, "
+	    << j ["market"]["mean-us"].get<double> () << " us/tick (p50 " << j ["market"]["p50-us"].get<double> ()
+	    << ", p99 " << j ["market"]["p99-us"].get<double> () << ", max " << j ["market"]["max-us"].get<double> () << ")" << std::endl;
+
+	for (auto & it : groups) {
+	    auto & g = it.second;
+	    out << "[" << it.first << "] " << g.vms << " vms" << std::endl;
+	    out << "    satisfaction : " << (g.demand == 0 ? 1.0 : g.received / g.demand) << std::endl;
+	    out << "    sla          : " << (g.seconds == 0 ? 0.0 : (double) g.violations / g.seconds * 100.0) << " % of the seconds in violation, "
+		<< g.deficit / 1000000.0 << " cpu.s missing" << std::endl;
+	    out << "    quotas       : " << (g.seconds == 0 ? 0.0 : (double) g.throttledSeconds / g.seconds * 100.0) << " % of the seconds throttled, "
+		<< g.throttled / 1000000.0 << " cpu.s throttled, " << g.unused / 1000000.0 << " cpu.s allocated and unused" << std::endl;
+	    if (!g.slowdowns.empty () || g.unfinished != 0) {
+		out << "    jobs         : slowdown mean " << (g.slowdowns.empty () ? 0.0 : std::accumulate (g.slowdowns.begin (), g.slowdowns.end (), 0.0) / g.slowdowns.size ())
+		    << ", p99 " << percentile (g.slowdowns, 0.99) << ", " << g.unfinished << " unfinished" << std::endl;
+	    }
+
+	    if (!g.delays.empty ()) {
+		out << "    delay        : p50 " << percentile (g.delays, 0.5) << " s, p99 " << percentile (g.delays, 0.99) << " s" << std::endl;
+	    }
+	}
+    }
+
+    double Report::jain (const std::vector <double> & values) {
+	double sum = 0, sq = 0;
+	for (auto & v : values) {
+	    sum += v;
+	    sq += v * v;
+	}
+
+	if (values.empty () || sq == 0) return 1.0;
+	return (sum * sum) / (values.size () * sq);
+    }
+
+    double Report::percentile (std::vector <double> values, double p) {
+	if (values.empty ()) return 0.0;
+
+	auto i = std::min (values.size () - 1, (std::size_t) (p * (values.size () - 1) + 0.5));
+	std::nth_element (values.begin (), values.begin () + i, values.end ());
+	return values [i];
+    }
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+namespace sim {
+
+    /**
+     * The metrics of a simulation
+     *  - fairness: the Jain index of the satisfaction (received / demand) of the VMs that want cpu, at each second
+     *  - sla: a VM is in violation when it receives less than the cpu it is entitled to (min (demand, nominal)), with a tolerance
+     *  - quotas: the cpu time refused by the quotas of the VMs (throttled), and the cpu time allowed by the quotas and not consumed (unused)
+     *  - market: the cpu time taken by the execution of the market at each tick
+     *  - jobs: the completion time of the jobs (phoronix) compared to their completion time at full speed
+     *  - delays: the time the queued requests wait (deathstar)
+     */
+    class Report {
+
+	/**
+	 * The metrics of one VM
+	 */
+	struct vm_stats {
+	    /// The name of the VM
+	    std::string name;
+
+	    /// The name of the group of instances of the VM in the scenario
+	    std::string group;
+
+	    /// The total cpu time wanted by the VM in microseconds
+	    double demand = 0;
+
+	    /// The total cpu time received by the VM in microseconds
+	    double received = 0;
+
+	    /// The total cpu time the VM was entitled to and did not receive in microseconds
+	    double deficit = 0;
+
+	    /// The number of seconds the VM was running
+	    unsigned long seconds = 0;
+
+	    /// The number of seconds the VM was in violation of its SLA
+	    unsigned long violations = 0;
+
+	    /// The total cpu time wanted by the VM and refused by its quotas in microseconds
+	    double throttled = 0;
+
+	    /// The number of seconds the quotas refused more than the tolerance of the demand of the VM
+	    unsigned long throttledSeconds = 0;
+
+	    /// The total cpu time allowed by the quotas of the VM and not consumed in microseconds
+	    double unused = 0;
+
+	    /// The delay of the requests at each second (deathstar)
+	    std::vector <float> delays;
+
+	    /// The duration of the job (-1 if it is not a job or not finished)
+	    long completion = -1;
+
+	    /// The duration of the job at full speed
+	    float ideal = 0;
+	};
+
+	/// The share of the entitlement under which a VM is in violation
+	float _tolerance;
+
+	/// The metrics of the VMs
+	std::vector <vm_stats> _vms;
+
+	/// The Jain index of each second
+	std::vector <double> _fairness;
+
+	/// The duration of each market tick in microseconds
+	std::vector <double> _market;
+
+	/// The number of entries of the market (vcpus or VMs)
+	unsigned long _entries = 0;
+
+	/// The number of simulated seconds
+	unsigned long _duration = 0;
+
+    public:
+
+	/**
+	 * @params:
+	 *   - tolerance: the share of the entitlement under which a VM is in violation of its SLA
+	 */
+	Report (float tolerance = 0.95f);
+
+	/**
+	 * Register a VM
+	 * @returns: the index of the VM in the report
+	 */
+	int addVM (const std::string & name, const std::string & group);
+
+	/**
+	 * Record the cpu of a VM during one second
+	 * @params:
+	 *   - vm: the index of the VM
+	 *   - demand: the cpu time wanted by the VM in microseconds
+	 *   - received: the cpu time received by the VM
+	 *   - nominal: the cpu time guaranteed to the VM
+	 *   - delay: the delay of the requests of the VM (0 if it does not serve requests)
+	 *   - wanted: the demand of the VM bounded by its quotas
+	 *   - allowed: the cpu time allowed by the quotas of the VM
+	 */
+	void record (int vm, unsigned long demand, unsigned long received, unsigned long nominal, float delay, unsigned long wanted, unsigned long allowed);
+
+	/**
+	 * Record the fairness of the allocation of one second
+	 */
+	void fairness (double jain);
+
+	/**
+	 * Record the execution of a market tick
+	 * @params:
+	 *   - micros: the duration of the execution in microseconds
+	 *   - entries: the number of entries in the market
+	 */
+	void market (double micros, unsigned long entries);
+
+	/**
+	 * Record the end of the simulation of a job
+	 */
+	void job (int vm, long completion, float ideal);
+
+	/**
+	 * Set the duration of the simulation in seconds
+	 */
+	void duration (unsigned long seconds);
+
+	/**
+	 * @returns: the report in json
+	 */
+	nlohmann::json dump () const;
+
+	/**
+	 * Print a summary of the report (per group of VMs)
+	 */
+	void print (std::ostream & s) const;
+
+	/**
+	 * @returns: the Jain index of a set of values (1 if the set is empty)
+	 */
+	static double jain (const std::vector <double> & values);
+
+	/**
+	 * @returns: the pth percentile of a set of values (0 if the set is empty)
+	 */
+	static double percentile (std::vector <double> values, double p);
+
+    };
+
+}
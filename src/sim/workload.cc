@@ -0,0 +1,133 @@
+#include "workload.hh"
+#include <algorithm>
+#include <monitor/utils/exception.hh>
+
+using json = nlohmann::json;
+
+namespace sim {
+
+    Workload::Workload (kind k, int vcpus) :
+	_kind (k),
+	_vcpus (vcpus)
+    {}
+
+    Workload Workload::fromTest (const json & test, int vcpus, const WorkloadModel & model) {
+	if (test.is_null ()) return Workload (kind::IDLE, vcpus);
+
+	auto type = test.at ("type").get<std::string> ();
+	if (type == "stress") {
+	    Workload w (kind::STRESS, vcpus);
+	    w._start = test.value ("start", 0);
+	    w._end = test.value ("end", 0);
+	    w._nbCpus = std::min (vcpus, test.value ("nb-cpus", vcpus));
+	    return w;
+	} else if (type == "phoronix") {
+	    Workload w (kind::PHORONIX, vcpus);
+	    w._start = test.value ("start", 0);
+	    w._work = ((double) test.value ("nb-run", 1)) * model.runLength * vcpus * 1000000.0;
+	    w._backlog = w._work;
+	    return w;
+	} else if (type == "deathstar") {
+	    Workload w (kind::DEATHSTAR, vcpus);
+	    w._start = test.value ("start", 0);
+	    w._end = test.value ("end", 0);
+	    w._work = ((double) test.value ("nb-per-seconds", 1000)) * model.requestCost;
+	    return w;
+	}
+
+	throw monitor::utils::exception ("unknown test type : " + type);
+    }
+
+    Workload Workload::fromTrace (unsigned long start, std::vector <std::vector <unsigned long> > samples) {
+	Workload w (kind::TRACE, samples.empty () ? 1 : samples [0].size ());
+	w._traceStart = start;
+	w._trace = std::move (samples);
+	return w;
+    }
+
+    bool Workload::isAlive (unsigned long t) const {
+	if (this-> _kind != kind::TRACE) return true;
+	return t >= this-> _traceStart * 2 && t < (this-> _traceStart + this-> _trace.size ()) * 2;
+    }
+
+    bool Workload::isFinished (unsigned long t) const {
+	switch (this-> _kind) {
+	case kind::STRESS : return this-> _end != 0 && t >= this-> _end;
+	case kind::PHORONIX : return this-> _finish >= 0;
+	case kind::DEATHSTAR : return this-> _end != 0 && t >= this-> _end && this-> _backlog == 0;
+	case kind::TRACE : return t >= (this-> _traceStart + this-> _trace.size ()) * 2;
+	default : return true;
+	}
+    }
+
+    void Workload::demand (unsigned long t, std::vector <unsigned long> & demand) const {
+	demand.assign (this-> _vcpus, 0);
+	if (t < this-> _start || (this-> _end != 0 && t >= this-> _end)) {
+	    if (this-> _kind != kind::DEATHSTAR || this-> _backlog == 0) return;
+	}
+
+	switch (this-> _kind) {
+	case kind::STRESS :
+	    for (int i = 0 ; i < this-> _nbCpus ; i++) demand [i] = 1000000;
+	    break;
+	case kind::PHORONIX : {
+	    // The benchmark spreads its work on all the vcpus
+	    auto perVcpu = std::min (1000000.0, this-> _backlog / this-> _vcpus);
+	    for (auto & d : demand) d = (unsigned long) perVcpu;
+	} break;
+	case kind::DEATHSTAR : {
+	    bool arriving = t >= this-> _start && (this-> _end == 0 || t < this-> _end);
+	    auto wanted = (arriving ? this-> _work : 0.0) + this-> _backlog;
+	    auto perVcpu = std::min (1000000.0, wanted / this-> _vcpus);
+	    for (auto & d : demand) d = (unsigned long) perVcpu;
+	} break;
+	case kind::TRACE : {
+	    if (!this-> isAlive (t)) return;
+	    auto & s = this-> _trace [t / 2 - this-> _traceStart];
+	    for (std::size_t i = 0 ; i < s.size () && i < demand.size () ; i++) demand [i] = std::min ((unsigned long) 1000000, s [i]);
+	} break;
+	default : break;
+	}
+    }
+
+    void Workload::consume (unsigned long t, const std::vector <unsigned long> & received) {
+	double sum = 0;
+	for (auto & r : received) sum += r;
+
+	if (this-> _kind == kind::PHORONIX && t >= this-> _start && this-> _finish < 0) {
+	    this-> _backlog = std::max (0.0, this-> _backlog - sum);
+	    if (this-> _backlog < this-> _vcpus) { // less than a microsecond per vcpu, lost in the roundings
+		this-> _backlog = 0;
+		this-> _finish = t + 1;
+	    }
+	} else if (this-> _kind == kind::DEATHSTAR) {
+	    bool arriving = t >= this-> _start && (this-> _end == 0 || t < this-> _end);
+	    this-> _backlog = std::max (0.0, this-> _backlog + (arriving ? this-> _work : 0.0) - sum);
+	}
+    }
+
+    float Workload::delay () const {
+	if (this-> _kind != kind::DEATHSTAR || this-> _work == 0) return 0.0f;
+
+	// The queue is served at the arrival rate when the VM has enough cpu
+	return this-> _backlog / this-> _work;
+    }
+
+    bool Workload::isJob () const {
+	return this-> _kind == kind::PHORONIX;
+    }
+
+    long Workload::completion () const {
+	if (this-> _finish < 0) return -1;
+	return this-> _finish - this-> _start;
+    }
+
+    float Workload::idealCompletion () const {
+	return this-> _work / (this-> _vcpus * 1000000.0);
+    }
+
+    Workload::kind Workload::getKind () const {
+	return this-> _kind;
+    }
+
+}
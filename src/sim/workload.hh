@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <nlohmann/json.hpp>
+
+namespace sim {
+
+    /**
+     * The parameters of the models of the benchmarks
+     */
+    struct WorkloadModel {
+	/// The cpu time of one run of a phoronix benchmark, in seconds per vcpu at full speed
+	float runLength = 30.0f;
+
+	/// The cpu time of one request of a deathstar benchmark in microseconds
+	float requestCost = 100.0f;
+    };
+
+    /**
+     * The cpu demand of the vcpus of a simulated VM
+     * The workloads are the benchmarks of the scenarios (cf. test/scenarios), or the consumptions recorded in a control log
+     */
+    class Workload {
+    public:
+
+	enum class kind {
+	    /// The VM does nothing
+	    IDLE,
+
+	    /// nb-cpus threads that are always running between start and end
+	    STRESS,
+
+	    /// nb-run runs of a benchmark using all the vcpus, the job ends when all the runs are done
+	    PHORONIX,
+
+	    /// requests arriving at a constant rate between start and end, the requests that are not served are queued
+	    DEATHSTAR,
+
+	    /// the consumptions recorded in a control log, one sample per market tick
+	    TRACE
+	};
+
+    private:
+
+	/// The kind of workload
+	kind _kind;
+
+	/// The number of vcpus of the VM
+	int _vcpus;
+
+	/// The second at which the benchmark starts
+	unsigned long _start = 0;
+
+	/// The second at which the benchmark stops (0 if it never stops)
+	unsigned long _end = 0;
+
+	/// The number of vcpus that are busy (stress)
+	int _nbCpus = 0;
+
+	/// The cpu time needed per second (deathstar), or in total (phoronix) in microseconds
+	double _work = 0;
+
+	/// The cpu time that remains to be done (phoronix), or that was not done yet (deathstar)
+	double _backlog = 0;
+
+	/// The second at which the job finished (phoronix)
+	long _finish = -1;
+
+	/// The recorded demands of the vcpus (trace), one entry per market tick
+	std::vector <std::vector <unsigned long> > _trace;
+
+	/// The first market tick of the trace
+	unsigned long _traceStart = 0;
+
+    public:
+
+	/**
+	 * Create the workload of a test of a scenario
+	 * @params:
+	 *   - test: the test of a vm in the scenario (null for an idle VM)
+	 *   - vcpus: the number of vcpus of the VM
+	 *   - model: the parameters of the models
+	 * @throws:
+	 *   - utils::exception: if the type of test is unknown
+	 */
+	static Workload fromTest (const nlohmann::json & test, int vcpus, const WorkloadModel & model);
+
+	/**
+	 * Create the workload replaying a trace
+	 * @params:
+	 *   - start: the first market tick at which the VM was running
+	 *   - samples: the consumptions of the vcpus at each market tick
+	 */
+	static Workload fromTrace (unsigned long start, std::vector <std::vector <unsigned long> > samples);
+
+	/**
+	 * @returns: true iif the VM is running at the second t
+	 */
+	bool isAlive (unsigned long t) const;
+
+	/**
+	 * @returns: true iif the workload will not want any cpu after the second t
+	 */
+	bool isFinished (unsigned long t) const;
+
+	/**
+	 * Compute the cpu time wanted by the vcpus during the second t
+	 * @params:
+	 *   - t: the current second
+	 *   - demand: the demand of each vcpu in microseconds (resized to the number of vcpus)
+	 */
+	void demand (unsigned long t, std::vector <unsigned long> & demand) const;
+
+	/**
+	 * Consume the cpu time given to the vcpus during the second t
+	 * @params:
+	 *   - t: the current second
+	 *   - received: the cpu time given to each vcpu in microseconds
+	 */
+	void consume (unsigned long t, const std::vector <unsigned long> & received);
+
+	/**
+	 * @returns: the time the queued requests will wait (deathstar) in seconds
+	 */
+	float delay () const;
+
+	/**
+	 * @returns: true iif the workload is a job that finishes (phoronix)
+	 */
+	bool isJob () const;
+
+	/**
+	 * @returns: the duration of the job, -1 if it is not finished
+	 */
+	long completion () const;
+
+	/**
+	 * @returns: the duration of the job when all its vcpus run at full speed
+	 */
+	float idealCompletion () const;
+
+	/**
+	 * @returns: the kind of workload
+	 */
+	kind getKind () const;
+
+    private:
+
+	Workload (kind k, int vcpus);
+
+    };
+
+}
@@ -0,0 +1,150 @@
+#include "yaml.hh"
+#include <sstream>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace sim {
+
+    namespace {
+
+	/**
+	 * A non empty line of the document
+	 */
+	struct line {
+	    /// The number of the line in the document
+	    int nb;
+
+	    /// The column of the first character of the content
+	    int indent;
+
+	    /// The content of the line without indentation, and comment
+	    std::string content;
+	};
+
+	std::string trim (const std::string & s) {
+	    auto b = s.find_first_not_of (" \t");
+	    if (b == std::string::npos) return "";
+	    auto e = s.find_last_not_of (" \t\r");
+	    return s.substr (b, e - b + 1);
+	}
+
+	json scalar (const std::string & s) {
+	    if (s.length () >= 2 && (s [0] == '"' || s [0] == '\'') && s.back () == s [0]) return s.substr (1, s.length () - 2);
+	    if (s == "true") return true;
+	    if (s == "false") return false;
+	    if (s == "~" || s == "null") return nullptr;
+
+	    char * end = nullptr;
+	    auto i = strtol (s.c_str (), &end, 10);
+	    if (end != s.c_str () && *end == '\0') return i;
+
+	    auto f = strtod (s.c_str (), &end);
+	    if (end != s.c_str () && *end == '\0') return f;
+
+	    return s;
+	}
+
+	std::vector <line> split (const std::string & content) {
+	    std::vector <line> lines;
+	    std::stringstream ss (content);
+	    std::string l;
+	    int nb = 0;
+	    while (std::getline (ss, l)) {
+		nb += 1;
+		bool quoted = false;
+		for (std::size_t i = 0 ; i < l.length () ; i++) { // removing the comments that are not in strings
+		    if (l [i] == '"' || l [i] == '\'') quoted = !quoted;
+		    else if (l [i] == '#' && !quoted && (i == 0 || l [i - 1] == ' ' || l [i - 1] == '\t')) {
+			l = l.substr (0, i);
+			break;
+		    }
+		}
+
+		auto content = trim (l);
+		if (content.empty () || content == "---") continue;
+		if (l.find ('\t') < l.find_first_not_of (" \t")) throw yaml_error (nb, "tabulations are not allowed in the indentation");
+
+		lines.push_back ({nb, (int) l.find_first_not_of (' '), content});
+	    }
+
+	    return lines;
+	}
+
+	json parseBlock (std::vector <line> & lines, std::size_t & i, int indent);
+
+	/**
+	 * Parse the value of key, on the rest of its line, or in the indented block under it
+	 */
+	json parseValue (std::vector <line> & lines, std::size_t & i, int indent, const std::string & rest) {
+	    if (!rest.empty ()) {
+		i += 1;
+		return scalar (rest);
+	    }
+
+	    i += 1;
+	    if (i < lines.size () && lines [i].indent > indent) return parseBlock (lines, i, lines [i].indent);
+	    if (i < lines.size () && lines [i].indent == indent && lines [i].content.rfind ("- ", 0) == 0) { // sequences can be at the indentation of their key
+		return parseBlock (lines, i, indent);
+	    }
+
+	    return nullptr;
+	}
+
+	json parseSequence (std::vector <line> & lines, std::size_t & i, int indent) {
+	    json arr = json::array ();
+	    while (i < lines.size () && lines [i].indent == indent && (lines [i].content == "-" || lines [i].content.rfind ("- ", 0) == 0)) {
+		auto rest = trim (lines [i].content.substr (1));
+		if (rest.empty ()) {
+		    arr.push_back (parseValue (lines, i, indent, rest));
+		} else if (rest.find (": ") != std::string::npos || rest.back () == ':') {
+		    // The first key of a mapping is on the line of the dash, the line is read again as a mapping indented after the dash
+		    auto offset = (int) (lines [i].content.length () - rest.length ());
+		    lines [i].indent += offset;
+		    lines [i].content = rest;
+		    arr.push_back (parseBlock (lines, i, lines [i].indent));
+		} else {
+		    arr.push_back (scalar (rest));
+		    i += 1;
+		}
+	    }
+
+	    return arr;
+	}
+
+	json parseMapping (std::vector <line> & lines, std::size_t & i, int indent) {
+	    json dict = json::object ();
+	    while (i < lines.size () && lines [i].indent == indent) {
+		auto & l = lines [i];
+		auto sep = l.content.find (':');
+		if (sep == std::string::npos) throw yaml_error (l.nb, "expected a key");
+		if (sep + 1 < l.content.length () && l.content [sep + 1] != ' ') throw yaml_error (l.nb, "expected a space after the key");
+
+		auto key = trim (l.content.substr (0, sep));
+		auto rest = trim (l.content.substr (sep + 1));
+		dict [key] = parseValue (lines, i, indent, rest);
+	    }
+
+	    if (i < lines.size () && lines [i].indent > indent) throw yaml_error (lines [i].nb, "unexpected indentation");
+	    return dict;
+	}
+
+	json parseBlock (std::vector <line> & lines, std::size_t & i, int indent) {
+	    if (lines [i].content == "-" || lines [i].content.rfind ("- ", 0) == 0) return parseSequence (lines, i, indent);
+	    return parseMapping (lines, i, indent);
+	}
+
+    }
+
+    json parseYaml (const std::string & content) {
+	auto lines = split (content);
+	if (lines.empty ()) return nullptr;
+
+	std::size_t i = 0;
+	auto ret = parseBlock (lines, i, lines [0].indent);
+	if (i < lines.size ()) throw yaml_error (lines [i].nb, "unexpected indentation");
+
+	return ret;
+    }
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <nlohmann/json.hpp>
+#include <monitor/utils/exception.hh>
+
+namespace sim {
+
+    struct yaml_error : monitor::utils::exception {
+
+	int line;
+
+	yaml_error (int line, const std::string & msg) :
+	    exception (msg),
+	    line (line)
+	{}
+
+    };
+
+    /**
+     * Read the subset of yaml used by the scenarios of the tests (cf. test/scenarios)
+     * Only block mappings, block sequences, and scalars (integers, floats, booleans, strings) are supported
+     * @params:
+     *   - content: the content of the document
+     * @returns: the document as a json value
+     * @throws:
+     *   - yaml_error: if the document is not in the supported subset
+     */
+    nlohmann::json parseYaml (const std::string & content);
+
+}